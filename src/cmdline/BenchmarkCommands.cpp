@@ -0,0 +1,669 @@
+#pragma region Copyright (c) 2014-2016 OpenRCT2 Developers
+/*****************************************************************************
+ * OpenRCT2, an open source clone of Roller Coaster Tycoon 2.
+ *
+ * OpenRCT2 is the work of many authors, a full list can be found in contributors.md
+ * For more information, visit https://github.com/OpenRCT2/OpenRCT2
+ *
+ * OpenRCT2 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * A full copy of the GNU General Public License can be found in licence.txt
+ *****************************************************************************/
+#pragma endregion
+
+#include <algorithm>
+#include <SDL_timer.h>
+#include "../core/Console.hpp"
+#include "../core/Math.hpp"
+#include "../core/Memory.hpp"
+#include "../core/Path.hpp"
+#include "../core/String.hpp"
+#include "CommandLine.hpp"
+
+#ifndef DISABLE_NETWORK
+#include "../network/network.h"
+#include "../network/NetworkLoadTest.h"
+#endif
+
+extern "C"
+{
+    #include "../cheats.h"
+    #include "../config.h"
+    #include "../drawing/drawing.h"
+    #include "../game.h"
+    #include "../interface/viewport.h"
+    #include "../intro.h"
+    #include "../openrct2.h"
+    #include "../replay.h"
+    #include "../ride/ride.h"
+    #include "../util/sawyercoding.h"
+    #include "../util/util.h"
+    #include "../world/map.h"
+    #include "../world/park.h"
+    #include "../world/scenery.h"
+}
+
+static sint32 _benchmarkZoom     = 0;
+static sint32 _benchmarkRotation = 0;
+static sint32 _benchmarkFrames   = 100;
+static utf8 * _benchmarkSize     = nullptr;
+
+const CommandLineOptionDefinition CommandLine::BenchmarkRenderOptions[]
+{
+    { CMDLINE_TYPE_INTEGER, &_benchmarkZoom,     NAC, "zoom",     "zoom level to render at (0-3)"                 },
+    { CMDLINE_TYPE_INTEGER, &_benchmarkRotation, NAC, "rotation", "view rotation (0-3)"                           },
+    { CMDLINE_TYPE_INTEGER, &_benchmarkFrames,   NAC, "frames",   "number of frames to render, default 100"       },
+    { CMDLINE_TYPE_STRING,  &_benchmarkSize,     NAC, "size",     "frame size as <width>x<height>, default 1920x1080" },
+    OptionTableEnd
+};
+
+static sint32 _benchmarkIterations = 10;
+
+const CommandLineOptionDefinition CommandLine::BenchmarkSawyerCodingOptions[]
+{
+    { CMDLINE_TYPE_INTEGER, &_benchmarkIterations, NAC, "iterations", "number of times to encode each chunk, default 10" },
+    OptionTableEnd
+};
+
+static bool _replayNoVerify = false;
+
+const CommandLineOptionDefinition CommandLine::ReplayOptions[]
+{
+    { CMDLINE_TYPE_SWITCH, &_replayNoVerify, NAC, "no-verify", "do not compare the state with the hashes in the replay" },
+    OptionTableEnd
+};
+
+#ifndef DISABLE_NETWORK
+static sint32 _multiplayerClients  = 8;
+static sint32 _multiplayerDuration = 60;
+static sint32 _multiplayerPort     = NETWORK_DEFAULT_PORT + 1;
+static float  _multiplayerRate     = 1;
+static utf8 * _multiplayerMix      = nullptr;
+
+const CommandLineOptionDefinition CommandLine::BenchmarkMultiplayerOptions[]
+{
+    { CMDLINE_TYPE_INTEGER, &_multiplayerClients,  NAC, "clients",  "number of synthetic clients, default 8"                          },
+    { CMDLINE_TYPE_INTEGER, &_multiplayerDuration, NAC, "duration", "seconds to run the server for, default 60"                      },
+    { CMDLINE_TYPE_INTEGER, &_multiplayerPort,     NAC, "port",     "loopback port to host on, default 11754"                        },
+    { CMDLINE_TYPE_REAL,    &_multiplayerRate,     NAC, "rate",     "actions per second of each client, default 1"                   },
+    { CMDLINE_TYPE_STRING,  &_multiplayerMix,      NAC, "mix",      "weights of <land>,<scenery>,<track>,<rides>,<chat> actions, default 3,3,2,1,1" },
+    OptionTableEnd
+};
+#endif
+
+struct BenchmarkFrameTimes
+{
+    double Total;
+    double Setup;
+    double Sort;
+    double Draw;
+};
+
+static void PrintBenchmarkRow(const utf8 * name, const BenchmarkFrameTimes * frames, sint32 numFrames, double BenchmarkFrameTimes::*field);
+static void PrintEncodeBenchmark(const utf8 * name, size_t decodedLength, size_t encodedLength, uint64 ticks, sint32 iterations);
+
+exitcode_t CommandLine::HandleCommandBenchmarkRender(CommandLineArgEnumerator * enumerator)
+{
+    exitcode_t result = CommandLine::HandleCommandDefault();
+    if (result != EXITCODE_CONTINUE)
+    {
+        return result;
+    }
+
+    const utf8 * rawParkPath;
+    if (!enumerator->TryPopString(&rawParkPath))
+    {
+        Console::Error::WriteLine("Expected a path to a saved park or scenario.");
+        return EXITCODE_FAIL;
+    }
+
+    utf8 parkPath[MAX_PATH];
+    Path::GetAbsolute(parkPath, sizeof(parkPath), rawParkPath);
+
+    sint32 width = 1920;
+    sint32 height = 1080;
+    if (_benchmarkSize != nullptr)
+    {
+        bool validSize = sscanf(_benchmarkSize, "%dx%d", &width, &height) == 2;
+        Memory::Free(_benchmarkSize);
+        _benchmarkSize = nullptr;
+        if (!validSize || width <= 0 || height <= 0)
+        {
+            Console::Error::WriteLine("Expected --size in the form <width>x<height>.");
+            return EXITCODE_FAIL;
+        }
+    }
+    if (_benchmarkZoom < 0 || _benchmarkZoom > 3)
+    {
+        Console::Error::WriteLine("Zoom must be between 0 and 3.");
+        return EXITCODE_FAIL;
+    }
+    if (_benchmarkFrames <= 0)
+    {
+        Console::Error::WriteLine("Number of frames must be positive.");
+        return EXITCODE_FAIL;
+    }
+
+    gOpenRCT2Headless = true;
+    if (!openrct2_initialise())
+    {
+        Console::Error::WriteLine("Error while initialising OpenRCT2.");
+        return EXITCODE_FAIL;
+    }
+
+    drawing_engine_init();
+    if (!rct2_open_file(parkPath))
+    {
+        Console::Error::WriteLine("Unable to load '%s'.", parkPath);
+        drawing_engine_dispose();
+        openrct2_dispose();
+        return EXITCODE_FAIL;
+    }
+
+    gIntroState = INTRO_STATE_NONE;
+    gScreenFlags = SCREEN_FLAGS_PLAYING;
+    gScreenWidth = width;
+    gScreenHeight = height;
+    drawing_engine_resize();
+    rct_drawpixelinfo * dpi = drawing_engine_get_dpi();
+
+    sint32 zoom = _benchmarkZoom;
+    sint32 rotation = _benchmarkRotation & 3;
+    gCurrentRotation = rotation;
+
+    // Ensure sprites appear regardless of rotation
+    reset_all_sprite_quadrant_placements();
+
+    rct_viewport viewport = { 0 };
+    viewport.width = width;
+    viewport.height = height;
+    viewport.view_width = width << zoom;
+    viewport.view_height = height << zoom;
+    viewport.zoom = zoom;
+
+    Console::WriteLine("Rendering %d frames of %dx%d at zoom %d, rotation %d...", _benchmarkFrames, width, height, zoom, rotation);
+
+    auto frames = new BenchmarkFrameTimes[_benchmarkFrames];
+    double frequency = (double)SDL_GetPerformanceFrequency() / 1000.0;
+    sint32 mapSize = gMapSize;
+    for (sint32 i = 0; i < _benchmarkFrames; i++)
+    {
+        // Pan diagonally across the whole map, one step per frame
+        sint32 tileX = 1 + ((mapSize - 2) * i) / _benchmarkFrames;
+        sint32 tileY = 1 + ((mapSize - 2) * (_benchmarkFrames - 1 - i)) / _benchmarkFrames;
+        sint32 mapX = tileX * 32 + 16;
+        sint32 mapY = tileY * 32 + 16;
+        rct_xyz16 mapCoord = { (sint16)mapX, (sint16)mapY, (sint16)(map_element_height(mapX, mapY) & 0xFFFF) };
+        rct_xy16 viewCoord = coordinate_3d_to_2d(&mapCoord, rotation);
+        viewport.view_x = viewCoord.x - (viewport.view_width / 2);
+        viewport.view_y = viewCoord.y - (viewport.view_height / 2);
+
+        viewport_paint_timings timings = { 0 };
+        gViewportPaintTimings = &timings;
+        uint64 startTicks = SDL_GetPerformanceCounter();
+        viewport_render(dpi, &viewport, 0, 0, width, height);
+        uint64 endTicks = SDL_GetPerformanceCounter();
+        gViewportPaintTimings = nullptr;
+
+        frames[i].Total = (endTicks - startTicks) / frequency;
+        frames[i].Setup = timings.setup / frequency;
+        frames[i].Sort = timings.sort / frequency;
+        frames[i].Draw = timings.draw / frequency;
+    }
+
+    Console::WriteLine("%-8s %10s %10s %10s", "stage", "mean (ms)", "min (ms)", "max (ms)");
+    PrintBenchmarkRow("setup", frames, _benchmarkFrames, &BenchmarkFrameTimes::Setup);
+    PrintBenchmarkRow("sort", frames, _benchmarkFrames, &BenchmarkFrameTimes::Sort);
+    PrintBenchmarkRow("blit", frames, _benchmarkFrames, &BenchmarkFrameTimes::Draw);
+    PrintBenchmarkRow("total", frames, _benchmarkFrames, &BenchmarkFrameTimes::Total);
+    delete [] frames;
+
+    drawing_engine_dispose();
+    openrct2_dispose();
+    return EXITCODE_OK;
+}
+
+static void PrintBenchmarkRow(const utf8 * name, const BenchmarkFrameTimes * frames, sint32 numFrames, double BenchmarkFrameTimes::*field)
+{
+    double sum = 0;
+    double min = frames[0].*field;
+    double max = frames[0].*field;
+    for (sint32 i = 0; i < numFrames; i++)
+    {
+        double value = frames[i].*field;
+        sum += value;
+        min = Math::Min(min, value);
+        max = Math::Max(max, value);
+    }
+    Console::WriteLine("%-8s %10.3f %10.3f %10.3f", name, sum / numFrames, min, max);
+}
+
+exitcode_t CommandLine::HandleCommandBenchmarkSawyerCoding(CommandLineArgEnumerator * enumerator)
+{
+    exitcode_t result = CommandLine::HandleCommandDefault();
+    if (result != EXITCODE_CONTINUE)
+    {
+        return result;
+    }
+
+    const utf8 * rawPath;
+    if (!enumerator->TryPopString(&rawPath))
+    {
+        Console::Error::WriteLine("Expected a path to a saved park, scenario or track design.");
+        return EXITCODE_FAIL;
+    }
+    if (_benchmarkIterations <= 0)
+    {
+        Console::Error::WriteLine("Number of iterations must be positive.");
+        return EXITCODE_FAIL;
+    }
+
+    utf8 path[MAX_PATH];
+    Path::GetAbsolute(path, sizeof(path), rawPath);
+
+    void * fileData;
+    int fileLength;
+    if (!readentirefile(path, &fileData, &fileLength) || fileLength <= 4)
+    {
+        Console::Error::WriteLine("Unable to read '%s'.", path);
+        return EXITCODE_FAIL;
+    }
+
+    // Decoded chunks are never larger than 16 MiB, encoding can at worst double the size
+    const size_t bufferSize = 16 * 1024 * 1024;
+    uint8 * decoded = Memory::Allocate<uint8>(bufferSize);
+    uint8 * encoded = Memory::Allocate<uint8>(bufferSize * 2);
+    uint8 * roundTrip = Memory::Allocate<uint8>(bufferSize);
+    bool roundTripOk = true;
+
+    Console::WriteLine("%-8s %10s %10s %10s %10s", "chunk", "size", "encoded", "mean (ms)", "MiB/s");
+    if (String::Equals(Path::GetExtension(path), ".td6", true))
+    {
+        size_t decodedLength = sawyercoding_decode_td6((const uint8 *)fileData, decoded, fileLength);
+        size_t encodedLength = 0;
+        uint64 startTicks = SDL_GetPerformanceCounter();
+        for (sint32 i = 0; i < _benchmarkIterations; i++)
+        {
+            encodedLength = sawyercoding_encode_td6(decoded, encoded, decodedLength);
+        }
+        uint64 ticks = SDL_GetPerformanceCounter() - startTicks;
+        PrintEncodeBenchmark("td6", decodedLength, encodedLength, ticks, _benchmarkIterations);
+
+        roundTripOk = sawyercoding_decode_td6(encoded, roundTrip, encodedLength) == decodedLength &&
+                      memcmp(decoded, roundTrip, decodedLength) == 0;
+    }
+    else
+    {
+        SDL_RWops * rw = SDL_RWFromConstMem(fileData, fileLength - 4);
+        uint64 totalTicks = 0;
+        size_t totalDecoded = 0;
+        size_t totalEncoded = 0;
+        for (sint32 chunkIndex = 0; SDL_RWtell(rw) < fileLength - 4; chunkIndex++)
+        {
+            sawyercoding_chunk_header chunkHeader;
+            sint64 chunkPosition = SDL_RWtell(rw);
+            if (SDL_RWread(rw, &chunkHeader, sizeof(chunkHeader), 1) != 1)
+            {
+                break;
+            }
+            SDL_RWseek(rw, chunkPosition, RW_SEEK_SET);
+
+            size_t decodedLength = sawyercoding_read_chunk(rw, decoded);
+            if (decodedLength == SIZE_MAX)
+            {
+                break;
+            }
+
+            chunkHeader.length = (uint32)decodedLength;
+            size_t encodedLength = 0;
+            uint64 startTicks = SDL_GetPerformanceCounter();
+            for (sint32 i = 0; i < _benchmarkIterations; i++)
+            {
+                encodedLength = sawyercoding_write_chunk_buffer(encoded, decoded, chunkHeader);
+            }
+            uint64 ticks = SDL_GetPerformanceCounter() - startTicks;
+
+            utf8 name[16];
+            String::Format(name, sizeof(name), "%d", chunkIndex);
+            PrintEncodeBenchmark(name, decodedLength, encodedLength, ticks, _benchmarkIterations);
+            totalTicks += ticks;
+            totalDecoded += decodedLength;
+            totalEncoded += encodedLength;
+
+            SDL_RWops * encodedRW = SDL_RWFromConstMem(encoded, (int)encodedLength);
+            if (sawyercoding_read_chunk(encodedRW, roundTrip) != decodedLength ||
+                memcmp(decoded, roundTrip, decodedLength) != 0)
+            {
+                roundTripOk = false;
+            }
+            SDL_RWclose(encodedRW);
+        }
+        SDL_RWclose(rw);
+        PrintEncodeBenchmark("total", totalDecoded, totalEncoded, totalTicks, _benchmarkIterations);
+    }
+
+    Memory::Free(roundTrip);
+    Memory::Free(encoded);
+    Memory::Free(decoded);
+    free(fileData);
+
+    if (!roundTripOk)
+    {
+        Console::Error::WriteLine("Encoded data did not decode back to the original.");
+        return EXITCODE_FAIL;
+    }
+    return EXITCODE_OK;
+}
+
+static void PrintEncodeBenchmark(const utf8 * name, size_t decodedLength, size_t encodedLength, uint64 ticks, sint32 iterations)
+{
+    double milliseconds = (ticks * 1000.0) / SDL_GetPerformanceFrequency() / iterations;
+    double throughput = milliseconds == 0 ? 0 : (decodedLength / (1024.0 * 1024.0)) / (milliseconds / 1000.0);
+    Console::WriteLine("%-8s %10u %10u %10.3f %10.1f", name, (uint32)decodedLength, (uint32)encodedLength, milliseconds, throughput);
+}
+
+exitcode_t CommandLine::HandleCommandReplay(CommandLineArgEnumerator * enumerator)
+{
+    exitcode_t result = CommandLine::HandleCommandDefault();
+    if (result != EXITCODE_CONTINUE)
+    {
+        return result;
+    }
+
+    const utf8 * rawReplayPath;
+    if (!enumerator->TryPopString(&rawReplayPath))
+    {
+        Console::Error::WriteLine("Expected a path to a replay.");
+        return EXITCODE_FAIL;
+    }
+
+    utf8 replayPath[MAX_PATH];
+    Path::GetAbsolute(replayPath, sizeof(replayPath), rawReplayPath);
+
+    gOpenRCT2Headless = true;
+    if (!openrct2_initialise())
+    {
+        Console::Error::WriteLine("Error while initialising OpenRCT2.");
+        return EXITCODE_FAIL;
+    }
+
+    if (!replay_start_playback(replayPath, !_replayNoVerify))
+    {
+        openrct2_dispose();
+        return EXITCODE_FAIL;
+    }
+    gIntroState = INTRO_STATE_NONE;
+    game_load_init();
+
+    uint32 startTick = gCurrentTicks;
+    uint32 endTick = replay_get_end_tick();
+    const replay_stats * stats = replay_get_stats();
+    uint32 numTicks = endTick - startTick;
+    Console::WriteLine("Playing back %u ticks from tick %u...", numTicks, startTick);
+
+    // A tick that takes longer than this can not keep up with the normal game speed
+    const double realTimeTick = 25.0;
+    double frequency = (double)SDL_GetPerformanceFrequency() / 1000.0;
+    double total = 0;
+    double slowest = 0;
+    uint32 slowestTick = startTick;
+    uint32 numSlowTicks = 0;
+    while (gCurrentTicks < endTick)
+    {
+        uint32 tick = gCurrentTicks;
+        uint64 verifyTime = stats->verify_time;
+        uint64 startTicks = SDL_GetPerformanceCounter();
+        game_logic_update();
+        uint64 endTicks = SDL_GetPerformanceCounter();
+
+        double time = ((endTicks - startTicks) - (stats->verify_time - verifyTime)) / frequency;
+        total += time;
+        if (time > slowest)
+        {
+            slowest = time;
+            slowestTick = tick;
+        }
+        if (time > realTimeTick)
+        {
+            numSlowTicks++;
+        }
+    }
+
+    Console::WriteLine("%u ticks, %u commands", numTicks, stats->commands);
+    Console::WriteLine("total %.3f ms, mean %.3f ms per tick, %.1f ticks per second", total, numTicks == 0 ? 0 : total / numTicks, total == 0 ? 0 : numTicks * 1000.0 / total);
+    Console::WriteLine("slowest tick %u took %.3f ms, %u ticks took longer than %.0f ms", slowestTick, slowest, numSlowTicks, realTimeTick);
+
+    bool matched = stats->mismatches == 0;
+    if (!_replayNoVerify)
+    {
+        Console::WriteLine("%u of %u state hashes matched the recording", stats->checkpoints - stats->mismatches, stats->checkpoints);
+        if (!matched)
+        {
+            Console::Error::WriteLine("The simulation first diverged at tick %u.", stats->first_mismatch_tick);
+        }
+    }
+
+    replay_stop_playback();
+    openrct2_dispose();
+    return matched ? EXITCODE_OK : EXITCODE_FAIL;
+}
+
+#ifndef DISABLE_NETWORK
+
+static uint32 Percentile(std::vector<uint32> values, sint32 percentile)
+{
+    if (values.empty())
+    {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    return values[Math::Min(values.size() - 1, values.size() * percentile / 100)];
+}
+
+static double Mean(const std::vector<uint32> &values)
+{
+    double sum = 0;
+    for (uint32 value : values)
+    {
+        sum += value;
+    }
+    return values.empty() ? 0 : sum / values.size();
+}
+
+exitcode_t CommandLine::HandleCommandBenchmarkMultiplayer(CommandLineArgEnumerator * enumerator)
+{
+    exitcode_t result = CommandLine::HandleCommandDefault();
+    if (result != EXITCODE_CONTINUE)
+    {
+        return result;
+    }
+
+    const utf8 * rawParkPath;
+    if (!enumerator->TryPopString(&rawParkPath))
+    {
+        Console::Error::WriteLine("Expected a path to a saved park or scenario.");
+        return EXITCODE_FAIL;
+    }
+
+    utf8 parkPath[MAX_PATH];
+    Path::GetAbsolute(parkPath, sizeof(parkPath), rawParkPath);
+
+    NetworkLoadTestOptions options;
+    if (_multiplayerMix != nullptr)
+    {
+        sint32 * mix = options.Mix;
+        bool validMix = sscanf(_multiplayerMix, "%d,%d,%d,%d,%d", &mix[0], &mix[1], &mix[2], &mix[3], &mix[4]) == 5 &&
+                        mix[0] >= 0 && mix[1] >= 0 && mix[2] >= 0 && mix[3] >= 0 && mix[4] >= 0 &&
+                        mix[0] + mix[1] + mix[2] + mix[3] + mix[4] > 0;
+        Memory::Free(_multiplayerMix);
+        _multiplayerMix = nullptr;
+        if (!validMix)
+        {
+            Console::Error::WriteLine("Expected --mix in the form <land>,<scenery>,<track>,<rides>,<chat>.");
+            return EXITCODE_FAIL;
+        }
+    }
+    if (_multiplayerClients <= 0 || _multiplayerClients > 254)
+    {
+        Console::Error::WriteLine("Number of clients must be between 1 and 254.");
+        return EXITCODE_FAIL;
+    }
+    if (_multiplayerDuration <= 0)
+    {
+        Console::Error::WriteLine("Duration must be positive.");
+        return EXITCODE_FAIL;
+    }
+    if (_multiplayerPort <= 0 || _multiplayerPort > UINT16_MAX)
+    {
+        Console::Error::WriteLine("Port must be between 1 and 65535.");
+        return EXITCODE_FAIL;
+    }
+
+    gOpenRCT2Headless = true;
+    if (!openrct2_initialise())
+    {
+        Console::Error::WriteLine("Error while initialising OpenRCT2.");
+        return EXITCODE_FAIL;
+    }
+
+    if (!rct2_open_file(parkPath))
+    {
+        Console::Error::WriteLine("Unable to load '%s'.", parkPath);
+        openrct2_dispose();
+        return EXITCODE_FAIL;
+    }
+    gIntroState = INTRO_STATE_NONE;
+    gGamePaused = 0;
+
+    // Let the clients build anywhere for free, so that their commands are not refused
+    gCheatsSandboxMode = true;
+    gParkFlags |= PARK_FLAGS_NO_MONEY;
+
+    options.Port = (uint16)_multiplayerPort;
+    options.NumClients = _multiplayerClients;
+    options.ActionsPerSecond = _multiplayerRate;
+    options.MapSize = gMapSize;
+    sint32 rideIndex;
+    rct_ride * ride;
+    FOR_ALL_RIDES(rideIndex, ride)
+    {
+        options.Rides.push_back((uint8)rideIndex);
+        if (ride_type_has_flag(ride->type, RIDE_TYPE_FLAG_HAS_TRACK) &&
+            !ride_type_has_flag(ride->type, RIDE_TYPE_FLAG_FLAT_RIDE) &&
+            ride->type != RIDE_TYPE_MAZE)
+        {
+            options.TrackRides.push_back((uint8)rideIndex);
+        }
+    }
+    sint32 numSmallScenery = Math::Min(object_entry_group_counts[OBJECT_TYPE_SMALL_SCENERY], 256);
+    for (sint32 i = 0; i < numSmallScenery; i++)
+    {
+        rct_scenery_entry * sceneryEntry = get_small_scenery_entry(i);
+        if (sceneryEntry != nullptr && sceneryEntry != (rct_scenery_entry *)-1)
+        {
+            options.SmallScenery.push_back((uint8)i);
+        }
+    }
+
+    // Only for this run, the configuration is not saved
+    gConfigNetwork.maxplayers = (uint8)Math::Max<sint32>(gConfigNetwork.maxplayers, _multiplayerClients + 1);
+    gConfigNetwork.advertise = false;
+    network_set_password("");
+    if (!network_begin_server(options.Port, "127.0.0.1"))
+    {
+        Console::Error::WriteLine("Unable to host on port %u.", options.Port);
+        openrct2_dispose();
+        return EXITCODE_FAIL;
+    }
+    // The admin group may run every command
+    network_set_default_group(0);
+
+    Console::WriteLine("Generating a key for the clients...");
+    NetworkLoadTest loadTest(options);
+    if (!loadTest.Start())
+    {
+        Console::Error::WriteLine("Unable to start the clients.");
+        network_close();
+        openrct2_dispose();
+        return EXITCODE_FAIL;
+    }
+    Console::WriteLine("Running %d clients for %d seconds...", _multiplayerClients, _multiplayerDuration);
+
+    // The server runs at the normal game speed, the tick time includes handling the clients
+    const uint32 tickInterval = 25;
+    std::vector<uint32> tickTimes;
+    double frequency = (double)SDL_GetPerformanceFrequency() / 1000000.0;
+    uint32 startTime = SDL_GetTicks();
+    uint32 nextTickTime = startTime;
+    while (SDL_GetTicks() - startTime < (uint32)_multiplayerDuration * 1000)
+    {
+        uint64 startTicks = SDL_GetPerformanceCounter();
+        game_logic_update();
+        tickTimes.push_back((uint32)((SDL_GetPerformanceCounter() - startTicks) / frequency));
+
+        nextTickTime += tickInterval;
+        sint32 delay = (sint32)(nextTickTime - SDL_GetTicks());
+        if (delay > 0)
+        {
+            SDL_Delay(delay);
+        }
+    }
+    double seconds = (SDL_GetTicks() - startTime) / 1000.0;
+
+    loadTest.Stop();
+    std::vector<NetworkLoadTestClientStats> clients = loadTest.GetStats();
+    network_close();
+
+    uint32 numSlowTicks = 0;
+    for (uint32 tickTime : tickTimes)
+    {
+        if (tickTime > tickInterval * 1000)
+        {
+            numSlowTicks++;
+        }
+    }
+    Console::WriteLine("server: %u ticks, tick time mean %.3f ms, p50 %.3f ms, p99 %.3f ms, max %.3f ms, %u ticks longer than %u ms",
+                       (uint32)tickTimes.size(), Mean(tickTimes) / 1000.0, Percentile(tickTimes, 50) / 1000.0,
+                       Percentile(tickTimes, 99) / 1000.0, Percentile(tickTimes, 100) / 1000.0, numSlowTicks, tickInterval);
+
+    Console::WriteLine("%-12s %8s %8s %6s %8s %8s %8s %8s %8s %10s %10s", "client", "join", "map", "ping", "actions", "commands",
+                       "latency", "p99", "max", "down KiB", "up KiB");
+    std::vector<uint32> joinTimes;
+    std::vector<uint32> latencies;
+    uint64 bytesReceived = 0;
+    uint64 bytesSent = 0;
+    for (const NetworkLoadTestClientStats &client : clients)
+    {
+        if (client.Joined)
+        {
+            joinTimes.push_back(client.JoinTime);
+        }
+        latencies.insert(latencies.end(), client.Latencies.begin(), client.Latencies.end());
+        bytesReceived += client.BytesReceived;
+        bytesSent += client.BytesSent;
+
+        Console::WriteLine("%-12s %8u %8u %6u %8u %4u/%-4u %8.1f %8u %8u %10.1f %10.1f", client.Name.c_str(), client.JoinTime, client.MapTime,
+                           client.Ping, client.Actions, (uint32)client.Latencies.size(), client.CommandsSent, Mean(client.Latencies),
+                           Percentile(client.Latencies, 99), Percentile(client.Latencies, 100),
+                           client.BytesReceived / 1024.0, client.BytesSent / 1024.0);
+        if (!client.Error.empty())
+        {
+            Console::WriteLine("%-12s %s", "", client.Error.c_str());
+        }
+    }
+
+    Console::WriteLine("joined: %u of %u, join time mean %.0f ms, max %u ms",
+                       (uint32)joinTimes.size(), (uint32)clients.size(), Mean(joinTimes), Percentile(joinTimes, 100));
+    Console::WriteLine("command latency: mean %.1f ms, p50 %u ms, p99 %u ms, max %u ms",
+                       Mean(latencies), Percentile(latencies, 50), Percentile(latencies, 99), Percentile(latencies, 100));
+    Console::WriteLine("bandwidth: server to clients %.1f KiB/s, clients to server %.1f KiB/s",
+                       bytesReceived / 1024.0 / seconds, bytesSent / 1024.0 / seconds);
+
+    openrct2_dispose();
+    return !clients.empty() && joinTimes.size() == clients.size() ? EXITCODE_OK : EXITCODE_FAIL;
+}
+
+#endif
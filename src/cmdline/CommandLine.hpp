@@ -106,8 +106,17 @@ namespace CommandLine
 
     extern const CommandLineExample RootExamples[];
 
+    extern const CommandLineOptionDefinition BenchmarkRenderOptions[];
+    extern const CommandLineOptionDefinition BenchmarkSawyerCodingOptions[];
+    extern const CommandLineOptionDefinition ReplayOptions[];
+    extern const CommandLineOptionDefinition BenchmarkMultiplayerOptions[];
+
     void PrintHelp(bool allCommands = false);
     exitcode_t HandleCommandDefault();
 
     exitcode_t HandleCommandConvert(CommandLineArgEnumerator * enumerator);
+    exitcode_t HandleCommandBenchmarkRender(CommandLineArgEnumerator * enumerator);
+    exitcode_t HandleCommandBenchmarkSawyerCoding(CommandLineArgEnumerator * enumerator);
+    exitcode_t HandleCommandReplay(CommandLineArgEnumerator * enumerator);
+    exitcode_t HandleCommandBenchmarkMultiplayer(CommandLineArgEnumerator * enumerator);
 }
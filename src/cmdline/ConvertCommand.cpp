@@ -66,9 +66,10 @@ exitcode_t CommandLine::HandleCommandConvert(CommandLineArgEnumerator * enumerat
 
     // Validate target type
     if (destinationFileType != FILE_EXTENSION_SC6 &&
-        destinationFileType != FILE_EXTENSION_SV6)
+        destinationFileType != FILE_EXTENSION_SV6 &&
+        destinationFileType != FILE_EXTENSION_PARK)
     {
-        Console::Error::WriteLine("Only conversion to .SC6 or .SV4 is supported.");
+        Console::Error::WriteLine("Only conversion to .SC6, .SV6 or .PARK is supported.");
         return EXITCODE_FAIL;
     }
 
@@ -91,8 +92,15 @@ exitcode_t CommandLine::HandleCommandConvert(CommandLineArgEnumerator * enumerat
             return EXITCODE_FAIL;
         }
         break;
+    case FILE_EXTENSION_PARK:
+        if (destinationFileType == FILE_EXTENSION_PARK)
+        {
+            Console::Error::WriteLine("File is already an OpenRCT2 park.");
+            return EXITCODE_FAIL;
+        }
+        break;
     default:
-        Console::Error::WriteLine("Only conversion from .SC4, .SV4, .SC6 or .SV6 is supported.");
+        Console::Error::WriteLine("Only conversion from .SC4, .SV4, .SC6, .SV6 or .PARK is supported.");
         return EXITCODE_FAIL;
     }
 
@@ -140,7 +148,8 @@ exitcode_t CommandLine::HandleCommandConvert(CommandLineArgEnumerator * enumerat
         {
             scenario_load_and_play_from_path(sourcePath);
         }
-        if (sourceFileType == FILE_EXTENSION_SV6)
+        if (sourceFileType == FILE_EXTENSION_SV6 ||
+            sourceFileType == FILE_EXTENSION_PARK)
         {
             game_load_save(sourcePath);
         }
@@ -156,6 +165,10 @@ exitcode_t CommandLine::HandleCommandConvert(CommandLineArgEnumerator * enumerat
         {
             scenario_save(rw, 0x80000002);
         }
+        else if (destinationFileType == FILE_EXTENSION_PARK)
+        {
+            scenario_save_park(rw, 0x80000001);
+        }
         else
         {
             scenario_save(rw, 0x80000001);
@@ -186,6 +199,7 @@ static const utf8 * GetFileTypeFriendlyName(uint32 fileType)
     case FILE_EXTENSION_SV4: return "RollerCoaster Tycoon 1 saved game";
     case FILE_EXTENSION_SC6: return "RollerCoaster Tycoon 2 scenario";
     case FILE_EXTENSION_SV6: return "RollerCoaster Tycoon 2 saved game";
+    case FILE_EXTENSION_PARK: return "OpenRCT2 park";
     }
 
     assert(false);
@@ -114,6 +114,12 @@ const CommandLineCommand CommandLine::RootCommands[]
 #endif
     DefineCommand("set-rct2", "<path>",                 StandardOptions, HandleCommandSetRCT2),
     DefineCommand("convert",  "<source> <destination>", StandardOptions, CommandLine::HandleCommandConvert),
+    DefineCommand("benchmark-render", "<park>",         CommandLine::BenchmarkRenderOptions, CommandLine::HandleCommandBenchmarkRender),
+    DefineCommand("benchmark-sawyercoding", "<file>",   CommandLine::BenchmarkSawyerCodingOptions, CommandLine::HandleCommandBenchmarkSawyerCoding),
+    DefineCommand("replay",   "<replay>",               CommandLine::ReplayOptions, CommandLine::HandleCommandReplay),
+#ifndef DISABLE_NETWORK
+    DefineCommand("benchmark-multiplayer", "<park>",    CommandLine::BenchmarkMultiplayerOptions, CommandLine::HandleCommandBenchmarkMultiplayer),
+#endif
 
 #if defined(__WINDOWS__) && !defined(__MINGW32__)
     DefineCommand("register-shell", "", RegisterShellOptions, HandleCommandRegisterShell),
@@ -277,6 +277,8 @@ config_property_definition _networkDefinitions[] = {
 	{ offsetof(network_configuration, provider_website),				"provider_website",				CONFIG_VALUE_TYPE_STRING,		{.value_string = NULL },		NULL					},
 	{ offsetof(network_configuration, known_keys_only),					"known_keys_only",				CONFIG_VALUE_TYPE_BOOLEAN,		false,							NULL					},
 	{ offsetof(network_configuration, log_chat),						"log_chat",						CONFIG_VALUE_TYPE_BOOLEAN,		false,							NULL					},
+	{ offsetof(network_configuration, desync_debugging),				"desync_debugging",				CONFIG_VALUE_TYPE_BOOLEAN,		false,							NULL					},
+	{ offsetof(network_configuration, stats_interval),					"stats_interval",				CONFIG_VALUE_TYPE_UINT32,		60,								NULL					},
 };
 
 config_property_definition _notificationsDefinitions[] = {
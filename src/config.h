@@ -247,6 +247,8 @@ typedef struct network_configuration {
 	utf8string provider_website;
 	uint8 known_keys_only;
 	uint8 log_chat;
+	uint8 desync_debugging;
+	uint32 stats_interval;
 } network_configuration;
 
 typedef struct notification_configuration {
@@ -61,6 +61,12 @@ namespace DrawingEngineFactory
     IDrawingEngine * CreateSoftware();
     IDrawingEngine * CreateSoftwareWithHardwareDisplay();
     IDrawingEngine * CreateOpenGL();
+
+    /**
+     * Creates a software engine that draws into a plain memory buffer and never presents to a window.
+     * Used when running headless, the buffer is available via GetDrawingPixelInfo after Resize.
+     */
+    IDrawingEngine * CreateOffscreen();
 };
 
 interface IRainDrawer
@@ -25,6 +25,7 @@ extern "C"
     #include "../drawing/drawing.h"
     #include "../interface/screenshot.h"
     #include "../localisation/string_ids.h"
+    #include "../openrct2.h"
     #include "../platform/platform.h"
 }
 
@@ -48,6 +49,14 @@ extern "C"
         assert(_drawingEngine == nullptr);
 
         _drawingEngineType = gConfigGeneral.drawing_engine;
+        if (gOpenRCT2Headless)
+        {
+            // There is no window to present to, so draw into memory regardless of the configured engine
+            _drawingEngineType = DRAWING_ENGINE_SOFTWARE;
+            _drawingEngine = DrawingEngineFactory::CreateOffscreen();
+            return;
+        }
+
         switch (_drawingEngineType) {
         case DRAWING_ENGINE_SOFTWARE:
             _drawingEngine = DrawingEngineFactory::CreateSoftware();
@@ -215,12 +215,22 @@ void gfx_draw_string_centred_wrapped_partial(rct_drawpixelinfo *dpi, int x, int
 void gfx_draw_string_with_y_offsets(rct_drawpixelinfo *dpi, const utf8 *text, int colour, int x, int y, const sint8 *yOffsets, bool forceSpriteFont);
 int gfx_clip_string(char* buffer, int width);
 void shorten_path(utf8 *buffer, size_t bufferSize, const utf8 *path, int availableWidth);
-SDL_Surface *ttf_surface_cache_get_or_add(TTF_Font *font, const utf8 *text);
+uint8 *ttf_render_glyph_run(TTF_Font *font, const utf8 *text, int *outWidth, int *outHeight);
 TTFFontDescriptor *ttf_get_font_from_sprite_base(uint16 spriteBase);
 
 bool ttf_initialise();
 void ttf_dispose();
 
+typedef struct ttf_glyph_cache_stats {
+	uint32 glyph_count;
+	uint32 page_count;
+	size_t memory_used;
+	uint32 hit_count;
+	uint32 miss_count;
+} ttf_glyph_cache_stats;
+
+void ttf_get_glyph_cache_stats(ttf_glyph_cache_stats *stats);
+
 // scrolling text
 void scrolling_text_initialise_bitmaps();
 int scrolling_text_setup(rct_string_id stringId, uint16 scroll, uint16 scrollingMode);
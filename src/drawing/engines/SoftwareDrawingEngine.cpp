@@ -14,6 +14,7 @@
  *****************************************************************************/
 #pragma endregion
 
+#include <vector>
 #include "../../core/Math.hpp"
 #include "../../core/Memory.hpp"
 #include "../IDrawingContext.h"
@@ -41,6 +42,23 @@ struct DirtyGrid
     uint32  BlockColumns;
     uint32  BlockRows;
     uint8 * Blocks;
+    uint8 * PresentBlocks;  // Blocks changed since the last present
+};
+
+/**
+ * A rectangle of dirty blocks, right and bottom are exclusive.
+ */
+struct DirtyRegion
+{
+    uint32 Left;
+    uint32 Top;
+    uint32 Right;
+    uint32 Bottom;
+
+    uint32 GetArea() const
+    {
+        return (Right - Left) * (Bottom - Top);
+    }
 };
 
 class RainDrawer : public IRainDrawer
@@ -132,6 +150,11 @@ public:
         }
     }
 
+    bool HasPixels() const
+    {
+        return _rainPixelsCount > 0;
+    }
+
     void Restore()
     {
         if (_rainPixelsCount > 0)
@@ -181,6 +204,7 @@ class SoftwareDrawingEngine : public IDrawingEngine
 {
 private:
     bool _hardwareDisplay;
+    bool _offscreen;
 
     SDL_Window *    _window         = nullptr;
     SDL_Surface *   _surface        = nullptr;
@@ -205,7 +229,13 @@ private:
     size_t  _bitsSize   = 0;
     uint8 * _bits       = nullptr;
 
-    DirtyGrid   _dirtyGrid  = { 0 };
+    DirtyGrid                   _dirtyGrid  = { 0 };
+    std::vector<DirtyRegion>    _dirtyRegions;
+    std::vector<DirtyRegion>    _presentRegions;
+    std::vector<SDL_Rect>       _presentRects;
+    bool                        _presentAll = true;
+    SDL_Color                   _presentPalette[256] = { 0 };   // The palette of the last present
+    uint32 *                    _presentBits = nullptr;
 
     rct_drawpixelinfo _bitsDPI  = { 0 };
 
@@ -213,9 +243,10 @@ private:
     SoftwareDrawingContext *    _drawingContext;
 
 public:
-    SoftwareDrawingEngine(bool hardwareDisplay)
+    SoftwareDrawingEngine(bool hardwareDisplay, bool offscreen = false)
     {
         _hardwareDisplay = hardwareDisplay;
+        _offscreen = offscreen;
         _drawingContext = new SoftwareDrawingContext(this);
     }
 
@@ -223,6 +254,8 @@ public:
     {
         delete _drawingContext;
         delete [] _dirtyGrid.Blocks;
+        delete [] _dirtyGrid.PresentBlocks;
+        delete [] _presentBits;
         delete [] _bits;
         SDL_FreeSurface(_surface);
         SDL_FreeSurface(_RGBASurface);
@@ -246,7 +279,11 @@ public:
         SDL_FreeFormat(_screenTextureFormat);
         SDL_DestroyRenderer(_sdlRenderer);
 
-        if (_hardwareDisplay)
+        if (_offscreen)
+        {
+            ConfigureBits(width, height, width);
+        }
+        else if (_hardwareDisplay)
         {
             _sdlRenderer = SDL_CreateRenderer(_window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
 
@@ -300,7 +337,19 @@ public:
 
     void SetPalette(SDL_Color * palette) override
     {
-        if (_hardwareDisplay)
+        // Palette effects set the same colours again most frames, only when a colour has changed
+        // may every pixel look different
+        if (memcmp(_presentPalette, palette, sizeof(_presentPalette)) != 0)
+        {
+            memcpy(_presentPalette, palette, sizeof(_presentPalette));
+            _presentAll = true;
+        }
+
+        if (_offscreen)
+        {
+            // Nothing to map, the palette is only applied when the bits are read
+        }
+        else if (_hardwareDisplay)
         {
             if (_screenTextureFormat != nullptr)
             {
@@ -352,12 +401,14 @@ public:
 
         uint32 dirtyBlockColumns = _dirtyGrid.BlockColumns;
         uint8 * screenDirtyBlocks = _dirtyGrid.Blocks;
+        uint8 * presentBlocks = _dirtyGrid.PresentBlocks;
         for (sint16 y = top; y <= bottom; y++)
         {
             uint32 yOffset = y * dirtyBlockColumns;
             for (sint16 x = left; x <= right; x++)
             {
                 screenDirtyBlocks[yOffset + x] = 0xFF;
+                presentBlocks[yOffset + x] = 0xFF;
             }
         }
     }
@@ -366,8 +417,14 @@ public:
     {
         if (gIntroState != INTRO_STATE_NONE) {
             intro_draw(&_bitsDPI);
+            _presentAll = true;
         } else {
             _rainDrawer.SetDPI(&_bitsDPI);
+            if (_rainDrawer.HasPixels())
+            {
+                // Rain is scattered across the whole screen, not worth tracking
+                _presentAll = true;
+            }
             _rainDrawer.Restore();
 
             ResetWindowVisbilities();
@@ -384,11 +441,19 @@ public:
             gfx_invalidate_pickedup_peep();
 
             DrawRain(&_bitsDPI, &_rainDrawer);
+            if (_rainDrawer.HasPixels())
+            {
+                _presentAll = true;
+            }
 
             rct2_draw(&_bitsDPI);
         }
 
-        if (_hardwareDisplay)
+        if (_offscreen)
+        {
+            // Nothing to present, the frame stays in the bits
+        }
+        else if (_hardwareDisplay)
         {
             DisplayViaTexture();
         }
@@ -435,6 +500,8 @@ public:
             to += stride;
             from += stride;
         }
+
+        SetPresentBlocks(x, y, x + width, y + height);
     }
 
     sint32 Screenshot() override
@@ -519,6 +586,13 @@ private:
         dpi->height = height;
         dpi->pitch = _pitch - width;
 
+        delete [] _presentBits;
+        _presentBits = nullptr;
+        if (_hardwareDisplay)
+        {
+            _presentBits = new uint32[width * height];
+        }
+
         ConfigureDirtyGrid();
     }
 
@@ -531,8 +605,35 @@ private:
         _dirtyGrid.BlockColumns = (_width >> _dirtyGrid.BlockShiftX) + 1;
         _dirtyGrid.BlockRows = (_height >> _dirtyGrid.BlockShiftY) + 1;
 
+        size_t numBlocks = _dirtyGrid.BlockColumns * _dirtyGrid.BlockRows;
         delete [] _dirtyGrid.Blocks;
-        _dirtyGrid.Blocks = new uint8[_dirtyGrid.BlockColumns * _dirtyGrid.BlockRows];
+        delete [] _dirtyGrid.PresentBlocks;
+        _dirtyGrid.Blocks = new uint8[numBlocks];
+        _dirtyGrid.PresentBlocks = new uint8[numBlocks];
+        Memory::Set(_dirtyGrid.Blocks, 0, numBlocks);
+        Memory::Set(_dirtyGrid.PresentBlocks, 0, numBlocks);
+        _presentAll = true;
+    }
+
+    void SetPresentBlocks(sint32 left, sint32 top, sint32 right, sint32 bottom)
+    {
+        left = Math::Max(left, 0);
+        top = Math::Max(top, 0);
+        right = Math::Min(right, (sint32)_width);
+        bottom = Math::Min(bottom, (sint32)_height);
+        if (left >= right || top >= bottom)
+        {
+            return;
+        }
+
+        uint32 blockLeft = left >> _dirtyGrid.BlockShiftX;
+        uint32 blockRight = (right - 1) >> _dirtyGrid.BlockShiftX;
+        uint32 blockTop = top >> _dirtyGrid.BlockShiftY;
+        uint32 blockBottom = (bottom - 1) >> _dirtyGrid.BlockShiftY;
+        for (uint32 y = blockTop; y <= blockBottom; y++)
+        {
+            Memory::Set(_dirtyGrid.PresentBlocks + y * _dirtyGrid.BlockColumns + blockLeft, 0xFF, blockRight - blockLeft + 1);
+        }
     }
 
     static void ResetWindowVisbilities()
@@ -546,73 +647,122 @@ private:
     }
 
     void DrawAllDirtyBlocks()
+    {
+        CollectDirtyRegions(_dirtyGrid.Blocks, _dirtyRegions);
+        for (const DirtyRegion &region : _dirtyRegions)
+        {
+            DrawDirtyRegion(region);
+        }
+    }
+
+    /**
+     * Condenses a grid of dirty blocks into a list of block rectangles and clears the grid. Horizontal runs
+     * of dirty blocks are first stacked into rectangles, then any rectangles whose combined bounds
+     * waste little area are merged so that wide or ragged invalidations result in a few large redraws
+     * rather than many small ones. The resulting order only depends on the grid contents.
+     */
+    void CollectDirtyRegions(uint8 * dirtyBlocks, std::vector<DirtyRegion> &regions)
     {
         uint32  dirtyBlockColumns = _dirtyGrid.BlockColumns;
         uint32  dirtyBlockRows = _dirtyGrid.BlockRows;
-        uint8 * dirtyBlocks = _dirtyGrid.Blocks;
 
-        for (uint32 x = 0; x < dirtyBlockColumns; x++)
+        regions.clear();
+
+        // Regions that touch the previous row and can still grow downwards
+        size_t openRegionsStart = 0;
+        for (uint32 y = 0; y < dirtyBlockRows; y++)
         {
-            for (uint32 y = 0; y < dirtyBlockRows; y++)
+            uint8 * row = dirtyBlocks + y * dirtyBlockColumns;
+            size_t openRegionsEnd = regions.size();
+            size_t nextOpenRegionsStart = openRegionsEnd;
+
+            uint32 x = 0;
+            while (x < dirtyBlockColumns)
             {
-                uint32 yOffset = y * dirtyBlockColumns;
-                if (dirtyBlocks[yOffset + x] == 0)
+                if (row[x] == 0)
                 {
+                    x++;
                     continue;
                 }
 
-                // Determine columns
-                uint32 xx;
-                for (xx = x; xx < dirtyBlockColumns; xx++)
+                uint32 runStart = x;
+                while (x < dirtyBlockColumns && row[x] != 0)
                 {
-                    if (dirtyBlocks[yOffset + xx] == 0)
-                    {
-                        break;
-                    }
+                    row[x] = 0;
+                    x++;
                 }
-                uint32 columns = xx - x;
 
-                // Check rows
-                uint32 yy;
-                for (yy = y; yy < dirtyBlockRows; yy++)
+                // Extend a region from the previous row with the exact same span
+                bool extended = false;
+                for (size_t i = openRegionsStart; i < openRegionsEnd; i++)
                 {
-                    uint32 yyOffset = yy * dirtyBlockColumns;
-                    for (xx = x; xx < x + columns; xx++)
+                    DirtyRegion * region = &regions[i];
+                    if (region->Left == runStart && region->Right == x && region->Bottom == y)
                     {
-                        if (dirtyBlocks[yyOffset + xx] == 0)
-                        {
-                            goto endRowCheck;
-                        }
+                        region->Bottom = y + 1;
+                        // Keep the region open by moving it to the end of the list
+                        DirtyRegion extendedRegion = *region;
+                        regions.erase(regions.begin() + i);
+                        regions.push_back(extendedRegion);
+                        openRegionsEnd--;
+                        nextOpenRegionsStart--;
+                        extended = true;
+                        break;
                     }
                 }
-
-            endRowCheck:
-                uint32 rows = yy - y;
-                DrawDirtyBlocks(x, y, columns, rows);
+                if (!extended)
+                {
+                    regions.push_back({ runStart, y, x, y + 1 });
+                }
             }
+            openRegionsStart = nextOpenRegionsStart;
         }
+
+        MergeDirtyRegions(regions);
     }
 
-    void DrawDirtyBlocks(uint32 x, uint32 y, uint32 columns, uint32 rows)
+    static void MergeDirtyRegions(std::vector<DirtyRegion> &regions)
     {
-        uint32  dirtyBlockColumns = _dirtyGrid.BlockColumns;
-        uint8 * screenDirtyBlocks = _dirtyGrid.Blocks;
-
-        // Unset dirty blocks
-        for (uint32 top = y; top < y + (uint32)rows; top++)
+        bool merged;
+        do
         {
-            uint32 topOffset = top * dirtyBlockColumns;
-            for (uint32 left = x; left < x + (uint32)columns; left++)
+            merged = false;
+            for (size_t i = 0; i < regions.size(); i++)
             {
-                screenDirtyBlocks[topOffset + left] = 0;
+                for (size_t j = i + 1; j < regions.size(); j++)
+                {
+                    const DirtyRegion &a = regions[i];
+                    const DirtyRegion &b = regions[j];
+                    DirtyRegion combined =
+                    {
+                        Math::Min(a.Left, b.Left),
+                        Math::Min(a.Top, b.Top),
+                        Math::Max(a.Right, b.Right),
+                        Math::Max(a.Bottom, b.Bottom)
+                    };
+
+                    // Merge if the combined rectangle redraws at most 25% more blocks than
+                    // the two regions would separately
+                    uint32 separateArea = a.GetArea() + b.GetArea();
+                    if (combined.GetArea() * 4 <= separateArea * 5)
+                    {
+                        regions[i] = combined;
+                        regions.erase(regions.begin() + j);
+                        merged = true;
+                        j = i;
+                    }
+                }
             }
-        }
+        } while (merged);
+    }
 
+    void DrawDirtyRegion(const DirtyRegion &region)
+    {
         // Determine region in pixels
-        uint32 left = Math::Max<uint32>(0, x * _dirtyGrid.BlockWidth);
-        uint32 top = Math::Max<uint32>(0, y * _dirtyGrid.BlockHeight);
-        uint32 right = Math::Min((uint32)gScreenWidth, left + (columns * _dirtyGrid.BlockWidth));
-        uint32 bottom = Math::Min((uint32)gScreenHeight, top + (rows * _dirtyGrid.BlockHeight));
+        uint32 left = region.Left * _dirtyGrid.BlockWidth;
+        uint32 top = region.Top * _dirtyGrid.BlockHeight;
+        uint32 right = Math::Min((uint32)gScreenWidth, region.Right * _dirtyGrid.BlockWidth);
+        uint32 bottom = Math::Min((uint32)gScreenHeight, region.Bottom * _dirtyGrid.BlockHeight);
         if (right <= left || bottom <= top)
         {
             return;
@@ -622,8 +772,46 @@ private:
         window_draw_all(&_bitsDPI, left, top, right, bottom);
     }
 
+    /**
+     * Gets the rectangles of the screen that have changed since the last present, in pixels. Returns
+     * false if the whole screen should be presented instead.
+     */
+    bool GetPresentRects()
+    {
+        if (_presentAll)
+        {
+            _presentAll = false;
+            Memory::Set(_dirtyGrid.PresentBlocks, 0, _dirtyGrid.BlockColumns * _dirtyGrid.BlockRows);
+            return false;
+        }
+
+        CollectDirtyRegions(_dirtyGrid.PresentBlocks, _presentRegions);
+        _presentRects.clear();
+        for (const DirtyRegion &region : _presentRegions)
+        {
+            sint32 left = region.Left * _dirtyGrid.BlockWidth;
+            sint32 top = region.Top * _dirtyGrid.BlockHeight;
+            sint32 right = Math::Min((sint32)_width, (sint32)(region.Right * _dirtyGrid.BlockWidth));
+            sint32 bottom = Math::Min((sint32)_height, (sint32)(region.Bottom * _dirtyGrid.BlockHeight));
+            if (right > left && bottom > top)
+            {
+                _presentRects.push_back({ left, top, right - left, bottom - top });
+            }
+        }
+        return true;
+    }
+
     void Display()
     {
+        bool scaled = !(gConfigGeneral.window_scale == 1 || gConfigGeneral.window_scale <= 0);
+
+        // Scaling is done for the whole window surface, so always copy everything in that case
+        bool partial = GetPresentRects() && !scaled;
+        if (partial && _presentRects.size() == 0)
+        {
+            return;
+        }
+
         // Lock the surface before setting its pixels
         if (SDL_MUSTLOCK(_surface))
         {
@@ -635,7 +823,25 @@ private:
         }
 
         // Copy pixels from the virtual screen buffer to the surface
-        Memory::Copy<void>(_surface->pixels, _bits, _surface->pitch * _surface->h);
+        if (partial)
+        {
+            for (const SDL_Rect &rect : _presentRects)
+            {
+                size_t offset = rect.y * _pitch + rect.x;
+                uint8 * src = _bits + offset;
+                uint8 * dst = (uint8 *)_surface->pixels + offset;
+                for (sint32 y = 0; y < rect.h; y++)
+                {
+                    Memory::Copy(dst, src, rect.w);
+                    src += _pitch;
+                    dst += _pitch;
+                }
+            }
+        }
+        else
+        {
+            Memory::Copy<void>(_surface->pixels, _bits, _surface->pitch * _surface->h);
+        }
 
         // Unlock the surface
         if (SDL_MUSTLOCK(_surface))
@@ -644,10 +850,22 @@ private:
         }
 
         // Copy the surface to the window
-        if (gConfigGeneral.window_scale == 1 || gConfigGeneral.window_scale <= 0)
+        if (!scaled)
         {
             SDL_Surface * windowSurface = SDL_GetWindowSurface(gWindow);
-            if (SDL_BlitSurface(_surface, nullptr, windowSurface, nullptr))
+            if (partial)
+            {
+                for (const SDL_Rect &rect : _presentRects)
+                {
+                    SDL_Rect dstRect = rect;
+                    if (SDL_BlitSurface(_surface, &rect, windowSurface, &dstRect))
+                    {
+                        log_fatal("SDL_BlitSurface %s", SDL_GetError());
+                        exit(1);
+                    }
+                }
+            }
+            else if (SDL_BlitSurface(_surface, nullptr, windowSurface, nullptr))
             {
                 log_fatal("SDL_BlitSurface %s", SDL_GetError());
                 exit(1);
@@ -670,7 +888,16 @@ private:
                 exit(1);
             }
         }
-        if (SDL_UpdateWindowSurface(gWindow))
+
+        if (partial)
+        {
+            if (SDL_UpdateWindowSurfaceRects(gWindow, _presentRects.data(), (int)_presentRects.size()))
+            {
+                log_fatal("SDL_UpdateWindowSurfaceRects %s", SDL_GetError());
+                exit(1);
+            }
+        }
+        else if (SDL_UpdateWindowSurface(gWindow))
         {
             log_fatal("SDL_UpdateWindowSurface %s", SDL_GetError());
             exit(1);
@@ -678,6 +905,75 @@ private:
     }
 
     void DisplayViaTexture()
+    {
+        bool partial = GetPresentRects();
+        if (partial && _screenTextureFormat->BytesPerPixel == 4)
+        {
+            // Only convert and upload the rectangles that have changed, the texture keeps the rest
+            for (const SDL_Rect &rect : _presentRects)
+            {
+                const uint8 * src = _bits + rect.y * _pitch + rect.x;
+                uint32 * dst = _presentBits + rect.y * _width + rect.x;
+                for (sint32 y = 0; y < rect.h; y++)
+                {
+                    ConvertPaletteRow(dst, src, rect.w, _paletteHWMapped);
+                    src += _pitch;
+                    dst += _width;
+                }
+                SDL_UpdateTexture(_screenTexture, &rect, _presentBits + rect.y * _width + rect.x, _width * 4);
+            }
+        }
+        else
+        {
+            CopyBitsToTexture();
+        }
+
+        SDL_RenderCopy(_sdlRenderer, _screenTexture, NULL, NULL);
+
+        if (gSteamOverlayActive && gConfigGeneral.steam_overlay_pause)
+        {
+            OverlayPreRenderCheck();
+        }
+
+        SDL_RenderPresent(_sdlRenderer);
+
+        if (gSteamOverlayActive && gConfigGeneral.steam_overlay_pause)
+        {
+            OverlayPostRenderCheck();
+        }
+    }
+
+    /**
+     * Converts a row of 8-bit palette indices to 32-bit pixels. The loop is unrolled to do eight
+     * independent lookups per iteration from a single 64-bit load, which lets the compiler keep
+     * several loads in flight rather than serialising on each byte.
+     */
+    static void ConvertPaletteRow(uint32 * RESTRICT dst, const uint8 * RESTRICT src, size_t count, const uint32 * RESTRICT palette)
+    {
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            uint64 indices;
+            Memory::Copy<void>(&indices, src + i, sizeof(indices));
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+            indices = SDL_Swap64(indices);
+#endif
+            dst[i + 0] = palette[(indices >>  0) & 0xFF];
+            dst[i + 1] = palette[(indices >>  8) & 0xFF];
+            dst[i + 2] = palette[(indices >> 16) & 0xFF];
+            dst[i + 3] = palette[(indices >> 24) & 0xFF];
+            dst[i + 4] = palette[(indices >> 32) & 0xFF];
+            dst[i + 5] = palette[(indices >> 40) & 0xFF];
+            dst[i + 6] = palette[(indices >> 48) & 0xFF];
+            dst[i + 7] = palette[(indices >> 56) & 0xFF];
+        }
+        for (; i < count; i++)
+        {
+            dst[i] = palette[src[i]];
+        }
+    }
+
+    void CopyBitsToTexture()
     {
         void *  pixels;
         int     pitch;
@@ -686,11 +982,7 @@ private:
             uint8 * src = _bits;
             int padding = pitch - (_width * 4);
             if ((uint32)pitch == _width * 4) {
-                uint32 * dst = (uint32 *)pixels;
-                for (int i = _width * _height; i > 0; i--)
-                {
-                    *dst++ = *(uint32 *)(&_paletteHWMapped[*src++]);
-                }
+                ConvertPaletteRow((uint32 *)pixels, src, _width * _height, _paletteHWMapped);
             }
             else
             {
@@ -723,20 +1015,6 @@ private:
             }
             SDL_UnlockTexture(_screenTexture);
         }
-
-        SDL_RenderCopy(_sdlRenderer, _screenTexture, NULL, NULL);
-
-        if (gSteamOverlayActive && gConfigGeneral.steam_overlay_pause)
-        {
-            OverlayPreRenderCheck();
-        }
-
-        SDL_RenderPresent(_sdlRenderer);
-
-        if (gSteamOverlayActive && gConfigGeneral.steam_overlay_pause)
-        {
-            OverlayPostRenderCheck();
-        }
     }
 
     void ReadCentrePixel(uint32 * pixel)
@@ -788,6 +1066,11 @@ IDrawingEngine * DrawingEngineFactory::CreateSoftwareWithHardwareDisplay()
     return new SoftwareDrawingEngine(true);
 }
 
+IDrawingEngine * DrawingEngineFactory::CreateOffscreen()
+{
+    return new SoftwareDrawingEngine(false, true);
+}
+
 SoftwareDrawingContext::SoftwareDrawingContext(SoftwareDrawingEngine * engine)
 {
     _engine = engine;
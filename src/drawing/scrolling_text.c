@@ -264,19 +264,14 @@ void scrolling_text_set_bitmap_for_ttf(utf8 *text, int scroll, uint8 *bitmap, si
 		colour = RCT2_GLOBAL(0x009FF048, uint8*)[(colour - FORMAT_COLOUR_CODE_START) * 4];
 	}
 
-	SDL_Surface *surface = ttf_surface_cache_get_or_add(fontDesc->font, text);
-	if (surface == NULL) {
+	int width, height;
+	uint8 *glyphBitmap = ttf_render_glyph_run(fontDesc->font, text, &width, &height);
+	if (glyphBitmap == NULL) {
 		return;
 	}
 
-	if (SDL_MUSTLOCK(surface) && SDL_LockSurface(surface) == -1) {
-		return;
-	}
-
-	int pitch = surface->pitch;
-	int width = surface->w;
-	int height = surface->h;
-	uint8 *src = surface->pixels;
+	int pitch = width;
+	uint8 *src = glyphBitmap;
 
 	// Offset
 	height -= 3;
@@ -288,7 +283,7 @@ void scrolling_text_set_bitmap_for_ttf(utf8 *text, int scroll, uint8 *bitmap, si
 		// Skip any none displayed columns
 		if (scroll == 0) {
 			sint16 scrollPosition = *scrollPositionOffsets;
-			if (scrollPosition == -1) return;
+			if (scrollPosition == -1) break;
 			if (scrollPosition > -1) {
 				uint8 *dst = &bitmap[scrollPosition];
 
@@ -308,5 +303,5 @@ void scrolling_text_set_bitmap_for_ttf(utf8 *text, int scroll, uint8 *bitmap, si
 		if (x >= width) x = 0;
 	}
 
-	if (SDL_MUSTLOCK(surface)) SDL_UnlockSurface(surface);
+	free(glyphBitmap);
 }
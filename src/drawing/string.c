@@ -28,32 +28,40 @@ static void ttf_draw_string(rct_drawpixelinfo *dpi, char *buffer, int colour, in
 
 static bool _ttfInitialised = false;
 
-#define TTF_SURFACE_CACHE_SIZE 256
-#define TTF_GETWIDTH_CACHE_SIZE 1024
+#define TTF_GLYPH_PAGE_SIZE 256
+#define TTF_GLYPH_PAGE_COUNT 256
 
-typedef struct ttf_cache_entry {
-	SDL_Surface *surface;
-	TTF_Font *font;
-	utf8 *text;
-	uint32 lastUseTick;
-} ttf_cache_entry;
-
-static ttf_cache_entry _ttfSurfaceCache[TTF_SURFACE_CACHE_SIZE] = { 0 };
-static int _ttfSurfaceCacheCount = 0;
-static int _ttfSurfaceCacheHitCount = 0;
-static int _ttfSurfaceCacheMissCount = 0;
+/**
+ * A single rasterised glyph. The bitmap covers the glyph's bounding box from
+ * TTF_GlyphMetrics, is tightly packed (pitch == width) and is non-zero where the
+ * glyph is set. The offsets place the box relative to the pen position and the
+ * top of the line. Glyphs without any pixels (e.g. space) have no bitmap but
+ * still have an advance.
+ */
+typedef struct ttf_glyph {
+	uint8 *bitmap;
+	uint16 width;
+	uint16 height;
+	sint16 offset_x;
+	sint16 offset_y;
+	sint16 advance;
+	bool loaded;
+} ttf_glyph;
 
-typedef struct ttf_getwidth_cache_entry {
-	uint32 width;
+/**
+ * Glyphs for one font size, stored in pages of 256 code points that are only
+ * allocated once a code point from that page is used.
+ */
+typedef struct ttf_glyph_cache {
 	TTF_Font *font;
-	utf8 *text;
-	uint32 lastUseTick;
-} ttf_getwidth_cache_entry;
+	int ascent;
+	int height;
+	bool kerning;
+	ttf_glyph *pages[TTF_GLYPH_PAGE_COUNT];
+} ttf_glyph_cache;
 
-static ttf_getwidth_cache_entry _ttfGetWidthCache[TTF_GETWIDTH_CACHE_SIZE] = { 0 };
-static int _ttfGetWidthCacheCount = 0;
-static int _ttfGetWidthCacheHitCount = 0;
-static int _ttfGetWidthCacheMissCount = 0;
+static ttf_glyph_cache _ttfGlyphCaches[FONT_SIZE_COUNT] = { 0 };
+static ttf_glyph_cache_stats _ttfGlyphCacheStats = { 0 };
 
 /**
  *
@@ -698,142 +706,227 @@ void gfx_draw_string_centred_wrapped_partial(rct_drawpixelinfo *dpi, int x, int
 	}
 }
 
-static uint32 _ttf_surface_cache_hash(TTF_Font *font, const utf8 *text)
+static ttf_glyph_cache *_ttf_glyph_cache_get(TTF_Font *font)
 {
-	uint32 hash = ((uint32)font * 23) ^ 0xAAAAAAAA;
-	for (const utf8 *ch = text; *ch != 0; ch++) {
-		hash = ror32(hash, 3) ^ (*ch * 13);
+	for (int i = 0; i < FONT_SIZE_COUNT; i++) {
+		if (_ttfGlyphCaches[i].font == font) {
+			return &_ttfGlyphCaches[i];
+		}
 	}
-	return hash;
+	return NULL;
 }
 
-static void _ttf_surface_cache_dispose(ttf_cache_entry *entry)
+static void _ttf_glyph_cache_init(ttf_glyph_cache *cache, TTF_Font *font)
 {
-	if (entry->surface != NULL) {
-		SDL_FreeSurface(entry->surface);
-		free(entry->text);
+	memset(cache, 0, sizeof(ttf_glyph_cache));
+	cache->font = font;
+	cache->ascent = TTF_FontAscent(font);
+	cache->height = TTF_FontHeight(font);
+	cache->kerning = TTF_GetFontKerning(font) != 0;
+}
 
-		entry->surface = NULL;
-		entry->font = NULL;
-		entry->text = NULL;
+static void _ttf_glyph_cache_dispose(ttf_glyph_cache *cache)
+{
+	for (int i = 0; i < TTF_GLYPH_PAGE_COUNT; i++) {
+		ttf_glyph *page = cache->pages[i];
+		if (page != NULL) {
+			for (int j = 0; j < TTF_GLYPH_PAGE_SIZE; j++) {
+				free(page[j].bitmap);
+			}
+			free(page);
+		}
 	}
+	memset(cache, 0, sizeof(ttf_glyph_cache));
 }
 
-static void _ttf_surface_cache_dispose_all()
+static void _ttf_glyph_cache_dispose_all()
 {
-	for (int i = 0; i < TTF_SURFACE_CACHE_SIZE; i++) {
-		_ttf_surface_cache_dispose(&_ttfSurfaceCache[i]);
-		_ttfSurfaceCacheCount--;
+	for (int i = 0; i < FONT_SIZE_COUNT; i++) {
+		_ttf_glyph_cache_dispose(&_ttfGlyphCaches[i]);
 	}
+	memset(&_ttfGlyphCacheStats, 0, sizeof(ttf_glyph_cache_stats));
 }
 
-SDL_Surface *ttf_surface_cache_get_or_add(TTF_Font *font, const utf8 *text)
+/**
+ * SDL_ttf can only render glyphs from the basic multilingual plane, the same
+ * restriction TTF_RenderUTF8_Solid had.
+ */
+static uint16 _ttf_glyph_codepoint(int codepoint)
 {
-	ttf_cache_entry *entry;
-
-	uint32 hash = _ttf_surface_cache_hash(font, text);
-	int index = hash % TTF_SURFACE_CACHE_SIZE;
-	for (int i = 0; i < TTF_SURFACE_CACHE_SIZE; i++) {
-		entry = &_ttfSurfaceCache[index];
-
-		// Check if entry is a hit
-		if (entry->surface == NULL) break;
-		if (entry->font == font && strcmp(entry->text, text) == 0) {
-			_ttfSurfaceCacheHitCount++;
-			entry->lastUseTick = gCurrentDrawCount;
-			return entry->surface;
-		}
+	return codepoint > 0xFFFF ? 0xFFFD : (uint16)codepoint;
+}
 
-		// If entry hasn't been used for a while, replace it
-		if (entry->lastUseTick < gCurrentDrawCount - 64) {
-			break;
-		}
+static void _ttf_glyph_load(ttf_glyph_cache *cache, ttf_glyph *glyph, uint16 codepoint)
+{
+	glyph->loaded = true;
 
-		// Check if next entry is a hit
-		if (++index >= TTF_SURFACE_CACHE_SIZE) index = 0;
+	int minX, maxX, minY, maxY, advance;
+	if (TTF_GlyphMetrics(cache->font, codepoint, &minX, &maxX, &minY, &maxY, &advance) != 0) {
+		return;
+	}
+	glyph->offset_x = minX;
+	glyph->offset_y = cache->ascent - maxY;
+	glyph->advance = advance;
+	if (maxX <= minX || maxY <= minY) {
+		return;
 	}
 
-	// Cache miss, replace entry with new surface
-	entry = &_ttfSurfaceCache[index];
-	_ttf_surface_cache_dispose(entry);
-
+	// Render the glyph as a one character line so the layout is the same on every
+	// version of SDL_ttf: the surface is a full line high and the pen starts at 0,
+	// or at -minX when the glyph extends to the left of it. The glyph's box is then
+	// cut out of the line using its metrics.
+	utf8 text[8] = { 0 };
+	utf8_write_codepoint(text, codepoint);
 	SDL_Color c = { 0, 0, 0, 255 };
-	SDL_Surface *surface = TTF_RenderUTF8_Solid(font, text, c);
+	SDL_Surface *surface = TTF_RenderUTF8_Solid(cache->font, text, c);
 	if (surface == NULL) {
-		return NULL;
+		return;
 	}
 
-	_ttfSurfaceCacheMissCount++;
-	// printf("CACHE HITS: %d   MISSES: %d)\n", _ttfSurfaceCacheHitCount, _ttfSurfaceCacheMissCount);
-
-	_ttfSurfaceCacheCount++;
-	entry->surface = surface;
-	entry->font = font;
-	entry->text = _strdup(text);
-	entry->lastUseTick = gCurrentDrawCount;
-	return entry->surface;
+	if (surface->w > 0 && surface->h > 0 && (!SDL_MUSTLOCK(surface) || SDL_LockSurface(surface) == 0)) {
+		int width = maxX - minX;
+		int height = maxY - minY;
+		int srcLeft = max(0, -minX) + minX;
+		int srcTop = glyph->offset_y;
+		size_t size = width * height;
+		glyph->bitmap = calloc(size, 1);
+		if (glyph->bitmap != NULL) {
+			const uint8 *src = surface->pixels;
+			for (int y = max(0, -srcTop); y < height && srcTop + y < surface->h; y++) {
+				const uint8 *srcRow = src + ((srcTop + y) * surface->pitch);
+				for (int x = max(0, -srcLeft); x < width && srcLeft + x < surface->w; x++) {
+					glyph->bitmap[(y * width) + x] = srcRow[srcLeft + x];
+				}
+			}
+			glyph->width = width;
+			glyph->height = height;
+			_ttfGlyphCacheStats.memory_used += size;
+		}
+		if (SDL_MUSTLOCK(surface)) {
+			SDL_UnlockSurface(surface);
+		}
+	}
+	SDL_FreeSurface(surface);
 }
 
-static void _ttf_getwidth_cache_dispose(ttf_getwidth_cache_entry *entry)
+static const ttf_glyph *_ttf_glyph_cache_get_or_add(ttf_glyph_cache *cache, uint16 codepoint)
 {
-	if (entry->text != NULL) {
-		free(entry->text);
+	ttf_glyph **page = &cache->pages[codepoint / TTF_GLYPH_PAGE_SIZE];
+	if (*page == NULL) {
+		*page = calloc(TTF_GLYPH_PAGE_SIZE, sizeof(ttf_glyph));
+		if (*page == NULL) {
+			return NULL;
+		}
+		_ttfGlyphCacheStats.page_count++;
+		_ttfGlyphCacheStats.memory_used += TTF_GLYPH_PAGE_SIZE * sizeof(ttf_glyph);
+	}
 
-		entry->width = 0;
-		entry->font = NULL;
-		entry->text = NULL;
+	ttf_glyph *glyph = &(*page)[codepoint % TTF_GLYPH_PAGE_SIZE];
+	if (glyph->loaded) {
+		_ttfGlyphCacheStats.hit_count++;
+		return glyph;
 	}
+
+	_ttfGlyphCacheStats.miss_count++;
+	_ttfGlyphCacheStats.glyph_count++;
+	_ttf_glyph_load(cache, glyph, codepoint);
+	return glyph;
 }
 
-static void _ttf_getwidth_cache_dispose_all()
+static int _ttf_glyph_cache_get_kerning(ttf_glyph_cache *cache, uint16 previous, uint16 codepoint)
 {
-	for (int i = 0; i < TTF_GETWIDTH_CACHE_SIZE; i++) {
-		_ttf_getwidth_cache_dispose(&_ttfGetWidthCache[i]);
-		_ttfGetWidthCacheCount--;
+	if (!cache->kerning || previous == 0) {
+		return 0;
+	}
+#if SDL_VERSIONNUM(SDL_TTF_MAJOR_VERSION, SDL_TTF_MINOR_VERSION, SDL_TTF_PATCHLEVEL) >= SDL_VERSIONNUM(2, 0, 14)
+	return TTF_GetFontKerningSizeGlyphs(cache->font, previous, codepoint);
+#else
+	// Before 2.0.14 kerning is looked up by glyph index, which TTF_GlyphIsProvided returns
+	int previousIndex = TTF_GlyphIsProvided(cache->font, previous);
+	int index = TTF_GlyphIsProvided(cache->font, codepoint);
+	if (previousIndex == 0 || index == 0) {
+		return 0;
 	}
+	return TTF_GetFontKerningSize(cache->font, previousIndex, index);
+#endif
 }
 
-static uint32 _ttf_getwidth_cache_get_or_add(TTF_Font *font, const utf8 *text)
+static int _ttf_glyph_run_get_width(ttf_glyph_cache *cache, const utf8 *text)
 {
-	ttf_getwidth_cache_entry *entry;
-
-	uint32 hash = _ttf_surface_cache_hash(font, text);
-	int index = hash % TTF_GETWIDTH_CACHE_SIZE;
-	for (int i = 0; i < TTF_GETWIDTH_CACHE_SIZE; i++) {
-		entry = &_ttfGetWidthCache[index];
-
-		// Check if entry is a hit
-		if (entry->text == NULL) break;
-		if (entry->font == font && strcmp(entry->text, text) == 0) {
-			_ttfGetWidthCacheHitCount++;
-			entry->lastUseTick = gCurrentDrawCount;
-			return entry->width;
+	const utf8 *ch = text;
+	int codepoint;
+	uint16 previous = 0;
+	int width = 0;
+	while ((codepoint = utf8_get_next(ch, &ch)) != 0) {
+		uint16 glyphCodepoint = _ttf_glyph_codepoint(codepoint);
+		const ttf_glyph *glyph = _ttf_glyph_cache_get_or_add(cache, glyphCodepoint);
+		width += _ttf_glyph_cache_get_kerning(cache, previous, glyphCodepoint);
+		if (glyph != NULL) {
+			width += glyph->advance;
 		}
+		previous = glyphCodepoint;
+	}
+	return width;
+}
 
-		// If entry hasn't been used for a while, replace it
-		if (entry->lastUseTick < gCurrentDrawCount - 64) {
-			break;
-		}
+void ttf_get_glyph_cache_stats(ttf_glyph_cache_stats *stats)
+{
+	*stats = _ttfGlyphCacheStats;
+}
+
+/**
+ * Renders a run of text (no format codes) into a newly allocated bitmap that is
+ * the advance width of the run by the font height. Pixels are non-zero where set.
+ * The caller is responsible for freeing the bitmap.
+ */
+uint8 *ttf_render_glyph_run(TTF_Font *font, const utf8 *text, int *outWidth, int *outHeight)
+{
+	ttf_glyph_cache *cache = _ttf_glyph_cache_get(font);
+	if (cache == NULL) {
+		return NULL;
+	}
 
-		// Check if next entry is a hit
-		if (++index >= TTF_GETWIDTH_CACHE_SIZE) index = 0;
+	int width = _ttf_glyph_run_get_width(cache, text);
+	int height = cache->height;
+	if (width <= 0 || height <= 0) {
+		return NULL;
 	}
 
-	// Cache miss, replace entry with new width
-	entry = &_ttfGetWidthCache[index];
-	_ttf_getwidth_cache_dispose(entry);
+	uint8 *bitmap = calloc(width * height, 1);
+	if (bitmap == NULL) {
+		return NULL;
+	}
 
-	int width, height;
-	TTF_SizeUTF8(font, text, &width, &height);
+	const utf8 *ch = text;
+	int codepoint;
+	uint16 previous = 0;
+	int x = 0;
+	while ((codepoint = utf8_get_next(ch, &ch)) != 0) {
+		uint16 glyphCodepoint = _ttf_glyph_codepoint(codepoint);
+		const ttf_glyph *glyph = _ttf_glyph_cache_get_or_add(cache, glyphCodepoint);
+		x += _ttf_glyph_cache_get_kerning(cache, previous, glyphCodepoint);
+		previous = glyphCodepoint;
+		if (glyph == NULL) {
+			continue;
+		}
 
-	_ttfGetWidthCacheMissCount++;
+		if (glyph->bitmap != NULL) {
+			int left = x + glyph->offset_x;
+			int top = glyph->offset_y;
+			for (int yy = max(0, -top); yy < glyph->height && top + yy < height; yy++) {
+				const uint8 *src = glyph->bitmap + (yy * glyph->width);
+				uint8 *dst = bitmap + ((top + yy) * width);
+				for (int xx = max(0, -left); xx < glyph->width && left + xx < width; xx++) {
+					dst[left + xx] |= src[xx];
+				}
+			}
+		}
+		x += glyph->advance;
+	}
 
-	_ttfGetWidthCacheCount++;
-	entry->width = width;
-	entry->font = font;
-	entry->text = _strdup(text);
-	entry->lastUseTick = gCurrentDrawCount;
-	return entry->width;
+	*outWidth = width;
+	*outHeight = height;
+	return bitmap;
 }
 
 bool ttf_initialise()
@@ -857,6 +950,8 @@ bool ttf_initialise()
 				log_error("Unable to load '%s'", fontPath);
 				return false;
 			}
+
+			_ttf_glyph_cache_init(&_ttfGlyphCaches[i], fontDesc->font);
 		}
 
 		_ttfInitialised = true;
@@ -869,8 +964,10 @@ void ttf_dispose()
 	if (!_ttfInitialised)
 		return;
 
-	_ttf_surface_cache_dispose_all();
-	_ttf_getwidth_cache_dispose_all();
+	log_verbose("TTF glyph cache: %u glyphs, %u pages, %u bytes, %u hits, %u misses",
+		_ttfGlyphCacheStats.glyph_count, _ttfGlyphCacheStats.page_count, (uint32)_ttfGlyphCacheStats.memory_used,
+		_ttfGlyphCacheStats.hit_count, _ttfGlyphCacheStats.miss_count);
+	_ttf_glyph_cache_dispose_all();
 
 	for (int i = 0; i < 4; i++) {
 		TTFFontDescriptor *fontDesc = &(gCurrentTTFFontSet->size[i]);
@@ -940,108 +1037,132 @@ static void ttf_draw_string_raw_sprite(rct_drawpixelinfo *dpi, const utf8 *text,
 	};
 }
 
-static void ttf_draw_string_raw_ttf(rct_drawpixelinfo *dpi, const utf8 *text, text_draw_info *info)
+/**
+ * Draws a single cached glyph. The shadow pass draws the outline and inset shadow
+ * so that it can be done for the whole run before the glyphs themselves, stopping
+ * the shadow of one glyph from overwriting its neighbour.
+ */
+static void ttf_draw_glyph(rct_drawpixelinfo *dpi, const ttf_glyph *glyph, int drawX, int drawY, bool shadowPass, const text_draw_info *info)
 {
-	if (!_ttfInitialised && !ttf_initialise())
-		return;
-
-	TTFFontDescriptor *fontDesc = ttf_get_font_from_sprite_base(info->font_sprite_base);
-	if (fontDesc->font == NULL) {
-		ttf_draw_string_raw_sprite(dpi, text, info);
-		return;
+	int width = glyph->width;
+	int height = glyph->height;
+
+	int overflowX = (dpi->x + dpi->width) - (drawX + width);
+	int overflowY = (dpi->y + dpi->height) - (drawY + height);
+	if (overflowX < 0) width += overflowX;
+	if (overflowY < 0) height += overflowY;
+	int skipX = drawX - dpi->x;
+	int skipY = drawY - dpi->y;
+
+	const uint8 *src = glyph->bitmap;
+	uint8 *dst = dpi->bits;
+
+	if (skipX < 0) {
+		width += skipX;
+		src += -skipX;
+		skipX = 0;
 	}
-
-	if (info->flags & TEXT_DRAW_FLAG_NO_DRAW) {
-		info->x += _ttf_getwidth_cache_get_or_add(fontDesc->font, text);
+	if (skipY < 0) {
+		height += skipY;
+		src += (-skipY * glyph->width);
+		skipY = 0;
+	}
+	if (width <= 0 || height <= 0) {
 		return;
-	} else {
-		uint8 colour = info->palette[1];
-		SDL_Surface *surface = ttf_surface_cache_get_or_add(fontDesc->font, text);
-		if (surface == NULL)
-			return;
-
-		if (SDL_MUSTLOCK(surface)) {
-			if (SDL_LockSurface(surface) != 0) {
-				return;
-			}
-		}
-
-		int drawX = info->x + fontDesc->offset_x;
-		int drawY = info->y + fontDesc->offset_y;
-		int width = surface->w;
-		int height = surface->h;
-
-		int overflowX = (dpi->x + dpi->width) - (drawX + width);
-		int overflowY = (dpi->y + dpi->height) - (drawY + height);
-		if (overflowX < 0) width += overflowX;
-		if (overflowY < 0) height += overflowY;
-		int skipX = drawX - dpi->x;
-		int skipY = drawY - dpi->y;
-		info->x += width;
-
-		uint8 *src = surface->pixels;
-		uint8 *dst = dpi->bits;
-
-		if (skipX < 0) {
-			width += skipX;
-			src += -skipX;
-			skipX = 0;
-		}
-		if (skipY < 0) {
-			height += skipY;
-			src += (-skipY * surface->pitch);
-			skipY = 0;
-		}
+	}
 
-		dst += skipX;
-		dst += skipY * (dpi->width + dpi->pitch);
-
-		int srcScanSkip = surface->pitch - width;
-		int dstScanSkip = dpi->width + dpi->pitch - width;
-		uint8 *dst_orig = dst;
-		uint8 *src_orig = src;
-
-		// Draw shadow/outline
-		if (info->flags & TEXT_DRAW_FLAG_OUTLINE) {
-			for (int yy = 0; yy < height - 0; yy++) {
-				for (int xx = 0; xx < width - 0; xx++) {
-					if (*src != 0) {
-						*(dst + 1) = info->palette[3]; // right
-						*(dst - 1) = info->palette[3]; // left
-						*(dst - width - dstScanSkip) = info->palette[3]; // top
-						*(dst + width + dstScanSkip) = info->palette[3]; // bottom
+	int dstStride = dpi->width + dpi->pitch;
+	dst += skipX;
+	dst += skipY * dstStride;
+
+	int srcScanSkip = glyph->width - width;
+	int dstScanSkip = dstStride - width;
+
+	if (shadowPass) {
+		uint8 shadowColour = info->palette[3];
+		bool outline = (info->flags & TEXT_DRAW_FLAG_OUTLINE) != 0;
+		bool inset = (info->flags & TEXT_DRAW_FLAG_INSET) != 0;
+		for (int yy = 0; yy < height; yy++) {
+			for (int xx = 0; xx < width; xx++) {
+				if (*src != 0) {
+					if (outline) {
+						*(dst + 1) = shadowColour; // right
+						*(dst - 1) = shadowColour; // left
+						*(dst - dstStride) = shadowColour; // top
+						*(dst + dstStride) = shadowColour; // bottom
+					}
+					if (inset) {
+						*(dst + dstStride + 1) = shadowColour;
 					}
-					src++;
-					dst++;
 				}
-				// Skip any remaining bits
-				src += srcScanSkip;
-				dst += dstScanSkip;
+				src++;
+				dst++;
 			}
+			src += srcScanSkip;
+			dst += dstScanSkip;
 		}
-		{
-			dst = dst_orig;
-			src = src_orig;
-			for (int yy = 0; yy < height; yy++) {
-				for (int xx = 0; xx < width; xx++) {
-					if (*src != 0) {
-						if (info->flags & TEXT_DRAW_FLAG_INSET) {
-							*(dst + width + dstScanSkip + 1) = info->palette[3];
-						}
-						*dst = colour;
-					}
-					src++;
-					dst++;
+	} else {
+		uint8 colour = info->palette[1];
+		for (int yy = 0; yy < height; yy++) {
+			for (int xx = 0; xx < width; xx++) {
+				if (*src != 0) {
+					*dst = colour;
 				}
-				src += srcScanSkip;
-				dst += dstScanSkip;
+				src++;
+				dst++;
 			}
+			src += srcScanSkip;
+			dst += dstScanSkip;
 		}
+	}
+}
 
-		if (SDL_MUSTLOCK(surface)) {
-			SDL_UnlockSurface(surface);
+static int ttf_draw_glyph_run(rct_drawpixelinfo *dpi, ttf_glyph_cache *cache, const utf8 *text, int x, int y, bool shadowPass, const text_draw_info *info)
+{
+	const utf8 *ch = text;
+	int codepoint;
+	uint16 previous = 0;
+	while ((codepoint = utf8_get_next(ch, &ch)) != 0) {
+		uint16 glyphCodepoint = _ttf_glyph_codepoint(codepoint);
+		const ttf_glyph *glyph = _ttf_glyph_cache_get_or_add(cache, glyphCodepoint);
+		x += _ttf_glyph_cache_get_kerning(cache, previous, glyphCodepoint);
+		previous = glyphCodepoint;
+		if (glyph == NULL) {
+			continue;
+		}
+
+		if (glyph->bitmap != NULL) {
+			ttf_draw_glyph(dpi, glyph, x + glyph->offset_x, y + glyph->offset_y, shadowPass, info);
 		}
+		x += glyph->advance;
+	}
+	return x;
+}
+
+static void ttf_draw_string_raw_ttf(rct_drawpixelinfo *dpi, const utf8 *text, text_draw_info *info)
+{
+	if (!_ttfInitialised && !ttf_initialise())
+		return;
+
+	TTFFontDescriptor *fontDesc = ttf_get_font_from_sprite_base(info->font_sprite_base);
+	ttf_glyph_cache *cache = _ttf_glyph_cache_get(fontDesc->font);
+	if (fontDesc->font == NULL || cache == NULL) {
+		ttf_draw_string_raw_sprite(dpi, text, info);
+		return;
+	}
+
+	if (info->flags & TEXT_DRAW_FLAG_NO_DRAW) {
+		info->x += _ttf_glyph_run_get_width(cache, text);
+		return;
+	}
+
+	int drawX = info->x + fontDesc->offset_x;
+	int drawY = info->y + fontDesc->offset_y;
+	if (info->flags & (TEXT_DRAW_FLAG_OUTLINE | TEXT_DRAW_FLAG_INSET)) {
+		ttf_draw_glyph_run(dpi, cache, text, drawX, drawY, true, info);
 	}
+	int endX = ttf_draw_glyph_run(dpi, cache, text, drawX, drawY, false, info);
+	info->x += endX - drawX;
 }
 
 static void ttf_draw_string_raw(rct_drawpixelinfo *dpi, const utf8 *text, text_draw_info *info)
@@ -23,6 +23,7 @@
 #include "world/footpath.h"
 #include "input.h"
 #include "localisation/localisation.h"
+#include "interface/console.h"
 #include "interface/screenshot.h"
 #include "interface/viewport.h"
 #include "interface/widget.h"
@@ -38,6 +39,7 @@
 #include "peep/staff.h"
 #include "platform/platform.h"
 #include "rct1.h"
+#include "replay.h"
 #include "ride/ride.h"
 #include "ride/ride_ratings.h"
 #include "ride/vehicle.h"
@@ -58,6 +60,23 @@
 
 #define NUMBER_OF_AUTOSAVES_TO_KEEP 9
 
+enum {
+	AUTOSAVE_STATE_IDLE,
+	AUTOSAVE_STATE_WRITING,
+	AUTOSAVE_STATE_FINISHED
+};
+
+typedef struct autosave_job {
+	scenario_snapshot *snapshot;
+	utf8 path[MAX_PATH];
+	utf8 backup_path[MAX_PATH];
+	bool result;
+} autosave_job;
+
+static SDL_Thread *_autosaveThread = NULL;
+static SDL_atomic_t _autosaveState = { AUTOSAVE_STATE_IDLE };
+static autosave_job _autosaveJob;
+
 uint16 gTicksSinceLastUpdate;
 uint32 gLastTickCount;
 uint8 gGamePaused = 0;
@@ -306,6 +325,7 @@ void game_update()
 	}
 
 	// Always perform autosave check, even when paused
+	game_autosave_update(false);
 	scenario_autosave_check();
 
 	network_update();
@@ -353,6 +373,10 @@ void game_logic_update()
 			return;
 		}
 	}
+	// Commands of a replay that is being played back run at the same point as network commands
+	replay_update();
+	// All the commands of this tick have run on both the server and the clients
+	network_record_state();
 	gCurrentTicks++;
 	gScenarioTicks++;
 	gScreenAge++;
@@ -513,6 +537,10 @@ int game_do_command_p(int command, int *eax, int *ebx, int *ecx, int *edx, int *
 				}
 			}
 
+			if (gGameCommandNestLevel == 1 && command != GAME_COMMAND_LOAD_OR_QUIT) {
+				replay_record_command(command, *eax, *ebx, *ecx, *edx, *edi, *ebp, game_command_playerid);
+			}
+
 			// Second call to actually perform the operation
 			new_game_command_table[command](eax, ebx, ecx, edx, esi, edi, ebp);
 
@@ -797,6 +825,8 @@ bool game_load_save(const utf8 *path)
 
 	if (extension_type == FILE_EXTENSION_SV6) {
 		result = game_load_sv6(rw);
+	} else if (extension_type == FILE_EXTENSION_PARK) {
+		result = game_load_park(rw);
 	} else if (extension_type == FILE_EXTENSION_SV4) {
 		result = rct1_load_saved_game(path);
 		if (result)
@@ -826,6 +856,9 @@ void game_load_init()
 {
 	rct_window *mainWindow;
 
+	// A replay continues from a single park
+	replay_stop_recording();
+
 	gScreenFlags = SCREEN_FLAGS_PLAYING;
 	viewport_init_all();
 	game_create_windows();
@@ -889,7 +922,12 @@ void save_game()
 
 		SDL_RWops* rw = SDL_RWFromFile(gScenarioSavePath, "wb+");
 		if (rw != NULL) {
-			scenario_save(rw, 0x80000000 | (gConfigGeneral.save_plugin_data ? 1 : 0));
+			int flags = 0x80000000 | (gConfigGeneral.save_plugin_data ? 1 : 0);
+			if (get_file_extension_type(gScenarioSavePath) == FILE_EXTENSION_PARK) {
+				scenario_save_park(rw, flags);
+			} else {
+				scenario_save(rw, flags);
+			}
 			log_verbose("Saved to %s", gScenarioSavePath);
 			SDL_RWclose(rw);
 
@@ -913,6 +951,8 @@ static int compare_autosave_file_paths (const void * a, const void * b ) {
 	return strcmp(*(char **)a, *(char **)b);
 }
 
+static int game_autosave_thread(void *ptr);
+
 static void limit_autosave_count(const size_t numberOfFilesToKeep)
 {
 	int fileEnumHandle = 0;
@@ -980,6 +1020,11 @@ static void limit_autosave_count(const size_t numberOfFilesToKeep)
 
 void game_autosave()
 {
+	if (SDL_AtomicGet(&_autosaveState) != AUTOSAVE_STATE_IDLE) {
+		log_verbose("skipping autosave, previous autosave still being written");
+		return;
+	}
+
 	utf8 path[MAX_PATH];
 	utf8 backupPath[MAX_PATH];
 	utf8 timeString[21]="";
@@ -1003,15 +1048,64 @@ void game_autosave()
 	
 	strcat(backupPath, "autosave.sv6.bak");
 
-	if (platform_file_exists(path)) {
-		platform_file_copy(path, backupPath, true);
+	// Capture the park now, encoding and writing happen on a background thread
+	_autosaveJob.snapshot = scenario_snapshot_create();
+	safe_strcpy(_autosaveJob.path, path, MAX_PATH);
+	safe_strcpy(_autosaveJob.backup_path, backupPath, MAX_PATH);
+	_autosaveJob.result = false;
+
+	SDL_AtomicSet(&_autosaveState, AUTOSAVE_STATE_WRITING);
+	_autosaveThread = SDL_CreateThread(game_autosave_thread, "autosave", &_autosaveJob);
+	if (_autosaveThread == NULL) {
+		log_warning("Unable to create autosave thread, saving on the game thread.");
+		game_autosave_thread(&_autosaveJob);
 	}
+}
+
+static int game_autosave_thread(void *ptr)
+{
+	autosave_job *job = (autosave_job*)ptr;
 
-	SDL_RWops* rw = SDL_RWFromFile(path, "wb+");
+	if (platform_file_exists(job->path)) {
+		platform_file_copy(job->path, job->backup_path, true);
+	}
+
+	SDL_RWops* rw = SDL_RWFromFile(job->path, "wb+");
 	if (rw != NULL) {
-		scenario_save(rw, 0x80000000);
+		job->result = scenario_snapshot_write(job->snapshot, rw) != 0;
 		SDL_RWclose(rw);
 	}
+
+	SDL_AtomicSet(&_autosaveState, AUTOSAVE_STATE_FINISHED);
+	return 0;
+}
+
+/**
+ * Checks whether a background autosave has finished and reports the result. Called
+ * every update, and with wait set before anything that must not overlap an autosave.
+ */
+void game_autosave_update(bool wait)
+{
+	int state = SDL_AtomicGet(&_autosaveState);
+	if (state == AUTOSAVE_STATE_IDLE || (state == AUTOSAVE_STATE_WRITING && !wait)) {
+		return;
+	}
+
+	if (_autosaveThread != NULL) {
+		SDL_WaitThread(_autosaveThread, NULL);
+		_autosaveThread = NULL;
+	}
+	scenario_snapshot_dispose(_autosaveJob.snapshot);
+	_autosaveJob.snapshot = NULL;
+	SDL_AtomicSet(&_autosaveState, AUTOSAVE_STATE_IDLE);
+
+	if (_autosaveJob.result) {
+		log_verbose("autosaved to %s", _autosaveJob.path);
+		console_printf("Autosaved to %s", _autosaveJob.path);
+	} else {
+		log_error("Unable to autosave to %s", _autosaveJob.path);
+		console_writeline_error("Autosave failed.");
+	}
 }
 
 /**
@@ -159,6 +159,7 @@ void game_reduce_game_speed();
 
 void game_load_or_quit_no_save_prompt();
 int game_load_sv6(SDL_RWops* rw);
+int game_load_park(SDL_RWops* rw);
 int game_load_network(SDL_RWops* rw);
 bool game_load_save(const utf8 *path);
 void game_load_init();
@@ -171,6 +172,7 @@ void save_game_as();
 void rct2_exit();
 void rct2_exit_reason(rct_string_id title, rct_string_id body);
 void game_autosave();
+void game_autosave_update(bool wait);
 void game_convert_strings_to_utf8();
 void game_convert_strings_to_rct2(rct_s6_data *s6);
 void game_fix_save_vars();
@@ -25,4 +25,11 @@ bool image_io_png_read(uint8 **pixels, uint32 *width, uint32 *height, const utf8
 bool image_io_png_write(const rct_drawpixelinfo *dpi, const rct_palette *palette, const utf8 *path);
 bool image_io_png_write_32bpp(sint32 width, sint32 height, const void *pixels, const utf8 *path);
 
+// Writes an 8-bit palette PNG a band of rows at a time, so the whole image never needs to be in memory
+typedef struct image_io_png_stream image_io_png_stream;
+
+image_io_png_stream *image_io_png_stream_open(sint32 width, sint32 height, const rct_palette *palette, const utf8 *path);
+bool image_io_png_stream_write_rows(image_io_png_stream *stream, const uint8 *bits, sint32 stride, sint32 rows);
+bool image_io_png_stream_close(image_io_png_stream *stream);
+
 #endif
@@ -28,8 +28,10 @@
 #include "../cursors.h"
 #include "../game.h"
 #include "../input.h"
+#include "../network/network.h"
 #include "../network/twitch.h"
 #include "../object.h"
+#include "../replay.h"
 #include "../object/ObjectManager.h"
 #include "../object/ObjectRepository.h"
 #include "../world/banner.h"
@@ -951,6 +953,19 @@ static int cc_object_count(const utf8 **argv, int argc) {
 	return 0;
 }
 
+static int cc_font_cache(const utf8 **argv, int argc)
+{
+	ttf_glyph_cache_stats stats;
+	ttf_get_glyph_cache_stats(&stats);
+
+	uint32 lookups = stats.hit_count + stats.miss_count;
+	console_printf("Glyphs: %u (%u pages)", stats.glyph_count, stats.page_count);
+	console_printf("Memory: %u KiB", (uint32)(stats.memory_used / 1024));
+	console_printf("Hits: %u  Misses: %u  Hit rate: %.1f%%", stats.hit_count, stats.miss_count,
+		lookups == 0 ? 0.0 : (stats.hit_count * 100.0) / lookups);
+	return 0;
+}
+
 static int cc_reset_user_strings(const utf8 **argv, int argc)
 {
 	reset_user_strings();
@@ -963,6 +978,83 @@ static int cc_fix_banner_count(const utf8 **argv, int argc)
 	return 0;
 }
 
+static int cc_desync_check(const utf8 **argv, int argc)
+{
+	if (network_get_mode() != NETWORK_MODE_CLIENT) {
+		console_writeline_error("Only clients can check for a desync.");
+		return 1;
+	}
+	network_check_state();
+	console_writeline("Requested the state hashes from the server.");
+	return 0;
+}
+
+static int cc_network_stats(const utf8 **argv, int argc)
+{
+	if (network_get_mode() == NETWORK_MODE_NONE) {
+		console_writeline_error("Not in a multiplayer game.");
+		return 1;
+	}
+
+	network_stats_summary stats;
+	network_get_stats(&stats);
+	console_printf("Received: %u KiB in %u packets (%u B/s)", (uint32)(stats.bytes_in / 1024), stats.packets_in, stats.bytes_in_per_second);
+	console_printf("Sent: %u KiB in %u packets (%u B/s)", (uint32)(stats.bytes_out / 1024), stats.packets_out, stats.bytes_out_per_second);
+	console_printf("Send queue: %u packets (max %u)  Recent time in queue: p50 %u ms  p99 %u ms  max %u ms",
+		stats.queue_depth, stats.max_queue_depth, stats.queue_time_p50, stats.queue_time_p99, stats.queue_time_max);
+	if (stats.map_sends > 0) {
+		console_printf("Maps sent: %u  Mean: %u ms  Max: %u ms", stats.map_sends, stats.map_send_time_mean, stats.map_send_time_max);
+	}
+	if (stats.ping_samples > 0) {
+		console_printf("Recent ping: p50 %u ms  p99 %u ms  max %u ms", stats.ping_p50, stats.ping_p99, stats.ping_max);
+	}
+	if (stats.command_latency_samples > 0) {
+		console_printf("Recent game command round trip: p50 %u ms  p99 %u ms  max %u ms",
+			stats.command_latency_p50, stats.command_latency_p99, stats.command_latency_max);
+	}
+	for (uint32 i = 0; i < stats.num_commands; i++) {
+		const network_command_stats *command = &stats.commands[i];
+		if (command->packets_in != 0 || command->packets_out != 0) {
+			console_printf("  %-16s in: %6u packets %8u B  out: %6u packets %8u B", command->name,
+				command->packets_in, (uint32)command->bytes_in, command->packets_out, (uint32)command->bytes_out);
+		}
+	}
+	return 0;
+}
+
+static int cc_replay(const utf8 **argv, int argc)
+{
+	if (argc > 0 && strcmp(argv[0], "stop") == 0) {
+		if (!replay_is_recording()) {
+			console_writeline_error("No replay is being recorded.");
+			return 1;
+		}
+		replay_stop_recording();
+		console_writeline("Stopped recording the replay.");
+		return 0;
+	}
+	if (argc < 2 || strcmp(argv[0], "start") != 0) {
+		console_writeline_error("Expected start <name> or stop.");
+		return 1;
+	}
+	if (gScreenFlags != SCREEN_FLAGS_PLAYING) {
+		console_writeline_error("Replays can only be recorded while playing a park.");
+		return 1;
+	}
+
+	utf8 path[MAX_PATH];
+	platform_get_user_directory(path, "replay");
+	platform_ensure_directory_exists(path);
+	safe_strcat_path(path, argv[1], sizeof(path));
+	path_append_extension(path, ".replay");
+	if (!replay_start_recording(path)) {
+		console_writeline_error("Unable to start recording the replay.");
+		return 1;
+	}
+	console_printf("Recording the replay to %s", path);
+	return 0;
+}
+
 static int cc_open(const utf8 **argv, int argc) {
 	if (argc > 0) {
 		bool title = (gScreenFlags & SCREEN_FLAGS_TITLE_DEMO) != 0;
@@ -1056,10 +1148,15 @@ console_command console_command_table[] = {
 									"load_object <objectfilenodat>" },
 	{ "object_count", cc_object_count, "Shows the number of objects of each type in the scenario.", "object_count" },
 	{ "twitch", cc_twitch, "Twitch API" },
+	{ "font_cache", cc_font_cache, "Shows the TrueType glyph cache size and hit rate.", "font_cache" },
 	{ "reset_user_strings", cc_reset_user_strings, "Resets all user-defined strings, to fix incorrectly occurring 'Chosen name in use already' errors.", "reset_user_strings" },
 	{ "fix_banner_count", cc_fix_banner_count, "Fixes incorrectly appearing 'Too many banners' error by marking every banner entry without a map element as null.", "fix_banner_count" },
 	{ "rides", cc_rides, "Ride management.", "rides <subcommand>" },
 	{ "staff", cc_staff, "Staff management.", "staff <subcommand>"},
+	{ "desync_check", cc_desync_check, "Compares the recent state hashes of the client with the server and dumps the first difference.\n"
+										"Requires desync_debugging to be enabled on both.", "desync_check" },
+	{ "network_stats", cc_network_stats, "Shows the multiplayer traffic of each packet type, the send queue and round trip times.", "network_stats" },
+	{ "replay", cc_replay, "Records the park and every game command from now on, to be played back with the replay command line command.", "replay start <name>\nreplay stop" },
 };
 
 static int cc_windows(const utf8 **argv, int argc) {
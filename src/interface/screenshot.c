@@ -150,6 +150,124 @@ int screenshot_dump_png_32bpp(sint32 width, sint32 height, const void *pixels)
 	}
 }
 
+// Upper bound for the memory of a single band, giant screenshots are rendered and written one band at a time
+#define SCREENSHOT_BAND_MAX_SIZE (16 * 1024 * 1024)
+
+typedef struct screenshot_band {
+	uint8 *bits;
+	sint32 rows;
+	SDL_sem *free;
+	SDL_sem *ready;
+} screenshot_band;
+
+typedef struct screenshot_band_writer {
+	image_io_png_stream *stream;
+	screenshot_band bands[2];
+	sint32 width;
+	sint32 numBands;
+	bool failed;
+} screenshot_band_writer;
+
+/**
+ * Writes bands to the PNG in order as they are rendered, so that compression of one band overlaps with
+ * painting of the next. Painting itself relies on global state and always happens on the calling thread.
+ */
+static int screenshot_band_writer_run(void *ptr)
+{
+	screenshot_band_writer *writer = (screenshot_band_writer*)ptr;
+	for (sint32 i = 0; i < writer->numBands; i++) {
+		screenshot_band *band = &writer->bands[i & 1];
+		SDL_SemWait(band->ready);
+		if (!writer->failed && !image_io_png_stream_write_rows(writer->stream, band->bits, writer->width, band->rows)) {
+			writer->failed = true;
+		}
+		SDL_SemPost(band->free);
+	}
+	return 0;
+}
+
+/**
+ * Renders the viewport to a PNG file in horizontal bands, peak memory is bounded by two bands
+ * rather than the whole image.
+ */
+static bool screenshot_render_viewport_to_png(rct_viewport *viewport, const utf8 *path)
+{
+	sint32 width = viewport->width;
+	sint32 height = viewport->height;
+
+	rct_palette renderedPalette;
+	screenshot_get_rendered_palette(&renderedPalette);
+
+	screenshot_band_writer writer = { 0 };
+	writer.stream = image_io_png_stream_open(width, height, &renderedPalette, path);
+	if (writer.stream == NULL) {
+		// The file may have been created before the header failed to write
+		platform_file_delete(path);
+		return false;
+	}
+
+	sint32 bandHeight = clamp(1, SCREENSHOT_BAND_MAX_SIZE / width, height);
+	writer.width = width;
+	writer.numBands = (height + bandHeight - 1) / bandHeight;
+	for (int i = 0; i < 2; i++) {
+		writer.bands[i].bits = malloc(width * bandHeight);
+		writer.bands[i].free = SDL_CreateSemaphore(1);
+		writer.bands[i].ready = SDL_CreateSemaphore(0);
+	}
+
+	SDL_Thread *thread = NULL;
+	if (writer.numBands > 1) {
+		thread = SDL_CreateThread(screenshot_band_writer_run, "Screenshot writer", &writer);
+		if (thread == NULL) {
+			log_warning("Unable to create screenshot writer thread, writing bands synchronously.");
+		}
+	}
+
+	for (sint32 i = 0; i < writer.numBands; i++) {
+		screenshot_band *band = &writer.bands[i & 1];
+		sint32 top = i * bandHeight;
+		band->rows = min(bandHeight, height - top);
+
+		if (thread != NULL) {
+			SDL_SemWait(band->free);
+		}
+
+		rct_drawpixelinfo dpi;
+		dpi.x = 0;
+		dpi.y = top;
+		dpi.width = width;
+		dpi.height = band->rows;
+		dpi.pitch = 0;
+		dpi.zoom_level = 0;
+		dpi.bits = band->bits;
+		memset(dpi.bits, 0, width * band->rows);
+		viewport_render(&dpi, viewport, 0, top, width, top + band->rows);
+
+		if (thread != NULL) {
+			SDL_SemPost(band->ready);
+		} else if (!writer.failed && !image_io_png_stream_write_rows(writer.stream, band->bits, width, band->rows)) {
+			writer.failed = true;
+		}
+	}
+
+	if (thread != NULL) {
+		SDL_WaitThread(thread, NULL);
+	}
+
+	for (int i = 0; i < 2; i++) {
+		free(writer.bands[i].bits);
+		SDL_DestroySemaphore(writer.bands[i].free);
+		SDL_DestroySemaphore(writer.bands[i].ready);
+	}
+
+	bool result = image_io_png_stream_close(writer.stream) && !writer.failed;
+	if (!result) {
+		// Do not leave a truncated image behind
+		platform_file_delete(path);
+	}
+	return result;
+}
+
 void screenshot_giant()
 {
 	int originalRotation = get_current_rotation();
@@ -210,17 +328,6 @@ void screenshot_giant()
 	// Ensure sprites appear regardless of rotation
 	reset_all_sprite_quadrant_placements();
 
-	rct_drawpixelinfo dpi;
-	dpi.x = 0;
-	dpi.y = 0;
-	dpi.width = resolutionWidth;
-	dpi.height = resolutionHeight;
-	dpi.pitch = 0;
-	dpi.zoom_level = 0;
-	dpi.bits = malloc(dpi.width * dpi.height);
-
-	viewport_render(&dpi, &viewport, 0, 0, viewport.width, viewport.height);
-
 	// Get a free screenshot path
 	char path[MAX_PATH];
 	int index;
@@ -230,12 +337,11 @@ void screenshot_giant()
 		return;
 	}
 
-	rct_palette renderedPalette;
-	screenshot_get_rendered_palette(&renderedPalette);
-
-	image_io_png_write(&dpi, &renderedPalette, path);
-
-	free(dpi.bits);
+	if (!screenshot_render_viewport_to_png(&viewport, path)) {
+		log_error("Giant screenshot failed, unable to write '%s'.", path);
+		window_error_open(STR_SCREENSHOT_FAILED, -1);
+		return;
+	}
 
 	// Show user that screenshot saved successfully
 	rct_string_id stringId = STR_PLACEHOLDER;
@@ -357,23 +463,10 @@ int cmdline_for_screenshot(const char **argv, int argc)
 		// Ensure sprites appear regardless of rotation
 		reset_all_sprite_quadrant_placements();
 
-		rct_drawpixelinfo dpi;
-		dpi.x = 0;
-		dpi.y = 0;
-		dpi.width = resolutionWidth;
-		dpi.height = resolutionHeight;
-		dpi.pitch = 0;
-		dpi.zoom_level = 0;
-		dpi.bits = malloc(dpi.width * dpi.height);
-
-		viewport_render(&dpi, &viewport, 0, 0, viewport.width, viewport.height);
-
-		rct_palette renderedPalette;
-		screenshot_get_rendered_palette(&renderedPalette);
-
-		image_io_png_write(&dpi, &renderedPalette, outputPath);
+		if (!screenshot_render_viewport_to_png(&viewport, outputPath)) {
+			log_error("Unable to write screenshot to '%s'.", outputPath);
+		}
 
-		free(dpi.bits);
 		drawing_engine_dispose();
 	}
 	openrct2_dispose();
@@ -22,6 +22,7 @@
 #include "../input.h"
 #include "../localisation/localisation.h"
 #include "../peep/staff.h"
+#include "../platform/platform.h"
 #include "../ride/ride_data.h"
 #include "../ride/track_data.h"
 #include "../sprites.h"
@@ -41,6 +42,7 @@
 
 rct_viewport g_viewport_list[MAX_VIEWPORT_COUNT];
 rct_viewport *g_music_tracking_viewport;
+viewport_paint_timings *gViewportPaintTimings = NULL;
 
 #ifdef NO_RCT2
 paint_struct *unk_EE7884;
@@ -661,6 +663,13 @@ void viewport_render(rct_drawpixelinfo *dpi, rct_viewport *viewport, int left, i
 #endif
 }
 
+static void viewport_paint_timing_lap(uint64 *stage, uint64 *stageStart)
+{
+	uint64 now = SDL_GetPerformanceCounter();
+	*stage += now - *stageStart;
+	*stageStart = now;
+}
+
 /**
  *
  *  rct2: 0x00685CBF
@@ -748,10 +757,15 @@ void viewport_paint(rct_viewport* viewport, rct_drawpixelinfo* dpi, int left, in
 		}
 		RCT2_GLOBAL(0xEE7880, uint32) = 0xF1A4CC;
 		unk_140E9A8 = dpi2;
+		viewport_paint_timings *timings = gViewportPaintTimings;
+		uint64 stageStart = timings != NULL ? SDL_GetPerformanceCounter() : 0;
 		painter_setup();
 		viewport_paint_setup();
+		if (timings != NULL) viewport_paint_timing_lap(&timings->setup, &stageStart);
 		sub_688217();
+		if (timings != NULL) viewport_paint_timing_lap(&timings->sort, &stageStart);
 		paint_quadrant_ps();
+		if (timings != NULL) viewport_paint_timing_lap(&timings->draw, &stageStart);
 
 		int weather_colour = RCT2_ADDRESS(0x98195C, uint32)[gClimateCurrentWeatherGloom];
 		if ((weather_colour != -1) && (!(gCurrentViewportFlags & VIEWPORT_FLAG_INVISIBLE_SPRITES)) && (!(RCT2_GLOBAL(0x9DEA6F, uint8) & 1))){
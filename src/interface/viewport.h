@@ -105,6 +105,15 @@ extern paint_struct *unk_EE7888;
 	#define unk_EE7888 RCT2_GLOBAL(0x00EE7888, paint_struct*)
 #endif
 
+typedef struct viewport_paint_timings {
+	uint64 setup;
+	uint64 sort;
+	uint64 draw;
+} viewport_paint_timings;
+
+// When set, viewport_paint adds the performance counter ticks spent in each paint stage
+extern viewport_paint_timings *gViewportPaintTimings;
+
 void viewport_init_all();
 void center_2d_coordinates(int x, int y, int z, int* out_x, int* out_y, rct_viewport* viewport);
 void viewport_create(rct_window *w, int x, int y, int width, int height, int zoom, int center_x, int center_y, int center_z, char flags, sint16 sprite);
@@ -18,6 +18,8 @@
 
 #include "network.h"
 #include "NetworkConnection.h"
+#include "../core/Exception.hpp"
+#include "../core/Math.hpp"
 #include "../core/String.hpp"
 #include <SDL.h>
 
@@ -27,9 +29,13 @@ extern "C"
 }
 
 constexpr size_t NETWORK_DISCONNECT_REASON_BUFFER_SIZE = 256;
+constexpr size_t NETWORK_MAX_SEND_BUFFERS = 64;
+constexpr uint32 NETWORK_DISCONNECT_FLUSH_TIMEOUT = 2000;   // How long queued packets may take to send before a disconnect
 
 NetworkConnection::NetworkConnection()
 {
+    SDL_AtomicSet(&_disconnected, 0);
+    SDL_AtomicSet(&_disconnectRequested, 0);
     ResetLastPacketTime();
 }
 
@@ -44,11 +50,11 @@ NetworkConnection::~NetworkConnection()
 
 int NetworkConnection::ReadPacket()
 {
-    if (InboundPacket.transferred < sizeof(InboundPacket.size))
+    if (_inboundPacket.transferred < sizeof(_inboundPacket.size))
     {
         // read packet size
-        void * buffer = &((char*)&InboundPacket.size)[InboundPacket.transferred];
-        size_t bufferLength = sizeof(InboundPacket.size) - InboundPacket.transferred;
+        void * buffer = &((char*)&_inboundPacket.size)[_inboundPacket.transferred];
+        size_t bufferLength = sizeof(_inboundPacket.size) - _inboundPacket.transferred;
         size_t readBytes;
         NETWORK_READPACKET status = Socket->ReceiveData(buffer, bufferLength, &readBytes);
         if (status != NETWORK_READPACKET_SUCCESS)
@@ -56,24 +62,24 @@ int NetworkConnection::ReadPacket()
             return status;
         }
         
-        InboundPacket.transferred += readBytes;
-        if (InboundPacket.transferred == sizeof(InboundPacket.size))
+        _inboundPacket.transferred += readBytes;
+        if (_inboundPacket.transferred == sizeof(_inboundPacket.size))
         {
-            InboundPacket.size = Convert::NetworkToHost(InboundPacket.size);
-            if (InboundPacket.size == 0) // Can't have a size 0 packet
+            _inboundPacket.size = Convert::NetworkToHost(_inboundPacket.size);
+            if (_inboundPacket.size == 0) // Can't have a size 0 packet
             {
                 return NETWORK_READPACKET_DISCONNECTED;
             }
-            InboundPacket.data->resize(InboundPacket.size);
+            _inboundPacket.data->resize(_inboundPacket.size);
         }
     }
     else
     {
         // read packet data
-        if (InboundPacket.data->capacity() > 0)
+        if (_inboundPacket.data->capacity() > 0)
         {
-            void * buffer = &InboundPacket.GetData()[InboundPacket.transferred - sizeof(InboundPacket.size)];
-            size_t bufferLength = sizeof(InboundPacket.size) + InboundPacket.size - InboundPacket.transferred;
+            void * buffer = &_inboundPacket.GetData()[_inboundPacket.transferred - sizeof(_inboundPacket.size)];
+            size_t bufferLength = sizeof(_inboundPacket.size) + _inboundPacket.size - _inboundPacket.transferred;
             size_t readBytes;
             NETWORK_READPACKET status = Socket->ReceiveData(buffer, bufferLength, &readBytes);
             if (status != NETWORK_READPACKET_SUCCESS)
@@ -81,72 +87,286 @@ int NetworkConnection::ReadPacket()
                 return status;
             }
 
-            InboundPacket.transferred += readBytes;
+            _inboundPacket.transferred += readBytes;
         }
-        if (InboundPacket.transferred == sizeof(InboundPacket.size) + InboundPacket.size)
+        if (_inboundPacket.transferred == sizeof(_inboundPacket.size) + _inboundPacket.size)
         {
-            _lastPacketTime = SDL_GetTicks();
+            SDL_AtomicSet(&_lastPacketTime, (int)SDL_GetTicks());
             return NETWORK_READPACKET_SUCCESS;
         }
     }
     return NETWORK_READPACKET_MORE_DATA;
 }
 
-bool NetworkConnection::SendPacket(NetworkPacket& packet)
+bool NetworkConnection::ReceivePacket(std::unique_ptr<NetworkPacket> * packet)
 {
-    uint16 sizen = Convert::HostToNetwork(packet.size);
-    std::vector<uint8> tosend;
-    tosend.reserve(sizeof(sizen) + packet.size);
-    tosend.insert(tosend.end(), (uint8*)&sizen, (uint8*)&sizen + sizeof(sizen));
-    tosend.insert(tosend.end(), packet.data->begin(), packet.data->end());
+    return _inboundQueue.Pop(packet);
+}
+
+void NetworkConnection::QueuePacket(std::unique_ptr<NetworkPacket> packet, bool front)
+{
+    QueuePacket(*packet, front);
+}
+
+void NetworkConnection::QueuePacket(const NetworkPacket &packet, bool front)
+{
+    if (AuthStatus == NETWORK_AUTH_OK || !packet.CommandRequiresAuth())
+    {
+        OutboundPacket outboundPacket;
+        outboundPacket.Data = packet.data;
+        outboundPacket.Size = Convert::HostToNetwork((uint16)packet.data->size());
+        outboundPacket.Front = front;
+        outboundPacket.QueueTime = SDL_GetTicks();
+        _outboundQueue.Push(outboundPacket);
+        _newRequests = true;
+    }
+}
+
+/**
+ * Shuts down the socket once the packets queued so far have been sent, or after a timeout if the
+ * other side stops receiving.
+ */
+void NetworkConnection::Disconnect()
+{
+    SDL_AtomicSet(&_disconnectRequested, 1);
+    _newRequests = true;
+}
+
+/**
+ * Checks whether packets have been queued or a disconnect requested since the last call, so the
+ * connection can be handed to the network thread.
+ */
+bool NetworkConnection::TakeNewRequests()
+{
+    bool newRequests = _newRequests;
+    _newRequests = false;
+    return newRequests;
+}
+
+bool NetworkConnection::IsDisconnected()
+{
+    return SDL_AtomicGet(&_disconnected) != 0;
+}
+
+/**
+ * Discards all packets, must not be called while the connection is serviced by the network
+ * thread.
+ */
+void NetworkConnection::ClearPackets()
+{
+    std::unique_ptr<NetworkPacket> inboundPacket;
+    while (_inboundQueue.Pop(&inboundPacket)) { }
+    OutboundPacket outboundPacket;
+    while (_outboundQueue.Pop(&outboundPacket)) { }
+
+    _inboundPacket.Clear();
+    _outboundPackets.clear();
+    _outboundTransferred = 0;
+    _shutdown = false;
+    _disconnectRequestTime = 0;
+    _stats = NetworkConnectionStats();
+    _mapSendStartTime = 0;
+    SDL_AtomicSet(&_disconnected, 0);
+    SDL_AtomicSet(&_disconnectRequested, 0);
+}
+
+/**
+ * Reads all the complete packets available and sends queued packets.
+ */
+void NetworkConnection::Service()
+{
+    if (IsDisconnected())
+    {
+        return;
+    }
+
+    try
+    {
+        int packetStatus;
+        do
+        {
+            packetStatus = ReadPacket();
+            if (packetStatus == NETWORK_READPACKET_SUCCESS)
+            {
+                uint32 command = Math::Min<uint32>(_inboundPacket.GetCommand(), NETWORK_COMMAND_MAX);
+                _stats.Commands[command].PacketsIn++;
+                _stats.Commands[command].BytesIn += sizeof(_inboundPacket.size) + _inboundPacket.size;
+
+                // Hand the packet over and start reading the next one into a new packet
+                std::unique_ptr<NetworkPacket> packet = NetworkPacket::Allocate();
+                std::swap(*packet, _inboundPacket);
+                _inboundQueue.Push(std::move(packet));
+            }
+        }
+        while (packetStatus == NETWORK_READPACKET_MORE_DATA || packetStatus == NETWORK_READPACKET_SUCCESS);
+
+        if (packetStatus == NETWORK_READPACKET_DISCONNECTED)
+        {
+            SDL_AtomicSet(&_disconnected, 1);
+            return;
+        }
+
+        // Read before draining the queue, so the packets queued before the disconnect was
+        // requested are sent first
+        bool disconnectRequested = !_shutdown && SDL_AtomicGet(&_disconnectRequested) != 0;
+
+        OutboundPacket outboundPacket;
+        while (_outboundQueue.Pop(&outboundPacket))
+        {
+            if (outboundPacket.Front)
+            {
+                // A partly sent packet has to be finished first
+                auto it = _outboundPackets.begin();
+                if (_outboundTransferred > 0)
+                {
+                    it++;
+                }
+                _outboundPackets.insert(it, outboundPacket);
+            }
+            else
+            {
+                _outboundPackets.push_back(outboundPacket);
+            }
+        }
+        SendQueuedPackets();
+        _stats.QueueDepth = (uint32)_outboundPackets.size();
+        _stats.MaxQueueDepth = Math::Max(_stats.MaxQueueDepth, _stats.QueueDepth);
 
-    const void * buffer = &tosend[packet.transferred];
-    size_t bufferSize = tosend.size() - packet.transferred;
-    size_t sent = Socket->SendData(buffer, bufferSize);
-    if (sent > 0)
+        if (disconnectRequested)
+        {
+            uint32 now = SDL_GetTicks();
+            if (_disconnectRequestTime == 0)
+            {
+                _disconnectRequestTime = now;
+            }
+            if (_outboundPackets.empty() || SDL_TICKS_PASSED(now, _disconnectRequestTime + NETWORK_DISCONNECT_FLUSH_TIMEOUT))
+            {
+                Socket->Disconnect();
+                _shutdown = true;
+            }
+        }
+    }
+    catch (const Exception &)
     {
-        packet.transferred += sent;
+        SDL_AtomicSet(&_disconnected, 1);
     }
-    if (packet.transferred == tosend.size())
+}
+
+/**
+ * Checks whether the game thread has queued packets or requested a disconnect that Service has
+ * not handled yet.
+ */
+bool NetworkConnection::HasRequests()
+{
+    if (IsDisconnected())
     {
-        return true;
+        return false;
     }
-    return false;
+    return !_outboundQueue.IsEmpty() || (!_shutdown && SDL_AtomicGet(&_disconnectRequested) != 0);
 }
 
-void NetworkConnection::QueuePacket(std::unique_ptr<NetworkPacket> packet, bool front)
+/**
+ * Checks whether packets are waiting for the socket to become writable.
+ */
+bool NetworkConnection::HasPendingSends() const
 {
-    if (AuthStatus == NETWORK_AUTH_OK || !packet->CommandRequiresAuth())
+    return !_outboundPackets.empty();
+}
+
+void NetworkConnection::SendQueuedPackets()
+{
+    while (_outboundPackets.size() > 0)
     {
-        packet->size = (uint16)packet->data->size();
-        if (front)
+        // Gather the size and data of as many packets as possible into one send
+        TcpSendBuffer buffers[NETWORK_MAX_SEND_BUFFERS];
+        size_t numBuffers = 0;
+        size_t totalSize = 0;
+        size_t skip = _outboundTransferred;
+        for (auto it = _outboundPackets.begin(); it != _outboundPackets.end() && numBuffers + 2 <= NETWORK_MAX_SEND_BUFFERS; it++)
+        {
+            const uint8 * size = (const uint8 *)&it->Size;
+            if (skip < sizeof(it->Size))
+            {
+                buffers[numBuffers++] = { size + skip, sizeof(it->Size) - skip };
+                totalSize += sizeof(it->Size) - skip;
+                skip = 0;
+            }
+            else
+            {
+                skip -= sizeof(it->Size);
+            }
+
+            size_t dataSize = it->Data->size();
+            if (skip < dataSize)
+            {
+                buffers[numBuffers++] = { it->Data->data() + skip, dataSize - skip };
+                totalSize += dataSize - skip;
+            }
+            skip = 0;
+        }
+
+        size_t sent = Socket->SendData(buffers, numBuffers);
+        _outboundTransferred += sent;
+        while (_outboundPackets.size() > 0)
         {
-            _outboundPackets.push_front(std::move(packet));
+            size_t packetSize = sizeof(uint16) + _outboundPackets.front().Data->size();
+            if (_outboundTransferred < packetSize)
+            {
+                break;
+            }
+            _outboundTransferred -= packetSize;
+            RecordSentPacket(_outboundPackets.front());
+            _outboundPackets.pop_front();
         }
-        else
+
+        if (sent < totalSize)
         {
-            _outboundPackets.push_back(std::move(packet));
+            // The socket buffer is full
+            break;
         }
     }
 }
 
-void NetworkConnection::SendQueuedPackets()
+void NetworkConnection::RecordSentPacket(const OutboundPacket &packet)
 {
-    while (_outboundPackets.size() > 0 && SendPacket(*(_outboundPackets.front()).get()))
+    const std::vector<uint8> &data = *packet.Data;
+    uint32 command = NETWORK_COMMAND_MAX;
+    if (data.size() >= sizeof(uint32))
+    {
+        command = Math::Min<uint32>(ByteSwapBE(*(uint32 *)&data[0]), NETWORK_COMMAND_MAX);
+    }
+    _stats.Commands[command].PacketsOut++;
+    _stats.Commands[command].BytesOut += sizeof(uint16) + data.size();
+
+    uint32 now = SDL_GetTicks();
+    _stats.QueueTime.Add(now - packet.QueueTime, now);
+
+    // Map chunks start with the total size and the offset of the chunk
+    if (command == NETWORK_COMMAND_MAP && data.size() >= 3 * sizeof(uint32))
     {
-        _outboundPackets.remove(_outboundPackets.front());
+        uint32 totalSize = ByteSwapBE(*(uint32 *)&data[4]);
+        uint32 offset = ByteSwapBE(*(uint32 *)&data[8]);
+        if (offset == 0)
+        {
+            _mapSendStartTime = packet.QueueTime;
+        }
+        if (offset + (data.size() - 3 * sizeof(uint32)) >= totalSize)
+        {
+            _stats.MapSendTime.Add(now - _mapSendStartTime);
+        }
     }
 }
 
 void NetworkConnection::ResetLastPacketTime()
 {
-    _lastPacketTime = SDL_GetTicks();
+    SDL_AtomicSet(&_lastPacketTime, (int)SDL_GetTicks());
 }
 
 bool NetworkConnection::ReceivedPacketRecently()
 {
 #ifndef DEBUG
-    if (SDL_TICKS_PASSED(SDL_GetTicks(), _lastPacketTime + 7000))
+    uint32 lastPacketTime = (uint32)SDL_AtomicGet(&_lastPacketTime);
+    if (SDL_TICKS_PASSED(SDL_GetTicks(), lastPacketTime + 7000))
     {
         return false;
     }
@@ -16,7 +16,7 @@
 
 #pragma once
 
-#include <list>
+#include <deque>
 #include <memory>
 #include <vector>
 
@@ -25,38 +25,85 @@
 #include "NetworkTypes.h"
 #include "NetworkKey.h"
 #include "NetworkPacket.h"
+#include "NetworkQueue.h"
+#include "NetworkStats.h"
 #include "TcpSocket.h"
 
 class NetworkPlayer;
 
+/**
+ * A connection to a client or server. The socket is read and written by the network thread,
+ * which passes complete packets to and from the game thread through queues.
+ */
 class NetworkConnection
 {
 public:
     ITcpSocket *        Socket          = nullptr;
-    NetworkPacket       InboundPacket;
     NETWORK_AUTH        AuthStatus      = NETWORK_AUTH_NONE;
     NetworkPlayer *     Player          = nullptr;
     uint32              PingTime        = 0;
+    uint32              StateHashTime   = 0;    // When the client last requested state hashes
+    uint32              StateDumpTime   = 0;    // When the client last requested state dumps
     NetworkKey          Key;
     std::vector<uint8>  Challenge;
 
     NetworkConnection();
     ~NetworkConnection();
 
-    int  ReadPacket();
+    // Game thread
+    bool ReceivePacket(std::unique_ptr<NetworkPacket> * packet);
     void QueuePacket(std::unique_ptr<NetworkPacket> packet, bool front = false);
-    void SendQueuedPackets();
+    void QueuePacket(const NetworkPacket &packet, bool front = false);
+    void Disconnect();
+    bool IsDisconnected();
+    void ClearPackets();
     void ResetLastPacketTime();
     bool ReceivedPacketRecently();
+    bool TakeNewRequests();
+
+    // Network thread
+    void Service();
+    bool HasRequests();
+    bool HasPendingSends() const;
+
+    // Only valid while the network thread is not servicing the connection
+    const NetworkConnectionStats & GetStats() const { return _stats; }
 
     const utf8 * GetLastDisconnectReason() const;
     void SetLastDisconnectReason(const utf8 * src);
     void SetLastDisconnectReason(const rct_string_id string_id, void * args = nullptr);
 
 private:
-    std::list<std::unique_ptr<NetworkPacket>>   _outboundPackets;
-    uint32                                      _lastPacketTime;
-    utf8 *                                      _lastDisconnectReason   = nullptr;
+    // A queued packet, the payload is shared with any other connections it was sent to
+    struct OutboundPacket
+    {
+        std::shared_ptr<const std::vector<uint8>>   Data;
+        uint16                                      Size    = 0;        // Network byte order
+        bool                                        Front   = false;
+        uint32                                      QueueTime   = 0;    // When the game thread queued it
+    };
+
+    // Shared between the threads
+    NetworkQueue<std::unique_ptr<NetworkPacket>>    _inboundQueue;
+    NetworkQueue<OutboundPacket>                    _outboundQueue;
+    SDL_atomic_t                                    _disconnected;
+    SDL_atomic_t                                    _disconnectRequested;
+    SDL_atomic_t                                    _lastPacketTime;
 
-    bool SendPacket(NetworkPacket &packet);
+    // Network thread
+    NetworkPacket                                   _inboundPacket;
+    std::deque<OutboundPacket>                      _outboundPackets;
+    size_t                                          _outboundTransferred    = 0;    // Bytes sent of the first packet
+    bool                                            _shutdown               = false;
+    uint32                                          _disconnectRequestTime  = 0;
+    NetworkConnectionStats                          _stats;
+    uint32                                          _mapSendStartTime       = 0;
+
+    // Game thread
+    utf8 *                                          _lastDisconnectReason   = nullptr;
+    bool                                            _newRequests            = false;
+
+    int  ReadPacket();
+    void SendQueuedPackets();
+    void RecordSentPacket(const OutboundPacket &packet);
 };
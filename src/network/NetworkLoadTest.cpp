@@ -0,0 +1,485 @@
+#pragma region Copyright (c) 2014-2016 OpenRCT2 Developers
+/*****************************************************************************
+ * OpenRCT2, an open source clone of Roller Coaster Tycoon 2.
+ *
+ * OpenRCT2 is the work of many authors, a full list can be found in contributors.md
+ * For more information, visit https://github.com/OpenRCT2/OpenRCT2
+ *
+ * OpenRCT2 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * A full copy of the GNU General Public License can be found in licence.txt
+ *****************************************************************************/
+#pragma endregion
+
+
+#ifndef DISABLE_NETWORK
+
+#include "network.h"
+#include "NetworkConnection.h"
+#include "NetworkLoadTest.h"
+#include "../core/Math.hpp"
+#include "../core/Util.hpp"
+
+extern "C"
+{
+    #include "../game.h"
+    #include "../ride/track.h"
+    #include "../world/map.h"
+}
+
+constexpr uint32 NETWORK_LOAD_TEST_WAIT_TIMEOUT = 5;
+constexpr size_t NETWORK_LOAD_TEST_MAX_EVENTS   = 64;
+
+enum NETWORK_LOAD_TEST_CLIENT_STATE
+{
+    NETWORK_LOAD_TEST_CLIENT_STATE_CONNECTING,
+    NETWORK_LOAD_TEST_CLIENT_STATE_JOINING,
+    NETWORK_LOAD_TEST_CLIENT_STATE_JOINED,
+    NETWORK_LOAD_TEST_CLIENT_STATE_CLOSED,
+};
+
+class NetworkLoadTestClient
+{
+public:
+    NetworkLoadTestClientStats Stats;
+
+    NetworkLoadTestClient(const NetworkLoadTestOptions &options, NetworkKey &key, ITcpSocketPoller * poller, sint32 index)
+        : _options(options), _key(key), _poller(poller)
+    {
+        Stats.Name = "loadtest" + std::to_string(index + 1);
+        _random = 0x9E3779B9 * (uint32)(index + 1);
+        _connectTime = SDL_GetTicks();
+
+        // Spread the actions of the clients over the interval instead of sending them all at once
+        _actionInterval = _options.ActionsPerSecond > 0 ? 1000.0 / _options.ActionsPerSecond : 0;
+        _nextActionTime = _connectTime + _actionInterval * (index % 16) / 16.0;
+
+        _connection.Socket = CreateTcpSocket();
+        _connection.Socket->ConnectAsync("127.0.0.1", _options.Port);
+    }
+
+    ~NetworkLoadTestClient()
+    {
+        Close(nullptr);
+    }
+
+    void Service()
+    {
+        _connection.Service();
+    }
+
+    void Update(uint32 now)
+    {
+        switch (_state)
+        {
+        case NETWORK_LOAD_TEST_CLIENT_STATE_CONNECTING:
+            switch (_connection.Socket->GetStatus())
+            {
+            case SOCKET_STATUS_CONNECTED:
+                _poller->Add(_connection.Socket, this);
+                _state = NETWORK_LOAD_TEST_CLIENT_STATE_JOINING;
+                SendToken();
+                break;
+            case SOCKET_STATUS_CLOSED:
+                Close(_connection.Socket->GetError());
+                break;
+            default:
+                break;
+            }
+            return;
+        case NETWORK_LOAD_TEST_CLIENT_STATE_CLOSED:
+            return;
+        default:
+            break;
+        }
+
+        std::unique_ptr<NetworkPacket> packet;
+        while (_connection.ReceivePacket(&packet))
+        {
+            Stats.BytesReceived += sizeof(packet->size) + packet->size;
+            ProcessPacket(*packet, now);
+        }
+        if (_connection.IsDisconnected())
+        {
+            Close(Stats.Error.empty() ? "Connection closed by the server." : nullptr);
+            return;
+        }
+
+        if (_state == NETWORK_LOAD_TEST_CLIENT_STATE_JOINED && _actionInterval > 0 && now >= _nextActionTime)
+        {
+            _nextActionTime += _actionInterval;
+            PerformAction(now);
+        }
+
+        if (_connection.HasRequests())
+        {
+            _connection.Service();
+        }
+        _poller->SetWriteInterest(_connection.Socket, _connection.HasPendingSends());
+    }
+
+private:
+    const NetworkLoadTestOptions &  _options;
+    NetworkKey &                    _key;
+    ITcpSocketPoller *              _poller;
+    NetworkConnection               _connection;
+    NETWORK_LOAD_TEST_CLIENT_STATE  _state              = NETWORK_LOAD_TEST_CLIENT_STATE_CONNECTING;
+    uint32                          _random             = 0;
+    uint32                          _connectTime        = 0;
+    uint32                          _mapStartTime       = 0;
+    double                          _actionInterval     = 0;
+    double                          _nextActionTime     = 0;
+    uint8                           _playerId           = 0;
+    uint32                          _serverTick         = 0;
+    uint8                           _nextTag            = 0;
+    uint32                          _pendingCommands[256] = { 0 };  // Send time by tag, 0 if none
+
+    uint32 Random(uint32 range)
+    {
+        // xorshift, the game's random number generator must not be touched from this thread
+        _random ^= _random << 13;
+        _random ^= _random >> 17;
+        _random ^= _random << 5;
+        return range == 0 ? 0 : _random % range;
+    }
+
+    void Close(const char * error)
+    {
+        if (_state != NETWORK_LOAD_TEST_CLIENT_STATE_CONNECTING && _state != NETWORK_LOAD_TEST_CLIENT_STATE_CLOSED)
+        {
+            _poller->Remove(_connection.Socket);
+        }
+        if (_state != NETWORK_LOAD_TEST_CLIENT_STATE_CLOSED)
+        {
+            _connection.Socket->Disconnect();
+            _state = NETWORK_LOAD_TEST_CLIENT_STATE_CLOSED;
+        }
+        if (error != nullptr && Stats.Error.empty())
+        {
+            Stats.Error = error;
+        }
+    }
+
+    void Send(std::unique_ptr<NetworkPacket> packet)
+    {
+        Stats.BytesSent += sizeof(packet->size) + packet->data->size();
+        _connection.QueuePacket(std::move(packet));
+    }
+
+    void SendToken()
+    {
+        std::unique_ptr<NetworkPacket> packet = NetworkPacket::Allocate();
+        *packet << (uint32)NETWORK_COMMAND_TOKEN;
+        Send(std::move(packet));
+    }
+
+    void SendGameCommand(uint32 eax, uint32 ebx, uint32 ecx, uint32 edx, uint32 esi, uint32 edi, uint32 ebp, uint32 now)
+    {
+        // The callback comes back unchanged with the command, it tags the command to time it
+        _nextTag = _nextTag == 255 ? 1 : _nextTag + 1;
+        _pendingCommands[_nextTag] = Math::Max(1u, now);
+
+        std::unique_ptr<NetworkPacket> packet = NetworkPacket::Allocate();
+        *packet << (uint32)NETWORK_COMMAND_GAMECMD << _serverTick << eax << (ebx | GAME_COMMAND_FLAG_NETWORKED)
+                << ecx << edx << esi << edi << ebp << _nextTag;
+        Send(std::move(packet));
+        Stats.CommandsSent++;
+    }
+
+    void PerformAction(uint32 now)
+    {
+        sint32 total = 0;
+        for (sint32 weight : _options.Mix)
+        {
+            total += weight;
+        }
+        sint32 pick = (sint32)Random(total);
+        sint32 action = 0;
+        while (action < NETWORK_LOAD_TEST_ACTION_COUNT - 1 && pick >= _options.Mix[action])
+        {
+            pick -= _options.Mix[action];
+            action++;
+        }
+        // Fall back to the land when the park has nothing to use for the action
+        if ((action == NETWORK_LOAD_TEST_ACTION_SCENERY && _options.SmallScenery.empty()) ||
+            (action == NETWORK_LOAD_TEST_ACTION_TRACK && _options.TrackRides.empty()) ||
+            (action == NETWORK_LOAD_TEST_ACTION_RIDE && _options.Rides.empty()))
+        {
+            action = NETWORK_LOAD_TEST_ACTION_LAND;
+        }
+
+        sint32 x = (1 + Random(_options.MapSize - 2)) * 32;
+        sint32 y = (1 + Random(_options.MapSize - 2)) * 32;
+        switch (action)
+        {
+        case NETWORK_LOAD_TEST_ACTION_LAND:
+        {
+            uint32 kind = Random(3);
+            if (kind < 2)
+            {
+                uint32 command = kind == 0 ? GAME_COMMAND_RAISE_LAND : GAME_COMMAND_LOWER_LAND;
+                SendGameCommand(x + 16, GAME_COMMAND_FLAG_APPLY, y + 16, x | (x << 16), command, MAP_SELECT_TYPE_FULL, y | (y << 16), now);
+            }
+            else
+            {
+                // Only the surface, 0xFF leaves the edges as they are
+                uint32 surface = Random(TERRAIN_SAND_LIGHT + 1);
+                SendGameCommand(x, GAME_COMMAND_FLAG_APPLY, y, surface | (0xFF << 8), GAME_COMMAND_CHANGE_SURFACE_STYLE, x, y, now);
+            }
+            break;
+        }
+        case NETWORK_LOAD_TEST_ACTION_SCENERY:
+        {
+            // A height of 0 places the scenery on the ground, full tile scenery ignores the quadrant
+            uint8 entryIndex = _options.SmallScenery[Random((uint32)_options.SmallScenery.size())];
+            uint32 quadrant = Random(4);
+            uint32 rotation = Random(4);
+            uint32 colour = Random(32);
+            SendGameCommand(x, GAME_COMMAND_FLAG_APPLY | (entryIndex << 8), y, quadrant | (colour << 8),
+                            GAME_COMMAND_PLACE_SCENERY, rotation | (colour << 16), 0, now);
+            break;
+        }
+        case NETWORK_LOAD_TEST_ACTION_TRACK:
+        {
+            // The clients do not have the map, so the height is a guess and some pieces are refused
+            // for being underground or too high, which still goes through the clearance checks
+            uint8 rideIndex = _options.TrackRides[Random((uint32)_options.TrackRides.size())];
+            uint32 direction = Random(4);
+            uint32 z = (4 + Random(8)) * 16;
+            SendGameCommand(x, GAME_COMMAND_FLAG_APPLY | (direction << 8), y, rideIndex | (TRACK_ELEM_FLAT << 8),
+                            GAME_COMMAND_PLACE_TRACK, z, 0, now);
+            break;
+        }
+        case NETWORK_LOAD_TEST_ACTION_RIDE:
+        {
+            uint8 rideIndex = _options.Rides[Random((uint32)_options.Rides.size())];
+            SendGameCommand(0, GAME_COMMAND_FLAG_APPLY, 0, rideIndex, GAME_COMMAND_SET_RIDE_PRICE, Random(200), 0, now);
+            break;
+        }
+        case NETWORK_LOAD_TEST_ACTION_CHAT:
+        {
+            std::string text = "Load test message " + std::to_string(Stats.Actions + 1);
+            std::unique_ptr<NetworkPacket> packet = NetworkPacket::Allocate();
+            *packet << (uint32)NETWORK_COMMAND_CHAT;
+            packet->WriteString(text.c_str());
+            Send(std::move(packet));
+            break;
+        }
+        }
+        Stats.Actions++;
+    }
+
+    void ProcessPacket(NetworkPacket &packet, uint32 now)
+    {
+        uint32 command;
+        packet >> command;
+        switch (command)
+        {
+        case NETWORK_COMMAND_TOKEN:
+            HandleToken(packet);
+            break;
+        case NETWORK_COMMAND_AUTH:
+        {
+            uint32 status;
+            packet >> status >> _playerId;
+            if (status != NETWORK_AUTH_OK)
+            {
+                Close(("Authentication failed with status " + std::to_string(status) + ".").c_str());
+            }
+            break;
+        }
+        case NETWORK_COMMAND_MAP:
+        {
+            uint32 size, offset;
+            packet >> size >> offset;
+            uint32 chunkSize = packet.size - packet.read;
+            if (offset == 0)
+            {
+                _mapStartTime = now;
+            }
+            if (offset + chunkSize >= size && _state == NETWORK_LOAD_TEST_CLIENT_STATE_JOINING)
+            {
+                _state = NETWORK_LOAD_TEST_CLIENT_STATE_JOINED;
+                Stats.Joined = true;
+                Stats.JoinTime = now - _connectTime;
+                Stats.MapTime = now - _mapStartTime;
+                Stats.MapSize = size;
+                _nextActionTime = Math::Max(_nextActionTime, (double)now);
+            }
+            break;
+        }
+        case NETWORK_COMMAND_GAMECMDS:
+            HandleGameCommands(packet, now);
+            break;
+        case NETWORK_COMMAND_TICK:
+            packet >> _serverTick;
+            break;
+        case NETWORK_COMMAND_PING:
+        {
+            std::unique_ptr<NetworkPacket> ping = NetworkPacket::Allocate();
+            *ping << (uint32)NETWORK_COMMAND_PING;
+            Send(std::move(ping));
+            break;
+        }
+        case NETWORK_COMMAND_PINGLIST:
+        {
+            uint8 count;
+            packet >> count;
+            for (uint8 i = 0; i < count; i++)
+            {
+                uint8 id;
+                uint16 ping;
+                packet >> id >> ping;
+                if (id == _playerId)
+                {
+                    Stats.Ping = ping;
+                }
+            }
+            break;
+        }
+        case NETWORK_COMMAND_SHOWERROR:
+            // Sent instead of the command when the player is not allowed to run it
+            Stats.CommandsRejected++;
+            break;
+        case NETWORK_COMMAND_SETDISCONNECTMSG:
+        {
+            const utf8 * message = packet.ReadString();
+            if (message != nullptr)
+            {
+                Stats.Error = message;
+            }
+            break;
+        }
+        }
+    }
+
+    void HandleToken(NetworkPacket &packet)
+    {
+        uint32 challengeSize;
+        packet >> challengeSize;
+        const uint8 * challenge = packet.Read(challengeSize);
+        char * signature;
+        size_t signatureSize;
+        if (challenge == nullptr || !_key.Sign(challenge, challengeSize, &signature, &signatureSize))
+        {
+            Close("Unable to sign the challenge of the server.");
+            return;
+        }
+
+        std::unique_ptr<NetworkPacket> auth = NetworkPacket::Allocate();
+        *auth << (uint32)NETWORK_COMMAND_AUTH;
+        auth->WriteString(NETWORK_STREAM_ID);
+        auth->WriteString(Stats.Name.c_str());
+        auth->WriteString("");
+        auth->WriteString(_key.PublicKeyString().c_str());
+        *auth << (uint32)signatureSize;
+        auth->Write((const uint8 *)signature, (uint32)signatureSize);
+        delete [] signature;
+        Send(std::move(auth));
+    }
+
+    void HandleGameCommands(NetworkPacket &packet, uint32 now)
+    {
+        uint32 tick;
+        packet >> tick;
+        while (packet.read < packet.size)
+        {
+            uint8 playerId, callback, mask;
+            packet.ReadVarInt();
+            packet >> playerId >> callback >> mask;
+            for (int j = 0; j < 7; j++)
+            {
+                if (mask & (1 << j))
+                {
+                    packet.ReadVarInt();
+                }
+            }
+            if (playerId == _playerId && callback != 0 && _pendingCommands[callback] != 0)
+            {
+                Stats.Latencies.push_back(now - _pendingCommands[callback]);
+                _pendingCommands[callback] = 0;
+            }
+        }
+    }
+};
+
+NetworkLoadTest::NetworkLoadTest(const NetworkLoadTestOptions &options)
+    : _options(options)
+{
+    SDL_AtomicSet(&_stop, 0);
+}
+
+NetworkLoadTest::~NetworkLoadTest()
+{
+    Stop();
+    _clients.clear();
+    delete _poller;
+}
+
+bool NetworkLoadTest::Start()
+{
+    // All clients share one key, the server only uses it to look up the group of the player
+    if (!_key.Generate())
+    {
+        return false;
+    }
+
+    _poller = CreateTcpSocketPoller();
+    for (sint32 i = 0; i < _options.NumClients; i++)
+    {
+        _clients.emplace_back(new NetworkLoadTestClient(_options, _key, _poller, i));
+    }
+    _thread = SDL_CreateThread(Run, "network_load_test", this);
+    return _thread != nullptr;
+}
+
+/**
+ * Stops the clients from sending, the clients and their statistics are kept until the load test
+ * is destroyed.
+ */
+void NetworkLoadTest::Stop()
+{
+    if (_thread != nullptr)
+    {
+        SDL_AtomicSet(&_stop, 1);
+        _poller->Wake();
+        SDL_WaitThread(_thread, nullptr);
+        _thread = nullptr;
+    }
+}
+
+std::vector<NetworkLoadTestClientStats> NetworkLoadTest::GetStats() const
+{
+    std::vector<NetworkLoadTestClientStats> stats;
+    for (const auto &client : _clients)
+    {
+        stats.push_back(client->Stats);
+    }
+    return stats;
+}
+
+int NetworkLoadTest::Run(void * arg)
+{
+    NetworkLoadTest * loadTest = (NetworkLoadTest *)arg;
+    void * readyTags[NETWORK_LOAD_TEST_MAX_EVENTS];
+    while (SDL_AtomicGet(&loadTest->_stop) == 0)
+    {
+        size_t numReady = loadTest->_poller->Wait(readyTags, Util::CountOf(readyTags), NETWORK_LOAD_TEST_WAIT_TIMEOUT);
+        for (size_t i = 0; i < numReady; i++)
+        {
+            ((NetworkLoadTestClient *)readyTags[i])->Service();
+        }
+
+        uint32 now = SDL_GetTicks();
+        for (auto &client : loadTest->_clients)
+        {
+            client->Update(now);
+        }
+    }
+    return 0;
+}
+
+#endif
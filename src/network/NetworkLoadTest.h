@@ -0,0 +1,94 @@
+#pragma region Copyright (c) 2014-2016 OpenRCT2 Developers
+/*****************************************************************************
+ * OpenRCT2, an open source clone of Roller Coaster Tycoon 2.
+ *
+ * OpenRCT2 is the work of many authors, a full list can be found in contributors.md
+ * For more information, visit https://github.com/OpenRCT2/OpenRCT2
+ *
+ * OpenRCT2 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * A full copy of the GNU General Public License can be found in licence.txt
+ *****************************************************************************/
+#pragma endregion
+
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <SDL.h>
+#include "../common.h"
+#include "NetworkKey.h"
+#include "TcpSocket.h"
+
+enum NETWORK_LOAD_TEST_ACTION
+{
+    NETWORK_LOAD_TEST_ACTION_LAND,      // Raise, lower or paint the land
+    NETWORK_LOAD_TEST_ACTION_SCENERY,   // Place small scenery
+    NETWORK_LOAD_TEST_ACTION_TRACK,     // Place a piece of track for a ride
+    NETWORK_LOAD_TEST_ACTION_RIDE,      // Change the price of a ride
+    NETWORK_LOAD_TEST_ACTION_CHAT,
+    NETWORK_LOAD_TEST_ACTION_COUNT
+};
+
+struct NetworkLoadTestOptions
+{
+    uint16              Port                = 0;
+    sint32              NumClients          = 0;
+    float               ActionsPerSecond    = 1;                                // Per client
+    sint32              Mix[NETWORK_LOAD_TEST_ACTION_COUNT] = { 3, 3, 2, 1, 1 };    // Relative weights
+    sint32              MapSize             = 0;
+    std::vector<uint8>  Rides;                                                      // Rides that can be priced
+    std::vector<uint8>  TrackRides;                                                 // Rides that flat track can be added to
+    std::vector<uint8>  SmallScenery;                                               // Loaded small scenery entries
+};
+
+struct NetworkLoadTestClientStats
+{
+    std::string         Name;
+    std::string         Error;
+    bool                Joined              = false;
+    uint32              JoinTime            = 0;    // Milliseconds from connecting until the map was received
+    uint32              MapTime             = 0;    // Milliseconds from the first to the last part of the map
+    uint32              MapSize             = 0;
+    uint32              Ping                = 0;    // Last round trip measured by the server
+    uint32              Actions             = 0;
+    uint32              CommandsSent        = 0;
+    uint32              CommandsRejected    = 0;
+    std::vector<uint32> Latencies;                  // Milliseconds until a command came back from the server
+    uint64              BytesReceived       = 0;
+    uint64              BytesSent           = 0;
+};
+
+class NetworkLoadTestClient;
+
+/**
+ * Synthetic clients that join a server on the loopback interface with the real protocol and
+ * issue a mix of game commands and chat messages. The clients do not load the map or run the
+ * game, so many of them can be served from a single thread next to the server.
+ */
+class NetworkLoadTest
+{
+public:
+    explicit NetworkLoadTest(const NetworkLoadTestOptions &options);
+    ~NetworkLoadTest();
+
+    bool Start();
+    void Stop();
+
+    std::vector<NetworkLoadTestClientStats> GetStats() const;
+
+private:
+    NetworkLoadTestOptions                              _options;
+    NetworkKey                                          _key;
+    std::vector<std::unique_ptr<NetworkLoadTestClient>> _clients;
+    ITcpSocketPoller *                                  _poller = nullptr;
+    SDL_Thread *                                        _thread = nullptr;
+    SDL_atomic_t                                        _stop;
+
+    static int Run(void * arg);
+};
@@ -32,17 +32,12 @@ std::unique_ptr<NetworkPacket> NetworkPacket::Allocate()
     return std::unique_ptr<NetworkPacket>(new NetworkPacket); // change to make_unique in c++14
 }
 
-std::unique_ptr<NetworkPacket> NetworkPacket::Duplicate(NetworkPacket &packet)
-{
-    return std::unique_ptr<NetworkPacket>(new NetworkPacket(packet)); // change to make_unique in c++14
-}
-
 uint8 * NetworkPacket::GetData()
 {
     return &(*data)[0];
 }
 
-uint32 NetworkPacket::GetCommand()
+uint32 NetworkPacket::GetCommand() const
 {
     if (data->size() >= sizeof(uint32))
     {
@@ -61,7 +56,7 @@ void NetworkPacket::Clear()
     data->clear();
 }
 
-bool NetworkPacket::CommandRequiresAuth()
+bool NetworkPacket::CommandRequiresAuth() const
 {
     switch (GetCommand()) {
     case NETWORK_COMMAND_PING:
@@ -115,4 +110,29 @@ const utf8 * NetworkPacket::ReadString()
     return str;
 }
 
+uint32 NetworkPacket::ReadVarInt()
+{
+    uint32 value = 0;
+    for (int shift = 0; shift < 35 && read < size; shift += 7)
+    {
+        uint8 byte = GetData()[read++];
+        value |= (uint32)(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+        {
+            break;
+        }
+    }
+    return value;
+}
+
+void NetworkPacket::WriteVarInt(uint32 value)
+{
+    while (value >= 0x80)
+    {
+        data->push_back((uint8)(value | 0x80));
+        value >>= 7;
+    }
+    data->push_back((uint8)value);
+}
+
 #endif
@@ -30,15 +30,14 @@ public:
     sint32                              read;
 
     static std::unique_ptr<NetworkPacket> Allocate();
-    static std::unique_ptr<NetworkPacket> Duplicate(NetworkPacket& packet);
 
     NetworkPacket();
 
     uint8 * GetData();
-    uint32  GetCommand();
+    uint32  GetCommand() const;
 
     void Clear();
-    bool CommandRequiresAuth();
+    bool CommandRequiresAuth() const;
 
     const uint8 * Read(uint32 size);
     const utf8 *  ReadString();
@@ -46,6 +45,12 @@ public:
     void Write(const uint8 * bytes, uint32 size);
     void WriteString(const utf8 * string);
 
+    /**
+     * Variable length integers, 7 bits per byte with the high bit set on all but the last byte.
+     */
+    uint32 ReadVarInt();
+    void   WriteVarInt(uint32 value);
+
     template <typename T>
     NetworkPacket & operator >>(T &value)
     {
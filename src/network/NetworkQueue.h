@@ -0,0 +1,87 @@
+#pragma region Copyright (c) 2014-2016 OpenRCT2 Developers
+/*****************************************************************************
+ * OpenRCT2, an open source clone of Roller Coaster Tycoon 2.
+ *
+ * OpenRCT2 is the work of many authors, a full list can be found in contributors.md
+ * For more information, visit https://github.com/OpenRCT2/OpenRCT2
+ *
+ * OpenRCT2 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * A full copy of the GNU General Public License can be found in licence.txt
+ *****************************************************************************/
+#pragma endregion
+
+#pragma once
+
+#include <utility>
+#include <SDL.h>
+
+/**
+ * An unbounded queue for passing items from one thread to another without locking. Only one
+ * thread may push and only one other thread may pop.
+ */
+template <typename T>
+class NetworkQueue
+{
+public:
+    NetworkQueue()
+    {
+        _head = new Node();
+        _tail = _head;
+    }
+
+    ~NetworkQueue()
+    {
+        while (_head != nullptr)
+        {
+            Node * next = (Node *)_head->Next;
+            delete _head;
+            _head = next;
+        }
+    }
+
+    void Push(T value)
+    {
+        Node * node = new Node();
+        node->Value = std::move(value);
+        SDL_AtomicSetPtr(&_tail->Next, node);
+        _tail = node;
+    }
+
+    bool Pop(T * value)
+    {
+        Node * next = (Node *)SDL_AtomicGetPtr(&_head->Next);
+        if (next == nullptr)
+        {
+            return false;
+        }
+
+        // The popped node becomes the new dummy head
+        *value = std::move(next->Value);
+        next->Value = T();
+        delete _head;
+        _head = next;
+        return true;
+    }
+
+    /**
+     * Checks whether there is anything to pop, only valid on the popping thread.
+     */
+    bool IsEmpty()
+    {
+        return SDL_AtomicGetPtr(&_head->Next) == nullptr;
+    }
+
+private:
+    struct Node
+    {
+        T       Value;
+        void *  Next = nullptr;
+    };
+
+    Node * _head;   // Only used by the popping thread
+    Node * _tail;   // Only used by the pushing thread
+};
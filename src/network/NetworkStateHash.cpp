@@ -0,0 +1,440 @@
+#pragma region Copyright (c) 2014-2016 OpenRCT2 Developers
+/*****************************************************************************
+ * OpenRCT2, an open source clone of Roller Coaster Tycoon 2.
+ *
+ * OpenRCT2 is the work of many authors, a full list can be found in contributors.md
+ * For more information, visit https://github.com/OpenRCT2/OpenRCT2
+ *
+ * OpenRCT2 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * A full copy of the GNU General Public License can be found in licence.txt
+ *****************************************************************************/
+#pragma endregion
+
+#include <cstdarg>
+#include <SDL.h>
+#include "../core/Path.hpp"
+#include "../core/String.hpp"
+#include "NetworkStateHash.h"
+
+extern "C"
+{
+    #include "../game.h"
+    #include "../management/finance.h"
+    #include "../platform/platform.h"
+    #include "../ride/ride.h"
+    #include "../scenario.h"
+    #include "../world/map.h"
+    #include "../world/park.h"
+    #include "../world/sprite.h"
+}
+
+static_assert(NETWORK_STATE_NUM_SPRITE_LISTS == NUM_SPRITE_LISTS, "Sprite list count changed");
+
+static const char * const SpriteListNames[] = { "null", "vehicle", "peep", "misc", "litter", "unknown" };
+
+constexpr uint64 HASH_OFFSET_BASIS  = 0xCBF29CE484222325ULL;
+constexpr uint64 HASH_PRIME         = 0x100000001B3ULL;
+
+/**
+ * FNV-1a over 64-bit words rather than bytes, so the whole park can be hashed every tick.
+ */
+static uint64 HashData(uint64 hash, const void * data, size_t length)
+{
+    const uint8 * bytes = (const uint8 *)data;
+    while (length >= sizeof(uint64))
+    {
+        uint64 word;
+        memcpy(&word, bytes, sizeof(word));
+        hash = (hash ^ word) * HASH_PRIME;
+        bytes += sizeof(uint64);
+        length -= sizeof(uint64);
+    }
+    while (length > 0)
+    {
+        hash = (hash ^ *bytes) * HASH_PRIME;
+        bytes++;
+        length--;
+    }
+    return hash;
+}
+
+template <typename T>
+static uint64 HashValue(uint64 hash, const T &value)
+{
+    return HashData(hash, &value, sizeof(T));
+}
+
+// Cleared by the ride window, which is only open on some peers
+static rct_ride GetRideState(const rct_ride * ride)
+{
+    rct_ride rideState = *ride;
+    rideState.window_invalidate_flags = 0;
+    return rideState;
+}
+
+// The screen bounds depend on the view rotation of the peer and the window flags are cleared by
+// its windows, neither is part of the simulation
+static rct_sprite GetSpriteState(const rct_sprite * sprite)
+{
+    rct_sprite spriteState = *sprite;
+    spriteState.unknown.sprite_left = 0;
+    spriteState.unknown.sprite_top = 0;
+    spriteState.unknown.sprite_right = 0;
+    spriteState.unknown.sprite_bottom = 0;
+    if (spriteState.unknown.sprite_identifier == SPRITE_IDENTIFIER_PEEP)
+    {
+        spriteState.peep.window_invalidate_flags = 0;
+    }
+    return spriteState;
+}
+
+// Ghosts only exist on the peer placing them
+static bool IsMapElementState(const rct_map_element * mapElement)
+{
+    return !(mapElement->flags & MAP_ELEMENT_FLAG_GHOST);
+}
+
+static uint64 HashRng()
+{
+    uint64 hash = HASH_OFFSET_BASIS;
+    hash = HashValue(hash, gScenarioSrand0);
+    hash = HashValue(hash, gScenarioSrand1);
+    return hash;
+}
+
+static uint64 HashFinances()
+{
+    uint64 hash = HASH_OFFSET_BASIS;
+    hash = HashValue(hash, gCashEncrypted);
+    hash = HashValue(hash, gBankLoan);
+    hash = HashValue(hash, gBankLoanInterestRate);
+    hash = HashValue(hash, gMaxBankLoan);
+    hash = HashValue(hash, gCurrentExpenditure);
+    hash = HashValue(hash, gCurrentProfit);
+    hash = HashValue(hash, gParkValue);
+    hash = HashValue(hash, gCompanyValue);
+    hash = HashValue(hash, gParkEntranceFee);
+    hash = HashValue(hash, gParkRating);
+    hash = HashData(hash, gExpenditureTable, EXPENDITURE_TABLE_TOTAL_COUNT * sizeof(money32));
+    return hash;
+}
+
+static uint64 HashRides()
+{
+    uint64 hash = HASH_OFFSET_BASIS;
+    for (int i = 0; i < MAX_RIDES; i++)
+    {
+        rct_ride * ride = get_ride(i);
+        if (ride->type != RIDE_TYPE_NULL)
+        {
+            rct_ride rideState = GetRideState(ride);
+            hash = HashValue(hash, i);
+            hash = HashData(hash, &rideState, sizeof(rct_ride));
+        }
+    }
+    return hash;
+}
+
+static uint64 HashSpriteList(int list)
+{
+    uint64 hash = HASH_OFFSET_BASIS;
+    for (uint16 spriteIndex = gSpriteListHead[list]; spriteIndex != SPRITE_INDEX_NULL; )
+    {
+        rct_sprite * sprite = get_sprite(spriteIndex);
+        rct_sprite spriteState = GetSpriteState(sprite);
+        hash = HashData(hash, &spriteState, sizeof(rct_sprite));
+        spriteIndex = sprite->unknown.next;
+    }
+    return hash;
+}
+
+static uint64 HashMapRegion(int region)
+{
+    int left = (region % NETWORK_STATE_MAP_REGIONS_PER_ROW) * NETWORK_STATE_MAP_REGION_SIZE;
+    int top = (region / NETWORK_STATE_MAP_REGIONS_PER_ROW) * NETWORK_STATE_MAP_REGION_SIZE;
+
+    uint64 hash = HASH_OFFSET_BASIS;
+    for (int y = top; y < top + NETWORK_STATE_MAP_REGION_SIZE; y++)
+    {
+        for (int x = left; x < left + NETWORK_STATE_MAP_REGION_SIZE; x++)
+        {
+            rct_map_element * mapElement = map_get_first_element_at(x, y);
+            do
+            {
+                if (IsMapElementState(mapElement))
+                {
+                    hash = HashData(hash, mapElement, sizeof(rct_map_element));
+                }
+            }
+            while (!map_element_is_last_for_tile(mapElement++));
+        }
+    }
+    return hash;
+}
+
+void NetworkStateCompute(NetworkStateHashes * hashes)
+{
+    hashes->Tick = gCurrentTicks;
+    hashes->Hashes[NETWORK_STATE_COMPONENT_RNG] = HashRng();
+    hashes->Hashes[NETWORK_STATE_COMPONENT_FINANCES] = HashFinances();
+    hashes->Hashes[NETWORK_STATE_COMPONENT_RIDES] = HashRides();
+    for (int i = 0; i < NETWORK_STATE_NUM_SPRITE_LISTS; i++)
+    {
+        hashes->Hashes[NETWORK_STATE_COMPONENT_SPRITES + i] = HashSpriteList(i);
+    }
+    for (int i = NETWORK_STATE_COMPONENT_MAP; i < NETWORK_STATE_COMPONENT_COUNT; i++)
+    {
+        hashes->Hashes[i] = HashMapRegion(i - NETWORK_STATE_COMPONENT_MAP);
+    }
+}
+
+void NetworkStateHistory::Record(uint32 tick)
+{
+    // Recording the same tick again replaces it
+    if (_count > 0 && GetNewestTick() == tick)
+    {
+        _next = (_next + Capacity - 1) % Capacity;
+        _count--;
+    }
+
+    NetworkStateCompute(&_entries[_next]);
+    _entries[_next].Tick = tick;
+    _next = (_next + 1) % Capacity;
+    if (_count < Capacity)
+    {
+        _count++;
+    }
+}
+
+void NetworkStateHistory::Clear()
+{
+    _count = 0;
+    _next = 0;
+}
+
+const NetworkStateHashes * NetworkStateHistory::Get(uint32 tick) const
+{
+    for (size_t i = 0; i < _count; i++)
+    {
+        const NetworkStateHashes * entry = &_entries[(_next + Capacity - 1 - i) % Capacity];
+        if (entry->Tick == tick)
+        {
+            return entry;
+        }
+    }
+    return nullptr;
+}
+
+const NetworkStateHashes * NetworkStateHistory::GetEntry(size_t index) const
+{
+    if (index >= _count)
+    {
+        return nullptr;
+    }
+    return &_entries[(_next + Capacity - _count + index) % Capacity];
+}
+
+uint32 NetworkStateHistory::GetOldestTick() const
+{
+    return _entries[(_next + Capacity - _count) % Capacity].Tick;
+}
+
+uint32 NetworkStateHistory::GetNewestTick() const
+{
+    return _entries[(_next + Capacity - 1) % Capacity].Tick;
+}
+
+std::string NetworkStateGetComponentName(uint32 component)
+{
+    if (component == NETWORK_STATE_COMPONENT_RNG)
+    {
+        return "rng";
+    }
+    else if (component == NETWORK_STATE_COMPONENT_FINANCES)
+    {
+        return "finances";
+    }
+    else if (component == NETWORK_STATE_COMPONENT_RIDES)
+    {
+        return "rides";
+    }
+    else if (component < NETWORK_STATE_COMPONENT_MAP)
+    {
+        return std::string("sprites-") + SpriteListNames[component - NETWORK_STATE_COMPONENT_SPRITES];
+    }
+    else if (component < NETWORK_STATE_COMPONENT_COUNT)
+    {
+        int region = component - NETWORK_STATE_COMPONENT_MAP;
+        int left = (region % NETWORK_STATE_MAP_REGIONS_PER_ROW) * NETWORK_STATE_MAP_REGION_SIZE;
+        int top = (region / NETWORK_STATE_MAP_REGIONS_PER_ROW) * NETWORK_STATE_MAP_REGION_SIZE;
+        return "map-" + std::to_string(left) + "-" + std::to_string(top);
+    }
+    return "unknown";
+}
+
+static void AppendHex(std::string &text, const void * data, size_t length)
+{
+    static const char HexDigits[] = "0123456789abcdef";
+    const uint8 * bytes = (const uint8 *)data;
+    for (size_t i = 0; i < length; i++)
+    {
+        text.push_back(HexDigits[bytes[i] >> 4]);
+        text.push_back(HexDigits[bytes[i] & 0x0F]);
+    }
+}
+
+static void AppendLine(std::string &text, const char * format, ...)
+{
+    char buffer[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    text.append(buffer);
+    text.push_back('\n');
+}
+
+static void DumpFinances(std::string &text)
+{
+    AppendLine(text, "cash_encrypted: %d", gCashEncrypted);
+    AppendLine(text, "cash: %d", finance_get_current_cash());
+    AppendLine(text, "loan: %d", gBankLoan);
+    AppendLine(text, "interest_rate: %d", gBankLoanInterestRate);
+    AppendLine(text, "max_loan: %d", gMaxBankLoan);
+    AppendLine(text, "current_expenditure: %d", gCurrentExpenditure);
+    AppendLine(text, "current_profit: %d", gCurrentProfit);
+    AppendLine(text, "park_value: %d", gParkValue);
+    AppendLine(text, "company_value: %d", gCompanyValue);
+    AppendLine(text, "park_entrance_fee: %d", gParkEntranceFee);
+    AppendLine(text, "park_rating: %d", gParkRating);
+    for (int month = 0; month < EXPENDITURE_TABLE_MONTH_COUNT; month++)
+    {
+        text.append("expenditure[" + std::to_string(month) + "]:");
+        for (int type = 0; type < RCT_EXPENDITURE_TYPE_COUNT; type++)
+        {
+            text.append(" " + std::to_string(gExpenditureTable[month * RCT_EXPENDITURE_TYPE_COUNT + type]));
+        }
+        text.push_back('\n');
+    }
+}
+
+static void DumpRides(std::string &text)
+{
+    for (int i = 0; i < MAX_RIDES; i++)
+    {
+        rct_ride * ride = get_ride(i);
+        if (ride->type != RIDE_TYPE_NULL)
+        {
+            AppendLine(text, "ride %d: type %d mode %d status %d", i, ride->type, ride->mode, ride->status);
+            rct_ride rideState = GetRideState(ride);
+            text.append("  data ");
+            AppendHex(text, &rideState, sizeof(rct_ride));
+            text.push_back('\n');
+        }
+    }
+}
+
+static void DumpSpriteList(std::string &text, int list)
+{
+    for (uint16 spriteIndex = gSpriteListHead[list]; spriteIndex != SPRITE_INDEX_NULL; )
+    {
+        rct_sprite * sprite = get_sprite(spriteIndex);
+        rct_unk_sprite * unk = &sprite->unknown;
+        AppendLine(text, "sprite %d: identifier %d type %d x %d y %d z %d", spriteIndex, unk->sprite_identifier, unk->misc_identifier, unk->x, unk->y, unk->z);
+        rct_sprite spriteState = GetSpriteState(sprite);
+        text.append("  data ");
+        AppendHex(text, &spriteState, sizeof(rct_sprite));
+        text.push_back('\n');
+        spriteIndex = unk->next;
+    }
+}
+
+static void DumpMapRegion(std::string &text, int region)
+{
+    int left = (region % NETWORK_STATE_MAP_REGIONS_PER_ROW) * NETWORK_STATE_MAP_REGION_SIZE;
+    int top = (region / NETWORK_STATE_MAP_REGIONS_PER_ROW) * NETWORK_STATE_MAP_REGION_SIZE;
+    for (int y = top; y < top + NETWORK_STATE_MAP_REGION_SIZE; y++)
+    {
+        for (int x = left; x < left + NETWORK_STATE_MAP_REGION_SIZE; x++)
+        {
+            AppendLine(text, "tile %d,%d", x, y);
+            rct_map_element * mapElement = map_get_first_element_at(x, y);
+            do
+            {
+                if (!IsMapElementState(mapElement))
+                {
+                    continue;
+                }
+                AppendLine(text, "  type 0x%02X flags 0x%02X base %d clearance %d properties %02X %02X %02X %02X",
+                    mapElement->type, mapElement->flags, mapElement->base_height, mapElement->clearance_height,
+                    ((uint8 *)&mapElement->properties)[0], ((uint8 *)&mapElement->properties)[1],
+                    ((uint8 *)&mapElement->properties)[2], ((uint8 *)&mapElement->properties)[3]);
+            }
+            while (!map_element_is_last_for_tile(mapElement++));
+        }
+    }
+}
+
+bool NetworkStateWriteDump(uint32 component, const utf8 * side, utf8 * outPath, size_t outPathSize)
+{
+    std::string name = NetworkStateGetComponentName(component);
+
+    NetworkStateHashes hashes;
+    NetworkStateCompute(&hashes);
+
+    std::string text;
+    AppendLine(text, "# OpenRCT2 desync dump");
+    AppendLine(text, "side: %s", side);
+    AppendLine(text, "tick: %u", gCurrentTicks);
+    AppendLine(text, "component: %s", name.c_str());
+    AppendLine(text, "hash: %016llx", (unsigned long long)hashes.Hashes[component]);
+    text.push_back('\n');
+
+    if (component == NETWORK_STATE_COMPONENT_RNG)
+    {
+        AppendLine(text, "srand0: %08X", gScenarioSrand0);
+        AppendLine(text, "srand1: %08X", gScenarioSrand1);
+    }
+    else if (component == NETWORK_STATE_COMPONENT_FINANCES)
+    {
+        DumpFinances(text);
+    }
+    else if (component == NETWORK_STATE_COMPONENT_RIDES)
+    {
+        DumpRides(text);
+    }
+    else if (component < NETWORK_STATE_COMPONENT_MAP)
+    {
+        DumpSpriteList(text, component - NETWORK_STATE_COMPONENT_SPRITES);
+    }
+    else if (component < NETWORK_STATE_COMPONENT_COUNT)
+    {
+        DumpMapRegion(text, component - NETWORK_STATE_COMPONENT_MAP);
+    }
+    else
+    {
+        return false;
+    }
+
+    utf8 directory[MAX_PATH];
+    platform_get_user_directory(directory, "desync");
+    platform_ensure_directory_exists(directory);
+
+    utf8 fileName[64];
+    snprintf(fileName, sizeof(fileName), "%u-%s-%s.txt", gCurrentTicks, side, name.c_str());
+    String::Set(outPath, outPathSize, directory);
+    Path::Append(outPath, outPathSize, fileName);
+
+    SDL_RWops * file = SDL_RWFromFile(outPath, "wb");
+    if (file == nullptr)
+    {
+        return false;
+    }
+    bool written = SDL_RWwrite(file, text.data(), text.size(), 1) == 1;
+    SDL_RWclose(file);
+    return written;
+}
@@ -0,0 +1,82 @@
+#pragma region Copyright (c) 2014-2016 OpenRCT2 Developers
+/*****************************************************************************
+ * OpenRCT2, an open source clone of Roller Coaster Tycoon 2.
+ *
+ * OpenRCT2 is the work of many authors, a full list can be found in contributors.md
+ * For more information, visit https://github.com/OpenRCT2/OpenRCT2
+ *
+ * OpenRCT2 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * A full copy of the GNU General Public License can be found in licence.txt
+ *****************************************************************************/
+#pragma endregion
+
+#pragma once
+
+#include <string>
+#include "../common.h"
+
+/**
+ * The game state is split into components that are hashed separately every tick, so that when
+ * a client desynchronises the first tick and the part of the park that differs can be found.
+ */
+#define NETWORK_STATE_MAP_SIZE              256
+#define NETWORK_STATE_MAP_REGION_SIZE       16
+#define NETWORK_STATE_MAP_REGIONS_PER_ROW   (NETWORK_STATE_MAP_SIZE / NETWORK_STATE_MAP_REGION_SIZE)
+#define NETWORK_STATE_NUM_SPRITE_LISTS      6
+
+enum NETWORK_STATE_COMPONENT
+{
+    NETWORK_STATE_COMPONENT_RNG,
+    NETWORK_STATE_COMPONENT_FINANCES,
+    NETWORK_STATE_COMPONENT_RIDES,
+    NETWORK_STATE_COMPONENT_SPRITES,    // One per sprite list
+    NETWORK_STATE_COMPONENT_MAP = NETWORK_STATE_COMPONENT_SPRITES + NETWORK_STATE_NUM_SPRITE_LISTS,   // One per region
+    NETWORK_STATE_COMPONENT_COUNT = NETWORK_STATE_COMPONENT_MAP + NETWORK_STATE_MAP_REGIONS_PER_ROW * NETWORK_STATE_MAP_REGIONS_PER_ROW,
+};
+
+struct NetworkStateHashes
+{
+    uint32 Tick;
+    uint64 Hashes[NETWORK_STATE_COMPONENT_COUNT];
+};
+
+/**
+ * Keeps the hashes of the most recent ticks.
+ */
+class NetworkStateHistory
+{
+public:
+    static constexpr size_t Capacity = 128;
+
+    void Record(uint32 tick);
+    void Clear();
+
+    const NetworkStateHashes * Get(uint32 tick) const;
+    const NetworkStateHashes * GetEntry(size_t index) const;   // 0 is the oldest entry
+    size_t GetCount() const { return _count; }
+    bool   IsEmpty() const { return _count == 0; }
+    uint32 GetOldestTick() const;
+    uint32 GetNewestTick() const;
+
+private:
+    NetworkStateHashes  _entries[Capacity];
+    size_t              _count  = 0;
+    size_t              _next   = 0;
+};
+
+void NetworkStateCompute(NetworkStateHashes * hashes);
+
+/**
+ * Returns a short name for a component, e.g. "sprites-peep" or "map-32-48".
+ */
+std::string NetworkStateGetComponentName(uint32 component);
+
+/**
+ * Writes the current contents of a component as text to the desync directory in the user
+ * directory, so that the dumps of the server and a client can be compared with a diff tool.
+ */
+bool NetworkStateWriteDump(uint32 component, const utf8 * side, utf8 * outPath, size_t outPathSize);
@@ -0,0 +1,190 @@
+#pragma region Copyright (c) 2014-2016 OpenRCT2 Developers
+/*****************************************************************************
+ * OpenRCT2, an open source clone of Roller Coaster Tycoon 2.
+ *
+ * OpenRCT2 is the work of many authors, a full list can be found in contributors.md
+ * For more information, visit https://github.com/OpenRCT2/OpenRCT2
+ *
+ * OpenRCT2 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * A full copy of the GNU General Public License can be found in licence.txt
+ *****************************************************************************/
+#pragma endregion
+
+#ifndef DISABLE_NETWORK
+
+#include "../core/Math.hpp"
+#include "../core/Util.hpp"
+#include "NetworkStats.h"
+
+void NetworkHistogram::Add(uint32 ms)
+{
+    size_t bucket = 0;
+    while (bucket < NumBuckets - 1 && ms >= (1u << bucket))
+    {
+        bucket++;
+    }
+    Buckets[bucket]++;
+    Count++;
+    Sum += ms;
+    Max = Math::Max(Max, ms);
+}
+
+void NetworkHistogram::Add(const NetworkHistogram &other)
+{
+    for (size_t i = 0; i < NumBuckets; i++)
+    {
+        Buckets[i] += other.Buckets[i];
+    }
+    Count += other.Count;
+    Sum += other.Sum;
+    Max = Math::Max(Max, other.Max);
+}
+
+void NetworkHistogram::Clear()
+{
+    *this = NetworkHistogram();
+}
+
+uint32 NetworkHistogram::GetMean() const
+{
+    if (Count == 0)
+    {
+        return 0;
+    }
+    return (uint32)(Sum / Count);
+}
+
+uint32 NetworkHistogram::GetPercentile(uint32 percentile) const
+{
+    if (Count == 0)
+    {
+        return 0;
+    }
+
+    uint64 target = Math::Max<uint64>(1, ((uint64)Count * percentile + 99) / 100);
+    uint64 seen = 0;
+    for (size_t i = 0; i < NumBuckets - 1; i++)
+    {
+        seen += Buckets[i];
+        if (seen >= target)
+        {
+            return Math::Min(Max, (1u << i) - 1);
+        }
+    }
+    return Max;
+}
+
+void NetworkRollingHistogram::Add(uint32 ms, uint32 ticks)
+{
+    Rotate(ticks / WindowLength);
+    _current.Add(ms);
+    _total.Add(ms);
+}
+
+void NetworkRollingHistogram::Add(const NetworkRollingHistogram &other)
+{
+    uint32 window = Math::Max(_window, other._window);
+    NetworkRollingHistogram aligned = other;
+    aligned.Rotate(window);
+    Rotate(window);
+    _current.Add(aligned._current);
+    _previous.Add(aligned._previous);
+    _total.Add(aligned._total);
+}
+
+void NetworkRollingHistogram::Clear()
+{
+    *this = NetworkRollingHistogram();
+}
+
+NetworkHistogram NetworkRollingHistogram::GetRecent(uint32 ticks) const
+{
+    NetworkRollingHistogram aligned = *this;
+    aligned.Rotate(ticks / WindowLength);
+    NetworkHistogram recent = aligned._previous;
+    recent.Add(aligned._current);
+    return recent;
+}
+
+void NetworkRollingHistogram::Rotate(uint32 window)
+{
+    if (window <= _window)
+    {
+        return;
+    }
+    if (window == _window + 1)
+    {
+        _previous = _current;
+    }
+    else
+    {
+        _previous.Clear();
+    }
+    _current.Clear();
+    _window = window;
+}
+
+void NetworkConnectionStats::Add(const NetworkConnectionStats &other)
+{
+    for (size_t i = 0; i < Util::CountOf(Commands); i++)
+    {
+        Commands[i].PacketsIn += other.Commands[i].PacketsIn;
+        Commands[i].PacketsOut += other.Commands[i].PacketsOut;
+        Commands[i].BytesIn += other.Commands[i].BytesIn;
+        Commands[i].BytesOut += other.Commands[i].BytesOut;
+    }
+    QueueDepth += other.QueueDepth;
+    MaxQueueDepth = Math::Max(MaxQueueDepth, other.MaxQueueDepth);
+    QueueTime.Add(other.QueueTime);
+    MapSendTime.Add(other.MapSendTime);
+}
+
+NetworkCommandStats NetworkConnectionStats::GetTotal() const
+{
+    NetworkCommandStats total;
+    for (const NetworkCommandStats &command : Commands)
+    {
+        total.PacketsIn += command.PacketsIn;
+        total.PacketsOut += command.PacketsOut;
+        total.BytesIn += command.BytesIn;
+        total.BytesOut += command.BytesOut;
+    }
+    return total;
+}
+
+static const utf8 * const NetworkCommandNames[] =
+{
+    "auth",
+    "map",
+    "chat",
+    "gamecmd",
+    "tick",
+    "playerlist",
+    "ping",
+    "pinglist",
+    "setdisconnectmsg",
+    "gameinfo",
+    "showerror",
+    "grouplist",
+    "event",
+    "token",
+    "gamecmds",
+    "statehash",
+    "statedump",
+};
+static_assert(Util::CountOf(NetworkCommandNames) == NETWORK_COMMAND_MAX, "Missing network command names");
+
+const utf8 * NetworkGetCommandName(uint32 command)
+{
+    if (command >= Util::CountOf(NetworkCommandNames))
+    {
+        return "unknown";
+    }
+    return NetworkCommandNames[command];
+}
+
+#endif
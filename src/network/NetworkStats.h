@@ -0,0 +1,100 @@
+#pragma region Copyright (c) 2014-2016 OpenRCT2 Developers
+/*****************************************************************************
+ * OpenRCT2, an open source clone of Roller Coaster Tycoon 2.
+ *
+ * OpenRCT2 is the work of many authors, a full list can be found in contributors.md
+ * For more information, visit https://github.com/OpenRCT2/OpenRCT2
+ *
+ * OpenRCT2 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * A full copy of the GNU General Public License can be found in licence.txt
+ *****************************************************************************/
+#pragma endregion
+
+#pragma once
+
+#include "../common.h"
+#include "NetworkTypes.h"
+
+/**
+ * Counts samples in power of two buckets of milliseconds, bucket n holds the samples below 2^n ms
+ * and the last bucket everything above.
+ */
+class NetworkHistogram
+{
+public:
+    static constexpr size_t NumBuckets = 14;
+
+    uint32 Buckets[NumBuckets] = { 0 };
+    uint32 Count    = 0;
+    uint64 Sum      = 0;
+    uint32 Max      = 0;
+
+    void   Add(uint32 ms);
+    void   Add(const NetworkHistogram &other);
+    void   Clear();
+    uint32 GetMean() const;
+
+    /**
+     * Returns the upper bound of the bucket the given percentile falls into, capped at the largest
+     * sample.
+     */
+    uint32 GetPercentile(uint32 percentile) const;
+};
+
+/**
+ * Keeps the samples of the current and the previous window so that the statistics follow recent
+ * conditions rather than the whole session. Windows are aligned to the tick count so histograms
+ * of different connections can be merged.
+ */
+class NetworkRollingHistogram
+{
+public:
+    static constexpr uint32 WindowLength = 30000;
+
+    void Add(uint32 ms, uint32 ticks);
+    void Add(const NetworkRollingHistogram &other);
+    void Clear();
+
+    // Samples of the last 30 to 60 seconds
+    NetworkHistogram        GetRecent(uint32 ticks) const;
+    const NetworkHistogram &GetTotal() const { return _total; }
+
+private:
+    uint32              _window = 0;
+    NetworkHistogram    _current;
+    NetworkHistogram    _previous;
+    NetworkHistogram    _total;
+
+    void Rotate(uint32 window);
+};
+
+struct NetworkCommandStats
+{
+    uint32 PacketsIn    = 0;
+    uint32 PacketsOut   = 0;
+    uint64 BytesIn      = 0;    // Including the size prefix
+    uint64 BytesOut     = 0;
+};
+
+/**
+ * Traffic of a connection, collected by the network thread.
+ */
+struct NetworkConnectionStats
+{
+    // The last entry counts packets with an unknown command
+    NetworkCommandStats Commands[NETWORK_COMMAND_MAX + 1];
+
+    uint32              QueueDepth      = 0;    // Packets waiting for the socket after the last service
+    uint32              MaxQueueDepth   = 0;
+    NetworkRollingHistogram QueueTime;          // From being queued by the game thread until fully sent
+    NetworkHistogram    MapSendTime;            // From queuing the first map chunk until the last is sent
+
+    void Add(const NetworkConnectionStats &other);
+    NetworkCommandStats GetTotal() const;
+};
+
+const utf8 * NetworkGetCommandName(uint32 command);
@@ -56,6 +56,9 @@ enum NETWORK_COMMAND
     NETWORK_COMMAND_GROUPLIST,
     NETWORK_COMMAND_EVENT,
     NETWORK_COMMAND_TOKEN,
+    NETWORK_COMMAND_GAMECMDS,
+    NETWORK_COMMAND_STATEHASH,
+    NETWORK_COMMAND_STATEDUMP,
     NETWORK_COMMAND_MAX,
     NETWORK_COMMAND_INVALID = -1
 };
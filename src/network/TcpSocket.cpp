@@ -44,7 +44,13 @@
     #include <netdb.h>
     #include <netinet/tcp.h>
     #include <sys/socket.h>
+    #include <sys/uio.h>
     #include <fcntl.h>
+    #include <poll.h>
+    #include <unistd.h>
+    #if defined(__LINUX__)
+        #include <sys/epoll.h>
+    #endif
     typedef int SOCKET;
     #define SOCKET_ERROR -1
     #define INVALID_SOCKET -1
@@ -58,10 +64,14 @@
     #endif // defined(__LINUX__)
 #endif // __WINDOWS__
 
+#include <unordered_map>
+#include <vector>
 #include "../core/Exception.hpp"
+#include "../core/Math.hpp"
 #include "TcpSocket.h"
 
 constexpr uint32 CONNECT_TIMEOUT_MS = 3000;
+constexpr size_t MAX_SEND_BUFFERS = 64;
 
 class TcpSocket;
 
@@ -115,6 +125,11 @@ public:
         return _error.empty() ? nullptr : _error.c_str();
     }
 
+    SOCKET GetSocket() const
+    {
+        return _socket;
+    }
+
     void Listen(uint16 port) override
     {
         Listen(nullptr, port);
@@ -361,6 +376,50 @@ public:
         return totalSent;
     }
 
+    /**
+     * Sends as much of the buffers as the socket accepts in a single call, returning the
+     * number of bytes sent.
+     */
+    size_t SendData(const TcpSendBuffer * buffers, size_t count) override
+    {
+        if (_status != SOCKET_STATUS_CONNECTED)
+        {
+            throw Exception("Socket not connected.");
+        }
+
+        count = Math::Min(count, MAX_SEND_BUFFERS);
+#ifdef __WINDOWS__
+        WSABUF wsaBuffers[MAX_SEND_BUFFERS];
+        for (size_t i = 0; i < count; i++)
+        {
+            wsaBuffers[i].buf = (CHAR *)buffers[i].Data;
+            wsaBuffers[i].len = (ULONG)buffers[i].Size;
+        }
+        DWORD sentBytes = 0;
+        if (WSASend(_socket, wsaBuffers, (DWORD)count, &sentBytes, 0, nullptr, nullptr) == SOCKET_ERROR)
+        {
+            return 0;
+        }
+        return sentBytes;
+#else
+        iovec iov[MAX_SEND_BUFFERS];
+        for (size_t i = 0; i < count; i++)
+        {
+            iov[i].iov_base = (void *)buffers[i].Data;
+            iov[i].iov_len = buffers[i].Size;
+        }
+        msghdr msg = { 0 };
+        msg.msg_iov = iov;
+        msg.msg_iovlen = count;
+        ssize_t sentBytes = sendmsg(_socket, &msg, FLAG_NO_PIPE);
+        if (sentBytes == SOCKET_ERROR)
+        {
+            return 0;
+        }
+        return (size_t)sentBytes;
+#endif
+    }
+
     NETWORK_READPACKET ReceiveData(void * buffer, size_t size, size_t * sizeReceived) override
     {
         if (_status != SOCKET_STATUS_CONNECTED)
@@ -467,4 +526,277 @@ ITcpSocket * CreateTcpSocket()
     return new TcpSocket();
 }
 
+#if defined(__LINUX__)
+
+/**
+ * Uses epoll so that waiting costs the same no matter how many sockets are idle.
+ */
+class TcpSocketPoller : public ITcpSocketPoller
+{
+private:
+    int                             _epoll          = -1;
+    int                             _wakePipe[2]    = { -1, -1 };
+    SDL_mutex *                     _mutex          = nullptr;
+    std::unordered_map<int, void *> _tags;
+
+public:
+    TcpSocketPoller()
+    {
+        _mutex = SDL_CreateMutex();
+        _epoll = epoll_create1(0);
+        if (_epoll == -1 || pipe(_wakePipe) != 0)
+        {
+            throw SocketException("Unable to create socket poller.");
+        }
+        fcntl(_wakePipe[0], F_SETFL, O_NONBLOCK);
+        fcntl(_wakePipe[1], F_SETFL, O_NONBLOCK);
+
+        epoll_event ev = { 0 };
+        ev.events = EPOLLIN;
+        ev.data.ptr = nullptr;
+        epoll_ctl(_epoll, EPOLL_CTL_ADD, _wakePipe[0], &ev);
+    }
+
+    ~TcpSocketPoller() override
+    {
+        close(_wakePipe[0]);
+        close(_wakePipe[1]);
+        close(_epoll);
+        SDL_DestroyMutex(_mutex);
+    }
+
+    void Add(ITcpSocket * socket, void * tag) override
+    {
+        int fd = ((TcpSocket *)socket)->GetSocket();
+        SDL_LockMutex(_mutex);
+        {
+            epoll_event ev = { 0 };
+            ev.events = EPOLLIN;
+            ev.data.ptr = tag;
+            if (epoll_ctl(_epoll, EPOLL_CTL_ADD, fd, &ev) == 0)
+            {
+                _tags[fd] = tag;
+            }
+        }
+        SDL_UnlockMutex(_mutex);
+    }
+
+    void Remove(ITcpSocket * socket) override
+    {
+        int fd = ((TcpSocket *)socket)->GetSocket();
+        SDL_LockMutex(_mutex);
+        {
+            if (_tags.erase(fd) != 0)
+            {
+                epoll_ctl(_epoll, EPOLL_CTL_DEL, fd, nullptr);
+            }
+        }
+        SDL_UnlockMutex(_mutex);
+    }
+
+    void SetWriteInterest(ITcpSocket * socket, bool enabled) override
+    {
+        int fd = ((TcpSocket *)socket)->GetSocket();
+        SDL_LockMutex(_mutex);
+        {
+            auto it = _tags.find(fd);
+            if (it != _tags.end())
+            {
+                epoll_event ev = { 0 };
+                ev.events = enabled ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+                ev.data.ptr = it->second;
+                epoll_ctl(_epoll, EPOLL_CTL_MOD, fd, &ev);
+            }
+        }
+        SDL_UnlockMutex(_mutex);
+    }
+
+    size_t Wait(void * * readyTags, size_t capacity, uint32 timeoutMs) override
+    {
+        epoll_event events[64];
+        int maxEvents = (int)Math::Min<size_t>(capacity, 64);
+        int numEvents = epoll_wait(_epoll, events, maxEvents, (int)timeoutMs);
+
+        size_t numReady = 0;
+        for (int i = 0; i < numEvents; i++)
+        {
+            if (events[i].data.ptr == nullptr)
+            {
+                DrainWakePipe(_wakePipe[0]);
+            }
+            else
+            {
+                readyTags[numReady++] = events[i].data.ptr;
+            }
+        }
+        return numReady;
+    }
+
+    void Wake() override
+    {
+        char c = 0;
+        ssize_t written = write(_wakePipe[1], &c, 1);
+        (void)written;
+    }
+
+private:
+    static void DrainWakePipe(int fd)
+    {
+        char buffer[64];
+        while (read(fd, buffer, sizeof(buffer)) > 0) { }
+    }
+};
+
+#else
+
+/**
+ * Portable fallback using poll (WSAPoll on Windows), which rebuilds the descriptor list on
+ * every wait. Windows has no wake descriptor, so waits are kept short there instead.
+ */
+class TcpSocketPoller : public ITcpSocketPoller
+{
+private:
+    struct Entry
+    {
+        SOCKET  Socket;
+        void *  Tag;
+        bool    Write;
+    };
+
+    SDL_mutex *         _mutex          = nullptr;
+    std::vector<Entry>  _entries;
+#ifndef __WINDOWS__
+    int                 _wakePipe[2]    = { -1, -1 };
+#endif
+
+public:
+    TcpSocketPoller()
+    {
+        _mutex = SDL_CreateMutex();
+#ifndef __WINDOWS__
+        if (pipe(_wakePipe) != 0)
+        {
+            throw SocketException("Unable to create socket poller.");
+        }
+        fcntl(_wakePipe[0], F_SETFL, O_NONBLOCK);
+        fcntl(_wakePipe[1], F_SETFL, O_NONBLOCK);
+#endif
+    }
+
+    ~TcpSocketPoller() override
+    {
+#ifndef __WINDOWS__
+        close(_wakePipe[0]);
+        close(_wakePipe[1]);
+#endif
+        SDL_DestroyMutex(_mutex);
+    }
+
+    void Add(ITcpSocket * socket, void * tag) override
+    {
+        SDL_LockMutex(_mutex);
+        {
+            _entries.push_back({ ((TcpSocket *)socket)->GetSocket(), tag, false });
+        }
+        SDL_UnlockMutex(_mutex);
+    }
+
+    void Remove(ITcpSocket * socket) override
+    {
+        SOCKET s = ((TcpSocket *)socket)->GetSocket();
+        SDL_LockMutex(_mutex);
+        {
+            _entries.erase(std::remove_if(_entries.begin(), _entries.end(), [s](const Entry &entry) -> bool
+            {
+                return entry.Socket == s;
+            }), _entries.end());
+        }
+        SDL_UnlockMutex(_mutex);
+    }
+
+    void SetWriteInterest(ITcpSocket * socket, bool enabled) override
+    {
+        SOCKET s = ((TcpSocket *)socket)->GetSocket();
+        SDL_LockMutex(_mutex);
+        {
+            for (Entry &entry : _entries)
+            {
+                if (entry.Socket == s)
+                {
+                    entry.Write = enabled;
+                }
+            }
+        }
+        SDL_UnlockMutex(_mutex);
+    }
+
+    size_t Wait(void * * readyTags, size_t capacity, uint32 timeoutMs) override
+    {
+        std::vector<pollfd> fds;
+        std::vector<void *> tags;
+        SDL_LockMutex(_mutex);
+        {
+            for (const Entry &entry : _entries)
+            {
+                pollfd pfd = { 0 };
+                pfd.fd = entry.Socket;
+                pfd.events = entry.Write ? (POLLIN | POLLOUT) : POLLIN;
+                fds.push_back(pfd);
+                tags.push_back(entry.Tag);
+            }
+        }
+        SDL_UnlockMutex(_mutex);
+
+#ifdef __WINDOWS__
+        timeoutMs = Math::Min<uint32>(timeoutMs, 1);
+        if (fds.empty())
+        {
+            SDL_Delay(timeoutMs);
+            return 0;
+        }
+        int result = WSAPoll(fds.data(), (ULONG)fds.size(), (INT)timeoutMs);
+#else
+        pollfd wakePfd = { 0 };
+        wakePfd.fd = _wakePipe[0];
+        wakePfd.events = POLLIN;
+        fds.push_back(wakePfd);
+        int result = poll(fds.data(), (nfds_t)fds.size(), (int)timeoutMs);
+        if (result > 0 && fds.back().revents != 0)
+        {
+            char buffer[64];
+            while (read(_wakePipe[0], buffer, sizeof(buffer)) > 0) { }
+        }
+#endif
+
+        size_t numReady = 0;
+        if (result > 0)
+        {
+            for (size_t i = 0; i < tags.size() && numReady < capacity; i++)
+            {
+                if (fds[i].revents != 0)
+                {
+                    readyTags[numReady++] = tags[i];
+                }
+            }
+        }
+        return numReady;
+    }
+
+    void Wake() override
+    {
+#ifndef __WINDOWS__
+        char c = 0;
+        ssize_t written = write(_wakePipe[1], &c, 1);
+        (void)written;
+#endif
+    }
+};
+
+#endif // defined(__LINUX__)
+
+ITcpSocketPoller * CreateTcpSocketPoller()
+{
+    return new TcpSocketPoller();
+}
+
 #endif
@@ -35,6 +35,15 @@ enum NETWORK_READPACKET
     NETWORK_READPACKET_DISCONNECTED
 };
 
+/**
+ * A block of memory to be sent as part of a vectored send.
+ */
+struct TcpSendBuffer
+{
+    const void * Data;
+    size_t       Size;
+};
+
 /**
  * Represents a TCP socket / connection or listener.
  */
@@ -54,10 +63,33 @@ public:
     virtual void ConnectAsync(const char * address, uint16 port) abstract;
 
     virtual size_t             SendData(const void * buffer, size_t size)                     abstract;
+    virtual size_t             SendData(const TcpSendBuffer * buffers, size_t count)          abstract;
     virtual NETWORK_READPACKET ReceiveData(void * buffer, size_t size, size_t * sizeReceived) abstract;
 
     virtual void Disconnect() abstract;
     virtual void Close() abstract;
 };
 
+/**
+ * Waits until any of a set of sockets can be read or written, so that idle sockets do not have
+ * to be probed.
+ */
+interface ITcpSocketPoller
+{
+public:
+    virtual ~ITcpSocketPoller() { }
+
+    virtual void Add(ITcpSocket * socket, void * tag)                abstract;
+    virtual void Remove(ITcpSocket * socket)                         abstract;
+    virtual void SetWriteInterest(ITcpSocket * socket, bool enabled) abstract;
+
+    /**
+     * Blocks until sockets are ready, Wake is called or the timeout passes. The tags of the ready
+     * sockets are written to readyTags, the return value is the number of tags written.
+     */
+    virtual size_t Wait(void * * readyTags, size_t capacity, uint32 timeoutMs) abstract;
+    virtual void   Wake()                                                      abstract;
+};
+
 ITcpSocket * CreateTcpSocket();
+ITcpSocketPoller * CreateTcpSocketPoller();
@@ -38,12 +38,15 @@ extern "C" {
 
 #include <cmath>
 #include <cerrno>
+#include <cstdarg>
 #include <algorithm>
 #include <set>
 #include <string>
+#include <zlib.h>
 
 #include "../core/Console.hpp"
 #include "../core/Json.hpp"
+#include "../core/Math.hpp"
 #include "../core/Path.hpp"
 #include "../core/String.hpp"
 #include "../core/Util.hpp"
@@ -52,6 +55,7 @@ extern "C" {
 #include "../config.h"
 #include "../game.h"
 #include "../interface/chat.h"
+#include "../interface/console.h"
 #include "../interface/window.h"
 #include "../interface/keyboard_shortcut.h"
 #include "../localisation/date.h"
@@ -93,6 +97,35 @@ enum {
 constexpr int MASTER_SERVER_REGISTER_TIME = 120 * 1000;	// 2 minutes
 constexpr int MASTER_SERVER_HEARTBEAT_TIME = 60 * 1000;	// 1 minute
 
+// The map is deflated in independent segments on several threads, joined into a single zlib stream
+constexpr size_t NETWORK_MAP_SEGMENT_SIZE = 1024 * 1024;
+constexpr int NETWORK_MAP_MAX_THREADS = 8;
+
+// The network thread wakes up at least this often even if no socket is ready
+constexpr uint32 NETWORK_IO_WAIT_TIMEOUT = 50;
+constexpr size_t NETWORK_IO_MAX_EVENTS = 64;
+
+// Batches of game commands are split so that they stay within the maximum packet size
+constexpr size_t NETWORK_GAMECMDS_MAX_PACKET_SIZE = 60000;
+
+// Limits on how far a joining client has to catch up from the map snapshot
+constexpr uint32 NETWORK_SNAPSHOT_MAX_AGE = 200;
+constexpr size_t NETWORK_SNAPSHOT_MAX_COMMANDS = 4096;
+
+// State hashes are sent in several packets, each within the maximum packet size
+constexpr size_t NETWORK_STATEHASH_TICKS_PER_PACKET = 28;
+constexpr size_t NETWORK_STATE_MAX_DUMPS = 8;
+
+// Clients may only ask for state hashes and dumps this often, servers ignore the requests unless
+// they have desync debugging enabled so clients stop waiting for an answer after a while
+constexpr uint32 NETWORK_STATE_REQUEST_INTERVAL = 5000;
+constexpr uint32 NETWORK_STATE_REQUEST_TIMEOUT = 10000;
+
+// Commands sent by a client that the server has not broadcast back yet, rejected commands are
+// never broadcast so the oldest are dropped
+constexpr size_t NETWORK_STATS_MAX_SENT_COMMANDS = 256;
+static_assert(NETWORK_COMMAND_MAX + 1 <= NETWORK_STATS_MAX_COMMANDS, "Too many network commands for network_stats_summary");
+
 void network_chat_show_connected_message();
 static void network_get_keys_directory(utf8 *buffer, size_t bufferSize);
 static void network_get_private_key_path(utf8 *buffer, size_t bufferSize, const utf8 * playerName);
@@ -107,11 +140,12 @@ Network::Network()
 	last_tick_sent_time = 0;
 	last_ping_sent_time = 0;
 	last_advertise_time = 0;
+	SDL_AtomicSet(&_ioStop, 0);
 	client_command_handlers.resize(NETWORK_COMMAND_MAX, 0);
 	client_command_handlers[NETWORK_COMMAND_AUTH] = &Network::Client_Handle_AUTH;
 	client_command_handlers[NETWORK_COMMAND_MAP] = &Network::Client_Handle_MAP;
 	client_command_handlers[NETWORK_COMMAND_CHAT] = &Network::Client_Handle_CHAT;
-	client_command_handlers[NETWORK_COMMAND_GAMECMD] = &Network::Client_Handle_GAMECMD;
+	client_command_handlers[NETWORK_COMMAND_GAMECMDS] = &Network::Client_Handle_GAMECMDS;
 	client_command_handlers[NETWORK_COMMAND_TICK] = &Network::Client_Handle_TICK;
 	client_command_handlers[NETWORK_COMMAND_PLAYERLIST] = &Network::Client_Handle_PLAYERLIST;
 	client_command_handlers[NETWORK_COMMAND_PING] = &Network::Client_Handle_PING;
@@ -122,6 +156,8 @@ Network::Network()
 	client_command_handlers[NETWORK_COMMAND_EVENT] = &Network::Client_Handle_EVENT;
 	client_command_handlers[NETWORK_COMMAND_GAMEINFO] = &Network::Client_Handle_GAMEINFO;
 	client_command_handlers[NETWORK_COMMAND_TOKEN] = &Network::Client_Handle_TOKEN;
+	client_command_handlers[NETWORK_COMMAND_STATEHASH] = &Network::Client_Handle_STATEHASH;
+	client_command_handlers[NETWORK_COMMAND_STATEDUMP] = &Network::Client_Handle_STATEDUMP;
 	server_command_handlers.resize(NETWORK_COMMAND_MAX, 0);
 	server_command_handlers[NETWORK_COMMAND_AUTH] = &Network::Server_Handle_AUTH;
 	server_command_handlers[NETWORK_COMMAND_CHAT] = &Network::Server_Handle_CHAT;
@@ -129,6 +165,8 @@ Network::Network()
 	server_command_handlers[NETWORK_COMMAND_PING] = &Network::Server_Handle_PING;
 	server_command_handlers[NETWORK_COMMAND_GAMEINFO] = &Network::Server_Handle_GAMEINFO;
 	server_command_handlers[NETWORK_COMMAND_TOKEN] = &Network::Server_Handle_TOKEN;
+	server_command_handlers[NETWORK_COMMAND_STATEHASH] = &Network::Server_Handle_STATEHASH;
+	server_command_handlers[NETWORK_COMMAND_STATEDUMP] = &Network::Server_Handle_STATEDUMP;
 	OpenSSL_add_all_algorithms();
 }
 
@@ -169,6 +207,7 @@ void Network::Close()
 		// which may no longer be valid on Linux and would cause a segfault.
 		return;
 	}
+	StopNetworkThread();
 	if (mode == NETWORK_MODE_CLIENT) {
 		delete server_connection.Socket;
 		server_connection.Socket = nullptr;
@@ -181,13 +220,26 @@ void Network::Close()
 	status = NETWORK_STATUS_NONE;
 	_lastConnectStatus = SOCKET_STATUS_CLOSED;
 	server_connection.AuthStatus = NETWORK_AUTH_NONE;
-	server_connection.InboundPacket.Clear();
+	server_connection.ClearPackets();
 	server_connection.SetLastDisconnectReason(nullptr);
 
 	client_connection_list.clear();
 	game_command_queue.clear();
+	_pendingGameCommands.clear();
 	player_list.clear();
 	group_list.clear();
+	InvalidateMapSnapshot();
+	_stateHistory.Clear();
+	_stateCheckPending = false;
+	_stateDumpPending = false;
+	_closedConnectionStats = NetworkConnectionStats();
+	_pingTimes.Clear();
+	_commandLatencies.Clear();
+	_sentGameCommands.clear();
+	_statsRateTime = 0;
+	_bytesInPerSecond = 0;
+	_bytesOutPerSecond = 0;
+	_lastStatsFileTime = 0;
 
 #ifdef __WINDOWS__
 	if (wsa_initialized) {
@@ -374,22 +426,36 @@ void Network::Update()
 		UpdateClient();
 		break;
 	}
+	if (GetMode() != NETWORK_MODE_NONE) {
+		UpdateStats();
+	}
+
+	// Let the network thread send the packets queued during this update
+	PostNetworkRequests();
 }
 
 void Network::UpdateServer()
 {
 	auto it = client_connection_list.begin();
 	while (it != client_connection_list.end()) {
+		auto next = std::next(it);
 		if (!ProcessConnection(*(*it))) {
 			RemoveClient((*it));
-			it = client_connection_list.begin();
-		} else {
-			it++;
 		}
+		it = next;
 	}
 	if (SDL_TICKS_PASSED(SDL_GetTicks(), last_tick_sent_time + 25)) {
 		Server_Send_TICK();
 	}
+	if (_mapSnapshotValid && gCurrentTicks - _mapSnapshotTick >= NETWORK_SNAPSHOT_MAX_AGE) {
+		// Prepare the next snapshot ahead of time while clients are joining, otherwise stop
+		// logging commands until someone joins
+		if (_mapSnapshotUsed) {
+			BuildMapSnapshot();
+		} else {
+			InvalidateMapSnapshot();
+		}
+	}
 	if (SDL_TICKS_PASSED(SDL_GetTicks(), last_ping_sent_time + 3000)) {
 		Server_Send_PING();
 		Server_Send_PINGLIST();
@@ -408,8 +474,17 @@ void Network::UpdateServer()
 		break;
 	}
 
-	ITcpSocket * tcpSocket = listening_socket->Accept();
-	if (tcpSocket != nullptr) {
+	if (gOpenRCT2Headless && gConfigNetwork.stats_interval != 0) {
+		if (_lastStatsFileTime == 0) {
+			_lastStatsFileTime = SDL_GetTicks();
+		} else if (SDL_TICKS_PASSED(SDL_GetTicks(), _lastStatsFileTime + gConfigNetwork.stats_interval * 1000)) {
+			WriteStatsFile();
+			_lastStatsFileTime = SDL_GetTicks();
+		}
+	}
+
+	ITcpSocket * tcpSocket;
+	while ((tcpSocket = listening_socket->Accept()) != nullptr) {
 		AddClient(tcpSocket);
 	}
 }
@@ -451,6 +526,7 @@ void Network::UpdateClient()
 		{
 			status = NETWORK_STATUS_CONNECTED;
 			server_connection.ResetLastPacketTime();
+			AddNetworkConnection(&server_connection);
 			Client_Send_TOKEN();
 			char str_authenticating[256];
 			format_string(str_authenticating, STR_MULTIPLAYER_AUTHENTICATING, NULL);
@@ -496,13 +572,22 @@ void Network::UpdateClient()
 		}
 		ProcessGameCommandQueue();
 
+		if (_stateDumpPending && gCurrentTicks >= _stateDumpTick) {
+			// The server wrote its dumps at this tick
+			_stateDumpPending = false;
+			WriteStateDumps("client", _stateDumpComponents);
+		}
+
 		// Check synchronisation
 		if (!_desynchronised && !CheckSRAND(gCurrentTicks, gScenarioSrand0)) {
 			_desynchronised = true;
 			char str_desync[256];
 			format_string(str_desync, STR_MULTIPLAYER_DESYNC, NULL);
 			window_network_status_open(str_desync, NULL);
-			if (!gConfigNetwork.stay_connected) {
+			if (gConfigNetwork.desync_debugging) {
+				// Stay connected to find out where the game diverged
+				RequestStateCheck();
+			} else if (!gConfigNetwork.stay_connected) {
 				Close();
 			}
 		}
@@ -570,7 +655,7 @@ const char* Network::FormatChat(NetworkPlayer* fromplayer, const char* text)
 void Network::SendPacketToClients(NetworkPacket& packet, bool front)
 {
 	for (auto it = client_connection_list.begin(); it != client_connection_list.end(); it++) {
-		(*it)->QueuePacket(std::move(NetworkPacket::Duplicate(packet)), front);
+		(*it)->QueuePacket(packet, front);
 	}
 }
 
@@ -605,8 +690,7 @@ void Network::KickPlayer(int playerId)
 			char str_disconnect_msg[256];
 			format_string(str_disconnect_msg, STR_MULTIPLAYER_KICKED_REASON, NULL);
 			Server_Send_SETDISCONNECTMSG(*(*it), str_disconnect_msg);
-			(*it)->Socket->Disconnect();
-			(*it)->SendQueuedPackets();
+			(*it)->Disconnect();
 			break;
 		}
 	}
@@ -620,7 +704,7 @@ void Network::SetPassword(const char* password)
 void Network::ShutdownClient()
 {
 	if (GetMode() == NETWORK_MODE_CLIENT) {
-		server_connection.Socket->Disconnect();
+		server_connection.Disconnect();
 	}
 }
 
@@ -988,63 +1072,263 @@ void Network::Server_Send_AUTH(NetworkConnection& connection)
 	}
 	connection.QueuePacket(std::move(packet));
 	if (connection.AuthStatus != NETWORK_AUTH_OK && connection.AuthStatus != NETWORK_AUTH_REQUIREPASSWORD) {
-		connection.SendQueuedPackets();
-		connection.Socket->Disconnect();
+		connection.Disconnect();
 	}
 }
 
-void Network::Server_Send_MAP(NetworkConnection* connection)
+#pragma region Map snapshot
+
+// A write stream into memory for saving the map, seeking is needed to fill in chunk headers
+struct NetworkMapBuffer
+{
+	std::vector<uint8> Data;
+	size_t Position = 0;
+};
+
+static Sint64 NetworkMapBufferSize(SDL_RWops * context)
+{
+	auto buffer = (NetworkMapBuffer *)context->hidden.unknown.data1;
+	return (Sint64)buffer->Data.size();
+}
+
+static Sint64 NetworkMapBufferSeek(SDL_RWops * context, Sint64 offset, int whence)
+{
+	auto buffer = (NetworkMapBuffer *)context->hidden.unknown.data1;
+	Sint64 position;
+	switch (whence) {
+	case RW_SEEK_SET: position = offset; break;
+	case RW_SEEK_CUR: position = (Sint64)buffer->Position + offset; break;
+	case RW_SEEK_END: position = (Sint64)buffer->Data.size() + offset; break;
+	default: return -1;
+	}
+	if (position < 0 || position > (Sint64)buffer->Data.size()) {
+		return -1;
+	}
+	buffer->Position = (size_t)position;
+	return position;
+}
+
+static size_t NetworkMapBufferRead(SDL_RWops * context, void * ptr, size_t size, size_t maxnum)
+{
+	return 0;
+}
+
+static size_t NetworkMapBufferWrite(SDL_RWops * context, const void * ptr, size_t size, size_t num)
+{
+	auto buffer = (NetworkMapBuffer *)context->hidden.unknown.data1;
+	size_t length = size * num;
+	if (buffer->Position + length > buffer->Data.size()) {
+		if (buffer->Position + length > buffer->Data.capacity()) {
+			buffer->Data.reserve((std::max)(buffer->Position + length, buffer->Data.capacity() * 2));
+		}
+		buffer->Data.resize(buffer->Position + length);
+	}
+	memcpy(&buffer->Data[buffer->Position], ptr, length);
+	buffer->Position += length;
+	return num;
+}
+
+static int NetworkMapBufferClose(SDL_RWops * context)
 {
+	return 0;
+}
+
+struct NetworkMapSegment
+{
+	const uint8 * Data;
+	size_t Length;
+	bool Last;
+	std::vector<uint8> Output;
+	uLong Adler;
+	bool Failed;
+};
+
+struct NetworkMapCompressQueue
+{
+	NetworkMapSegment * Segments;
+	int Count;
+	SDL_atomic_t Next;
+};
+
+/**
+ * Deflates segments as raw deflate data. All but the last end with a sync flush, so they are
+ * byte aligned and can be joined into one stream.
+ */
+static int NetworkMapCompressThread(void * ptr)
+{
+	auto queue = (NetworkMapCompressQueue *)ptr;
+
+	int index;
+	while ((index = SDL_AtomicAdd(&queue->Next, 1)) < queue->Count) {
+		NetworkMapSegment * segment = &queue->Segments[index];
+		segment->Adler = adler32(adler32(0L, Z_NULL, 0), segment->Data, (uInt)segment->Length);
+		segment->Failed = true;
+
+		z_stream strm = { 0 };
+		if (deflateInit2(&strm, Z_BEST_SPEED, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+			continue;
+		}
+		segment->Output.resize(deflateBound(&strm, (uLong)segment->Length) + 16);
+		strm.next_in = (Bytef *)segment->Data;
+		strm.avail_in = (uInt)segment->Length;
+		strm.next_out = segment->Output.data();
+		strm.avail_out = (uInt)segment->Output.size();
+
+		int ret = deflate(&strm, segment->Last ? Z_FINISH : Z_SYNC_FLUSH);
+		bool finished = segment->Last ? ret == Z_STREAM_END : (ret == Z_OK && strm.avail_out != 0);
+		if (finished && strm.avail_in == 0) {
+			segment->Output.resize(strm.total_out);
+			segment->Failed = false;
+		}
+		deflateEnd(&strm);
+	}
+	return 0;
+}
+
+/**
+ * Compresses data into a zlib stream that can be read with uncompress, using several threads.
+ */
+static bool NetworkMapCompress(const uint8 * data, size_t length, std::vector<uint8> &output)
+{
+	int count = (int)((length + NETWORK_MAP_SEGMENT_SIZE - 1) / NETWORK_MAP_SEGMENT_SIZE);
+	if (count == 0) {
+		return false;
+	}
+
+	std::vector<NetworkMapSegment> segments(count);
+	for (int i = 0; i < count; i++) {
+		size_t offset = i * NETWORK_MAP_SEGMENT_SIZE;
+		segments[i].Data = data + offset;
+		segments[i].Length = (std::min)(NETWORK_MAP_SEGMENT_SIZE, length - offset);
+		segments[i].Last = (i == count - 1);
+	}
+
+	NetworkMapCompressQueue queue;
+	queue.Segments = segments.data();
+	queue.Count = count;
+	SDL_AtomicSet(&queue.Next, 0);
+
+	SDL_Thread * threads[NETWORK_MAP_MAX_THREADS - 1] = { 0 };
+	int numThreads = Math::Clamp(1, SDL_GetCPUCount(), Math::Min(count, NETWORK_MAP_MAX_THREADS)) - 1;
+	for (int i = 0; i < numThreads; i++) {
+		threads[i] = SDL_CreateThread(NetworkMapCompressThread, "network_map", &queue);
+	}
+	NetworkMapCompressThread(&queue);
+	for (int i = 0; i < numThreads; i++) {
+		if (threads[i] != nullptr) {
+			SDL_WaitThread(threads[i], nullptr);
+		}
+	}
+
+	// zlib header (deflate, 32K window, fastest), the segments then the Adler-32 of the data
+	output.push_back(0x78);
+	output.push_back(0x01);
+	uLong adler = adler32(0L, Z_NULL, 0);
+	for (const NetworkMapSegment &segment : segments) {
+		if (segment.Failed) {
+			return false;
+		}
+		output.insert(output.end(), segment.Output.begin(), segment.Output.end());
+		adler = adler32_combine(adler, segment.Adler, (z_off_t)segment.Length);
+	}
+	output.push_back((uint8)(adler >> 24));
+	output.push_back((uint8)(adler >> 16));
+	output.push_back((uint8)(adler >> 8));
+	output.push_back((uint8)adler);
+	return true;
+}
+
+#pragma endregion
+
+bool Network::BuildMapSnapshot()
+{
+	// Clients reset the sprite order when they load the map, so reset it on the server and the
+	// connected clients at the tick of the snapshot. Otherwise the joining clients run the
+	// commands logged after the snapshot with a different sprite order.
+	game_do_command(0, GAME_COMMAND_FLAG_APPLY, 0, 0, GAME_COMMAND_RESET_SPRITES, 0, 0);
+
+	NetworkMapBuffer buffer;
+	SDL_RWops * rw = SDL_AllocRW();
+	if (rw == nullptr) {
+		log_warning("Failed to create stream to save map.");
+		return false;
+	}
+	rw->type = SDL_RWOPS_UNKNOWN;
+	rw->size = NetworkMapBufferSize;
+	rw->seek = NetworkMapBufferSeek;
+	rw->read = NetworkMapBufferRead;
+	rw->write = NetworkMapBufferWrite;
+	rw->close = NetworkMapBufferClose;
+	rw->hidden.unknown.data1 = &buffer;
+
 	bool RLEState = gUseRLE;
 	gUseRLE = false;
-	FILE* temp = tmpfile();
-	if (!temp) {
-		log_warning("Failed to create temporary file to save map.");
-		return;
-	}
-	SDL_RWops* rw = SDL_RWFromFP(temp, SDL_TRUE);
-	scenario_save_network(rw);
+	int saved = scenario_save_network(rw);
 	gUseRLE = RLEState;
-	int size = (int)SDL_RWtell(rw);
-	std::vector<uint8> buffer(size);
-	SDL_RWseek(rw, 0, RW_SEEK_SET);
-	if (SDL_RWread(rw, &buffer[0], size, 1) == 0) {
-		log_warning("Failed to read temporary map file into memory.");
-		SDL_RWclose(rw);
-		return;
+	SDL_FreeRW(rw);
+	if (!saved) {
+		log_warning("Failed to save map.");
+		return false;
 	}
-	size_t chunksize = 65000;
-	size_t out_size = size;
-	unsigned char *compressed = util_zlib_deflate(&buffer[0], size, &out_size);
-	unsigned char *header;
-	if (compressed != NULL)
-	{
-		header = (unsigned char *)_strdup("open2_sv6_zlib");
-		size_t header_len = strlen((char *)header) + 1; // account for null terminator
-		header = (unsigned char *)realloc(header, header_len + out_size);
-		memcpy(&header[header_len], compressed, out_size);
-		out_size += header_len;
-		free(compressed);
-		log_verbose("Sending map of size %u bytes, compressed to %u bytes", size, out_size);
+
+	const char * header = "open2_sv6_zlib";
+	size_t header_len = strlen(header) + 1; // account for null terminator
+	_mapSnapshot.assign(header, header + header_len);
+	if (NetworkMapCompress(buffer.Data.data(), buffer.Data.size(), _mapSnapshot)) {
+		log_verbose("Sending map of size %u bytes, compressed to %u bytes", (uint32)buffer.Data.size(), (uint32)_mapSnapshot.size());
 	} else {
 		log_warning("Failed to compress the data, falling back to non-compressed sv6.");
-		header = (unsigned char *)malloc(size);
-		out_size = size;
-		memcpy(header, &buffer[0], size);
+		_mapSnapshot = std::move(buffer.Data);
 	}
+
+	_mapSnapshotLog.clear();
+	_mapSnapshotTick = gCurrentTicks;
+	_mapSnapshotValid = true;
+	_mapSnapshotUsed = false;
+	return true;
+}
+
+void Network::InvalidateMapSnapshot()
+{
+	_mapSnapshot.clear();
+	_mapSnapshot.shrink_to_fit();
+	_mapSnapshotLog.clear();
+	_mapSnapshotLog.shrink_to_fit();
+	_mapSnapshotValid = false;
+	_mapSnapshotUsed = false;
+}
+
+void Network::Server_Send_MAP(NetworkConnection* connection)
+{
+	// The map includes the effect of the pending commands, clients joining would run them twice
+	Server_Send_GAMECMDS();
+
+	// Joining clients share the last snapshot, a broadcast is sent after a new park has been
+	// loaded so it always needs a new one
+	if ((connection == nullptr || !_mapSnapshotValid) && !BuildMapSnapshot()) {
+		return;
+	}
+
+	size_t chunksize = 65000;
+	size_t out_size = _mapSnapshot.size();
 	for (size_t i = 0; i < out_size; i += chunksize) {
 		int datasize = (std::min)(chunksize, out_size - i);
 		std::unique_ptr<NetworkPacket> packet = std::move(NetworkPacket::Allocate());
 		*packet << (uint32)NETWORK_COMMAND_MAP << (uint32)out_size << (uint32)i;
-		packet->Write(&header[i], datasize);
+		packet->Write(&_mapSnapshot[i], datasize);
 		if (connection) {
 			connection->QueuePacket(std::move(packet));
 		} else {
 			SendPacketToClients(*packet);
 		}
 	}
-	free(header);
-	SDL_RWclose(rw);
+
+	// The commands broadcast since the snapshot was taken, any broadcast to the client before
+	// the map is discarded when it loads the map
+	if (connection) {
+		Server_Send_GAMECMDS(_mapSnapshotLog, connection);
+		_mapSnapshotUsed = true;
+	}
 }
 
 void Network::Client_Send_CHAT(const char* text)
@@ -1069,18 +1353,79 @@ void Network::Client_Send_GAMECMD(uint32 eax, uint32 ebx, uint32 ecx, uint32 edx
 	*packet << (uint32)NETWORK_COMMAND_GAMECMD << (uint32)gCurrentTicks << eax << (ebx | GAME_COMMAND_FLAG_NETWORKED)
 			<< ecx << edx << esi << edi << ebp << callback;
 	server_connection.QueuePacket(std::move(packet));
+
+	// Matched with the command broadcast by the server to measure the round trip
+	SentGameCommand sent = { SDL_GetTicks(), { eax, ebx | GAME_COMMAND_FLAG_NETWORKED, ecx, edx, esi, edi, ebp } };
+	if (_sentGameCommands.size() >= NETWORK_STATS_MAX_SENT_COMMANDS) {
+		_sentGameCommands.pop_front();
+	}
+	_sentGameCommands.push_back(sent);
 }
 
 void Network::Server_Send_GAMECMD(uint32 eax, uint32 ebx, uint32 ecx, uint32 edx, uint32 esi, uint32 edi, uint32 ebp, uint8 playerid, uint8 callback)
 {
-	std::unique_ptr<NetworkPacket> packet = std::move(NetworkPacket::Allocate());
-	*packet << (uint32)NETWORK_COMMAND_GAMECMD << (uint32)gCurrentTicks << eax << (ebx | GAME_COMMAND_FLAG_NETWORKED)
-			<< ecx << edx << esi << edi << ebp << playerid << callback;
-	SendPacketToClients(*packet);
+	// Sent to the clients in one batch with the next tick
+	uint32 args[7] = { eax, ebx | GAME_COMMAND_FLAG_NETWORKED, ecx, edx, esi, edi, ebp };
+	GameCommand gc = GameCommand(gCurrentTicks, args, playerid, callback);
+	_pendingGameCommands.push_back(gc);
+
+	if (_mapSnapshotValid) {
+		if (_mapSnapshotLog.size() < NETWORK_SNAPSHOT_MAX_COMMANDS) {
+			_mapSnapshotLog.push_back(gc);
+		} else {
+			// Replaying this many commands would take longer than a new snapshot
+			InvalidateMapSnapshot();
+		}
+	}
+}
+
+void Network::Server_Send_GAMECMDS()
+{
+	Server_Send_GAMECMDS(_pendingGameCommands);
+	_pendingGameCommands.clear();
+}
+
+void Network::Server_Send_GAMECMDS(const std::vector<GameCommand>& commands, NetworkConnection* connection)
+{
+	// Each command is written as the tick relative to the previous command, the player, the
+	// callback and a mask of the registers that are not zero followed by those registers, all
+	// of them as variable length integers. The networked flag is implied.
+	size_t i = 0;
+	while (i < commands.size()) {
+		std::unique_ptr<NetworkPacket> packet = std::move(NetworkPacket::Allocate());
+		uint32 tick = commands[i].tick;
+		*packet << (uint32)NETWORK_COMMAND_GAMECMDS << tick;
+		for (; i < commands.size() && packet->data->size() < NETWORK_GAMECMDS_MAX_PACKET_SIZE; i++) {
+			const GameCommand& gc = commands[i];
+			uint32 args[7] = { gc.eax, gc.ebx & ~GAME_COMMAND_FLAG_NETWORKED, gc.ecx, gc.edx, gc.esi, gc.edi, gc.ebp };
+			uint8 mask = 0;
+			for (int j = 0; j < 7; j++) {
+				if (args[j] != 0) {
+					mask |= 1 << j;
+				}
+			}
+			packet->WriteVarInt(gc.tick - tick);
+			tick = gc.tick;
+			*packet << gc.playerid << gc.callback << mask;
+			for (int j = 0; j < 7; j++) {
+				if (mask & (1 << j)) {
+					packet->WriteVarInt(args[j]);
+				}
+			}
+		}
+		if (connection) {
+			connection->QueuePacket(std::move(packet));
+		} else {
+			SendPacketToClients(*packet);
+		}
+	}
 }
 
 void Network::Server_Send_TICK()
 {
+	// Clients must have all the commands of a tick before they are allowed to run past it
+	Server_Send_GAMECMDS();
+
 	last_tick_sent_time = SDL_GetTicks();
 	std::unique_ptr<NetworkPacket> packet = std::move(NetworkPacket::Allocate());
 	*packet << (uint32)NETWORK_COMMAND_TICK << (uint32)gCurrentTicks << (uint32)gScenarioSrand0;
@@ -1214,33 +1559,22 @@ void Network::Server_Send_EVENT_PLAYER_DISCONNECTED(const char *playerName, cons
 
 bool Network::ProcessConnection(NetworkConnection& connection)
 {
-	int packetStatus;
-	do {
-		packetStatus = connection.ReadPacket();
-		switch(packetStatus) {
-		case NETWORK_READPACKET_DISCONNECTED:
-			// closed connection or network error
-			if (!connection.GetLastDisconnectReason()) {
-				connection.SetLastDisconnectReason(STR_MULTIPLAYER_CONNECTION_CLOSED);
-			}
+	// Read the flag first so that every packet received before the connection closed is processed
+	bool disconnected = connection.IsDisconnected();
+	std::unique_ptr<NetworkPacket> packet;
+	while (connection.ReceivePacket(&packet)) {
+		ProcessPacket(connection, *packet);
+		if (connection.Socket == nullptr) {
 			return false;
-			break;
-		case NETWORK_READPACKET_SUCCESS:
-			// done reading in packet
-			ProcessPacket(connection, connection.InboundPacket);
-			if (connection.Socket == nullptr) {
-				return false;
-			}
-			break;
-		case NETWORK_READPACKET_MORE_DATA:
-			// more data required to be read
-			break;
-		case NETWORK_READPACKET_NO_DATA:
-			// could not read anything from socket
-			break;
 		}
-	} while (packetStatus == NETWORK_READPACKET_MORE_DATA || packetStatus == NETWORK_READPACKET_SUCCESS);
-	connection.SendQueuedPackets();
+	}
+	if (disconnected) {
+		// closed connection or network error
+		if (!connection.GetLastDisconnectReason()) {
+			connection.SetLastDisconnectReason(STR_MULTIPLAYER_CONNECTION_CLOSED);
+		}
+		return false;
+	}
 	if (!connection.ReceivedPacketRecently()) {
 		if (!connection.GetLastDisconnectReason()) {
 			connection.SetLastDisconnectReason(STR_MULTIPLAYER_NO_DATA);
@@ -1275,9 +1609,10 @@ void Network::ProcessPacket(NetworkConnection& connection, NetworkPacket& packet
 
 void Network::ProcessGameCommandQueue()
 {
-	while (game_command_queue.begin() != game_command_queue.end() && game_command_queue.begin()->tick == gCurrentTicks) {
+	while (!game_command_queue.empty() && game_command_queue.front().tick == gCurrentTicks) {
 		// run all the game commands at the current tick
-		const GameCommand& gc = (*game_command_queue.begin());
+		GameCommand gc = game_command_queue.front();
+		game_command_queue.pop_front();
 		if (GetPlayerID() == gc.playerid) {
 			game_command_callback = game_command_callback_get_callback(gc.callback);
 		}
@@ -1292,14 +1627,543 @@ void Network::ProcessGameCommandQueue()
 				player->AddMoneySpent(cost);
 			}
 		}
-		game_command_queue.erase(game_command_queue.begin());
 	}
 }
 
+void Network::StartNetworkThread()
+{
+	if (_ioThread != nullptr) {
+		return;
+	}
+	_ioMutex = SDL_CreateMutex();
+	_ioPoller = CreateTcpSocketPoller();
+	SDL_AtomicSet(&_ioStop, 0);
+	_ioThread = SDL_CreateThread(NetworkThread, "Network", this);
+}
+
+void Network::StopNetworkThread()
+{
+	if (_ioThread != nullptr) {
+		SDL_AtomicSet(&_ioStop, 1);
+		_ioPoller->Wake();
+		SDL_WaitThread(_ioThread, nullptr);
+		_ioThread = nullptr;
+	}
+	delete _ioPoller;
+	_ioPoller = nullptr;
+	if (_ioMutex != nullptr) {
+		SDL_DestroyMutex(_ioMutex);
+		_ioMutex = nullptr;
+	}
+	_ioConnections.clear();
+	_ioRequests.clear();
+}
+
+void Network::AddNetworkConnection(NetworkConnection* connection)
+{
+	StartNetworkThread();
+	SDL_LockMutex(_ioMutex);
+	_ioConnections.insert(connection);
+	_ioPoller->Add(connection->Socket, connection);
+	SDL_UnlockMutex(_ioMutex);
+	_ioPoller->Wake();
+}
+
+void Network::RemoveNetworkConnection(NetworkConnection* connection)
+{
+	if (_ioMutex == nullptr) {
+		return;
+	}
+	SDL_LockMutex(_ioMutex);
+	_ioConnections.erase(connection);
+	_ioRequests.erase(std::remove(_ioRequests.begin(), _ioRequests.end(), connection), _ioRequests.end());
+	_ioPoller->Remove(connection->Socket);
+	SDL_UnlockMutex(_ioMutex);
+}
+
+void Network::ServiceNetworkConnection(NetworkConnection* connection)
+{
+	connection->Service();
+	if (connection->IsDisconnected()) {
+		// A closed socket stays readable, stop waiting on it until the game thread removes it
+		_ioPoller->Remove(connection->Socket);
+	} else {
+		_ioPoller->SetWriteInterest(connection->Socket, connection->HasPendingSends());
+	}
+}
+
+/**
+ * Hands the connections that packets were queued on to the network thread and wakes it, the
+ * thread is left asleep if there is nothing to send.
+ */
+void Network::PostNetworkRequests()
+{
+	if (_ioMutex == nullptr) {
+		return;
+	}
+
+	bool posted = false;
+	SDL_LockMutex(_ioMutex);
+	for (NetworkConnection* connection : _ioConnections) {
+		if (connection->TakeNewRequests()) {
+			_ioRequests.push_back(connection);
+			posted = true;
+		}
+	}
+	SDL_UnlockMutex(_ioMutex);
+	if (posted) {
+		_ioPoller->Wake();
+	}
+}
+
+/**
+ * Reads and writes the sockets of all connections so that packets keep flowing while the game
+ * thread is busy. Packets are only processed on the game thread. The thread sleeps until a
+ * socket is ready or the game thread posts connections with packets to send, so idle
+ * connections are not probed.
+ */
+int Network::NetworkThread(void* arg)
+{
+	Network* network = (Network*)arg;
+	void* readyTags[NETWORK_IO_MAX_EVENTS];
+	std::vector<NetworkConnection*> requests;
+	while (SDL_AtomicGet(&network->_ioStop) == 0) {
+		size_t numReady = network->_ioPoller->Wait(readyTags, Util::CountOf(readyTags), NETWORK_IO_WAIT_TIMEOUT);
+
+		SDL_LockMutex(network->_ioMutex);
+		for (size_t i = 0; i < numReady; i++) {
+			// The connection may have been removed while waiting
+			NetworkConnection* connection = (NetworkConnection*)readyTags[i];
+			if (network->_ioConnections.find(connection) != network->_ioConnections.end()) {
+				network->ServiceNetworkConnection(connection);
+			}
+		}
+		requests.swap(network->_ioRequests);
+		for (NetworkConnection* connection : requests) {
+			network->ServiceNetworkConnection(connection);
+			// A disconnect waits for the queued packets to be sent, check it again on the next wake
+			if (connection->HasRequests()) {
+				network->_ioRequests.push_back(connection);
+			}
+		}
+		requests.clear();
+		SDL_UnlockMutex(network->_ioMutex);
+	}
+	return 0;
+}
+
+#pragma region Statistics
+
+/**
+ * Sums the traffic of all connections including those already closed, or returns the traffic of
+ * a single connection.
+ */
+NetworkConnectionStats Network::GetConnectionStats(const NetworkConnection* connection)
+{
+	NetworkConnectionStats stats;
+	if (_ioMutex != nullptr) {
+		SDL_LockMutex(_ioMutex);
+	}
+	if (connection != nullptr) {
+		stats = connection->GetStats();
+	} else {
+		stats = _closedConnectionStats;
+		if (mode == NETWORK_MODE_CLIENT) {
+			stats.Add(server_connection.GetStats());
+		}
+		for (auto& clientConnection : client_connection_list) {
+			stats.Add(clientConnection->GetStats());
+		}
+	}
+	if (_ioMutex != nullptr) {
+		SDL_UnlockMutex(_ioMutex);
+	}
+	return stats;
+}
+
+void Network::GetStats(network_stats_summary* summary)
+{
+	NetworkConnectionStats stats = GetConnectionStats();
+	NetworkCommandStats total = stats.GetTotal();
+
+	// Timings only cover the last minute at most so that they reflect the current conditions
+	uint32 now = SDL_GetTicks();
+	NetworkHistogram queueTime = stats.QueueTime.GetRecent(now);
+	NetworkHistogram pingTimes = _pingTimes.GetRecent(now);
+	NetworkHistogram commandLatencies = _commandLatencies.GetRecent(now);
+
+	*summary = { 0 };
+	summary->bytes_in = total.BytesIn;
+	summary->bytes_out = total.BytesOut;
+	summary->packets_in = total.PacketsIn;
+	summary->packets_out = total.PacketsOut;
+	summary->bytes_in_per_second = _bytesInPerSecond;
+	summary->bytes_out_per_second = _bytesOutPerSecond;
+	summary->queue_depth = stats.QueueDepth;
+	summary->max_queue_depth = stats.MaxQueueDepth;
+	summary->queue_time_p50 = queueTime.GetPercentile(50);
+	summary->queue_time_p99 = queueTime.GetPercentile(99);
+	summary->queue_time_max = queueTime.Max;
+	summary->map_sends = stats.MapSendTime.Count;
+	summary->map_send_time_mean = stats.MapSendTime.GetMean();
+	summary->map_send_time_max = stats.MapSendTime.Max;
+	summary->ping_samples = pingTimes.Count;
+	summary->ping_p50 = pingTimes.GetPercentile(50);
+	summary->ping_p99 = pingTimes.GetPercentile(99);
+	summary->ping_max = pingTimes.Max;
+	summary->command_latency_samples = commandLatencies.Count;
+	summary->command_latency_p50 = commandLatencies.GetPercentile(50);
+	summary->command_latency_p99 = commandLatencies.GetPercentile(99);
+	summary->command_latency_max = commandLatencies.Max;
+
+	summary->num_commands = (uint32)Util::CountOf(stats.Commands);
+	for (uint32 i = 0; i < summary->num_commands; i++) {
+		network_command_stats* command = &summary->commands[i];
+		command->name = NetworkGetCommandName(i);
+		command->packets_in = stats.Commands[i].PacketsIn;
+		command->packets_out = stats.Commands[i].PacketsOut;
+		command->bytes_in = stats.Commands[i].BytesIn;
+		command->bytes_out = stats.Commands[i].BytesOut;
+	}
+}
+
+// Updates the transfer rates once a second
+void Network::UpdateStats()
+{
+	uint32 now = SDL_GetTicks();
+	if (_statsRateTime != 0 && !SDL_TICKS_PASSED(now, _statsRateTime + 1000)) {
+		return;
+	}
+
+	NetworkCommandStats total = GetConnectionStats().GetTotal();
+	if (_statsRateTime != 0) {
+		uint32 elapsed = Math::Max<uint32>(1, now - _statsRateTime);
+		_bytesInPerSecond = (uint32)((total.BytesIn - _statsRateTotal.BytesIn) * 1000 / elapsed);
+		_bytesOutPerSecond = (uint32)((total.BytesOut - _statsRateTotal.BytesOut) * 1000 / elapsed);
+	}
+	_statsRateTotal = total;
+	_statsRateTime = now;
+}
+
+static json_t* network_command_stats_to_json(const NetworkCommandStats& stats)
+{
+	json_t* obj = json_object();
+	json_object_set_new(obj, "packets_in", json_integer(stats.PacketsIn));
+	json_object_set_new(obj, "packets_out", json_integer(stats.PacketsOut));
+	json_object_set_new(obj, "bytes_in", json_integer(stats.BytesIn));
+	json_object_set_new(obj, "bytes_out", json_integer(stats.BytesOut));
+	return obj;
+}
+
+static json_t* network_histogram_to_json(const NetworkHistogram& histogram)
+{
+	json_t* obj = json_object();
+	json_object_set_new(obj, "count", json_integer(histogram.Count));
+	json_object_set_new(obj, "mean", json_integer(histogram.GetMean()));
+	json_object_set_new(obj, "p50", json_integer(histogram.GetPercentile(50)));
+	json_object_set_new(obj, "p99", json_integer(histogram.GetPercentile(99)));
+	json_object_set_new(obj, "max", json_integer(histogram.Max));
+	json_t* buckets = json_array();
+	for (size_t i = 0; i < NetworkHistogram::NumBuckets; i++) {
+		json_array_append_new(buckets, json_integer(histogram.Buckets[i]));
+	}
+	json_object_set_new(obj, "buckets", buckets);
+	return obj;
+}
+
+/**
+ * Dedicated servers have no window to show the statistics in, they are written to
+ * network_stats.json in the user directory instead.
+ */
+void Network::WriteStatsFile()
+{
+	utf8 path[MAX_PATH];
+	platform_get_user_directory(path, NULL);
+	strcat(path, "network_stats.json");
+
+	NetworkConnectionStats stats = GetConnectionStats();
+	uint32 now = SDL_GetTicks();
+
+	json_t* jsonStats = json_object();
+	json_object_set_new(jsonStats, "tick", json_integer(gCurrentTicks));
+	json_object_set_new(jsonStats, "total", network_command_stats_to_json(stats.GetTotal()));
+	json_object_set_new(jsonStats, "bytes_in_per_second", json_integer(_bytesInPerSecond));
+	json_object_set_new(jsonStats, "bytes_out_per_second", json_integer(_bytesOutPerSecond));
+	json_object_set_new(jsonStats, "queue_depth", json_integer(stats.QueueDepth));
+	json_object_set_new(jsonStats, "max_queue_depth", json_integer(stats.MaxQueueDepth));
+	json_object_set_new(jsonStats, "queue_time", network_histogram_to_json(stats.QueueTime.GetRecent(now)));
+	json_object_set_new(jsonStats, "queue_time_session", network_histogram_to_json(stats.QueueTime.GetTotal()));
+	json_object_set_new(jsonStats, "map_send_time", network_histogram_to_json(stats.MapSendTime));
+	json_object_set_new(jsonStats, "ping", network_histogram_to_json(_pingTimes.GetRecent(now)));
+	json_object_set_new(jsonStats, "ping_session", network_histogram_to_json(_pingTimes.GetTotal()));
+
+	json_t* jsonCommands = json_object();
+	for (uint32 i = 0; i < Util::CountOf(stats.Commands); i++) {
+		json_object_set_new(jsonCommands, NetworkGetCommandName(i), network_command_stats_to_json(stats.Commands[i]));
+	}
+	json_object_set_new(jsonStats, "commands", jsonCommands);
+
+	json_t* jsonPlayers = json_array();
+	for (auto& connection : client_connection_list) {
+		if (connection->Player == nullptr) {
+			continue;
+		}
+		NetworkConnectionStats playerStats = GetConnectionStats(connection.get());
+		NetworkCommandStats playerTotal = playerStats.GetTotal();
+		json_t* jsonPlayer = json_object();
+		json_object_set_new(jsonPlayer, "name", json_string(connection->Player->name.c_str()));
+		json_object_set_new(jsonPlayer, "ping", json_integer(connection->Player->ping));
+		json_object_set_new(jsonPlayer, "bytes_in", json_integer(playerTotal.BytesIn));
+		json_object_set_new(jsonPlayer, "bytes_out", json_integer(playerTotal.BytesOut));
+		json_object_set_new(jsonPlayer, "queue_depth", json_integer(playerStats.QueueDepth));
+		json_object_set_new(jsonPlayer, "max_queue_depth", json_integer(playerStats.MaxQueueDepth));
+		json_object_set_new(jsonPlayer, "queue_time", network_histogram_to_json(playerStats.QueueTime.GetRecent(now)));
+		json_array_append_new(jsonPlayers, jsonPlayer);
+	}
+	json_object_set_new(jsonStats, "players", jsonPlayers);
+
+	try
+	{
+		Json::WriteToFile(path, jsonStats, JSON_INDENT(4) | JSON_PRESERVE_ORDER);
+	}
+	catch (const Exception& ex)
+	{
+		log_error("Unable to save %s: %s", path, ex.GetMessage());
+	}
+	json_decref(jsonStats);
+}
+
+#pragma endregion
+
+#pragma region Desync debugging
+
+// Shown in the in-game console and on standard output for dedicated servers
+static void network_desync_message(const char* format, ...)
+{
+	char buffer[256];
+	va_list args;
+	va_start(args, format);
+	vsnprintf(buffer, sizeof(buffer), format, args);
+	va_end(args);
+	Console::WriteLine("%s", buffer);
+	console_writeline(buffer);
+}
+
+void Network::RecordState()
+{
+	if (gConfigNetwork.desync_debugging && GetMode() != NETWORK_MODE_NONE) {
+		_stateHistory.Record(gCurrentTicks);
+	}
+}
+
+/**
+ * Asks the server for its state hashes of the ticks the client still has, so the first tick
+ * and components that differ can be found.
+ */
+void Network::RequestStateCheck()
+{
+	if (GetMode() != NETWORK_MODE_CLIENT) {
+		return;
+	}
+	if (_stateCheckPending && !SDL_TICKS_PASSED(SDL_GetTicks(), _stateCheckTime + NETWORK_STATE_REQUEST_TIMEOUT)) {
+		return;
+	}
+	if (_stateHistory.IsEmpty()) {
+		network_desync_message("No state hashes have been recorded, enable desync_debugging on the server and the client.");
+		return;
+	}
+	_stateCheckPending = true;
+	_stateCheckTime = SDL_GetTicks();
+	Client_Send_STATEHASH(_stateHistory.GetOldestTick(), _stateHistory.GetNewestTick());
+}
+
+void Network::WriteStateDumps(const char* side, const std::vector<uint32>& components)
+{
+	for (uint32 component : components) {
+		utf8 path[MAX_PATH];
+		if (NetworkStateWriteDump(component, side, path, sizeof(path))) {
+			network_desync_message("Wrote desync dump %s", path);
+		} else {
+			network_desync_message("Unable to write desync dump of %s", NetworkStateGetComponentName(component).c_str());
+		}
+	}
+}
+
+void Network::Client_Send_STATEHASH(uint32 firstTick, uint32 lastTick)
+{
+	std::unique_ptr<NetworkPacket> packet = std::move(NetworkPacket::Allocate());
+	*packet << (uint32)NETWORK_COMMAND_STATEHASH << firstTick << lastTick;
+	server_connection.QueuePacket(std::move(packet));
+}
+
+void Network::Server_Send_STATEHASH(NetworkConnection& connection, uint32 firstTick, uint32 lastTick)
+{
+	// The range comes from the client, so only look at the ticks that are in the history
+	std::vector<const NetworkStateHashes*> entries;
+	for (size_t i = 0; i < _stateHistory.GetCount(); i++) {
+		const NetworkStateHashes* hashes = _stateHistory.GetEntry(i);
+		if (hashes->Tick >= firstTick && hashes->Tick <= lastTick) {
+			entries.push_back(hashes);
+		}
+	}
+
+	// Always send at least one packet so the client knows the check has finished
+	size_t i = 0;
+	do {
+		size_t count = (std::min)(entries.size() - i, NETWORK_STATEHASH_TICKS_PER_PACKET);
+		bool last = i + count == entries.size();
+		std::unique_ptr<NetworkPacket> packet = std::move(NetworkPacket::Allocate());
+		*packet << (uint32)NETWORK_COMMAND_STATEHASH << (uint8)last << (uint32)count;
+		for (size_t j = 0; j < count; j++, i++) {
+			const NetworkStateHashes* hashes = entries[i];
+			*packet << hashes->Tick;
+			for (uint64 hash : hashes->Hashes) {
+				*packet << (uint32)(hash >> 32) << (uint32)hash;
+			}
+		}
+		connection.QueuePacket(std::move(packet));
+	} while (i < entries.size());
+}
+
+void Network::Client_Send_STATEDUMP(const std::vector<uint32>& components)
+{
+	std::unique_ptr<NetworkPacket> packet = std::move(NetworkPacket::Allocate());
+	*packet << (uint32)NETWORK_COMMAND_STATEDUMP << (uint32)components.size();
+	for (uint32 component : components) {
+		*packet << component;
+	}
+	server_connection.QueuePacket(std::move(packet));
+}
+
+void Network::Server_Send_STATEDUMP(NetworkConnection& connection, uint32 tick, const std::vector<uint32>& components)
+{
+	std::unique_ptr<NetworkPacket> packet = std::move(NetworkPacket::Allocate());
+	*packet << (uint32)NETWORK_COMMAND_STATEDUMP << tick << (uint32)components.size();
+	for (uint32 component : components) {
+		*packet << component;
+	}
+	connection.QueuePacket(std::move(packet));
+}
+
+// Computing hashes and writing dumps is only done for servers that have enabled it, and only
+// once in a while for each client
+static bool network_allow_state_request(uint32* lastRequestTime)
+{
+	if (!gConfigNetwork.desync_debugging) {
+		return false;
+	}
+	uint32 now = SDL_GetTicks();
+	if (*lastRequestTime != 0 && !SDL_TICKS_PASSED(now, *lastRequestTime + NETWORK_STATE_REQUEST_INTERVAL)) {
+		return false;
+	}
+	*lastRequestTime = now;
+	return true;
+}
+
+void Network::Server_Handle_STATEHASH(NetworkConnection& connection, NetworkPacket& packet)
+{
+	if (!network_allow_state_request(&connection.StateHashTime)) {
+		return;
+	}
+
+	uint32 firstTick, lastTick;
+	packet >> firstTick >> lastTick;
+	Server_Send_STATEHASH(connection, firstTick, lastTick);
+}
+
+void Network::Client_Handle_STATEHASH(NetworkConnection& connection, NetworkPacket& packet)
+{
+	if (!_stateCheckPending) {
+		return;
+	}
+
+	uint8 last;
+	uint32 count;
+	packet >> last >> count;
+	for (uint32 i = 0; i < count && _stateCheckPending; i++) {
+		NetworkStateHashes remote;
+		packet >> remote.Tick;
+		for (uint64 &hash : remote.Hashes) {
+			uint32 high, low;
+			packet >> high >> low;
+			hash = ((uint64)high << 32) | low;
+		}
+
+		// The ticks are in order, so the first difference is where the game diverged
+		const NetworkStateHashes* local = _stateHistory.Get(remote.Tick);
+		if (local == nullptr) {
+			continue;
+		}
+		std::vector<uint32> components;
+		std::string names;
+		for (uint32 component = 0; component < NETWORK_STATE_COMPONENT_COUNT; component++) {
+			if (local->Hashes[component] != remote.Hashes[component]) {
+				if (components.size() < NETWORK_STATE_MAX_DUMPS) {
+					components.push_back(component);
+				}
+				names += " " + NetworkStateGetComponentName(component);
+			}
+		}
+		if (!components.empty()) {
+			_stateCheckPending = false;
+			network_desync_message("Desync first found at tick %u in:%s", remote.Tick, names.c_str());
+			if (remote.Tick == _stateHistory.GetOldestTick()) {
+				network_desync_message("The game may have diverged before tick %u, the oldest recorded tick.", remote.Tick);
+			}
+			Client_Send_STATEDUMP(components);
+		}
+	}
+
+	if (last && _stateCheckPending) {
+		_stateCheckPending = false;
+		network_desync_message("No difference found between ticks %u and %u.", _stateHistory.GetOldestTick(), _stateHistory.GetNewestTick());
+	}
+}
+
+void Network::Server_Handle_STATEDUMP(NetworkConnection& connection, NetworkPacket& packet)
+{
+	if (!network_allow_state_request(&connection.StateDumpTime)) {
+		return;
+	}
+
+	uint32 count;
+	packet >> count;
+	std::vector<uint32> components;
+	for (uint32 i = 0; i < count && i < NETWORK_STATE_MAX_DUMPS; i++) {
+		uint32 component;
+		packet >> component;
+		if (component < NETWORK_STATE_COMPONENT_COUNT) {
+			components.push_back(component);
+		}
+	}
+
+	// The client is behind, it writes its own dumps once it reaches this tick
+	WriteStateDumps("server", components);
+	Server_Send_STATEDUMP(connection, gCurrentTicks, components);
+}
+
+void Network::Client_Handle_STATEDUMP(NetworkConnection& connection, NetworkPacket& packet)
+{
+	uint32 count;
+	packet >> _stateDumpTick >> count;
+	_stateDumpComponents.clear();
+	for (uint32 i = 0; i < count && i < NETWORK_STATE_MAX_DUMPS; i++) {
+		uint32 component;
+		packet >> component;
+		if (component < NETWORK_STATE_COMPONENT_COUNT) {
+			_stateDumpComponents.push_back(component);
+		}
+	}
+	_stateDumpPending = true;
+}
+
+#pragma endregion
+
 void Network::AddClient(ITcpSocket * socket)
 {
 	auto connection = std::unique_ptr<NetworkConnection>(new NetworkConnection);  // change to make_unique in c++14
 	connection->Socket = socket;
+	AddNetworkConnection(connection.get());
 	client_connection_list.push_back(std::move(connection));
 }
 
@@ -1324,6 +2188,10 @@ void Network::RemoveClient(std::unique_ptr<NetworkConnection>& connection)
 	player_list.erase(std::remove_if(player_list.begin(), player_list.end(), [connection_player](std::unique_ptr<NetworkPlayer>& player){
 						  return player.get() == connection_player;
 					  }), player_list.end());
+	RemoveNetworkConnection(connection.get());
+	NetworkConnectionStats stats = connection->GetStats();
+	stats.QueueDepth = 0;
+	_closedConnectionStats.Add(stats);
 	client_connection_list.remove(connection);
 	Server_Send_PLAYERLIST();
 }
@@ -1427,7 +2295,7 @@ void Network::Client_Handle_TOKEN(NetworkConnection& connection, NetworkPacket&
 	if (!ok) {
 		log_error("Failed to load key %s", keyPath);
 		connection.SetLastDisconnectReason(STR_MULTIPLAYER_VERIFICATION_FAILURE);
-		connection.Socket->Disconnect();
+		connection.Disconnect();
 		return;
 	}
 	uint32 challenge_size;
@@ -1442,7 +2310,7 @@ void Network::Client_Handle_TOKEN(NetworkConnection& connection, NetworkPacket&
 	if (!ok) {
 		log_error("Failed to sign server's challenge.");
 		connection.SetLastDisconnectReason(STR_MULTIPLAYER_VERIFICATION_FAILURE);
-		connection.Socket->Disconnect();
+		connection.Disconnect();
 		return;
 	}
 	// Don't keep private key in memory. There's no need and it may get leaked
@@ -1463,37 +2331,37 @@ void Network::Client_Handle_AUTH(NetworkConnection& connection, NetworkPacket& p
 		break;
 	case NETWORK_AUTH_BADNAME:
 		connection.SetLastDisconnectReason(STR_MULTIPLAYER_BAD_PLAYER_NAME);
-		connection.Socket->Disconnect();
+		connection.Disconnect();
 		break;
 	case NETWORK_AUTH_BADVERSION:
 	{
 		const char *version = packet.ReadString();
 		connection.SetLastDisconnectReason(STR_MULTIPLAYER_INCORRECT_SOFTWARE_VERSION, &version);
-		connection.Socket->Disconnect();
+		connection.Disconnect();
 		break;
 	}
 	case NETWORK_AUTH_BADPASSWORD:
 		connection.SetLastDisconnectReason(STR_MULTIPLAYER_BAD_PASSWORD);
-		connection.Socket->Disconnect();
+		connection.Disconnect();
 		break;
 	case NETWORK_AUTH_VERIFICATIONFAILURE:
 		connection.SetLastDisconnectReason(STR_MULTIPLAYER_VERIFICATION_FAILURE);
-		connection.Socket->Disconnect();
+		connection.Disconnect();
 		break;
 	case NETWORK_AUTH_FULL:
 		connection.SetLastDisconnectReason(STR_MULTIPLAYER_SERVER_FULL);
-		connection.Socket->Disconnect();
+		connection.Disconnect();
 		break;
 	case NETWORK_AUTH_REQUIREPASSWORD:
 		window_network_status_open_password();
 		break;
 	case NETWORK_AUTH_UNKNOWN_KEY_DISALLOWED:
 		connection.SetLastDisconnectReason(STR_MULTIPLAYER_UNKNOWN_KEY_DISALLOWED);
-		connection.Socket->Disconnect();
+		connection.Disconnect();
 		break;
 	default:
 		connection.SetLastDisconnectReason(STR_MULTIPLAYER_INCORRECT_SOFTWARE_VERSION);
-		connection.Socket->Disconnect();
+		connection.Disconnect();
 		break;
 	}
 }
@@ -1641,6 +2509,7 @@ void Network::Client_Handle_MAP(NetworkConnection& connection, NetworkPacket& pa
 		if (game_load_network(rw)) {
 			game_load_init();
 			game_command_queue.clear();
+			_stateHistory.Clear();
 			server_tick = gCurrentTicks;
 			server_srand0_tick = 0;
 			// window_network_status_open("Loaded new map from network");
@@ -1686,16 +2555,38 @@ void Network::Server_Handle_CHAT(NetworkConnection& connection, NetworkPacket& p
 	}
 }
 
-void Network::Client_Handle_GAMECMD(NetworkConnection& connection, NetworkPacket& packet)
+void Network::Client_Handle_GAMECMDS(NetworkConnection& connection, NetworkPacket& packet)
 {
+	// The server sends the commands in the order it ran them, so they are queued as they are
 	uint32 tick;
-	uint32 args[7];
-	uint8 playerid;
-	uint8 callback;
-	packet >> tick >> args[0] >> args[1] >> args[2] >> args[3] >> args[4] >> args[5] >> args[6] >> playerid >> callback;
+	packet >> tick;
+	while (packet.read < packet.size) {
+		uint32 args[7] = { 0 };
+		uint8 playerid;
+		uint8 callback;
+		uint8 mask;
+		tick += packet.ReadVarInt();
+		packet >> playerid >> callback >> mask;
+		for (int j = 0; j < 7; j++) {
+			if (mask & (1 << j)) {
+				args[j] = packet.ReadVarInt();
+			}
+		}
+		args[1] |= GAME_COMMAND_FLAG_NETWORKED;
+		game_command_queue.push_back(GameCommand(tick, args, playerid, callback));
 
-	GameCommand gc = GameCommand(tick, args, playerid, callback);
-	game_command_queue.insert(gc);
+		if (playerid == player_id) {
+			// The commands sent before the matching one were rejected by the server
+			auto it = std::find_if(_sentGameCommands.begin(), _sentGameCommands.end(), [&args](const SentGameCommand& sent) {
+				return std::equal(std::begin(args), std::end(args), std::begin(sent.args));
+			});
+			if (it != _sentGameCommands.end()) {
+				uint32 now = SDL_GetTicks();
+				_commandLatencies.Add(now - it->time, now);
+				_sentGameCommands.erase(_sentGameCommands.begin(), std::next(it));
+			}
+		}
+	}
 }
 
 void Network::Server_Handle_GAMECMD(NetworkConnection& connection, NetworkPacket& packet)
@@ -1819,6 +2710,7 @@ void Network::Server_Handle_PING(NetworkConnection& connection, NetworkPacket& p
 	if (ping < 0) {
 		ping = 0;
 	}
+	_pingTimes.Add(ping, SDL_GetTicks());
 	if (connection.Player) {
 		connection.Player->ping = ping;
 		window_invalidate_by_number(WC_PLAYER, connection.Player->id);
@@ -1972,9 +2864,9 @@ int network_begin_client(const char *host, int port)
 	return gNetwork.BeginClient(host, port);
 }
 
-int network_begin_server(int port)
+int network_begin_server(int port, const char* address)
 {
-	return gNetwork.BeginServer(port);
+	return gNetwork.BeginServer(port, address);
 }
 
 void network_update()
@@ -1982,6 +2874,21 @@ void network_update()
 	gNetwork.Update();
 }
 
+void network_record_state()
+{
+	gNetwork.RecordState();
+}
+
+void network_check_state()
+{
+	gNetwork.RequestStateCheck();
+}
+
+void network_get_stats(network_stats_summary *summary)
+{
+	gNetwork.GetStats(summary);
+}
+
 int network_get_mode()
 {
 	return gNetwork.GetMode();
@@ -2321,6 +3228,11 @@ uint8 network_get_default_group()
 	return gNetwork.GetDefaultGroup();
 }
 
+void network_set_default_group(uint8 id)
+{
+	gNetwork.SetDefaultGroup(id);
+}
+
 int network_get_num_actions()
 {
 	return NetworkActions::Actions.size();
@@ -2453,8 +3365,10 @@ uint32 network_get_server_tick() { return gCurrentTicks; }
 void network_send_gamecmd(uint32 eax, uint32 ebx, uint32 ecx, uint32 edx, uint32 esi, uint32 edi, uint32 ebp, uint8 callback) {}
 void network_send_map() {}
 void network_update() {}
+void network_record_state() {}
+void network_check_state() {}
 int network_begin_client(const char *host, int port) { return 1; }
-int network_begin_server(int port) { return 1; }
+int network_begin_server(int port, const char* address) { return 1; }
 int network_get_num_players() { return 1; }
 const char* network_get_player_name(unsigned int index) { return "local (OpenRCT2 compiled without MP)"; }
 uint32 network_get_player_flags(unsigned int index) { return 0; }
@@ -2478,6 +3392,7 @@ void game_command_set_player_group(int* eax, int* ebx, int* ecx, int* edx, int*
 void game_command_modify_groups(int* eax, int* ebx, int* ecx, int* edx, int* esi, int* edi, int* ebp) { }
 void game_command_kick_player(int* eax, int* ebx, int* ecx, int* edx, int* esi, int* edi, int* ebp) { }
 uint8 network_get_default_group() { return 0; }
+void network_set_default_group(uint8 id) { }
 int network_get_num_actions() { return 0; }
 rct_string_id network_get_action_name_string_id(unsigned int index) { return -1; }
 int network_can_perform_action(unsigned int groupindex, unsigned int index) { return 0; }
@@ -2495,4 +3410,5 @@ const utf8 * network_get_server_description() { return nullptr; }
 const utf8 * network_get_server_provider_name() { return nullptr; }
 const utf8 * network_get_server_provider_email() { return nullptr; }
 const utf8 * network_get_server_provider_website() { return nullptr; }
+void network_get_stats(network_stats_summary *summary) { *summary = { 0 }; }
 #endif /* DISABLE_NETWORK */
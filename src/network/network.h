@@ -50,21 +50,61 @@ extern "C" {
 
 #include "NetworkTypes.h"
 
+#define NETWORK_STATS_MAX_COMMANDS 32
+
+typedef struct network_command_stats {
+	const utf8 *name;
+	uint32 packets_in;
+	uint32 packets_out;
+	uint64 bytes_in;
+	uint64 bytes_out;
+} network_command_stats;
+
+// Times are in milliseconds, percentiles are rounded up to a power of two
+typedef struct network_stats_summary {
+	uint64 bytes_in;
+	uint64 bytes_out;
+	uint32 packets_in;
+	uint32 packets_out;
+	uint32 bytes_in_per_second;
+	uint32 bytes_out_per_second;
+	uint32 queue_depth;
+	uint32 max_queue_depth;
+	uint32 queue_time_p50;
+	uint32 queue_time_p99;
+	uint32 queue_time_max;
+	uint32 map_sends;
+	uint32 map_send_time_mean;
+	uint32 map_send_time_max;
+	uint32 ping_samples;
+	uint32 ping_p50;
+	uint32 ping_p99;
+	uint32 ping_max;
+	uint32 command_latency_samples;
+	uint32 command_latency_p50;
+	uint32 command_latency_p99;
+	uint32 command_latency_max;
+	uint32 num_commands;
+	network_command_stats commands[NETWORK_STATS_MAX_COMMANDS];
+} network_stats_summary;
+
 #ifndef DISABLE_NETWORK
 
 // This define specifies which version of network stream current build uses.
 // It is used for making sure only compatible builds get connected, even within
 // single OpenRCT2 version.
-#define NETWORK_STREAM_VERSION "11"
+#define NETWORK_STREAM_VERSION "13"
 #define NETWORK_STREAM_ID OPENRCT2_VERSION "-" NETWORK_STREAM_VERSION
 
 #ifdef __cplusplus
 
 #include <array>
+#include <deque>
 #include <list>
 #include <set>
 #include <memory>
 #include <string>
+#include <unordered_set>
 #include <vector>
 #include <map>
 #include <SDL.h>
@@ -75,6 +115,8 @@ extern "C" {
 #include "NetworkKey.h"
 #include "NetworkPacket.h"
 #include "NetworkPlayer.h"
+#include "NetworkStateHash.h"
+#include "NetworkStats.h"
 #include "NetworkUser.h"
 #include "TcpSocket.h"
 
@@ -96,7 +138,11 @@ public:
 	int GetAuthStatus();
 	uint32 GetServerTick();
 	uint8 GetPlayerID();
+	void RecordState();
+	void RequestStateCheck();
 	void Update();
+	NetworkConnectionStats GetConnectionStats(const NetworkConnection* connection = nullptr);
+	void GetStats(network_stats_summary* summary);
 	std::vector<std::unique_ptr<NetworkPlayer>>::iterator GetPlayerIteratorByID(uint8 id);
 	NetworkPlayer* GetPlayerByID(uint8 id);
 	std::vector<std::unique_ptr<NetworkGroup>>::iterator GetGroupIteratorByID(uint8 id);
@@ -131,6 +177,7 @@ public:
 	void Server_Send_CHAT(const char* text);
 	void Client_Send_GAMECMD(uint32 eax, uint32 ebx, uint32 ecx, uint32 edx, uint32 esi, uint32 edi, uint32 ebp, uint8 callback);
 	void Server_Send_GAMECMD(uint32 eax, uint32 ebx, uint32 ecx, uint32 edx, uint32 esi, uint32 edi, uint32 ebp, uint8 playerid, uint8 callback);
+	void Server_Send_GAMECMDS();
 	void Server_Send_TICK();
 	void Server_Send_PLAYERLIST();
 	void Client_Send_PING();
@@ -143,6 +190,10 @@ public:
 	void Server_Send_EVENT_PLAYER_JOINED(const char *playerName);
 	void Server_Send_EVENT_PLAYER_DISCONNECTED(const char *playerName, const char *reason);
 	void Client_Send_GAMEINFO();
+	void Client_Send_STATEHASH(uint32 firstTick, uint32 lastTick);
+	void Server_Send_STATEHASH(NetworkConnection& connection, uint32 firstTick, uint32 lastTick);
+	void Client_Send_STATEDUMP(const std::vector<uint32>& components);
+	void Server_Send_STATEDUMP(NetworkConnection& connection, uint32 tick, const std::vector<uint32>& components);
 
 	std::vector<std::unique_ptr<NetworkPlayer>> player_list;
 	std::vector<std::unique_ptr<NetworkGroup>> group_list;
@@ -168,6 +219,18 @@ private:
 	const char* GetMasterServerUrl();
 	std::string GenerateAdvertiseKey();
 	void SetupDefaultGroups();
+	bool BuildMapSnapshot();
+	void InvalidateMapSnapshot();
+	void WriteStateDumps(const char* side, const std::vector<uint32>& components);
+	void StartNetworkThread();
+	void StopNetworkThread();
+	void AddNetworkConnection(NetworkConnection* connection);
+	void RemoveNetworkConnection(NetworkConnection* connection);
+	void ServiceNetworkConnection(NetworkConnection* connection);
+	void PostNetworkRequests();
+	void UpdateStats();
+	void WriteStatsFile();
+	static int NetworkThread(void* arg);
 
 	struct GameCommand
 	{
@@ -184,6 +247,8 @@ private:
 		}
 	};
 
+	void Server_Send_GAMECMDS(const std::vector<GameCommand>& commands, NetworkConnection* connection = nullptr);
+
 	int mode = NETWORK_MODE_NONE;
 	int status = NETWORK_STATUS_NONE;
 	bool wsa_initialized = false;
@@ -199,7 +264,8 @@ private:
 	char server_sprite_hash[EVP_MAX_MD_SIZE + 1];
 	uint8 player_id = 0;
 	std::list<std::unique_ptr<NetworkConnection>> client_connection_list;
-	std::multiset<GameCommand> game_command_queue;
+	std::deque<GameCommand> game_command_queue;
+	std::vector<GameCommand> _pendingGameCommands;
 	std::vector<uint8> chunk_buffer;
 	std::string password;
 	bool _desynchronised = false;
@@ -213,6 +279,46 @@ private:
 	SDL_RWops *_chatLogStream;
 	std::string _chatLogPath;
 
+	// A compressed map taken at a known tick and the commands broadcast since, clients joining
+	// are sent both and catch up by running the ticks in between
+	std::vector<uint8> _mapSnapshot;
+	std::vector<GameCommand> _mapSnapshotLog;
+	uint32 _mapSnapshotTick = 0;
+	bool _mapSnapshotValid = false;
+	bool _mapSnapshotUsed = false;
+
+	// Per component state hashes of recent ticks for finding where a desync started
+	NetworkStateHistory _stateHistory;
+	bool _stateCheckPending = false;
+	uint32 _stateCheckTime = 0;
+	bool _stateDumpPending = false;
+	uint32 _stateDumpTick = 0;
+	std::vector<uint32> _stateDumpComponents;
+
+	// Connections serviced by the network thread, guarded by _ioMutex
+	SDL_Thread* _ioThread = nullptr;
+	SDL_mutex* _ioMutex = nullptr;
+	SDL_atomic_t _ioStop;
+	ITcpSocketPoller* _ioPoller = nullptr;
+	std::unordered_set<NetworkConnection*> _ioConnections;
+	std::vector<NetworkConnection*> _ioRequests;	// Connections with packets to send or a disconnect
+
+	// Traffic of the connections closed since the server started and round trip times
+	struct SentGameCommand
+	{
+		uint32 time;
+		uint32 args[7];
+	};
+	NetworkConnectionStats _closedConnectionStats;
+	NetworkRollingHistogram _pingTimes;
+	NetworkRollingHistogram _commandLatencies;
+	std::deque<SentGameCommand> _sentGameCommands;
+	NetworkCommandStats _statsRateTotal;
+	uint32 _statsRateTime = 0;
+	uint32 _bytesInPerSecond = 0;
+	uint32 _bytesOutPerSecond = 0;
+	uint32 _lastStatsFileTime = 0;
+
 	void UpdateServer();
 	void UpdateClient();
 
@@ -225,7 +331,7 @@ private:
 	void Client_Handle_MAP(NetworkConnection& connection, NetworkPacket& packet);
 	void Client_Handle_CHAT(NetworkConnection& connection, NetworkPacket& packet);
 	void Server_Handle_CHAT(NetworkConnection& connection, NetworkPacket& packet);
-	void Client_Handle_GAMECMD(NetworkConnection& connection, NetworkPacket& packet);
+	void Client_Handle_GAMECMDS(NetworkConnection& connection, NetworkPacket& packet);
 	void Server_Handle_GAMECMD(NetworkConnection& connection, NetworkPacket& packet);
 	void Client_Handle_TICK(NetworkConnection& connection, NetworkPacket& packet);
 	void Client_Handle_PLAYERLIST(NetworkConnection& connection, NetworkPacket& packet);
@@ -240,6 +346,10 @@ private:
 	void Client_Handle_EVENT(NetworkConnection& connection, NetworkPacket& packet);
 	void Client_Handle_TOKEN(NetworkConnection& connection, NetworkPacket& packet);
 	void Server_Handle_TOKEN(NetworkConnection& connection, NetworkPacket& packet);
+	void Client_Handle_STATEHASH(NetworkConnection& connection, NetworkPacket& packet);
+	void Server_Handle_STATEHASH(NetworkConnection& connection, NetworkPacket& packet);
+	void Client_Handle_STATEDUMP(NetworkConnection& connection, NetworkPacket& packet);
+	void Server_Handle_STATEDUMP(NetworkConnection& connection, NetworkPacket& packet);
 };
 
 namespace Convert
@@ -260,11 +370,13 @@ int network_init();
 void network_close();
 void network_shutdown_client();
 int network_begin_client(const char *host, int port);
-int network_begin_server(int port);
+int network_begin_server(int port, const char* address);
 
 int network_get_mode();
 int network_get_status();
 void network_update();
+void network_record_state();
+void network_check_state();
 int network_get_authstatus();
 uint32 network_get_server_tick();
 uint8 network_get_current_player_id();
@@ -292,6 +404,7 @@ void game_command_set_player_group(int* eax, int* ebx, int* ecx, int* edx, int*
 void game_command_modify_groups(int *eax, int *ebx, int *ecx, int *edx, int *esi, int *edi, int *ebp);
 void game_command_kick_player(int *eax, int *ebx, int *ecx, int *edx, int *esi, int *edi, int *ebp);
 uint8 network_get_default_group();
+void network_set_default_group(uint8 id);
 int network_get_num_actions();
 rct_string_id network_get_action_name_string_id(unsigned int index);
 int network_can_perform_action(unsigned int groupindex, unsigned int index);
@@ -311,6 +424,7 @@ const utf8 * network_get_server_description();
 const utf8 * network_get_server_provider_name();
 const utf8 * network_get_server_provider_email();
 const utf8 * network_get_server_provider_website();
+void network_get_stats(network_stats_summary *summary);
 
 #ifdef __cplusplus
 }
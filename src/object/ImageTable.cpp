@@ -34,13 +34,31 @@ void ImageTable::Read(IReadObjectContext * context, IStream * stream)
         uint32 numImages = stream->ReadValue<uint32>();
         uint32 imageDataSize = stream->ReadValue<uint32>();
 
-        uint64 headerTableSize = numImages * 16;
-        uint64 remainingBytes = stream->GetLength() - stream->GetPosition() - headerTableSize;
+        uint64 headerTableSize = (uint64)numImages * 16;
+        uint64 availableBytes = stream->GetLength() - stream->GetPosition();
+        if (headerTableSize > availableBytes)
+        {
+            context->LogError(OBJECT_ERROR_BAD_IMAGE_TABLE, "Image table headers truncated.");
+            throw Exception();
+        }
+
+        uint64 remainingBytes = availableBytes - headerTableSize;
         if (remainingBytes > imageDataSize)
         {
             context->LogWarning(OBJECT_ERROR_BAD_IMAGE_TABLE, "Image table size longer than expected.");
             imageDataSize = (uint32)remainingBytes;
         }
+        else if (remainingBytes < imageDataSize && context->IsMetadataOnly())
+        {
+            context->LogWarning(OBJECT_ERROR_BAD_IMAGE_TABLE, "Image table size shorter than expected.");
+        }
+
+        if (context->IsMetadataOnly())
+        {
+            // The image table is always the last part of an object, so the images themselves
+            // do not need to be read when only indexing
+            return;
+        }
 
         _dataSize = imageDataSize;
         _data = Memory::Reallocate(_data, _dataSize);
@@ -35,6 +35,12 @@ interface IReadObjectContext
 
     virtual void LogWarning(uint32 code, const utf8 * text) abstract;
     virtual void LogError(uint32 code, const utf8 * text) abstract;
+
+    /**
+     * Whether the object is only being read for its entry and repository metadata, in which
+     * case the image table is skipped. Such an object can not be loaded.
+     */
+    virtual bool IsMetadataOnly() const abstract;
 };
 
 class Object
@@ -44,6 +44,7 @@ class ReadObjectContext : public IReadObjectContext
 {
 private:
     utf8 *  _objectName;
+    bool    _metadataOnly;
     bool    _wasWarning = false;
     bool    _wasError = false;
 
@@ -51,9 +52,10 @@ public:
     bool WasWarning() const { return _wasWarning; }
     bool WasError() const { return _wasError; }
 
-    ReadObjectContext(const utf8 * objectFileName)
+    ReadObjectContext(const utf8 * objectFileName, bool metadataOnly = false)
     {
         _objectName = String::Duplicate(objectFileName);
+        _metadataOnly = metadataOnly;
     }
 
     ~ReadObjectContext() override
@@ -81,6 +83,11 @@ public:
             Console::Error::WriteLine("[%s] Error: %s", _objectName, text);
         }
     }
+
+    bool IsMetadataOnly() const override
+    {
+        return _metadataOnly;
+    }
 };
 
 namespace ObjectFactory
@@ -126,7 +133,7 @@ namespace ObjectFactory
         }
     }
 
-    Object * CreateObjectFromLegacyFile(const utf8 * path)
+    static Object * CreateObjectFromLegacyFile(const utf8 * path, bool metadataOnly)
     {
         Object * result = nullptr;
 
@@ -142,7 +149,7 @@ namespace ObjectFactory
                     utf8 objectName[9] = { 0 };
                     Memory::Copy(objectName, entry.name, 8);
 
-                    auto readContext = ReadObjectContext(objectName);
+                    auto readContext = ReadObjectContext(objectName, metadataOnly);
                     auto chunkStream = GetDecodedChunkStream(&readContext, file);
                     if (chunkStream != nullptr)
                     {
@@ -164,6 +171,16 @@ namespace ObjectFactory
         return result;
     }
 
+    Object * CreateObjectFromLegacyFile(const utf8 * path)
+    {
+        return CreateObjectFromLegacyFile(path, false);
+    }
+
+    Object * CreateObjectMetadataFromLegacyFile(const utf8 * path)
+    {
+        return CreateObjectFromLegacyFile(path, true);
+    }
+
     Object * CreateObjectFromLegacyData(const rct_object_entry * entry, const void * data, size_t dataSize)
     {
         Guard::ArgumentNotNull(entry, GUARD_LINE);
@@ -23,6 +23,10 @@ class Object;
 namespace ObjectFactory
 {
     Object * CreateObjectFromLegacyFile(const utf8 * path);
+    /**
+     * Reads an object without its image table, for indexing. The object can not be loaded.
+     */
+    Object * CreateObjectMetadataFromLegacyFile(const utf8 * path);
     Object * CreateObjectFromLegacyData(const rct_object_entry * entry, const void * data, size_t dataSize);
     Object * CreateObject(const rct_object_entry &entry);
 }
@@ -16,6 +16,7 @@
 
 #include <algorithm>
 #include <memory>
+#include <string>
 #include <unordered_map>
 #include <vector>
 
@@ -25,6 +26,7 @@
 #include "../core/FileStream.hpp"
 #include "../core/Guard.hpp"
 #include "../core/IStream.hpp"
+#include "../core/Math.hpp"
 #include "../core/Memory.hpp"
 #include "../core/MemoryStream.h"
 #include "../core/Path.hpp"
@@ -48,25 +50,33 @@ extern "C"
     #include "../util/sawyercoding.h"
 }
 
-constexpr uint16 OBJECT_REPOSITORY_VERSION = 9;
+constexpr uint16 OBJECT_REPOSITORY_VERSION = 11;
+constexpr sint32 OBJECT_REPOSITORY_MAX_SCAN_THREADS = 8;
 
 struct ObjectRepositoryHeader
 {
     uint16  Version;
     uint16  LanguageId;
-    uint32  TotalFiles;
-    uint64  TotalFileSize;
-    uint32  FileDateModifiedChecksum;
-    uint32  PathChecksum;
-    uint32  NumItems;
+    uint32  NumFiles;
 };
 
-struct QueryDirectoryResult
+// Each file in the index is either an item, an item that conflicts with another file's item or
+// a file that could not be read as an object
+enum OBJECT_FILE_STATUS : uint8
 {
-    uint32  TotalFiles;
-    uint64  TotalFileSize;
-    uint32  FileDateModifiedChecksum;
-    uint32  PathChecksum;
+    OBJECT_FILE_STATUS_ITEM,
+    OBJECT_FILE_STATUS_INVALID,
+    OBJECT_FILE_STATUS_DUPLICATE,
+};
+
+// An object file found in one of the object directories
+struct ObjectFileInfo
+{
+    std::string Path;
+    uint64      Size;
+    uint64      DateModified;
+    bool        Indexed;        // Unchanged since the index was saved, so it does not need scanning
+    bool        Invalid;
 };
 
 struct ObjectEntryHash
@@ -96,10 +106,13 @@ static void ReportMissingObject(const rct_object_entry * entry);
 
 class ObjectRepository : public IObjectRepository
 {
-    std::vector<ObjectRepositoryItem>   _items;
-    QueryDirectoryResult                _queryDirectoryResult;
-    ObjectEntryMap                      _itemMap;
-    uint16                              _languageId;
+    std::vector<ObjectRepositoryItem>       _items;
+    std::vector<ObjectRepositoryItem>       _duplicateItems;    // Items that conflict with one in _items
+    std::vector<ObjectFileInfo>             _files;
+    std::unordered_map<std::string, size_t> _fileMap;
+    ObjectEntryMap                          _itemMap;
+    uint16                                  _languageId;
+    bool                                    _itemsReplaced = false;
 
 public:
     ~ObjectRepository()
@@ -110,20 +123,23 @@ public:
     void LoadOrConstruct() override
     {
         ClearItems();
-
-        _queryDirectoryResult = { 0 };
+        _files.clear();
+        _fileMap.clear();
+        _languageId = gCurrentLanguage;
 
         utf8 path[MAX_PATH];
         GetRCT2ObjectPath(path, sizeof(path));
-        QueryDirectory(&_queryDirectoryResult, path);
+        QueryDirectory(path);
         GetUserObjectPath(path, sizeof(path));
-        QueryDirectory(&_queryDirectoryResult, path);
-        
-        if (!Load())
+        QueryDirectory(path);
+
+        // Take unchanged files from the index and only scan the rest
+        _itemsReplaced = false;
+        bool indexChanged = !Load();
+        indexChanged |= Construct();
+        indexChanged |= _itemsReplaced;
+        if (indexChanged)
         {
-            _languageId = gCurrentLanguage;
-
-            Construct();
             Save();
         }
 
@@ -228,9 +244,14 @@ private:
         }
         _items.clear();
         _itemMap.clear();
+        for (ObjectRepositoryItem &item : _duplicateItems)
+        {
+            FreeItem(&item);
+        }
+        _duplicateItems.clear();
     }
 
-    void QueryDirectory(QueryDirectoryResult * result, const utf8 * directory)
+    void QueryDirectory(const utf8 * directory)
     {
         utf8 pattern[MAX_PATH];
         String::Set(pattern, sizeof(pattern), directory);
@@ -240,68 +261,169 @@ private:
         while (fileEnumerator.Next())
         {
             const file_info * enumFileInfo = fileEnumerator.GetFileInfo();
-            const utf8 * enumPath = fileEnumerator.GetPath();
 
-            result->TotalFiles++;
-            result->TotalFileSize += enumFileInfo->size;
-            result->FileDateModifiedChecksum ^=
-                (uint32)(enumFileInfo->last_modified >> 32) ^
-                (uint32)(enumFileInfo->last_modified & 0xFFFFFFFF);
-            result->FileDateModifiedChecksum = ror32(result->FileDateModifiedChecksum, 5);
-            result->PathChecksum += GetPathChecksum(enumPath);
+            ObjectFileInfo file;
+            file.Path = fileEnumerator.GetPath();
+            file.Size = enumFileInfo->size;
+            file.DateModified = enumFileInfo->last_modified;
+            file.Indexed = false;
+            file.Invalid = false;
+
+            _fileMap[file.Path] = _files.size();
+            _files.push_back(file);
         }
     }
 
-    void Construct()
+    ObjectFileInfo * FindFile(const utf8 * path)
+    {
+        auto it = _fileMap.find(path);
+        return it != _fileMap.end() ? &_files[it->second] : nullptr;
+    }
+
+    /**
+     * Gets the position of a file in the order the directories were queried, files that were
+     * not queried (e.g. added since) come last.
+     */
+    size_t GetFileOrder(const utf8 * path) const
+    {
+        auto it = _fileMap.find(path);
+        return it != _fileMap.end() ? it->second : SIZE_MAX;
+    }
+
+    /**
+     * Scans all the files that were not taken from the index. Returns true if any files were
+     * scanned, as each of them is new to the index.
+     */
+    bool Construct()
     {
-        utf8 objectDirectory[MAX_PATH];
-        Path::GetDirectory(objectDirectory, sizeof(objectDirectory), gRCT2AddressObjectDataPath);
+        std::vector<ObjectFileInfo *> files;
+        for (ObjectFileInfo &file : _files)
+        {
+            if (!file.Indexed)
+            {
+                files.push_back(&file);
+            }
+        }
+        if (files.size() == 0)
+        {
+            return false;
+        }
 
-        Console::WriteLine("Scanning %lu objects...", _queryDirectoryResult.TotalFiles);
+        Console::WriteLine("Scanning %u new or modified objects...", (uint32)files.size());
 
         auto stopwatch = Stopwatch();
         stopwatch.Start();
 
-        utf8 path[MAX_PATH];
-        GetRCT2ObjectPath(path, sizeof(path));
-        ScanDirectory(path);
-        GetUserObjectPath(path, sizeof(path));
-        ScanDirectory(path);
+        ScanObjects(files);
 
         stopwatch.Stop();
         Console::WriteLine("Scanning complete in %.2f seconds.", stopwatch.GetElapsedMilliseconds() / 1000.0f);
+
+        return true;
     }
 
-    void ScanDirectory(const utf8 * directory)
+    struct ScanObjectsQueue
     {
-        utf8 pattern[MAX_PATH];
-        String::Set(pattern, sizeof(pattern), directory);
-        Path::Append(pattern, sizeof(pattern), "*.dat");
+        ObjectFileInfo * const *    Files;
+        ObjectRepositoryItem *      Items;
+        bool *                      Valid;
+        sint32                      Count;
+        SDL_atomic_t                Next;
+    };
+
+    static int ScanObjectsThread(void * arg)
+    {
+        auto queue = (ScanObjectsQueue *)arg;
+        sint32 index;
+        while ((index = SDL_AtomicAdd(&queue->Next, 1)) < queue->Count)
+        {
+            queue->Valid[index] = ReadItemFromFile(queue->Files[index]->Path.c_str(), &queue->Items[index]);
+        }
+        return 0;
+    }
 
-        auto fileEnumerator = FileEnumerator(pattern, true);
-        while (fileEnumerator.Next())
+    /**
+     * Reads the metadata of each object file on several threads, then adds the items.
+     */
+    void ScanObjects(const std::vector<ObjectFileInfo *> &files)
+    {
+        sint32 count = (sint32)files.size();
+        auto items = std::vector<ObjectRepositoryItem>(count);
+        auto valid = std::unique_ptr<bool[]>(new bool[count]);
+
+        ScanObjectsQueue queue;
+        queue.Files = files.data();
+        queue.Items = items.data();
+        queue.Valid = valid.get();
+        queue.Count = count;
+        SDL_AtomicSet(&queue.Next, 0);
+
+        std::vector<SDL_Thread *> threads;
+        sint32 numThreads = Math::Clamp(1, SDL_GetCPUCount(), Math::Max(1, Math::Min(count, OBJECT_REPOSITORY_MAX_SCAN_THREADS))) - 1;
+        for (sint32 i = 0; i < numThreads; i++)
+        {
+            threads.push_back(SDL_CreateThread(ScanObjectsThread, "ObjectRepository", &queue));
+        }
+        ScanObjectsThread(&queue);
+        for (SDL_Thread * thread : threads)
+        {
+            if (thread != nullptr)
+            {
+                SDL_WaitThread(thread, nullptr);
+            }
+        }
+
+        for (sint32 i = 0; i < count; i++)
         {
-            const utf8 * enumPath = fileEnumerator.GetPath();
-            ScanObject(enumPath);
+            if (!valid[i])
+            {
+                files[i]->Invalid = true;
+            }
+            else if (!AddItem(&items[i], true))
+            {
+                // Kept so the file is not scanned again, it replaces the other item if that
+                // file is removed
+                _duplicateItems.push_back(items[i]);
+            }
         }
     }
 
     void ScanObject(const utf8 * path)
     {
-        Object * object = ObjectFactory::CreateObjectFromLegacyFile(path);
-        if (object != nullptr)
+        ObjectRepositoryItem item;
+        if (ReadItemFromFile(path, &item) && !AddItem(&item, true))
         {
-            ObjectRepositoryItem item = { 0 };
-            item.ObjectEntry = *object->GetObjectEntry();
-            item.Path = String::Duplicate(path);
-            item.Name = String::Duplicate(object->GetName());
-            object->SetRepositoryItem(&item);
-            AddItem(&item);
+            FreeItem(&item);
+        }
+    }
+
+    /**
+     * Reads just the repository metadata of an object file. Safe to call from any thread.
+     */
+    static bool ReadItemFromFile(const utf8 * path, ObjectRepositoryItem * outItem)
+    {
+        *outItem = { 0 };
 
-            delete object;
+        Object * object = ObjectFactory::CreateObjectMetadataFromLegacyFile(path);
+        if (object == nullptr)
+        {
+            return false;
         }
+
+        outItem->ObjectEntry = *object->GetObjectEntry();
+        outItem->Path = String::Duplicate(path);
+        outItem->Name = String::Duplicate(object->GetName());
+        object->SetRepositoryItem(outItem);
+
+        delete object;
+        return true;
     }
 
+    /**
+     * Reads the index, adding the items of files that are unchanged and marking those files as
+     * indexed. Returns false if the index is missing, out of date or lists files that have
+     * since changed or been removed.
+     */
     bool Load()
     {
         utf8 path[MAX_PATH];
@@ -312,38 +434,91 @@ private:
             auto fs = FileStream(path, FILE_MODE_OPEN);
             auto header = fs.ReadValue<ObjectRepositoryHeader>();
 
-            if (header.Version == OBJECT_REPOSITORY_VERSION &&
-                header.LanguageId == gCurrentLanguage &&
-                header.TotalFiles == _queryDirectoryResult.TotalFiles &&
-                header.TotalFileSize == _queryDirectoryResult.TotalFileSize &&
-                header.FileDateModifiedChecksum == _queryDirectoryResult.FileDateModifiedChecksum &&
-                header.PathChecksum == _queryDirectoryResult.PathChecksum)
+            if (header.Version != OBJECT_REPOSITORY_VERSION ||
+                header.LanguageId != gCurrentLanguage)
             {
-                // Header matches, so the index is not out of date
+                Console::WriteLine("Object repository is out of date.");
+                return false;
+            }
+
+            // Buffer the rest of file into memory to speed up item reading
+            size_t dataSize = (size_t)(fs.GetLength() - fs.GetPosition());
+            void * data = fs.ReadArray<uint8>(dataSize);
+            auto ms = MemoryStream(data, dataSize, MEMORY_ACCESS_READ | MEMORY_ACCESS_OWNER);
+
+            bool upToDate = true;
+            for (uint32 i = 0; i < header.NumFiles; i++)
+            {
+                auto status = ms.ReadValue<uint8>();
+                auto size = ms.ReadValue<uint64>();
+                auto dateModified = ms.ReadValue<uint64>();
+
+                bool hasItem = (status == OBJECT_FILE_STATUS_ITEM || status == OBJECT_FILE_STATUS_DUPLICATE);
+                ObjectRepositoryItem item = { 0 };
+                utf8 * filePath;
+                if (hasItem)
+                {
+                    item = ReadItem(&ms);
+                    filePath = item.Path;
+                }
+                else
+                {
+                    filePath = ms.ReadString();
+                }
 
-                // Buffer the rest of file into memory to speed up item reading
-                size_t dataSize = (size_t)(fs.GetLength() - fs.GetPosition());
-                void * data = fs.ReadArray<uint8>(dataSize);
-                auto ms = MemoryStream(data, dataSize, MEMORY_ACCESS_READ | MEMORY_ACCESS_OWNER);
+                ObjectFileInfo * file = FindFile(filePath);
+                bool unchanged = file != nullptr &&
+                                 !file->Indexed &&
+                                 file->Size == size &&
+                                 file->DateModified == dateModified;
+                if (unchanged)
+                {
+                    file->Indexed = true;
+                    file->Invalid = (status == OBJECT_FILE_STATUS_INVALID);
+                }
+                else
+                {
+                    upToDate = false;
+                }
 
-                // Read items
-                for (uint32 i = 0; i < header.NumItems; i++)
+                if (hasItem)
                 {
-                    ObjectRepositoryItem item = ReadItem(&ms);
-                    AddItem(&item);
+                    if (!unchanged)
+                    {
+                        FreeItem(&item);
+                    }
+                    else if (AddItem(&item, false))
+                    {
+                        // A duplicate whose other file has been removed or changed
+                        upToDate &= (status == OBJECT_FILE_STATUS_ITEM);
+                    }
+                    else
+                    {
+                        _duplicateItems.push_back(item);
+                        upToDate &= (status == OBJECT_FILE_STATUS_DUPLICATE);
+                    }
+                }
+                else
+                {
+                    Memory::Free(filePath);
                 }
-                return true;
             }
-            Console::WriteLine("Object repository is out of date.");
-            return false;
+            return upToDate;
         }
         catch (IOException ex)
         {
+            // Start again from nothing if the index is truncated
+            ClearItems();
+            for (ObjectFileInfo &file : _files)
+            {
+                file.Indexed = false;
+                file.Invalid = false;
+            }
             return false;
         }
     }
 
-    void Save() const
+    void Save()
     {
         utf8 path[MAX_PATH];
         GetRepositoryPath(path, sizeof(path));
@@ -352,21 +527,62 @@ private:
         {
             auto fs = FileStream(path, FILE_MODE_WRITE);
 
+            // Items added since the directories were queried are picked up on the next load
+            std::vector<const ObjectRepositoryItem *> items;
+            for (const ObjectRepositoryItem &item : _items)
+            {
+                if (FindFile(item.Path) != nullptr)
+                {
+                    items.push_back(&item);
+                }
+            }
+            std::vector<const ObjectRepositoryItem *> duplicateItems;
+            for (const ObjectRepositoryItem &item : _duplicateItems)
+            {
+                if (FindFile(item.Path) != nullptr)
+                {
+                    duplicateItems.push_back(&item);
+                }
+            }
+            std::vector<const ObjectFileInfo *> invalidFiles;
+            for (const ObjectFileInfo &file : _files)
+            {
+                if (file.Invalid)
+                {
+                    invalidFiles.push_back(&file);
+                }
+            }
+
             // Write header
             ObjectRepositoryHeader header;
             header.Version = OBJECT_REPOSITORY_VERSION;
             header.LanguageId = _languageId;
-            header.TotalFiles = _queryDirectoryResult.TotalFiles;
-            header.TotalFileSize = _queryDirectoryResult.TotalFileSize;
-            header.FileDateModifiedChecksum = _queryDirectoryResult.FileDateModifiedChecksum;
-            header.PathChecksum = _queryDirectoryResult.PathChecksum;
-            header.NumItems = _items.size();
+            header.NumFiles = (uint32)(items.size() + duplicateItems.size() + invalidFiles.size());
             fs.WriteValue(header);
 
-            // Write items
-            for (uint32 i = 0; i < header.NumItems; i++)
+            // Write files
+            for (const ObjectRepositoryItem * item : items)
             {
-                WriteItem(&fs, _items[i]);
+                const ObjectFileInfo * file = FindFile(item->Path);
+                fs.WriteValue<uint8>(OBJECT_FILE_STATUS_ITEM);
+                fs.WriteValue<uint64>(file->Size);
+                fs.WriteValue<uint64>(file->DateModified);
+                WriteItem(&fs, *item);
+            }
+            for (const ObjectRepositoryItem * item : duplicateItems)
+            {
+                const ObjectFileInfo * file = FindFile(item->Path);
+                fs.WriteValue<uint8>(OBJECT_FILE_STATUS_DUPLICATE);
+                fs.WriteValue<uint64>(file->Size);
+                fs.WriteValue<uint64>(file->DateModified);
+                WriteItem(&fs, *item);
+            }
+            for (const ObjectFileInfo * file : invalidFiles)
+            {
+                fs.WriteValue<uint8>(OBJECT_FILE_STATUS_INVALID);
+                fs.WriteValue<uint64>(file->Size);
+                fs.WriteValue<uint64>(file->DateModified);
+                fs.WriteString(file->Path.c_str());
             }
         }
         catch (IOException ex)
@@ -392,10 +608,15 @@ private:
         }
     }
 
-    bool AddItem(ObjectRepositoryItem * item)
+    /**
+     * Adds an item unless it conflicts with an item from a file earlier in the directory order.
+     * An item from a later file is replaced and becomes a duplicate, so the same item wins no
+     * matter which files were taken from the index and which were scanned.
+     */
+    bool AddItem(ObjectRepositoryItem * item, bool reportConflict)
     {
-        const ObjectRepositoryItem * conflict = FindObject(&item->ObjectEntry);
-        if (conflict == nullptr)
+        auto kvp = _itemMap.find(item->ObjectEntry);
+        if (kvp == _itemMap.end())
         {
             size_t index = _items.size();
             item->Id = index;
@@ -403,12 +624,23 @@ private:
             _itemMap[item->ObjectEntry] = index;
             return true;
         }
-        else
+
+        ObjectRepositoryItem * conflict = &_items[kvp->second];
+        if (reportConflict)
         {
             Console::Error::WriteLine("Object conflict: '%s'", conflict->Path);
             Console::Error::WriteLine("               : '%s'", item->Path);
-            return false;
         }
+        if (conflict->LoadedObject == nullptr &&
+            GetFileOrder(item->Path) < GetFileOrder(conflict->Path))
+        {
+            item->Id = conflict->Id;
+            _duplicateItems.push_back(*conflict);
+            *conflict = *item;
+            _itemsReplaced = true;
+            return true;
+        }
+        return false;
     }
 
     static ObjectRepositoryItem ReadItem(IStream * stream)
@@ -644,21 +876,6 @@ private:
     {
         platform_get_user_directory(buffer, "object");
     }
-
-    static uint32 GetPathChecksum(const utf8 * path)
-    {
-        uint32 hash = 0xD8430DED;
-        for (const utf8 * ch = path; *ch != '\0'; ch++)
-        {
-            hash += (*ch);
-            hash += (hash << 10);
-            hash ^= (hash >> 6);
-        }
-        hash += (hash << 3);
-        hash ^= (hash >> 11);
-        hash += (hash << 15);
-        return hash;
-    }
 };
 
 static std::unique_ptr<ObjectRepository> _objectRepository;
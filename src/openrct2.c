@@ -33,6 +33,7 @@
 #include "openrct2.h"
 #include "platform/crash.h"
 #include "platform/platform.h"
+#include "replay.h"
 #include "ride/ride.h"
 #include "title.h"
 #include "util/sawyercoding.h"
@@ -308,7 +309,7 @@ void openrct2_launch()
 				else {
 					network_set_password(gCustomPassword);
 				}
-				network_begin_server(gNetworkStartPort);
+				network_begin_server(gNetworkStartPort, NULL);
 			}
 #endif // DISABLE_NETWORK
 			break;
@@ -341,6 +342,8 @@ void openrct2_launch()
 
 void openrct2_dispose()
 {
+	game_autosave_update(true);
+	replay_stop_recording();
 	network_close();
 	http_dispose();
 	language_close_all();
@@ -353,7 +353,7 @@ bool rct2_open_file(const char *path)
 	}
 	extension++;
 
-	if (_stricmp(extension, "sv6") == 0) {
+	if (_stricmp(extension, "sv6") == 0 || _stricmp(extension, "park") == 0) {
 		strcpy((char*)gRCT2AddressSavedGamesPath2, path);
 		game_load_save(path);
 		gFirstTimeSave = 0;
@@ -513,5 +513,6 @@ uint32 get_file_extension_type(const utf8 *path)
 	if (strcicmp(extension, ".sc6") == 0) return FILE_EXTENSION_SC6;
 	if (strcicmp(extension, ".sv6") == 0) return FILE_EXTENSION_SV6;
 	if (strcicmp(extension, ".td6") == 0) return FILE_EXTENSION_TD6;
+	if (strcicmp(extension, ".park") == 0) return FILE_EXTENSION_PARK;
 	return FILE_EXTENSION_UNKNOWN;
 }
@@ -263,6 +263,7 @@ enum {
 	FILE_EXTENSION_SC6,
 	FILE_EXTENSION_SV6,
 	FILE_EXTENSION_TD6,
+	FILE_EXTENSION_PARK,
 };
 
 #ifdef __cplusplus
@@ -0,0 +1,472 @@
+#pragma region Copyright (c) 2014-2016 OpenRCT2 Developers
+/*****************************************************************************
+ * OpenRCT2, an open source clone of Roller Coaster Tycoon 2.
+ *
+ * OpenRCT2 is the work of many authors, a full list can be found in contributors.md
+ * For more information, visit https://github.com/OpenRCT2/OpenRCT2
+ *
+ * OpenRCT2 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * A full copy of the GNU General Public License can be found in licence.txt
+ *****************************************************************************/
+#pragma endregion
+
+#include <zlib.h>
+#include "../core/Exception.hpp"
+#include "../core/IStream.hpp"
+#include "../core/Math.hpp"
+#include "../core/Memory.hpp"
+#include "ParkFile.h"
+
+// Segments are small enough that the large chunks (map elements and sprites) are split
+// across several threads, but large enough for deflate to find most repeats.
+constexpr size_t PARK_FILE_SEGMENT_SIZE = 512 * 1024;
+constexpr int    PARK_FILE_MAX_THREADS = 8;
+constexpr int    PARK_FILE_COMPRESSION_LEVEL = Z_BEST_SPEED;
+
+struct ParkFileJob
+{
+    ParkFileEntry * Entry;
+    const uint8 *   Src;
+    uint8 *         Dst;
+    size_t          DstCapacity;
+};
+
+struct ParkFileJobQueue
+{
+    ParkFileJob *   Jobs;
+    int             NumJobs;
+    bool            Compress;
+    SDL_atomic_t    NextJob;
+    SDL_atomic_t    Failed;
+};
+
+static bool CompressSegment(ParkFileJob * job)
+{
+    ParkFileEntry * entry = job->Entry;
+    entry->Checksum = crc32(0, job->Src, entry->Length);
+
+    uLongf compressedLength = (uLongf)job->DstCapacity;
+    if (compress2(job->Dst, &compressedLength, job->Src, entry->Length, PARK_FILE_COMPRESSION_LEVEL) != Z_OK)
+    {
+        return false;
+    }
+
+    if (compressedLength < entry->Length)
+    {
+        entry->Encoding = PARK_CHUNK_ENCODING_DEFLATE;
+        entry->CompressedLength = (uint32)compressedLength;
+    }
+    else
+    {
+        // Incompressible, store as is
+        entry->Encoding = PARK_CHUNK_ENCODING_NONE;
+        entry->CompressedLength = entry->Length;
+        memcpy(job->Dst, job->Src, entry->Length);
+    }
+    return true;
+}
+
+static bool DecompressSegment(ParkFileJob * job)
+{
+    const ParkFileEntry * entry = job->Entry;
+    switch (entry->Encoding) {
+    case PARK_CHUNK_ENCODING_NONE:
+        if (entry->CompressedLength != entry->Length)
+        {
+            return false;
+        }
+        memcpy(job->Dst, job->Src, entry->Length);
+        break;
+    case PARK_CHUNK_ENCODING_DEFLATE:
+    {
+        uLongf length = entry->Length;
+        if (uncompress(job->Dst, &length, job->Src, entry->CompressedLength) != Z_OK || length != entry->Length)
+        {
+            return false;
+        }
+        break;
+    }
+    default:
+        return false;
+    }
+    return crc32(0, job->Dst, entry->Length) == entry->Checksum;
+}
+
+static int RunJobs(void * arg)
+{
+    auto queue = (ParkFileJobQueue *)arg;
+    int jobIndex;
+    while ((jobIndex = SDL_AtomicAdd(&queue->NextJob, 1)) < queue->NumJobs)
+    {
+        ParkFileJob * job = &queue->Jobs[jobIndex];
+        bool success = queue->Compress ? CompressSegment(job) : DecompressSegment(job);
+        if (!success)
+        {
+            SDL_AtomicSet(&queue->Failed, 1);
+        }
+    }
+    return 0;
+}
+
+/**
+ * Runs all the jobs, on worker threads as well as the calling thread if parallel.
+ * Returns false if any job failed.
+ */
+static bool RunJobQueue(ParkFileJob * jobs, int numJobs, bool compress, bool parallel)
+{
+    ParkFileJobQueue queue;
+    queue.Jobs = jobs;
+    queue.NumJobs = numJobs;
+    queue.Compress = compress;
+    SDL_AtomicSet(&queue.NextJob, 0);
+    SDL_AtomicSet(&queue.Failed, 0);
+
+    SDL_Thread * threads[PARK_FILE_MAX_THREADS - 1] = { 0 };
+    int numThreads = 0;
+    if (parallel)
+    {
+        numThreads = Math::Clamp(1, SDL_GetCPUCount(), Math::Min(numJobs, PARK_FILE_MAX_THREADS)) - 1;
+        for (int i = 0; i < numThreads; i++)
+        {
+            threads[i] = SDL_CreateThread(RunJobs, "parkfile", &queue);
+        }
+    }
+
+    RunJobs(&queue);
+    for (int i = 0; i < numThreads; i++)
+    {
+        if (threads[i] != nullptr)
+        {
+            SDL_WaitThread(threads[i], nullptr);
+        }
+    }
+    return SDL_AtomicGet(&queue.Failed) == 0;
+}
+
+#pragma region Stream chunks
+
+struct ParkFileStreamBuffer
+{
+    uint8 * Data;
+    size_t  Length;
+    size_t  Capacity;
+};
+
+static Sint64 StreamChunkSize(SDL_RWops * context)
+{
+    auto buffer = (ParkFileStreamBuffer *)context->hidden.unknown.data1;
+    return (Sint64)buffer->Length;
+}
+
+static Sint64 StreamChunkSeek(SDL_RWops * context, Sint64 offset, int whence)
+{
+    auto buffer = (ParkFileStreamBuffer *)context->hidden.unknown.data1;
+    if (offset != 0 || whence == RW_SEEK_SET)
+    {
+        // Only appending is supported
+        return -1;
+    }
+    return (Sint64)buffer->Length;
+}
+
+static size_t StreamChunkRead(SDL_RWops * context, void * ptr, size_t size, size_t maxnum)
+{
+    return 0;
+}
+
+static size_t StreamChunkWrite(SDL_RWops * context, const void * ptr, size_t size, size_t num)
+{
+    auto buffer = (ParkFileStreamBuffer *)context->hidden.unknown.data1;
+    size_t length = size * num;
+    if (buffer->Length + length > buffer->Capacity)
+    {
+        size_t capacity = Math::Max(buffer->Length + length, Math::Max<size_t>(buffer->Capacity * 2, 64 * 1024));
+        uint8 * data = Memory::Reallocate(buffer->Data, capacity);
+        if (data == nullptr)
+        {
+            return 0;
+        }
+        buffer->Data = data;
+        buffer->Capacity = capacity;
+    }
+    memcpy(buffer->Data + buffer->Length, ptr, length);
+    buffer->Length += length;
+    return num;
+}
+
+static int StreamChunkClose(SDL_RWops * context)
+{
+    return 0;
+}
+
+static SDL_RWops * StreamChunkCreate()
+{
+    SDL_RWops * rw = SDL_AllocRW();
+    if (rw == nullptr)
+    {
+        return nullptr;
+    }
+
+    auto buffer = Memory::Allocate<ParkFileStreamBuffer>();
+    if (buffer == nullptr)
+    {
+        SDL_FreeRW(rw);
+        return nullptr;
+    }
+    buffer->Data = nullptr;
+    buffer->Length = 0;
+    buffer->Capacity = 0;
+
+    rw->type = SDL_RWOPS_UNKNOWN;
+    rw->size = StreamChunkSize;
+    rw->seek = StreamChunkSeek;
+    rw->read = StreamChunkRead;
+    rw->write = StreamChunkWrite;
+    rw->close = StreamChunkClose;
+    rw->hidden.unknown.data1 = buffer;
+    return rw;
+}
+
+static void StreamChunkFree(SDL_RWops * rw)
+{
+    auto buffer = (ParkFileStreamBuffer *)rw->hidden.unknown.data1;
+    Memory::Free(buffer->Data);
+    Memory::Free(buffer);
+    SDL_FreeRW(rw);
+}
+
+#pragma endregion
+
+ParkFileWriter::ParkFileWriter() { }
+
+ParkFileWriter::~ParkFileWriter()
+{
+    for (const Chunk &chunk : _chunks)
+    {
+        if (chunk.Stream != nullptr)
+        {
+            StreamChunkFree(chunk.Stream);
+        }
+    }
+}
+
+void ParkFileWriter::AddChunk(uint32 id, const void * data, size_t length)
+{
+    _chunks.push_back({ id, data, length, nullptr });
+}
+
+SDL_RWops * ParkFileWriter::AddStreamChunk(uint32 id)
+{
+    SDL_RWops * rw = StreamChunkCreate();
+    if (rw == nullptr)
+    {
+        throw Exception("Unable to allocate memory.");
+    }
+    _chunks.push_back({ id, nullptr, 0, rw });
+    return rw;
+}
+
+void ParkFileWriter::Write(SDL_RWops * rw)
+{
+    // Split the chunks into segments
+    std::vector<ParkFileEntry> entries;
+    std::vector<const uint8 *> sources;
+    for (const Chunk &chunk : _chunks)
+    {
+        const uint8 * data = (const uint8 *)chunk.Data;
+        size_t length = chunk.Length;
+        if (chunk.Stream != nullptr)
+        {
+            auto buffer = (ParkFileStreamBuffer *)chunk.Stream->hidden.unknown.data1;
+            data = buffer->Data;
+            length = buffer->Length;
+        }
+
+        // Empty chunks are left out of the file entirely
+        for (size_t offset = 0; offset < length;)
+        {
+            ParkFileEntry entry = { 0 };
+            entry.Id = chunk.Id;
+            entry.Offset = (uint32)offset;
+            entry.Length = (uint32)Math::Min(length - offset, PARK_FILE_SEGMENT_SIZE);
+            entries.push_back(entry);
+            sources.push_back(data + offset);
+            offset += entry.Length;
+        }
+    }
+
+    // Compress all segments, each into its own buffer
+    int numJobs = (int)entries.size();
+    auto jobs = Memory::AllocateArray<ParkFileJob>(numJobs);
+    for (int i = 0; i < numJobs; i++)
+    {
+        jobs[i].Entry = &entries[i];
+        jobs[i].Src = sources[i];
+        jobs[i].DstCapacity = compressBound(entries[i].Length);
+        jobs[i].Dst = Memory::Allocate<uint8>(jobs[i].DstCapacity);
+    }
+
+    bool success = RunJobQueue(jobs, numJobs, true, Parallel);
+    if (success)
+    {
+        uint32 fileOffset = (uint32)(sizeof(ParkFileHeader) + numJobs * sizeof(ParkFileEntry));
+        for (ParkFileEntry &entry : entries)
+        {
+            entry.FileOffset = fileOffset;
+            fileOffset += entry.CompressedLength;
+        }
+
+        ParkFileHeader header;
+        header.Magic = PARK_FILE_MAGIC;
+        header.Version = PARK_FILE_VERSION;
+        header.NumEntries = (uint16)numJobs;
+        header.Flags = 0;
+
+        success = SDL_RWwrite(rw, &header, sizeof(header), 1) == 1 &&
+                  SDL_RWwrite(rw, entries.data(), sizeof(ParkFileEntry), numJobs) == (size_t)numJobs;
+        for (int i = 0; success && i < numJobs; i++)
+        {
+            success = SDL_RWwrite(rw, jobs[i].Dst, entries[i].CompressedLength, 1) == 1;
+        }
+    }
+
+    for (int i = 0; i < numJobs; i++)
+    {
+        Memory::Free(jobs[i].Dst);
+    }
+    Memory::Free(jobs);
+
+    if (!success)
+    {
+        throw IOException("Unable to write park file.");
+    }
+}
+
+ParkFileReader::ParkFileReader() { }
+
+ParkFileReader::~ParkFileReader()
+{
+    Memory::Free(_fileData);
+}
+
+bool ParkFileReader::ReadFile(SDL_RWops * rw)
+{
+    sint64 length = SDL_RWsize(rw);
+    if (length < (sint64)sizeof(ParkFileHeader) || length > INT32_MAX)
+    {
+        return false;
+    }
+
+    _fileLength = (size_t)length;
+    _fileData = Memory::Reallocate(_fileData, _fileLength);
+    if (_fileData == nullptr)
+    {
+        throw Exception("Unable to allocate memory for file.");
+    }
+
+    SDL_RWseek(rw, 0, RW_SEEK_SET);
+    if (SDL_RWread(rw, _fileData, _fileLength, 1) != 1)
+    {
+        throw IOException("Unable to read file.");
+    }
+
+    auto header = (const ParkFileHeader *)_fileData;
+    if (header->Magic != PARK_FILE_MAGIC || header->Version > PARK_FILE_VERSION)
+    {
+        return false;
+    }
+
+    _entries = (ParkFileEntry *)(_fileData + sizeof(ParkFileHeader));
+    _numEntries = header->NumEntries;
+    if (sizeof(ParkFileHeader) + _numEntries * sizeof(ParkFileEntry) > _fileLength)
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < _numEntries; i++)
+    {
+        const ParkFileEntry * entry = &_entries[i];
+        if ((size_t)entry->FileOffset + entry->CompressedLength > _fileLength)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ParkFileReader::HasChunk(uint32 id) const
+{
+    for (size_t i = 0; i < _numEntries; i++)
+    {
+        if (_entries[i].Id == id)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t ParkFileReader::GetChunkLength(uint32 id) const
+{
+    size_t length = 0;
+    for (size_t i = 0; i < _numEntries; i++)
+    {
+        if (_entries[i].Id == id)
+        {
+            length = Math::Max(length, (size_t)_entries[i].Offset + _entries[i].Length);
+        }
+    }
+    return length;
+}
+
+bool ParkFileReader::ReadChunks(const Destination * destinations, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        if (destinations[i].Required && !HasChunk(destinations[i].Id))
+        {
+            return false;
+        }
+    }
+
+    // Every segment of a requested chunk becomes a job, segments are decoded straight into
+    // their destination so they can run in any order
+    auto jobs = Memory::AllocateArray<ParkFileJob>(_numEntries);
+    int numJobs = 0;
+    bool valid = true;
+    for (size_t i = 0; i < _numEntries && valid; i++)
+    {
+        ParkFileEntry * entry = &_entries[i];
+        for (size_t j = 0; j < count; j++)
+        {
+            const Destination * destination = &destinations[j];
+            if (destination->Id != entry->Id)
+            {
+                continue;
+            }
+            if ((size_t)entry->Offset + entry->Length > destination->Capacity)
+            {
+                valid = false;
+                break;
+            }
+
+            ParkFileJob * job = &jobs[numJobs++];
+            job->Entry = entry;
+            job->Src = _fileData + entry->FileOffset;
+            job->Dst = (uint8 *)destination->Data + entry->Offset;
+            job->DstCapacity = entry->Length;
+            break;
+        }
+    }
+
+    if (valid)
+    {
+        valid = RunJobQueue(jobs, numJobs, false, Parallel);
+    }
+    Memory::Free(jobs);
+    return valid;
+}
@@ -0,0 +1,152 @@
+#pragma region Copyright (c) 2014-2016 OpenRCT2 Developers
+/*****************************************************************************
+ * OpenRCT2, an open source clone of Roller Coaster Tycoon 2.
+ *
+ * OpenRCT2 is the work of many authors, a full list can be found in contributors.md
+ * For more information, visit https://github.com/OpenRCT2/OpenRCT2
+ *
+ * OpenRCT2 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * A full copy of the GNU General Public License can be found in licence.txt
+ *****************************************************************************/
+#pragma endregion
+
+#pragma once
+
+#include <vector>
+#include <SDL.h>
+#include "../common.h"
+
+/**
+ * OpenRCT2's native park format (*.park).
+ *
+ * The file starts with a header and a table of contents, followed by the chunk data. Chunks
+ * are split into independent segments that are each deflated on their own, so they can be
+ * compressed and decompressed on several threads and any chunk can be found without reading
+ * the ones before it. A chunk may be shorter than its destination, the remainder is left as
+ * it was.
+ *
+ * Since version 2 the map elements are stored sparsely. PARK_CHUNK_MAP_TILES has a uint32 per
+ * tile (a run of elements ending with the last tile flag): the number of elements the tile
+ * takes from PARK_CHUNK_MAP_ELEMENTS, or 0 if the tile is a copy of the previous one. Unused
+ * elements after the last tile are not stored. Version 1 files store the used elements as is.
+ */
+#define PARK_FILE_MAGIC     0x4B524150 // PARK
+#define PARK_FILE_VERSION   2
+
+enum PARK_CHUNK
+{
+    PARK_CHUNK_HEADER = 1,
+    PARK_CHUNK_INFO,
+    PARK_CHUNK_PACKED_OBJECTS,
+    PARK_CHUNK_OBJECTS,
+    PARK_CHUNK_MISC,
+    PARK_CHUNK_MAP_ELEMENTS,
+    PARK_CHUNK_STATE,
+    PARK_CHUNK_MAP_TILES,
+};
+
+enum PARK_CHUNK_ENCODING
+{
+    PARK_CHUNK_ENCODING_NONE,
+    PARK_CHUNK_ENCODING_DEFLATE,
+};
+
+#pragma pack(push, 1)
+struct ParkFileHeader
+{
+    uint32 Magic;
+    uint16 Version;
+    uint16 NumEntries;
+    uint32 Flags;
+};
+assert_struct_size(ParkFileHeader, 12);
+
+struct ParkFileEntry
+{
+    uint32 Id;
+    uint32 Encoding;
+    uint32 Offset;              // Position of the segment within its chunk
+    uint32 Length;
+    uint32 FileOffset;
+    uint32 CompressedLength;
+    uint32 Checksum;            // CRC-32 of the uncompressed segment
+};
+assert_struct_size(ParkFileEntry, 28);
+#pragma pack(pop)
+
+/**
+ * Collects chunks and writes them as a park file, compressing the segments on several
+ * threads when Parallel is set.
+ */
+class ParkFileWriter
+{
+public:
+    bool Parallel = false;
+
+    ParkFileWriter();
+    ~ParkFileWriter();
+
+    /**
+     * Adds a chunk, the data must remain valid until Write is called.
+     */
+    void AddChunk(uint32 id, const void * data, size_t length);
+
+    /**
+     * Returns a stream whose contents become a chunk, for data that is produced by code
+     * writing to an SDL_RWops. The stream is owned by the writer.
+     */
+    SDL_RWops * AddStreamChunk(uint32 id);
+
+    void Write(SDL_RWops * rw);
+
+private:
+    struct Chunk
+    {
+        uint32          Id;
+        const void *    Data;
+        size_t          Length;
+        SDL_RWops *     Stream;
+    };
+
+    std::vector<Chunk> _chunks;
+};
+
+/**
+ * Reads a whole park file into memory and decodes chunks into their destinations.
+ */
+class ParkFileReader
+{
+public:
+    bool Parallel = false;
+
+    ParkFileReader();
+    ~ParkFileReader();
+
+    bool ReadFile(SDL_RWops * rw);
+
+    bool    HasChunk(uint32 id) const;
+    size_t  GetChunkLength(uint32 id) const;
+
+    /**
+     * Decodes each of the given chunks into a buffer of the given capacity. Chunks that are
+     * not in the file are skipped unless required. Returns false if the data is corrupt.
+     */
+    struct Destination
+    {
+        uint32  Id;
+        void *  Data;
+        size_t  Capacity;
+        bool    Required;
+    };
+    bool ReadChunks(const Destination * destinations, size_t count);
+
+private:
+    uint8 *         _fileData = nullptr;
+    size_t          _fileLength = 0;
+    ParkFileEntry * _entries = nullptr;
+    size_t          _numEntries = 0;
+};
@@ -17,6 +17,8 @@
 #include "../core/Exception.hpp"
 #include "../core/IStream.hpp"
 #include "../core/String.hpp"
+#include "../core/Util.hpp"
+#include "ParkFile.h"
 #include "S6Exporter.h"
 
 extern "C"
@@ -47,12 +49,13 @@ S6Exporter::S6Exporter()
 {
     ExportObjects = false;
     RemoveTracklessRides = false;
+    ParallelEncoding = false;
     memset(&_s6, 0, sizeof(_s6));
 }
 
 void S6Exporter::SaveGame(const utf8 * path)
 {
-    SDL_RWops * rw = SDL_RWFromFile(path, "rb");
+    SDL_RWops * rw = SDL_RWFromFile(path, "wb");
     if (rw == nullptr)
     {
         throw IOException("Unable to write to destination file.");
@@ -70,13 +73,13 @@ void S6Exporter::SaveGame(SDL_RWops *rw)
 
 void S6Exporter::SaveScenario(const utf8 * path)
 {
-    SDL_RWops * rw = SDL_RWFromFile(path, "rb");
+    SDL_RWops * rw = SDL_RWFromFile(path, "wb");
     if (rw == nullptr)
     {
         throw IOException("Unable to write to destination file.");
     }
 
-    SaveGame(rw);
+    SaveScenario(rw);
 
     SDL_RWclose(rw);
 }
@@ -86,7 +89,7 @@ void S6Exporter::SaveScenario(SDL_RWops *rw)
     Save(rw, true);
 }
 
-void S6Exporter::Save(SDL_RWops * rw, bool isScenario)
+void S6Exporter::SetHeader(bool isScenario)
 {
     _s6.header.type = isScenario ? S6_TYPE_SCENARIO : S6_TYPE_SAVEDGAME;
     _s6.header.num_packed_objects = ExportObjects ? scenario_get_num_packed_objects_to_write() : 0;
@@ -94,38 +97,40 @@ void S6Exporter::Save(SDL_RWops * rw, bool isScenario)
     _s6.header.magic_number = S6_MAGIC_NUMBER;
 
     _s6.game_version_number = 201028;
+}
 
-    uint8 * buffer = (uint8 *)malloc(0x600000);
-    if (buffer == NULL)
+void S6Exporter::Save(SDL_RWops * rw, bool isScenario)
+{
+    SetHeader(isScenario);
+
+    sawyercoding_writer * writer = sawyercoding_writer_create(rw, ParallelEncoding);
+    if (writer == nullptr)
     {
         log_error("Unable to allocate enough space for a write buffer.");
         throw Exception("Unable to allocate memory.");
     }
-    
+
     sawyercoding_chunk_header chunkHeader;
-    int encodedLength;
 
     // 0: Write header chunk
     chunkHeader.encoding = CHUNK_ENCODING_ROTATE;
     chunkHeader.length = sizeof(rct_s6_header);
-    encodedLength = sawyercoding_write_chunk_buffer(buffer, (uint8*)&_s6.header, chunkHeader);
-    SDL_RWwrite(rw, buffer, encodedLength, 1);
+    sawyercoding_writer_write_chunk(writer, &_s6.header, chunkHeader);
 
     // 1: Write scenario info chunk
     if (_s6.header.type == S6_TYPE_SCENARIO)
     {
         chunkHeader.encoding = CHUNK_ENCODING_ROTATE;
         chunkHeader.length = sizeof(rct_s6_info);
-        encodedLength = sawyercoding_write_chunk_buffer(buffer, (uint8*)&_s6.info, chunkHeader);
-        SDL_RWwrite(rw, buffer, encodedLength, 1);
+        sawyercoding_writer_write_chunk(writer, &_s6.info, chunkHeader);
     }
 
     // 2: Write packed objects
     if (_s6.header.num_packed_objects > 0)
     {
-        if (!scenario_write_packed_objects(rw))
+        if (!scenario_write_packed_objects(sawyercoding_writer_get_rw(writer)))
         {
-            free(buffer);
+            sawyercoding_writer_dispose(writer);
             throw Exception("Unable to pack objects.");
         }
     }
@@ -133,95 +138,141 @@ void S6Exporter::Save(SDL_RWops * rw, bool isScenario)
     // 3: Write available objects chunk
     chunkHeader.encoding = CHUNK_ENCODING_ROTATE;
     chunkHeader.length = OBJECT_ENTRY_COUNT * sizeof(rct_object_entry);
-    encodedLength = sawyercoding_write_chunk_buffer(buffer, (uint8*)_s6.objects, chunkHeader);
-    SDL_RWwrite(rw, buffer, encodedLength, 1);
+    sawyercoding_writer_write_chunk(writer, _s6.objects, chunkHeader);
 
     // 4: Misc fields (data, rand...) chunk
     chunkHeader.encoding = CHUNK_ENCODING_RLECOMPRESSED;
     chunkHeader.length = 16;
-    encodedLength = sawyercoding_write_chunk_buffer(buffer, (uint8*)&_s6.elapsed_months, chunkHeader);
-    SDL_RWwrite(rw, buffer, encodedLength, 1);
+    sawyercoding_writer_write_chunk(writer, &_s6.elapsed_months, chunkHeader);
 
     // 5: Map elements + sprites and other fields chunk
     chunkHeader.encoding = CHUNK_ENCODING_RLECOMPRESSED;
     chunkHeader.length = 0x180000;
-    encodedLength = sawyercoding_write_chunk_buffer(buffer, (uint8*)_s6.map_elements, chunkHeader);
-    SDL_RWwrite(rw, buffer, encodedLength, 1);
+    sawyercoding_writer_write_chunk(writer, _s6.map_elements, chunkHeader);
 
     if (_s6.header.type == S6_TYPE_SCENARIO)
     {
         // 6:
         chunkHeader.encoding = CHUNK_ENCODING_RLECOMPRESSED;
         chunkHeader.length = 0x27104C;
-        encodedLength = sawyercoding_write_chunk_buffer(buffer, (uint8*)&_s6.dword_010E63B8, chunkHeader);
-        SDL_RWwrite(rw, buffer, encodedLength, 1);
+        sawyercoding_writer_write_chunk(writer, &_s6.dword_010E63B8, chunkHeader);
 
         // 7:
         chunkHeader.encoding = CHUNK_ENCODING_RLECOMPRESSED;
         chunkHeader.length = 4;
-        encodedLength = sawyercoding_write_chunk_buffer(buffer, (uint8*)&_s6.guests_in_park, chunkHeader);
-        SDL_RWwrite(rw, buffer, encodedLength, 1);
+        sawyercoding_writer_write_chunk(writer, &_s6.guests_in_park, chunkHeader);
 
         // 8:
         chunkHeader.encoding = CHUNK_ENCODING_RLECOMPRESSED;
         chunkHeader.length = 8;
-        encodedLength = sawyercoding_write_chunk_buffer(buffer, (uint8*)&_s6.last_guests_in_park, chunkHeader);
-        SDL_RWwrite(rw, buffer, encodedLength, 1);
+        sawyercoding_writer_write_chunk(writer, &_s6.last_guests_in_park, chunkHeader);
 
         // 9:
         chunkHeader.encoding = CHUNK_ENCODING_RLECOMPRESSED;
         chunkHeader.length = 2;
-        encodedLength = sawyercoding_write_chunk_buffer(buffer, (uint8*)&_s6.park_rating, chunkHeader);
-        SDL_RWwrite(rw, buffer, encodedLength, 1);
+        sawyercoding_writer_write_chunk(writer, &_s6.park_rating, chunkHeader);
 
         // 10:
         chunkHeader.encoding = CHUNK_ENCODING_RLECOMPRESSED;
         chunkHeader.length = 1082;
-        encodedLength = sawyercoding_write_chunk_buffer(buffer, (uint8*)&_s6.active_research_types, chunkHeader);
-        SDL_RWwrite(rw, buffer, encodedLength, 1);
+        sawyercoding_writer_write_chunk(writer, &_s6.active_research_types, chunkHeader);
 
         // 11:
         chunkHeader.encoding = CHUNK_ENCODING_RLECOMPRESSED;
         chunkHeader.length = 16;
-        encodedLength = sawyercoding_write_chunk_buffer(buffer, (uint8*)&_s6.current_expenditure, chunkHeader);
-        SDL_RWwrite(rw, buffer, encodedLength, 1);
+        sawyercoding_writer_write_chunk(writer, &_s6.current_expenditure, chunkHeader);
 
         // 12:
         chunkHeader.encoding = CHUNK_ENCODING_RLECOMPRESSED;
         chunkHeader.length = 4;
-        encodedLength = sawyercoding_write_chunk_buffer(buffer, (uint8*)&_s6.park_value, chunkHeader);
-        SDL_RWwrite(rw, buffer, encodedLength, 1);
+        sawyercoding_writer_write_chunk(writer, &_s6.park_value, chunkHeader);
 
         // 13:
         chunkHeader.encoding = CHUNK_ENCODING_RLECOMPRESSED;
         chunkHeader.length = 0x761E8;
-        encodedLength = sawyercoding_write_chunk_buffer(buffer, (uint8*)&_s6.completed_company_value, chunkHeader);
-        SDL_RWwrite(rw, buffer, encodedLength, 1);
+        sawyercoding_writer_write_chunk(writer, &_s6.completed_company_value, chunkHeader);
     }
     else
     {
         // 6: Everything else...
         chunkHeader.encoding = CHUNK_ENCODING_RLECOMPRESSED;
         chunkHeader.length = 0x2E8570;
-        encodedLength = sawyercoding_write_chunk_buffer(buffer, (uint8*)&_s6.dword_010E63B8, chunkHeader);
-        SDL_RWwrite(rw, buffer, encodedLength, 1);
+        sawyercoding_writer_write_chunk(writer, &_s6.dword_010E63B8, chunkHeader);
+    }
+
+    // Append the checksum, accumulated as the chunks were written
+    bool success = sawyercoding_writer_finish(writer);
+    sawyercoding_writer_dispose(writer);
+    if (!success)
+    {
+        throw IOException("Unable to write to destination file.");
+    }
+}
+
+void S6Exporter::SavePark(SDL_RWops * rw, bool isScenario)
+{
+    SetHeader(isScenario);
+
+    ParkFileWriter writer;
+    writer.Parallel = ParallelEncoding;
+    writer.AddChunk(PARK_CHUNK_HEADER, &_s6.header, sizeof(_s6.header));
+    if (isScenario)
+    {
+        writer.AddChunk(PARK_CHUNK_INFO, &_s6.info, sizeof(_s6.info));
+    }
+    if (_s6.header.num_packed_objects > 0)
+    {
+        // Packed objects are kept in their sawyercoding encoded form
+        if (!scenario_write_packed_objects(writer.AddStreamChunk(PARK_CHUNK_PACKED_OBJECTS)))
+        {
+            throw Exception("Unable to pack objects.");
+        }
+    }
+    writer.AddChunk(PARK_CHUNK_OBJECTS, _s6.objects, sizeof(_s6.objects));
+    writer.AddChunk(PARK_CHUNK_MISC, &_s6.elapsed_months, 16);
+
+    // Map elements are reorganised before saving so the unused ones are all at the end and
+    // zeroed, only store up to the last used one
+    size_t numMapElements = Util::CountOf(_s6.map_elements);
+    static const rct_map_element EmptyMapElement = { 0 };
+    while (numMapElements > 0 && memcmp(&_s6.map_elements[numMapElements - 1], &EmptyMapElement, sizeof(rct_map_element)) == 0)
+    {
+        numMapElements--;
+    }
+
+    // Tiles that are the same as the previous one (e.g. flat grass or outside the map) are
+    // only stored once
+    std::vector<uint32> mapTiles;
+    std::vector<rct_map_element> mapElements;
+    size_t previousStart = 0;
+    size_t previousCount = 0;
+    for (size_t i = 0; i < numMapElements;)
+    {
+        size_t last = i;
+        while (last < numMapElements - 1 && !(_s6.map_elements[last].flags & MAP_ELEMENT_FLAG_LAST_TILE))
+        {
+            last++;
+        }
+        size_t count = last + 1 - i;
+        if (count == previousCount &&
+            memcmp(&_s6.map_elements[i], &_s6.map_elements[previousStart], count * sizeof(rct_map_element)) == 0)
+        {
+            mapTiles.push_back(0);
+        }
+        else
+        {
+            mapTiles.push_back((uint32)count);
+            mapElements.insert(mapElements.end(), &_s6.map_elements[i], &_s6.map_elements[last + 1]);
+        }
+        previousStart = i;
+        previousCount = count;
+        i = last + 1;
     }
+    writer.AddChunk(PARK_CHUNK_MAP_TILES, mapTiles.data(), mapTiles.size() * sizeof(uint32));
+    writer.AddChunk(PARK_CHUNK_MAP_ELEMENTS, mapElements.data(), mapElements.size() * sizeof(rct_map_element));
 
-    free(buffer);
-    
-    // Determine number of bytes written
-    size_t fileSize = (size_t)SDL_RWtell(rw);
-    SDL_RWseek(rw, 0, RW_SEEK_SET);
-
-    // Read all written bytes back into a single buffer
-    buffer = (uint8 *)malloc(fileSize);
-    SDL_RWread(rw, buffer, fileSize, 1);
-    uint32 checksum = sawyercoding_calculate_checksum(buffer, fileSize);
-    free(buffer);
-
-    // Append the checksum
-    SDL_RWseek(rw, fileSize, RW_SEEK_SET);
-    SDL_RWwrite(rw, &checksum, sizeof(uint32), 1);
+    writer.AddChunk(PARK_CHUNK_STATE, &_s6.dword_010E63B8, sizeof(_s6) - offsetof(rct_s6_data, dword_010E63B8));
+    writer.Write(rw);
 }
 
 void S6Exporter::Export()
@@ -461,22 +512,8 @@ extern "C"
         S6_SAVE_FLAG_AUTOMATIC = 1 << 31,
     };
 
-    /**
-     *
-     *  rct2: 0x006754F5
-     * @param flags bit 0: pack objects, 1: save as scenario
-     */
-    int scenario_save(SDL_RWops* rw, int flags)
+    static void scenario_save_prepare(int flags)
     {
-        if (flags & S6_SAVE_FLAG_SCENARIO)
-        {
-            log_verbose("saving scenario");
-        }
-        else
-        {
-            log_verbose("saving game");
-        }
-
         if (!(flags & S6_SAVE_FLAG_AUTOMATIC))
         {
             window_close_construction_windows();
@@ -487,6 +524,20 @@ extern "C"
         sprite_clear_all_unused();
 
         viewport_set_saved_view();
+    }
+
+    static int scenario_save_format(SDL_RWops * rw, int flags, bool parkFormat)
+    {
+        if (flags & S6_SAVE_FLAG_SCENARIO)
+        {
+            log_verbose("saving scenario");
+        }
+        else
+        {
+            log_verbose("saving game");
+        }
+
+        scenario_save_prepare(flags);
 
         bool result = false;
         auto s6exporter = new S6Exporter();
@@ -494,8 +545,13 @@ extern "C"
         {
             s6exporter->ExportObjects = (flags & S6_SAVE_FLAG_EXPORT);
             s6exporter->RemoveTracklessRides = true;
+            s6exporter->ParallelEncoding = true;
             s6exporter->Export();
-            if (flags & S6_SAVE_FLAG_SCENARIO)
+            if (parkFormat)
+            {
+                s6exporter->SavePark(rw, (flags & S6_SAVE_FLAG_SCENARIO) != 0);
+            }
+            else if (flags & S6_SAVE_FLAG_SCENARIO)
             {
                 s6exporter->SaveScenario(rw);
             }
@@ -519,6 +575,71 @@ extern "C"
         return result;
     }
 
+    /**
+     *
+     *  rct2: 0x006754F5
+     * @param flags bit 0: pack objects, 1: save as scenario
+     */
+    int scenario_save(SDL_RWops * rw, int flags)
+    {
+        return scenario_save_format(rw, flags, false);
+    }
+
+    /**
+     * Saves the park in the native park format, takes the same flags as scenario_save.
+     */
+    int scenario_save_park(SDL_RWops * rw, int flags)
+    {
+        return scenario_save_format(rw, flags, true);
+    }
+
+    struct scenario_snapshot
+    {
+        S6Exporter Exporter;
+    };
+
+    /**
+     * Captures the current game state for an automatic save. This must be called on the game
+     * thread between ticks, the snapshot can then be written from any thread.
+     */
+    scenario_snapshot * scenario_snapshot_create()
+    {
+        log_verbose("capturing snapshot for saving game");
+
+        scenario_save_prepare(S6_SAVE_FLAG_AUTOMATIC);
+
+        auto snapshot = new scenario_snapshot();
+        snapshot->Exporter.ExportObjects = false;
+        snapshot->Exporter.RemoveTracklessRides = true;
+        snapshot->Exporter.ParallelEncoding = false;
+        snapshot->Exporter.Export();
+
+        gfx_invalidate_screen();
+        return snapshot;
+    }
+
+    /**
+     * Encodes and writes a snapshot as a saved game. Only touches the snapshot, so it is safe
+     * to call from a background thread.
+     */
+    int scenario_snapshot_write(scenario_snapshot * snapshot, SDL_RWops * rw)
+    {
+        try
+        {
+            snapshot->Exporter.SaveGame(rw);
+            return 1;
+        }
+        catch (Exception)
+        {
+            return 0;
+        }
+    }
+
+    void scenario_snapshot_dispose(scenario_snapshot * snapshot)
+    {
+        delete snapshot;
+    }
+
     // Save game state without modifying any of the state for multiplayer
     int scenario_save_network(SDL_RWops * rw)
     {
@@ -529,6 +650,7 @@ extern "C"
         try
         {
             s6exporter->ExportObjects = true;
+            s6exporter->ParallelEncoding = true;
             s6exporter->Export();
             s6exporter->SaveGame(rw);
             result = true;
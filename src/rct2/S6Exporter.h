@@ -32,6 +32,8 @@ class S6Exporter
 public:
     bool ExportObjects;
     bool RemoveTracklessRides;
+    /** Encode segments of large chunks on several threads. */
+    bool ParallelEncoding;
 
     S6Exporter();
 
@@ -39,10 +41,13 @@ public:
     void SaveGame(SDL_RWops *rw);
     void SaveScenario(const utf8 * path);
     void SaveScenario(SDL_RWops *rw);
+    /** Saves in the native park format (*.park) rather than SV6 or SC6. */
+    void SavePark(SDL_RWops *rw, bool isScenario);
     void Export();
 
 private:
     rct_s6_data _s6;
 
+    void SetHeader(bool isScenario);
     void Save(SDL_RWops *rw, bool isScenario);
 };
@@ -15,8 +15,13 @@
 #pragma endregion
 
 #include "../core/Exception.hpp"
+#include "../core/Guard.hpp"
 #include "../core/IStream.hpp"
+#include "../core/Math.hpp"
+#include "../core/Memory.hpp"
+#include "../core/Util.hpp"
 #include "../network/network.h"
+#include "ParkFile.h"
 #include "S6Importer.h"
 
 extern "C"
@@ -54,6 +59,55 @@ S6Importer::S6Importer()
     memset(&_s6, 0, sizeof(_s6));
 }
 
+S6Importer::~S6Importer()
+{
+    if (_fileRW != nullptr)
+    {
+        SDL_RWclose(_fileRW);
+    }
+    Memory::Free(_fileData);
+}
+
+bool S6Importer::ReadFile(SDL_RWops * rw)
+{
+    if (_fileRW != nullptr)
+    {
+        SDL_RWclose(_fileRW);
+        _fileRW = nullptr;
+    }
+
+    // Too short to even hold a checksum, this can not be loaded even when ignoring the checksum
+    sint64 length = SDL_RWsize(rw);
+    if (length < 8 || length > INT32_MAX)
+    {
+        gErrorType = ERROR_TYPE_FILE_LOAD;
+        gGameCommandErrorTitle = STR_FILE_CONTAINS_INVALID_DATA;
+        throw IOException("Invalid SV6 file size.");
+    }
+
+    _fileLength = (size_t)length;
+    _fileData = Memory::Reallocate(_fileData, _fileLength);
+    if (_fileData == nullptr)
+    {
+        throw Exception("Unable to allocate memory for file.");
+    }
+
+    SDL_RWseek(rw, 0, RW_SEEK_SET);
+    if (SDL_RWread(rw, _fileData, _fileLength, 1) != 1)
+    {
+        throw IOException("Unable to read file.");
+    }
+
+    _fileRW = SDL_RWFromConstMem(_fileData, (int)_fileLength);
+    return sawyercoding_validate_checksum_buffer(_fileData, _fileLength);
+}
+
+void S6Importer::LoadSavedGame()
+{
+    Guard::Assert(_fileRW != nullptr);
+    LoadSavedGame(_fileRW);
+}
+
 void S6Importer::LoadSavedGame(const utf8 * path)
 {
     SDL_RWops * rw = SDL_RWFromFile(path, "rb");
@@ -62,7 +116,9 @@ void S6Importer::LoadSavedGame(const utf8 * path)
         throw IOException("Unable to open SV6.");
     }
 
-    if (!sawyercoding_validate_checksum(rw))
+    bool validChecksum = ReadFile(rw);
+    SDL_RWclose(rw);
+    if (!validChecksum)
     {
         gErrorType = ERROR_TYPE_FILE_LOAD;
         gGameCommandErrorTitle = STR_FILE_CONTAINS_INVALID_DATA;
@@ -71,13 +127,17 @@ void S6Importer::LoadSavedGame(const utf8 * path)
         throw IOException("Invalid SV6 checksum.");
     }
 
-    LoadSavedGame(rw);
-
-    SDL_RWclose(rw);
+    LoadSavedGame();
 
     _s6Path = path;
 }
 
+void S6Importer::LoadScenario()
+{
+    Guard::Assert(_fileRW != nullptr);
+    LoadScenario(_fileRW);
+}
+
 void S6Importer::LoadScenario(const utf8 * path)
 {
     SDL_RWops * rw = SDL_RWFromFile(path, "rb");
@@ -86,10 +146,10 @@ void S6Importer::LoadScenario(const utf8 * path)
         throw IOException("Unable to open SV6.");
     }
 
-    if (!gConfigGeneral.allow_loading_with_incorrect_checksum && !sawyercoding_validate_checksum(rw))
+    bool validChecksum = ReadFile(rw);
+    SDL_RWclose(rw);
+    if (!gConfigGeneral.allow_loading_with_incorrect_checksum && !validChecksum)
     {
-        SDL_RWclose(rw);
-
         gErrorType = ERROR_TYPE_FILE_LOAD;
         gErrorStringId = STR_FILE_CONTAINS_INVALID_DATA;
 
@@ -97,16 +157,14 @@ void S6Importer::LoadScenario(const utf8 * path)
         throw IOException("Invalid SC6 checksum.");
     }
 
-    LoadScenario(rw);
-
-    SDL_RWclose(rw);
+    LoadScenario();
 
     _s6Path = path;
 }
 
 void S6Importer::LoadSavedGame(SDL_RWops *rw)
 {
-    sawyercoding_read_chunk_safe(rw, &_s6.header, sizeof(_s6.header));
+    ReadChunk(rw, &_s6.header, sizeof(_s6.header));
     if (_s6.header.type != S6_TYPE_SAVEDGAME)
     {
         throw Exception("Data is not a saved game.");
@@ -119,21 +177,21 @@ void S6Importer::LoadSavedGame(SDL_RWops *rw)
         object_load_packed(rw);
     }
 
-    sawyercoding_read_chunk_safe(rw, &_s6.objects, sizeof(_s6.objects));
-    sawyercoding_read_chunk_safe(rw, &_s6.elapsed_months, 16);
-    sawyercoding_read_chunk_safe(rw, &_s6.map_elements, sizeof(_s6.map_elements));
-    sawyercoding_read_chunk_safe(rw, &_s6.dword_010E63B8, 3048816);
+    ReadChunk(rw, &_s6.objects, sizeof(_s6.objects));
+    ReadChunk(rw, &_s6.elapsed_months, 16);
+    ReadChunk(rw, &_s6.map_elements, sizeof(_s6.map_elements));
+    ReadChunk(rw, &_s6.dword_010E63B8, 3048816);
 }
 
 void S6Importer::LoadScenario(SDL_RWops *rw)
 {
-    sawyercoding_read_chunk_safe(rw, &_s6.header, sizeof(_s6.header));
+    ReadChunk(rw, &_s6.header, sizeof(_s6.header));
     if (_s6.header.type != S6_TYPE_SCENARIO)
     {
         throw Exception("Data is not a scenario.");
     }
 
-    sawyercoding_read_chunk_safe(rw, &_s6.info, sizeof(_s6.info));
+    ReadChunk(rw, &_s6.info, sizeof(_s6.info));
 
     // Read packed objects
     // TODO try to contain this more and not store objects until later
@@ -142,17 +200,171 @@ void S6Importer::LoadScenario(SDL_RWops *rw)
         object_load_packed(rw);
     }
 
-    sawyercoding_read_chunk_safe(rw, &_s6.objects, sizeof(_s6.objects));
-    sawyercoding_read_chunk_safe(rw, &_s6.elapsed_months, 16);
-    sawyercoding_read_chunk_safe(rw, &_s6.map_elements, sizeof(_s6.map_elements));
-    sawyercoding_read_chunk_safe(rw, &_s6.dword_010E63B8, 2560076);
-    sawyercoding_read_chunk_safe(rw, &_s6.guests_in_park, 4);
-    sawyercoding_read_chunk_safe(rw, &_s6.last_guests_in_park, 8);
-    sawyercoding_read_chunk_safe(rw, &_s6.park_rating, 2);
-    sawyercoding_read_chunk_safe(rw, &_s6.active_research_types, 1082);
-    sawyercoding_read_chunk_safe(rw, &_s6.current_expenditure, 16);
-    sawyercoding_read_chunk_safe(rw, &_s6.park_value, 4);
-    sawyercoding_read_chunk_safe(rw, &_s6.completed_company_value, 483816);
+    ReadChunk(rw, &_s6.objects, sizeof(_s6.objects));
+    ReadChunk(rw, &_s6.elapsed_months, 16);
+    ReadChunk(rw, &_s6.map_elements, sizeof(_s6.map_elements));
+    ReadChunk(rw, &_s6.dword_010E63B8, 2560076);
+    ReadChunk(rw, &_s6.guests_in_park, 4);
+    ReadChunk(rw, &_s6.last_guests_in_park, 8);
+    ReadChunk(rw, &_s6.park_rating, 2);
+    ReadChunk(rw, &_s6.active_research_types, 1082);
+    ReadChunk(rw, &_s6.current_expenditure, 16);
+    ReadChunk(rw, &_s6.park_value, 4);
+    ReadChunk(rw, &_s6.completed_company_value, 483816);
+}
+
+void S6Importer::LoadPark(SDL_RWops * rw)
+{
+    ParkFileReader reader;
+    reader.Parallel = true;
+    if (!reader.ReadFile(rw))
+    {
+        throw IOException("Invalid park file.");
+    }
+
+    size_t packedObjectsLength = reader.GetChunkLength(PARK_CHUNK_PACKED_OBJECTS);
+    uint8 * packedObjects = Memory::Allocate<uint8>(Math::Max<size_t>(packedObjectsLength, 1));
+    if (packedObjects == nullptr)
+    {
+        throw Exception("Unable to allocate memory for packed objects.");
+    }
+
+    // Sparse map elements are read into separate buffers and expanded afterwards, older files
+    // have the elements as they are
+    bool sparseMap = reader.HasChunk(PARK_CHUNK_MAP_TILES);
+    size_t mapTilesLength = reader.GetChunkLength(PARK_CHUNK_MAP_TILES);
+    size_t mapElementsLength = Math::Min(reader.GetChunkLength(PARK_CHUNK_MAP_ELEMENTS), sizeof(_s6.map_elements));
+    std::vector<uint32> mapTiles((mapTilesLength + sizeof(uint32) - 1) / sizeof(uint32));
+    std::vector<rct_map_element> mapElements;
+    if (sparseMap)
+    {
+        mapElements.resize((mapElementsLength + sizeof(rct_map_element) - 1) / sizeof(rct_map_element));
+    }
+
+    // Everything decodes in one go, segments of all chunks are spread across the threads
+    const ParkFileReader::Destination destinations[] =
+    {
+        { PARK_CHUNK_HEADER,         &_s6.header,         sizeof(_s6.header),                                   true  },
+        { PARK_CHUNK_INFO,           &_s6.info,           sizeof(_s6.info),                                     false },
+        { PARK_CHUNK_PACKED_OBJECTS, packedObjects,       packedObjectsLength,                                  false },
+        { PARK_CHUNK_OBJECTS,        _s6.objects,         sizeof(_s6.objects),                                  true  },
+        { PARK_CHUNK_MISC,           &_s6.elapsed_months, 16,                                                   true  },
+        { PARK_CHUNK_MAP_TILES,      mapTiles.data(),     mapTiles.size() * sizeof(uint32),                     false },
+        { PARK_CHUNK_MAP_ELEMENTS,   sparseMap ? (void *)mapElements.data() : (void *)_s6.map_elements,
+                                                          sparseMap ? mapElementsLength : sizeof(_s6.map_elements), true  },
+        { PARK_CHUNK_STATE,          &_s6.dword_010E63B8, sizeof(_s6) - offsetof(rct_s6_data, dword_010E63B8), true  },
+    };
+    if (!reader.ReadChunks(destinations, Util::CountOf(destinations)))
+    {
+        Memory::Free(packedObjects);
+        throw IOException("Invalid park file.");
+    }
+    if (_s6.header.type != S6_TYPE_SAVEDGAME && _s6.header.type != S6_TYPE_SCENARIO)
+    {
+        Memory::Free(packedObjects);
+        throw Exception("Data is not a saved game or scenario.");
+    }
+    if (sparseMap && (mapTilesLength % sizeof(uint32) != 0 ||
+                      mapElementsLength % sizeof(rct_map_element) != 0 ||
+                      !ExpandMapElements(mapTiles.data(), mapTiles.size(), mapElements.data(), mapElements.size())))
+    {
+        Memory::Free(packedObjects);
+        throw IOException("Invalid park file.");
+    }
+
+    // Every packed object is an entry followed by a chunk, they must take up the whole of the
+    // packed objects chunk before any of them are installed
+    size_t packedObjectsPosition = 0;
+    for (uint16 i = 0; i < _s6.header.num_packed_objects; i++)
+    {
+        size_t headerEnd = packedObjectsPosition + sizeof(rct_object_entry) + sizeof(sawyercoding_chunk_header);
+        if (headerEnd > packedObjectsLength)
+        {
+            packedObjectsPosition = SIZE_MAX;
+            break;
+        }
+        sawyercoding_chunk_header chunkHeader;
+        memcpy(&chunkHeader, packedObjects + packedObjectsPosition + sizeof(rct_object_entry), sizeof(chunkHeader));
+        packedObjectsPosition = headerEnd + chunkHeader.length;
+    }
+    if (packedObjectsPosition != packedObjectsLength)
+    {
+        Memory::Free(packedObjects);
+        throw IOException("Invalid park file.");
+    }
+
+    // Packed objects are added to the object repository, so they are installed on this thread
+    SDL_RWops * packedObjectsRW = SDL_RWFromConstMem(packedObjects, (int)packedObjectsLength);
+    for (uint16 i = 0; i < _s6.header.num_packed_objects; i++)
+    {
+        object_load_packed(packedObjectsRW);
+    }
+    SDL_RWclose(packedObjectsRW);
+    Memory::Free(packedObjects);
+}
+
+/**
+ * Expands the sparse map elements of a park file into the map element array. Returns false if
+ * the tiles do not match the elements or need more elements than the array holds.
+ */
+bool S6Importer::ExpandMapElements(const uint32 * tiles, size_t numTiles, const rct_map_element * elements, size_t numElements)
+{
+    const size_t maxMapElements = Util::CountOf(_s6.map_elements);
+    size_t src = 0;
+    size_t dst = 0;
+    size_t previousStart = 0;
+    size_t previousCount = 0;
+    for (size_t i = 0; i < numTiles; i++)
+    {
+        size_t count = tiles[i] != 0 ? tiles[i] : previousCount;
+        if (count == 0 || count > maxMapElements - dst)
+        {
+            return false;
+        }
+
+        if (tiles[i] != 0)
+        {
+            if (count > numElements - src)
+            {
+                return false;
+            }
+            memcpy(&_s6.map_elements[dst], &elements[src], count * sizeof(rct_map_element));
+            src += count;
+        }
+        else
+        {
+            memcpy(&_s6.map_elements[dst], &_s6.map_elements[previousStart], count * sizeof(rct_map_element));
+        }
+        previousStart = dst;
+        previousCount = count;
+        dst += count;
+    }
+    if (src != numElements)
+    {
+        return false;
+    }
+
+    memset(&_s6.map_elements[dst], 0, (maxMapElements - dst) * sizeof(rct_map_element));
+    return true;
+}
+
+void S6Importer::ReadChunk(SDL_RWops * rw, void * dst, size_t dstLength)
+{
+    if (rw == _fileRW)
+    {
+        // Decode directly from the in-memory copy of the file, then skip over the chunk
+        size_t position = (size_t)SDL_RWtell(rw);
+        size_t chunkLength = sawyercoding_decode_chunk_safe(_fileData + position, _fileLength - position, dst, dstLength);
+        if (chunkLength == 0)
+        {
+            throw IOException("Invalid chunk.");
+        }
+        SDL_RWseek(rw, chunkLength, RW_SEEK_CUR);
+    }
+    else if (!sawyercoding_read_chunk_safe(rw, dst, dstLength))
+    {
+        throw IOException("Invalid chunk.");
+    }
 }
 
 void S6Importer::Import()
@@ -387,21 +599,49 @@ extern "C"
      */
     int game_load_sv6(SDL_RWops * rw)
     {
-        if (!sawyercoding_validate_checksum(rw))
+        bool result = false;
+        auto s6Importer = new S6Importer();
+        try
         {
-            log_error("invalid checksum");
+            if (!s6Importer->ReadFile(rw))
+            {
+                log_error("invalid checksum");
 
-            gErrorType = ERROR_TYPE_FILE_LOAD;
-            gGameCommandErrorTitle = STR_FILE_CONTAINS_INVALID_DATA;
-            return 0;
+                gErrorType = ERROR_TYPE_FILE_LOAD;
+                gGameCommandErrorTitle = STR_FILE_CONTAINS_INVALID_DATA;
+                delete s6Importer;
+                return 0;
+            }
+
+            s6Importer->FixIssues = true;
+            s6Importer->LoadSavedGame();
+            s6Importer->Import();
+
+            openrct2_reset_object_tween_locations();
+            result = true;
+        }
+        catch (ObjectLoadException)
+        {
         }
+        catch (Exception)
+        {
+        }
+        delete s6Importer;
 
+        // #2407: Resetting screen time to not open a save prompt shortly after loading a park.
+        gScreenAge = 0;
+        gLastAutoSaveTick = SDL_GetTicks();
+        return result;
+    }
+
+    int game_load_park(SDL_RWops * rw)
+    {
         bool result = false;
         auto s6Importer = new S6Importer();
         try
         {
             s6Importer->FixIssues = true;
-            s6Importer->LoadSavedGame(rw);
+            s6Importer->LoadPark(rw);
             s6Importer->Import();
 
             openrct2_reset_object_tween_locations();
@@ -412,10 +652,11 @@ extern "C"
         }
         catch (Exception)
         {
+            gErrorType = ERROR_TYPE_FILE_LOAD;
+            gGameCommandErrorTitle = STR_FILE_CONTAINS_INVALID_DATA;
         }
         delete s6Importer;
 
-        // #2407: Resetting screen time to not open a save prompt shortly after loading a park.
         gScreenAge = 0;
         gLastAutoSaveTick = SDL_GetTicks();
         return result;
@@ -32,15 +32,34 @@ public:
     bool FixIssues;
 
     S6Importer();
+    ~S6Importer();
 
+    /**
+     * Reads the whole of the given stream into memory with a single read and validates the
+     * file checksum. The parameterless LoadSavedGame and LoadScenario then decode each chunk
+     * straight from this copy into its destination.
+     */
+    bool ReadFile(SDL_RWops * rw);
+
+    void LoadSavedGame();
     void LoadSavedGame(const utf8 * path);
     void LoadSavedGame(SDL_RWops *rw);
+    void LoadScenario();
     void LoadScenario(const utf8 * path);
     void LoadScenario(SDL_RWops *rw);
+    /** Loads a saved game or scenario in the native park format (*.park). */
+    void LoadPark(SDL_RWops *rw);
     void Import();
 
 private:
     const utf8 * _s6Path = nullptr;
     rct_s6_data  _s6;
     uint8        _gameVersion = 0;
+
+    uint8 *      _fileData = nullptr;
+    size_t       _fileLength = 0;
+    SDL_RWops *  _fileRW = nullptr;
+
+    void ReadChunk(SDL_RWops * rw, void * dst, size_t dstLength);
+    bool ExpandMapElements(const uint32 * tiles, size_t numTiles, const rct_map_element * elements, size_t numElements);
 };
@@ -0,0 +1,358 @@
+#pragma region Copyright (c) 2014-2016 OpenRCT2 Developers
+/*****************************************************************************
+ * OpenRCT2, an open source clone of Roller Coaster Tycoon 2.
+ *
+ * OpenRCT2 is the work of many authors, a full list can be found in contributors.md
+ * For more information, visit https://github.com/OpenRCT2/OpenRCT2
+ *
+ * OpenRCT2 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * A full copy of the GNU General Public License can be found in licence.txt
+ *****************************************************************************/
+#pragma endregion
+
+
+#include <vector>
+#include <SDL.h>
+#include "core/Console.hpp"
+#include "core/Memory.hpp"
+#include "network/NetworkStateHash.h"
+
+extern "C"
+{
+    #include "game.h"
+    #include "replay.h"
+    #include "scenario.h"
+}
+
+constexpr uint32 REPLAY_MAGIC   = 0x4C50524F;   // ORPL
+constexpr uint16 REPLAY_VERSION = 1;
+
+enum REPLAY_RECORD
+{
+    REPLAY_RECORD_COMMAND,
+    REPLAY_RECORD_HASHES,
+    REPLAY_RECORD_END,
+};
+
+#pragma pack(push, 1)
+struct ReplayHeader
+{
+    uint32 Magic;
+    uint16 Version;
+    uint16 NumComponents;
+    uint32 StartTick;
+    uint32 ParkLength;
+};
+assert_struct_size(ReplayHeader, 16);
+
+struct ReplayCommand
+{
+    uint32 Tick;
+    sint32 PlayerId;
+    sint32 Command;
+    sint32 Eax;
+    sint32 Ebx;
+    sint32 Ecx;
+    sint32 Edx;
+    sint32 Edi;
+    sint32 Ebp;
+};
+assert_struct_size(ReplayCommand, 36);
+#pragma pack(pop)
+
+static SDL_RWops * _recordFile = nullptr;
+
+static bool                             _playing = false;
+static bool                             _playbackVerify = false;
+static uint32                           _playbackEndTick = 0;
+static std::vector<ReplayCommand>       _playbackCommands;
+static std::vector<NetworkStateHashes>  _playbackHashes;
+static size_t                           _playbackNextCommand = 0;
+static size_t                           _playbackNextHashes = 0;
+static replay_stats                     _playbackStats;
+
+static void WriteHashes(SDL_RWops * file, uint32 tick)
+{
+    NetworkStateHashes hashes;
+    NetworkStateCompute(&hashes);
+    SDL_WriteU8(file, REPLAY_RECORD_HASHES);
+    SDL_RWwrite(file, &tick, sizeof(tick), 1);
+    SDL_RWwrite(file, hashes.Hashes, sizeof(hashes.Hashes), 1);
+}
+
+static void RunCommands(uint32 tick)
+{
+    while (_playbackNextCommand < _playbackCommands.size() &&
+           _playbackCommands[_playbackNextCommand].Tick <= tick)
+    {
+        ReplayCommand command = _playbackCommands[_playbackNextCommand++];
+        int esi = command.Command;
+        game_command_playerid = command.PlayerId;
+        game_command_callback = 0;
+        game_do_command_p(command.Command, &command.Eax, &command.Ebx, &command.Ecx, &command.Edx, &esi, &command.Edi, &command.Ebp);
+        game_command_playerid = -1;
+        _playbackStats.commands++;
+    }
+}
+
+static void VerifyHashes(uint32 tick)
+{
+    while (_playbackNextHashes < _playbackHashes.size() &&
+           _playbackHashes[_playbackNextHashes].Tick < tick)
+    {
+        _playbackNextHashes++;
+    }
+    if (_playbackNextHashes >= _playbackHashes.size() ||
+        _playbackHashes[_playbackNextHashes].Tick != tick)
+    {
+        return;
+    }
+
+    uint64 startTime = SDL_GetPerformanceCounter();
+    const NetworkStateHashes &recorded = _playbackHashes[_playbackNextHashes++];
+    NetworkStateHashes hashes;
+    NetworkStateCompute(&hashes);
+    _playbackStats.checkpoints++;
+
+    std::string names;
+    for (uint32 i = 0; i < NETWORK_STATE_COMPONENT_COUNT; i++)
+    {
+        if (hashes.Hashes[i] != recorded.Hashes[i])
+        {
+            names += " " + NetworkStateGetComponentName(i);
+        }
+    }
+    if (!names.empty())
+    {
+        if (_playbackStats.mismatches == 0)
+        {
+            _playbackStats.first_mismatch_tick = tick;
+            Console::Error::WriteLine("State differs from the recording at tick %u in:%s", tick, names.c_str());
+        }
+        _playbackStats.mismatches++;
+    }
+    _playbackStats.verify_time += SDL_GetPerformanceCounter() - startTime;
+}
+
+extern "C"
+{
+    bool replay_start_recording(const utf8 * path)
+    {
+        replay_stop_recording();
+
+        SDL_RWops * file = SDL_RWFromFile(path, "wb");
+        if (file == nullptr)
+        {
+            log_error("Unable to create replay '%s'.", path);
+            return false;
+        }
+
+        ReplayHeader header = { 0 };
+        header.Magic = REPLAY_MAGIC;
+        header.Version = REPLAY_VERSION;
+        header.NumComponents = NETWORK_STATE_COMPONENT_COUNT;
+        header.StartTick = gCurrentTicks;
+        SDL_RWwrite(file, &header, sizeof(header), 1);
+
+        // The length of the park is only known once it has been written
+        sint64 parkPosition = SDL_RWtell(file);
+        if (!scenario_save_network(file))
+        {
+            log_error("Unable to save the park to the replay.");
+            SDL_RWclose(file);
+            return false;
+        }
+        sint64 endPosition = SDL_RWtell(file);
+        header.ParkLength = (uint32)(endPosition - parkPosition);
+        SDL_RWseek(file, 0, RW_SEEK_SET);
+        SDL_RWwrite(file, &header, sizeof(header), 1);
+        SDL_RWseek(file, endPosition, RW_SEEK_SET);
+
+        _recordFile = file;
+
+        // Loading the park for playback resets the sprite order, so reset it here as well. It is
+        // recorded as the first command and sent to the other players in multiplayer.
+        game_do_command(0, GAME_COMMAND_FLAG_APPLY, 0, 0, GAME_COMMAND_RESET_SPRITES, 0, 0);
+        return true;
+    }
+
+    void replay_stop_recording()
+    {
+        if (_recordFile != nullptr)
+        {
+            uint32 endTick = gCurrentTicks;
+            SDL_WriteU8(_recordFile, REPLAY_RECORD_END);
+            SDL_RWwrite(_recordFile, &endTick, sizeof(endTick), 1);
+            SDL_RWclose(_recordFile);
+            _recordFile = nullptr;
+        }
+    }
+
+    bool replay_is_recording()
+    {
+        return _recordFile != nullptr;
+    }
+
+    void replay_record_command(int command, int eax, int ebx, int ecx, int edx, int edi, int ebp, int playerId)
+    {
+        if (_recordFile == nullptr)
+        {
+            return;
+        }
+
+        SDL_WriteU8(_recordFile, REPLAY_RECORD_COMMAND);
+        ReplayCommand record;
+        record.Tick = gCurrentTicks;
+        record.PlayerId = playerId;
+        record.Command = command;
+        record.Eax = eax;
+        record.Ebx = ebx;
+        record.Ecx = ecx;
+        record.Edx = edx;
+        record.Edi = edi;
+        record.Ebp = ebp;
+        SDL_RWwrite(_recordFile, &record, sizeof(record), 1);
+    }
+
+    bool replay_start_playback(const utf8 * path, bool verify)
+    {
+        replay_stop_playback();
+
+        SDL_RWops * file = SDL_RWFromFile(path, "rb");
+        if (file == nullptr)
+        {
+            Console::Error::WriteLine("Unable to open '%s'.", path);
+            return false;
+        }
+
+        ReplayHeader header;
+        if (SDL_RWread(file, &header, sizeof(header), 1) != 1 || header.Magic != REPLAY_MAGIC)
+        {
+            Console::Error::WriteLine("'%s' is not a replay.", path);
+            SDL_RWclose(file);
+            return false;
+        }
+        if (header.Version != REPLAY_VERSION || header.NumComponents != NETWORK_STATE_COMPONENT_COUNT)
+        {
+            Console::Error::WriteLine("'%s' was recorded by an incompatible version.", path);
+            SDL_RWclose(file);
+            return false;
+        }
+
+        uint8 * park = Memory::Allocate<uint8>(header.ParkLength);
+        bool loaded = false;
+        if (SDL_RWread(file, park, header.ParkLength, 1) == 1)
+        {
+            SDL_RWops * parkRW = SDL_RWFromConstMem(park, header.ParkLength);
+            loaded = game_load_network(parkRW) != 0;
+            SDL_RWclose(parkRW);
+        }
+        Memory::Free(park);
+        if (!loaded)
+        {
+            Console::Error::WriteLine("Unable to load the park of '%s'.", path);
+            SDL_RWclose(file);
+            return false;
+        }
+
+        // Read everything up front so that file access does not count towards the playback, a
+        // recording that was cut off (e.g. by a crash) plays up to its last complete record. The
+        // end tick is the first tick that is not played.
+        uint32 endTick = header.StartTick;
+        bool ended = false;
+        uint8 type;
+        while (!ended && SDL_RWread(file, &type, sizeof(type), 1) == 1)
+        {
+            if (type == REPLAY_RECORD_COMMAND)
+            {
+                ReplayCommand command;
+                if (SDL_RWread(file, &command, sizeof(command), 1) != 1)
+                {
+                    break;
+                }
+                _playbackCommands.push_back(command);
+                endTick = command.Tick + 1;
+            }
+            else if (type == REPLAY_RECORD_HASHES)
+            {
+                NetworkStateHashes hashes;
+                if (SDL_RWread(file, &hashes.Tick, sizeof(hashes.Tick), 1) != 1 ||
+                    SDL_RWread(file, hashes.Hashes, sizeof(hashes.Hashes), 1) != 1)
+                {
+                    break;
+                }
+                _playbackHashes.push_back(hashes);
+                endTick = hashes.Tick + 1;
+            }
+            else if (type == REPLAY_RECORD_END)
+            {
+                ended = SDL_RWread(file, &endTick, sizeof(endTick), 1) == 1;
+            }
+            else
+            {
+                break;
+            }
+        }
+        SDL_RWclose(file);
+
+        if (!ended)
+        {
+            Console::WriteLine("The replay was not stopped properly, playing up to tick %u.", endTick - 1);
+        }
+
+        _playing = true;
+        _playbackVerify = verify;
+        _playbackEndTick = endTick;
+        return true;
+    }
+
+    void replay_stop_playback()
+    {
+        _playing = false;
+        _playbackCommands.clear();
+        _playbackCommands.shrink_to_fit();
+        _playbackHashes.clear();
+        _playbackHashes.shrink_to_fit();
+        _playbackNextCommand = 0;
+        _playbackNextHashes = 0;
+        _playbackStats = { 0 };
+    }
+
+    bool replay_is_playing()
+    {
+        return _playing;
+    }
+
+    uint32 replay_get_end_tick()
+    {
+        return _playbackEndTick;
+    }
+
+    const replay_stats * replay_get_stats()
+    {
+        return &_playbackStats;
+    }
+
+    void replay_update()
+    {
+        if (_recordFile != nullptr)
+        {
+            if (gCurrentTicks % REPLAY_HASH_INTERVAL == 0)
+            {
+                WriteHashes(_recordFile, gCurrentTicks);
+            }
+        }
+        else if (_playing)
+        {
+            RunCommands(gCurrentTicks);
+            if (_playbackVerify)
+            {
+                VerifyHashes(gCurrentTicks);
+            }
+        }
+    }
+}
@@ -0,0 +1,55 @@
+#pragma region Copyright (c) 2014-2016 OpenRCT2 Developers
+/*****************************************************************************
+ * OpenRCT2, an open source clone of Roller Coaster Tycoon 2.
+ *
+ * OpenRCT2 is the work of many authors, a full list can be found in contributors.md
+ * For more information, visit https://github.com/OpenRCT2/OpenRCT2
+ *
+ * OpenRCT2 is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * A full copy of the GNU General Public License can be found in licence.txt
+ *****************************************************************************/
+#pragma endregion
+
+
+#ifndef _REPLAY_H_
+#define _REPLAY_H_
+
+#include "common.h"
+
+/**
+ * A replay is the park as it was when the recording started, followed by every game command
+ * that was executed, keyed by tick and player, and the state hashes of every
+ * REPLAY_HASH_INTERVAL ticks. Playing it back runs the same simulation again without any input.
+ */
+#define REPLAY_HASH_INTERVAL 100
+
+typedef struct replay_stats {
+	uint32 commands;
+	uint32 checkpoints;
+	uint32 mismatches;
+	uint32 first_mismatch_tick;
+	uint64 verify_time;			// Performance counter ticks spent hashing the state
+} replay_stats;
+
+bool replay_start_recording(const utf8 *path);
+void replay_stop_recording();
+bool replay_is_recording();
+void replay_record_command(int command, int eax, int ebx, int ecx, int edx, int edi, int ebp, int playerId);
+
+bool replay_start_playback(const utf8 *path, bool verify);
+void replay_stop_playback();
+bool replay_is_playing();
+uint32 replay_get_end_tick();
+const replay_stats *replay_get_stats();
+
+/**
+ * Called once per tick before the game logic, records or checks the state hashes and runs the
+ * commands of the tick that is being played back.
+ */
+void replay_update();
+
+#endif
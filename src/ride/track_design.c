@@ -23,6 +23,7 @@
 #include "../management/finance.h"
 #include "../network/network.h"
 #include "../object/ObjectManager.h"
+#include "../object/ObjectRepository.h"
 #include "../rct1.h"
 #include "../util/sawyercoding.h"
 #include "../util/util.h"
@@ -36,7 +37,8 @@
 #include "track.h"
 
 typedef struct map_backup {
-	rct_map_element map_elements[MAX_MAP_ELEMENTS];
+	rct_map_element *map_elements;		// Only the used part of the element pool
+	size_t num_map_elements;
 	rct_map_element *tile_pointers[256 * 256];
 	rct_map_element *next_free_map_element;
 	uint16 map_size_units;
@@ -45,6 +47,31 @@ typedef struct map_backup {
 	uint8 current_rotation;
 } map_backup;
 
+#define TRACK_PREVIEW_CACHE_MAGIC 0x56504454 // TDPV
+#define TRACK_PREVIEW_CACHE_VERSION 1
+
+// The oldest previews are removed once the cache grows beyond this size
+#define TRACK_PREVIEW_CACHE_MAX_SIZE (16 * 1024 * 1024)
+
+#pragma pack(push, 1)
+// Header of a rendered preview saved in the track preview cache, followed by the deflated pixels
+typedef struct track_preview_cache_header {
+	uint32 magic;
+	uint16 version;
+	uint64 key;
+	money32 cost;
+	uint8 track_flags;
+	uint32 compressed_size;
+} track_preview_cache_header;
+assert_struct_size(track_preview_cache_header, 23);
+#pragma pack(pop)
+
+typedef struct track_preview_cache_file {
+	utf8 name[MAX_PATH];
+	uint64 size;
+	uint64 last_modified;
+} track_preview_cache_file;
+
 static rct_track_td6 *track_design_open_from_buffer(uint8 *src, size_t srcLength);
 
 rct_track_td6 *gActiveTrackDesign;
@@ -62,6 +89,12 @@ static money32 _trackDesignPlaceCost;
 static sint16 _trackDesignPlaceZ;
 static sint16 word_F44129;
 
+static bool track_design_render_preview(rct_track_td6 *td6, uint8 *pixels);
+static uint64 track_design_preview_get_cache_key(const rct_track_td6 *td6);
+static void track_design_preview_get_cache_path(utf8 *buffer, size_t bufferSize, uint64 key);
+static bool track_design_preview_read_cache(rct_track_td6 *td6, uint8 *pixels, uint64 key);
+static void track_design_preview_write_cache(const rct_track_td6 *td6, const uint8 *pixels, uint64 key);
+static void track_design_preview_trim_cache(const utf8 *directory, uint64 newSize);
 static map_backup *track_design_preview_backup_map();
 static void track_design_preview_restore_map(map_backup *backup);
 static void track_design_preview_clear_map();
@@ -1652,16 +1685,31 @@ void game_command_place_maze_design(int* eax, int* ebx, int* ecx, int* edx, int*
 
 #pragma region Track Design Preview
 
+/**
+ * Draws the four rotations of a track design preview, using the preview cache if the same
+ * design has been drawn before.
+ */
+void track_design_draw_preview(rct_track_td6 *td6, uint8 *pixels)
+{
+	uint64 key = track_design_preview_get_cache_key(td6);
+	if (track_design_preview_read_cache(td6, pixels, key)) {
+		return;
+	}
+	if (track_design_render_preview(td6, pixels)) {
+		track_design_preview_write_cache(td6, pixels, key);
+	}
+}
+
 /**
  *
  *  rct2: 0x006D1EF0
  */
-void track_design_draw_preview(rct_track_td6 *td6, uint8 *pixels)
+static bool track_design_render_preview(rct_track_td6 *td6, uint8 *pixels)
 {
 	// Make a copy of the map
 	map_backup *mapBackup = track_design_preview_backup_map();
 	if (mapBackup == NULL) {
-		return;
+		return false;
 	}
 	track_design_preview_clear_map();
 
@@ -1675,7 +1723,7 @@ void track_design_draw_preview(rct_track_td6 *td6, uint8 *pixels)
 	if (!sub_6D2189(td6, &cost, &rideIndex, &flags)) {
 		memset(pixels, 0, TRACK_PREVIEW_IMAGE_SIZE * 4);
 		track_design_preview_restore_map(mapBackup);
-		return;
+		return false;
 	}
 	td6->cost = cost;
 	td6->track_flags = flags & 7;
@@ -1783,21 +1831,223 @@ void track_design_draw_preview(rct_track_td6 *td6, uint8 *pixels)
 
 	ride_delete(rideIndex);
 	track_design_preview_restore_map(mapBackup);
+	return true;
+}
+
+/**
+ * Checks whether an object used by a track design will be available when the preview is drawn.
+ * The track manager loads the objects of each design from the object repository, in a park
+ * only the objects loaded by the park can be used.
+ */
+static bool track_design_preview_is_object_available(const rct_object_entry *entry)
+{
+	if (gScreenFlags & SCREEN_FLAGS_TRACK_MANAGER) {
+		return object_repository_find_object_by_entry(entry) != NULL;
+	} else {
+		uint8 entryType, entryIndex;
+		return find_object_in_entry_group(entry, &entryType, &entryIndex) != 0;
+	}
+}
+
+static uint64 track_design_preview_hash(uint64 hash, const uint8 *data, size_t length)
+{
+	// FNV-1a
+	for (size_t i = 0; i < length; i++) {
+		hash ^= data[i];
+		hash *= 0x100000001B3ULL;
+	}
+	return hash;
+}
+
+/**
+ * Gets a hash of the track design data, excluding the cost and flags that are filled in by
+ * drawing the preview, of the settings that change how the preview is drawn and of which of
+ * the objects used by the design are available, as missing objects are left out of the preview
+ * and change the flags.
+ */
+static uint64 track_design_preview_get_cache_key(const rct_track_td6 *td6)
+{
+	rct_track_td6 header = *td6;
+	header.cost = 0;
+	header.track_flags = 0;
+
+	uint8 settings[2];
+	settings[0] = (gScreenFlags & SCREEN_FLAGS_TRACK_MANAGER) ? 1 : 0;
+	settings[1] = gTrackDesignSceneryToggle ? 1 : 0;
+
+	uint64 hash = 0xCBF29CE484222325ULL;
+	hash = track_design_preview_hash(hash, (const uint8*)&header, offsetof(rct_track_td6, elements));
+	hash = track_design_preview_hash(hash, (const uint8*)td6->elements, td6->elementsSize);
+	hash = track_design_preview_hash(hash, settings, sizeof(settings));
+
+	uint8 available = track_design_preview_is_object_available(&td6->vehicle_object) ? 1 : 0;
+	hash = track_design_preview_hash(hash, &available, sizeof(available));
+	rct_td6_scenery_element *scenery = td6->scenery_elements;
+	for (; (scenery->scenery_object.flags & 0xFF) != 0xFF; scenery++) {
+		available = track_design_preview_is_object_available(&scenery->scenery_object) ? 1 : 0;
+		hash = track_design_preview_hash(hash, &available, sizeof(available));
+	}
+	return hash;
+}
+
+static void track_design_preview_get_cache_path(utf8 *buffer, size_t bufferSize, uint64 key)
+{
+	char fileName[32];
+	snprintf(fileName, sizeof(fileName), "%08X%08X.dat", (uint32)(key >> 32), (uint32)key);
+
+	platform_get_user_directory(buffer, "trackpreviews");
+	safe_strcat_path(buffer, fileName, bufferSize);
+}
+
+static bool track_design_preview_read_cache(rct_track_td6 *td6, uint8 *pixels, uint64 key)
+{
+	utf8 path[MAX_PATH];
+	track_design_preview_get_cache_path(path, sizeof(path), key);
+
+	SDL_RWops *file = SDL_RWFromFile(path, "rb");
+	if (file == NULL) {
+		return false;
+	}
+
+	bool result = false;
+	track_preview_cache_header header;
+	if (SDL_RWread(file, &header, sizeof(header), 1) == 1 &&
+		header.magic == TRACK_PREVIEW_CACHE_MAGIC &&
+		header.version == TRACK_PREVIEW_CACHE_VERSION &&
+		header.key == key &&
+		header.compressed_size <= SDL_RWsize(file) - sizeof(header)
+	) {
+		uint8 *compressed = malloc(header.compressed_size);
+		if (compressed != NULL && SDL_RWread(file, compressed, header.compressed_size, 1) == 1) {
+			size_t pixelsLength = TRACK_PREVIEW_IMAGE_SIZE * 4;
+			uint8 *decompressed = util_zlib_inflate(compressed, header.compressed_size, &pixelsLength);
+			if (decompressed != NULL) {
+				if (pixelsLength == TRACK_PREVIEW_IMAGE_SIZE * 4) {
+					memcpy(pixels, decompressed, pixelsLength);
+					td6->cost = header.cost;
+					td6->track_flags = header.track_flags;
+					result = true;
+				}
+				free(decompressed);
+			}
+		}
+		free(compressed);
+	}
+	SDL_RWclose(file);
+	return result;
+}
+
+static void track_design_preview_write_cache(const rct_track_td6 *td6, const uint8 *pixels, uint64 key)
+{
+	utf8 path[MAX_PATH];
+	platform_get_user_directory(path, "trackpreviews");
+	if (!platform_ensure_directory_exists(path)) {
+		return;
+	}
+
+	size_t compressedLength = 0;
+	uint8 *compressed = util_zlib_deflate((uint8*)pixels, TRACK_PREVIEW_IMAGE_SIZE * 4, &compressedLength);
+	if (compressed == NULL) {
+		return;
+	}
+
+	track_design_preview_trim_cache(path, sizeof(track_preview_cache_header) + compressedLength);
+	track_design_preview_get_cache_path(path, sizeof(path), key);
+
+	SDL_RWops *file = SDL_RWFromFile(path, "wb");
+	if (file != NULL) {
+		track_preview_cache_header header;
+		header.magic = TRACK_PREVIEW_CACHE_MAGIC;
+		header.version = TRACK_PREVIEW_CACHE_VERSION;
+		header.key = key;
+		header.cost = td6->cost;
+		header.track_flags = td6->track_flags;
+		header.compressed_size = (uint32)compressedLength;
+		SDL_RWwrite(file, &header, sizeof(header), 1);
+		SDL_RWwrite(file, compressed, compressedLength, 1);
+		SDL_RWclose(file);
+	}
+	free(compressed);
+}
+
+static int track_design_preview_cache_file_compare(const void *a, const void *b)
+{
+	const track_preview_cache_file *fileA = (const track_preview_cache_file*)a;
+	const track_preview_cache_file *fileB = (const track_preview_cache_file*)b;
+	if (fileA->last_modified != fileB->last_modified) {
+		return fileA->last_modified < fileB->last_modified ? -1 : 1;
+	}
+	return strcmp(fileA->name, fileB->name);
+}
+
+/**
+ * Removes the oldest previews until a new one of the given size fits within
+ * TRACK_PREVIEW_CACHE_MAX_SIZE.
+ */
+static void track_design_preview_trim_cache(const utf8 *directory, uint64 newSize)
+{
+	utf8 pattern[MAX_PATH];
+	safe_strcpy(pattern, directory, sizeof(pattern));
+	safe_strcat_path(pattern, "*.dat", sizeof(pattern));
+
+	track_preview_cache_file *files = NULL;
+	size_t numFiles = 0;
+	size_t capacity = 0;
+	uint64 totalSize = newSize;
+
+	file_info fileInfo;
+	int handle = platform_enumerate_files_begin(pattern);
+	while (platform_enumerate_files_next(handle, &fileInfo)) {
+		if (numFiles >= capacity) {
+			capacity = max(64, capacity * 2);
+			track_preview_cache_file *newFiles = realloc(files, capacity * sizeof(track_preview_cache_file));
+			if (newFiles == NULL) {
+				break;
+			}
+			files = newFiles;
+		}
+		track_preview_cache_file *cacheFile = &files[numFiles++];
+		safe_strcpy(cacheFile->name, fileInfo.path, sizeof(cacheFile->name));
+		cacheFile->size = fileInfo.size;
+		cacheFile->last_modified = fileInfo.last_modified;
+		totalSize += fileInfo.size;
+	}
+	platform_enumerate_files_end(handle);
+
+	if (totalSize > TRACK_PREVIEW_CACHE_MAX_SIZE) {
+		qsort(files, numFiles, sizeof(track_preview_cache_file), track_design_preview_cache_file_compare);
+		for (size_t i = 0; i < numFiles && totalSize > TRACK_PREVIEW_CACHE_MAX_SIZE; i++) {
+			utf8 path[MAX_PATH];
+			safe_strcpy(path, directory, sizeof(path));
+			safe_strcat_path(path, files[i].name, sizeof(path));
+			if (platform_file_delete(path)) {
+				totalSize -= files[i].size;
+			}
+		}
+	}
+	free(files);
 }
 
 /**
  * Create a backup of the map as it will be cleared for drawing the track
- * design preview.
+ * design preview. Only the elements in use are copied, the free space after
+ * them is cleared again on restore.
  *  rct2: 0x006D1C68
  */
 static map_backup *track_design_preview_backup_map()
 {
 	map_backup *backup = malloc(sizeof(map_backup));
 	if (backup != NULL) {
+		backup->num_map_elements = (size_t)(gNextFreeMapElement - gMapElements);
+		backup->map_elements = malloc(backup->num_map_elements * sizeof(rct_map_element));
+		if (backup->map_elements == NULL) {
+			free(backup);
+			return NULL;
+		}
 		memcpy(
 			backup->map_elements,
 			gMapElements,
-			sizeof(backup->map_elements)
+			backup->num_map_elements * sizeof(rct_map_element)
 		);
 		memcpy(
 			backup->tile_pointers,
@@ -1819,11 +2069,19 @@ static map_backup *track_design_preview_backup_map()
  */
 static void track_design_preview_restore_map(map_backup *backup)
 {
+	size_t numPreviewElements = (size_t)(gNextFreeMapElement - gMapElements);
 	memcpy(
 		gMapElements,
 		backup->map_elements,
-		sizeof(backup->map_elements)
+		backup->num_map_elements * sizeof(rct_map_element)
 	);
+	if (numPreviewElements > backup->num_map_elements) {
+		memset(
+			gMapElements + backup->num_map_elements,
+			0,
+			(numPreviewElements - backup->num_map_elements) * sizeof(rct_map_element)
+		);
+	}
 	memcpy(
 		gMapElementTilePointers,
 		backup->tile_pointers,
@@ -1835,6 +2093,7 @@ static void track_design_preview_restore_map(map_backup *backup)
 	gMapSize = backup->map_size;
 	gCurrentRotation = backup->current_rotation;
 
+	free(backup->map_elements);
 	free(backup);
 }
 
@@ -200,6 +200,7 @@ utf8 *track_design_get_name_from_path(const utf8 *path);
 bool track_design_index_rename(const utf8 *path, const utf8 *newName);
 bool track_design_index_delete(const utf8 *path);
 bool track_design_index_install(const utf8 *srcPath, const utf8 *destPath);
+void track_design_index_add(const utf8 *path, const rct_track_td6 *td6);
 
 void game_command_place_track_design(int* eax, int* ebx, int* ecx, int* edx, int* esi, int* edi, int* ebp);
 void game_command_place_maze_design(int* eax, int* ebx, int* ecx, int* edx, int* esi, int* edi, int* ebp);
@@ -34,21 +34,50 @@ typedef struct td_index_item {
 assert_struct_size(td_index_item, 1 + 9 + 260);
 #pragma pack(pop)
 
+#define TRACK_DESIGN_INDEX_MAX_THREADS 8
+
+// Files found while scanning the track directories, read on several threads
+typedef struct td_index_scan_queue {
+	td_index_item *items;
+	bool *valid;
+	int count;
+	SDL_atomic_t next;
+} td_index_scan_queue;
+
 static bool track_design_index_read_header(SDL_RWops *file, uint32 *tdidxCount);
+static void track_design_index_load();
+static void track_design_index_save();
 static void track_design_index_scan();
+static int track_design_index_scan_thread(void *ptr);
 static int track_design_index_item_compare(const void *a, const void *b);
+static int track_design_index_entry_compare(const void *a, const void *b);
+static void track_design_index_update_buckets();
+static size_t track_design_index_find_range(uint8 rideType, const char *entry, size_t *start);
+static const td_index_item *track_design_index_get_range_item(const char *entry, size_t position);
+static sint32 track_design_index_find_path(const utf8 *path);
+static void track_design_index_remove(size_t index);
 static void track_design_index_include(const utf8 *directory);
-static void track_design_add_file(const utf8 *path);
+static bool track_design_read_item(const utf8 *path, td_index_item *item);
 static void track_design_add(const td_index_item *item);
 static void track_design_index_dispose();
 static void track_design_index_get_path(utf8 * buffer, size_t bufferLength);
+static void track_design_index_changed();
 
 static const uint32 TrackIndexMagicNumber = 0x58444954;
 static const uint16 TrackIndexVersion = 0;
 
+// The index is kept in memory, sorted by ride type then by filename
 static td_index_item *_tdIndex = NULL;
 static size_t _tdIndexSize = 0;
 static size_t _tdIndexCapacity = 0;
+static bool _tdIndexLoaded = false;
+
+// Position of the first item of each ride type, ride type n spans [start[n], start[n + 1])
+static size_t _tdIndexRideTypeStart[256 + 1];
+
+// Indices of the items sorted by ride type, vehicle then filename, so the items for a vehicle
+// are contiguous within the range of their ride type
+static uint32 *_tdIndexByEntry = NULL;
 
 void track_design_index_create()
 {
@@ -56,97 +85,39 @@ void track_design_index_create()
 
 	log_verbose("saving track design index (tracks.idx)");
 
-	utf8 path[MAX_PATH];
-	track_design_index_get_path(path, sizeof(path));
-
-	SDL_RWops *file = SDL_RWFromFile(path, "wb");
-	if (file != NULL) {
-		track_design_index_scan();
-
-		SDL_RWwrite(file, &TrackIndexMagicNumber, sizeof(TrackIndexMagicNumber), 1);
-		SDL_RWwrite(file, &TrackIndexVersion, sizeof(TrackIndexVersion), 1);
-		SDL_RWwrite(file, &_tdIndexSize, sizeof(uint32), 1);
-		SDL_RWwrite(file, _tdIndex, sizeof(td_index_item), _tdIndexSize);
-		SDL_RWclose(file);
-		track_design_index_dispose();
-	}
+	track_design_index_scan();
+	track_design_index_update_buckets();
+	_tdIndexLoaded = true;
+	track_design_index_save();
 }
 
 size_t track_design_index_get_count_for_ride(uint8 rideType, const char *entry)
 {
-	log_verbose("reading track design index (tracks.idx)");
-
-	utf8 path[MAX_PATH];
-	track_design_index_get_path(path, sizeof(path));
-
-	// Return list
-	size_t refsCount = 0;
-	SDL_RWops *file = SDL_RWFromFile(path, "rb");
-	if (file != NULL) {
-		uint32 tdidxCount;
-		if (!track_design_index_read_header(file, &tdidxCount)) {
-			SDL_RWclose(file);
-			return 0;
-		}
-
-		for (uint32 i = 0; i < tdidxCount; i++) {
-			td_index_item tdItem;
-			SDL_RWread(file, &tdItem, sizeof(td_index_item), 1);
+	track_design_index_load();
 
-			if (tdItem.ride_type != rideType) continue;
-			if (entry != NULL && _strcmpi(entry, tdItem.ride_entry) != 0) continue;
-			refsCount++;
-		}
-		SDL_RWclose(file);
-	}
-
-	return refsCount;
+	size_t start;
+	return track_design_index_find_range(rideType, entry, &start);
 }
 
 size_t track_design_index_get_for_ride(track_design_file_ref **tdRefs, uint8 rideType, const char *entry)
 {
-	log_verbose("reading track design index (tracks.idx)");
-
-	utf8 path[MAX_PATH];
-	track_design_index_get_path(path, sizeof(path));
-
-	// Return list
-	size_t refsCount = 0;
-	size_t refsCapacity = 0;
-	track_design_file_ref *refs = NULL;
-
-	SDL_RWops *file = SDL_RWFromFile(path, "rb");
-	if (file != NULL) {
-		uint32 tdidxCount;
-		if (!track_design_index_read_header(file, &tdidxCount)) {
-			SDL_RWclose(file);
-			return 0;
-		}
+	track_design_index_load();
+
+	size_t start;
+	size_t refsCount = track_design_index_find_range(rideType, entry, &start);
+	track_design_file_ref *refs = malloc(max(1, refsCount) * sizeof(track_design_file_ref));
+	if (refs == NULL) {
+		log_fatal("Unable to allocate more memory.");
+		exit(-1);
+	}
 
-		for (uint32 i = 0; i < tdidxCount; i++) {
-			td_index_item tdItem;
-			SDL_RWread(file, &tdItem, sizeof(td_index_item), 1);
-
-			if (tdItem.ride_type != rideType) continue;
-			if (entry != NULL && _strcmpi(entry, tdItem.ride_entry) != 0) continue;
-
-			size_t nextIndex = refsCount;
-			if (nextIndex >= refsCapacity) {
-				refsCapacity = max(8, refsCapacity * 2);
-				refs = realloc(refs, refsCapacity * sizeof(track_design_file_ref));
-				if (refs == NULL) {
-					log_fatal("Unable to allocate more memory.");
-					exit(-1);
-				}
-			}
-			refs[nextIndex].name = track_design_get_name_from_path(tdItem.path);
-			refs[nextIndex].path = _strdup(tdItem.path);
-			refsCount++;
-		}
-		SDL_RWclose(file);
+	for (size_t i = 0; i < refsCount; i++) {
+		const td_index_item *tdItem = track_design_index_get_range_item(entry, start + i);
+		refs[i].name = track_design_get_name_from_path(tdItem->path);
+		refs[i].path = _strdup(tdItem->path);
 	}
 
-	*tdRefs = realloc(refs, refsCount * sizeof(track_design_file_ref));
+	*tdRefs = refs;
 	return refsCount;
 }
 
@@ -195,12 +166,18 @@ bool track_design_index_rename(const utf8 *path, const utf8 *newName)
 		return false;
 	}
 
-	track_design_index_create();
-
-	rct_window *trackListWindow = window_find_by_class(WC_TRACK_DESIGN_LIST);
-	if (trackListWindow != NULL) {
-		trackListWindow->track_list.reload_track_designs = true;
+	// The ride type and vehicle are unchanged, so only the path needs updating
+	track_design_index_load();
+	sint32 index = track_design_index_find_path(path);
+	if (index != -1) {
+		safe_strcpy(_tdIndex[index].path, newPath, sizeof(_tdIndex[index].path));
+	} else {
+		td_index_item item;
+		if (track_design_read_item(newPath, &item)) {
+			track_design_add(&item);
+		}
 	}
+	track_design_index_changed();
 	return true;
 }
 
@@ -215,12 +192,12 @@ bool track_design_index_delete(const utf8 *path)
 		return false;
 	}
 
-	track_design_index_create();
-
-	rct_window *trackListWindow = window_find_by_class(WC_TRACK_DESIGN_LIST);
-	if (trackListWindow != NULL) {
-		trackListWindow->track_list.reload_track_designs = true;
+	track_design_index_load();
+	sint32 index = track_design_index_find_path(path);
+	if (index != -1) {
+		track_design_index_remove(index);
 	}
+	track_design_index_changed();
 	return true;
 }
 
@@ -234,15 +211,37 @@ bool track_design_index_install(const utf8 *srcPath, const utf8 *destPath)
 		return false;
 	}
 
-	track_design_index_create();
-
-	rct_window *trackListWindow = window_find_by_class(WC_TRACK_DESIGN_LIST);
-	if (trackListWindow != NULL) {
-		trackListWindow->track_list.reload_track_designs = true;
+	track_design_index_load();
+	sint32 index = track_design_index_find_path(destPath);
+	if (index != -1) {
+		track_design_index_remove(index);
 	}
+	td_index_item item;
+	if (track_design_read_item(destPath, &item)) {
+		track_design_add(&item);
+	}
+	track_design_index_changed();
 	return true;
 }
 
+/**
+ * Adds a track design that has just been saved, replacing the item of any file it overwrote.
+ */
+void track_design_index_add(const utf8 *path, const rct_track_td6 *td6)
+{
+	track_design_index_load();
+	sint32 index = track_design_index_find_path(path);
+	if (index != -1) {
+		track_design_index_remove(index);
+	}
+	td_index_item item = { 0 };
+	safe_strcpy(item.path, path, sizeof(item.path));
+	memcpy(item.ride_entry, td6->vehicle_object.name, 8);
+	item.ride_type = td6->type;
+	track_design_add(&item);
+	track_design_index_changed();
+}
+
 static bool track_design_index_read_header(SDL_RWops *file, uint32 *tdidxCount)
 {
 	uint32 tdidxMagicNumber;
@@ -261,6 +260,64 @@ static bool track_design_index_read_header(SDL_RWops *file, uint32 *tdidxCount)
 	return true;
 }
 
+/**
+ * Reads tracks.idx into memory if it has not been loaded yet, scanning the track directories
+ * if it is missing or invalid.
+ */
+static void track_design_index_load()
+{
+	if (_tdIndexLoaded) {
+		return;
+	}
+
+	log_verbose("reading track design index (tracks.idx)");
+
+	utf8 path[MAX_PATH];
+	track_design_index_get_path(path, sizeof(path));
+
+	bool loaded = false;
+	SDL_RWops *file = SDL_RWFromFile(path, "rb");
+	if (file != NULL) {
+		uint32 tdidxCount;
+		if (track_design_index_read_header(file, &tdidxCount)) {
+			_tdIndexCapacity = max(128, tdidxCount);
+			_tdIndex = malloc(_tdIndexCapacity * sizeof(td_index_item));
+			if (_tdIndex == NULL) {
+				log_fatal("Unable to allocate more memory.");
+				exit(-1);
+			}
+			if (tdidxCount == 0 || SDL_RWread(file, _tdIndex, sizeof(td_index_item), tdidxCount) == tdidxCount) {
+				_tdIndexSize = tdidxCount;
+				loaded = true;
+			}
+		}
+		SDL_RWclose(file);
+	}
+
+	if (loaded) {
+		track_design_index_update_buckets();
+		_tdIndexLoaded = true;
+	} else {
+		track_design_index_create();
+	}
+}
+
+static void track_design_index_save()
+{
+	utf8 path[MAX_PATH];
+	track_design_index_get_path(path, sizeof(path));
+
+	SDL_RWops *file = SDL_RWFromFile(path, "wb");
+	if (file != NULL) {
+		uint32 tdidxCount = (uint32)_tdIndexSize;
+		SDL_RWwrite(file, &TrackIndexMagicNumber, sizeof(TrackIndexMagicNumber), 1);
+		SDL_RWwrite(file, &TrackIndexVersion, sizeof(TrackIndexVersion), 1);
+		SDL_RWwrite(file, &tdidxCount, sizeof(uint32), 1);
+		SDL_RWwrite(file, _tdIndex, sizeof(td_index_item), _tdIndexSize);
+		SDL_RWclose(file);
+	}
+}
+
 static void track_design_index_scan()
 {
 	utf8 directory[MAX_PATH];
@@ -274,8 +331,57 @@ static void track_design_index_scan()
 	platform_get_user_directory(directory, "track");
 	track_design_index_include(directory);
 
-	// Sort items by ride type then by filename
-	qsort(_tdIndex, _tdIndexSize, sizeof(td_index_item), track_design_index_item_compare);
+	// Only the paths have been collected so far, read the files on several threads
+	int count = (int)_tdIndexSize;
+	if (count == 0) {
+		return;
+	}
+
+	td_index_scan_queue queue;
+	queue.items = _tdIndex;
+	queue.valid = malloc(count * sizeof(bool));
+	queue.count = count;
+	SDL_AtomicSet(&queue.next, 0);
+	if (queue.valid == NULL) {
+		log_fatal("Unable to allocate more memory.");
+		exit(-1);
+	}
+
+	SDL_Thread *threads[TRACK_DESIGN_INDEX_MAX_THREADS - 1] = { 0 };
+	int numThreads = clamp(1, SDL_GetCPUCount(), min(count, TRACK_DESIGN_INDEX_MAX_THREADS)) - 1;
+	for (int i = 0; i < numThreads; i++) {
+		threads[i] = SDL_CreateThread(track_design_index_scan_thread, "track_design_index", &queue);
+	}
+	track_design_index_scan_thread(&queue);
+	for (int i = 0; i < numThreads; i++) {
+		if (threads[i] != NULL) {
+			SDL_WaitThread(threads[i], NULL);
+		}
+	}
+
+	// Remove the files that could not be read
+	size_t numValid = 0;
+	for (int i = 0; i < count; i++) {
+		if (queue.valid[i]) {
+			_tdIndex[numValid++] = _tdIndex[i];
+		}
+	}
+	_tdIndexSize = numValid;
+	free(queue.valid);
+}
+
+static int track_design_index_scan_thread(void *ptr)
+{
+	td_index_scan_queue *queue = (td_index_scan_queue*)ptr;
+
+	int index;
+	while ((index = SDL_AtomicAdd(&queue->next, 1)) < queue->count) {
+		td_index_item *item = &queue->items[index];
+		utf8 path[MAX_PATH];
+		safe_strcpy(path, item->path, sizeof(path));
+		queue->valid[index] = track_design_read_item(path, item);
+	}
+	return 0;
 }
 
 static int track_design_index_item_compare(const void *a, const void *b)
@@ -292,6 +398,111 @@ static int track_design_index_item_compare(const void *a, const void *b)
 	return _stricmp(tdAName, tdBName);
 }
 
+static int track_design_index_entry_compare(const void *a, const void *b)
+{
+	const td_index_item *tdA = &_tdIndex[*((const uint32*)a)];
+	const td_index_item *tdB = &_tdIndex[*((const uint32*)b)];
+
+	if (tdA->ride_type != tdB->ride_type) {
+		return tdA->ride_type - tdB->ride_type;
+	}
+
+	int entryCompare = _strcmpi(tdA->ride_entry, tdB->ride_entry);
+	if (entryCompare != 0) {
+		return entryCompare;
+	}
+	return track_design_index_item_compare(tdA, tdB);
+}
+
+/**
+ * Sorts the items and rebuilds the ride type and vehicle buckets after the items have changed.
+ */
+static void track_design_index_update_buckets()
+{
+	qsort(_tdIndex, _tdIndexSize, sizeof(td_index_item), track_design_index_item_compare);
+
+	size_t index = 0;
+	for (int rideType = 0; rideType < 256; rideType++) {
+		_tdIndexRideTypeStart[rideType] = index;
+		while (index < _tdIndexSize && _tdIndex[index].ride_type == rideType) {
+			index++;
+		}
+	}
+	_tdIndexRideTypeStart[256] = index;
+
+	_tdIndexByEntry = realloc(_tdIndexByEntry, max(1, _tdIndexSize) * sizeof(uint32));
+	if (_tdIndexByEntry == NULL) {
+		log_fatal("Unable to allocate more memory.");
+		exit(-1);
+	}
+	for (size_t i = 0; i < _tdIndexSize; i++) {
+		_tdIndexByEntry[i] = (uint32)i;
+	}
+	qsort(_tdIndexByEntry, _tdIndexSize, sizeof(uint32), track_design_index_entry_compare);
+}
+
+/**
+ * Finds the items for a ride type and, if entry is not NULL, a vehicle. Returns the number of
+ * items, which start at the returned position of track_design_index_get_range_item.
+ */
+static size_t track_design_index_find_range(uint8 rideType, const char *entry, size_t *start)
+{
+	size_t first = _tdIndexRideTypeStart[rideType];
+	size_t last = _tdIndexRideTypeStart[rideType + 1];
+	if (entry != NULL) {
+		// Lower bound of the vehicle
+		size_t lo = first, hi = last;
+		while (lo < hi) {
+			size_t mid = lo + (hi - lo) / 2;
+			if (_strcmpi(_tdIndex[_tdIndexByEntry[mid]].ride_entry, entry) < 0) {
+				lo = mid + 1;
+			} else {
+				hi = mid;
+			}
+		}
+		first = lo;
+
+		// Upper bound of the vehicle
+		hi = last;
+		while (lo < hi) {
+			size_t mid = lo + (hi - lo) / 2;
+			if (_strcmpi(_tdIndex[_tdIndexByEntry[mid]].ride_entry, entry) <= 0) {
+				lo = mid + 1;
+			} else {
+				hi = mid;
+			}
+		}
+		last = lo;
+	}
+	*start = first;
+	return last - first;
+}
+
+static const td_index_item *track_design_index_get_range_item(const char *entry, size_t position)
+{
+	if (entry == NULL) {
+		return &_tdIndex[position];
+	} else {
+		return &_tdIndex[_tdIndexByEntry[position]];
+	}
+}
+
+static sint32 track_design_index_find_path(const utf8 *path)
+{
+	for (size_t i = 0; i < _tdIndexSize; i++) {
+		if (_stricmp(_tdIndex[i].path, path) == 0) {
+			return (sint32)i;
+		}
+	}
+	return -1;
+}
+
+static void track_design_index_remove(size_t index)
+{
+	memmove(&_tdIndex[index], &_tdIndex[index + 1], (_tdIndexSize - index - 1) * sizeof(td_index_item));
+	_tdIndexSize--;
+}
+
 static void track_design_index_include(const utf8 *directory)
 {
 	int handle;
@@ -307,7 +518,10 @@ static void track_design_index_include(const utf8 *directory)
 		utf8 path[MAX_PATH];
 		safe_strcpy(path, directory, sizeof(pattern));
 		safe_strcat_path(path, fileInfo.path, sizeof(pattern));
-		track_design_add_file(path);
+
+		td_index_item item = { 0 };
+		safe_strcpy(item.path, path, sizeof(item.path));
+		track_design_add(&item);
 	}
 	platform_enumerate_files_end(handle);
 
@@ -323,17 +537,19 @@ static void track_design_index_include(const utf8 *directory)
 	platform_enumerate_directories_end(handle);
 }
 
-static void track_design_add_file(const utf8 *path)
+static bool track_design_read_item(const utf8 *path, td_index_item *item)
 {
 	rct_track_td6 *td6 = track_design_open(path);
-	if (td6 != NULL) {
-		td_index_item tdIndexItem = { 0 };
-		safe_strcpy(tdIndexItem.path, path, sizeof(tdIndexItem.path));
-		memcpy(tdIndexItem.ride_entry, td6->vehicle_object.name, 8);
-		tdIndexItem.ride_type = td6->type;
-		track_design_add(&tdIndexItem);
-		track_design_dispose(td6);
+	if (td6 == NULL) {
+		return false;
 	}
+
+	memset(item, 0, sizeof(td_index_item));
+	safe_strcpy(item->path, path, sizeof(item->path));
+	memcpy(item->ride_entry, td6->vehicle_object.name, 8);
+	item->ride_type = td6->type;
+	track_design_dispose(td6);
+	return true;
 }
 
 static void track_design_add(const td_index_item *item)
@@ -354,8 +570,10 @@ static void track_design_add(const td_index_item *item)
 static void track_design_index_dispose()
 {
 	SafeFree(_tdIndex);
+	SafeFree(_tdIndexByEntry);
 	_tdIndexSize = 0;
 	_tdIndexCapacity = 0;
+	_tdIndexLoaded = false;
 }
 
 static void track_design_index_get_path(utf8 * buffer, size_t bufferLength)
@@ -363,3 +581,18 @@ static void track_design_index_get_path(utf8 * buffer, size_t bufferLength)
 	platform_get_user_directory(buffer, NULL);
 	safe_strcat(buffer, "tracks.idx", bufferLength);
 }
+
+/**
+ * Saves the index after an item has been added, removed or renamed and reloads any open
+ * track design list.
+ */
+static void track_design_index_changed()
+{
+	track_design_index_update_buckets();
+	track_design_index_save();
+
+	rct_window *trackListWindow = window_find_by_class(WC_TRACK_DESIGN_LIST);
+	if (trackListWindow != NULL) {
+		trackListWindow->track_list.reload_track_designs = true;
+	}
+}
@@ -123,10 +123,6 @@ static void track_design_save_callback(int result) {
 	free(_trackDesign->entrance_elements);
 	free(_trackDesign->scenery_elements);
 	free(_trackDesign);
-	
-	if (result == MODAL_RESULT_OK) {
-		track_design_index_create();
-	}
 	gfx_invalidate_screen();
 }
 
@@ -1273,6 +1269,7 @@ bool track_design_save_to_file(const utf8 *path)
 	if (file != NULL) {
 		SDL_RWwrite(file, encodedData, encodedDataLength, 1);
 		SDL_RWclose(file);
+		track_design_index_add(path, td6);
 		result = true;
 	} else {
 		log_error("Failed to save %s", path);
@@ -94,13 +94,16 @@ bool scenario_load_basic(const char *path, rct_s6_header *header, rct_s6_info *i
 
 	SDL_RWops* rw = SDL_RWFromFile(path, "rb");
 	if (rw != NULL) {
-		// Read first chunk
-		sawyercoding_read_chunk(rw, (uint8*)header);
-		if (header->type == S6_TYPE_SCENARIO) {
+		// Read first chunk, the scenario list calls this on several threads so the chunks are
+		// decoded with the size of their destination
+		if (sawyercoding_read_chunk_safe(rw, header, sizeof(rct_s6_header)) && header->type == S6_TYPE_SCENARIO) {
 			// Read second chunk
-			sawyercoding_read_chunk(rw, (uint8*)info);
+			bool result = sawyercoding_read_chunk_safe(rw, info, sizeof(rct_s6_info));
 			SDL_RWclose(rw);
-			return true;
+			if (!result) {
+				log_error("invalid scenario, %s", path);
+			}
+			return result;
 		} else {
 			log_error("invalid scenario, %s", path);
 			SDL_RWclose(rw);
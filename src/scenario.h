@@ -399,6 +399,7 @@ typedef struct scenario_highscore_entry {
 typedef struct scenario_index_entry {
 	utf8 path[MAX_PATH];
 	uint64 timestamp;
+	uint64 file_size;
 
 	// Category / sequence
 	uint8 category;
@@ -475,7 +476,13 @@ unsigned int scenario_rand();
 unsigned int scenario_rand_max(unsigned int max);
 int scenario_prepare_for_save();
 int scenario_save(SDL_RWops* rw, int flags);
+int scenario_save_park(SDL_RWops* rw, int flags);
 int scenario_save_network(SDL_RWops* rw);
+
+typedef struct scenario_snapshot scenario_snapshot;
+scenario_snapshot *scenario_snapshot_create();
+int scenario_snapshot_write(scenario_snapshot *snapshot, SDL_RWops *rw);
+void scenario_snapshot_dispose(scenario_snapshot *snapshot);
 int scenario_get_num_packed_objects_to_write();
 int scenario_write_packed_objects(SDL_RWops* rw);
 void scenario_remove_trackless_rides(rct_s6_data *s6);
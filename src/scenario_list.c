@@ -31,11 +31,63 @@ int gScenarioHighscoreListCount = 0;
 int gScenarioHighscoreListCapacity = 0;
 scenario_highscore_entry *gScenarioHighscoreList = NULL;
 
-static void scenario_list_include(const utf8 *directory);
-static void scenario_list_add(const utf8 *path, uint64 timestamp);
+// Index of scenario metadata, saved so only new or modified scenario files need to be read
+#define SCENARIO_INDEX_VERSION 2
+#define SCENARIO_INDEX_MAX_THREADS 8
+
+typedef struct scenario_index_header {
+	uint16 version;
+	uint16 language_id;
+	uint32 entry_size;
+	uint32 num_entries;
+} scenario_index_header;
+
+// Files that could not be read are kept in the index as invalid records so they are not read again
+typedef struct scenario_index_record {
+	uint8 valid;
+	scenario_index_entry entry;
+} scenario_index_record;
+
+// A scenario file found while scanning the scenario directories
+typedef struct scenario_file {
+	utf8 path[MAX_PATH];
+	uint64 size;
+	uint64 timestamp;
+	bool valid;
+	rct_s6_info info;
+	scenario_index_entry entry;
+} scenario_file;
+
+typedef struct scenario_file_list {
+	scenario_file *files;
+	int count;
+	int capacity;
+} scenario_file_list;
+
+typedef struct scenario_file_load_queue {
+	scenario_file **files;
+	int count;
+	SDL_atomic_t next;
+} scenario_file_load_queue;
+
+// Open addressing table of list indices, empty slots are -1
+typedef struct scenario_hash_table {
+	sint32 *slots;
+	uint32 mask;
+} scenario_hash_table;
+
+static scenario_hash_table _scenarioFilenameTable = { 0 };
+
+static void scenario_list_include(scenario_file_list *list, const utf8 *directory);
+static void scenario_list_load_files(scenario_file **files, int count);
+static void scenario_list_add(const scenario_index_entry *entry);
 static void scenario_list_sort();
 static int scenario_list_sort_by_category(const void *a, const void *b);
 static int scenario_list_sort_by_index(const void *a, const void *b);
+static void scenario_list_build_filename_table();
+
+static scenario_index_record *scenario_index_load(int *outCount);
+static void scenario_index_save(const scenario_file_list *list);
 
 static bool scenario_scores_load();
 static void scenario_scores_legacy_get_path(utf8 *outPath);
@@ -45,6 +97,44 @@ static void scenario_highscore_list_dispose();
 static utf8 *io_read_string(SDL_RWops *file);
 static void io_write_string(SDL_RWops *file, utf8 *source);
 
+static uint32 scenario_hash_string(const utf8 *str)
+{
+	// FNV-1a, case insensitive as paths are compared with _strcmpi
+	uint32 hash = 2166136261U;
+	for (; *str != '\0'; str++) {
+		hash ^= (uint8)tolower((uint8)*str);
+		hash *= 16777619U;
+	}
+	return hash;
+}
+
+static void scenario_hash_table_init(scenario_hash_table *table, int count)
+{
+	uint32 capacity = 16;
+	while (capacity < (uint32)count * 2) {
+		capacity *= 2;
+	}
+
+	table->slots = realloc(table->slots, capacity * sizeof(sint32));
+	table->mask = capacity - 1;
+	memset(table->slots, 0xFF, capacity * sizeof(sint32));
+}
+
+static void scenario_hash_table_insert(scenario_hash_table *table, uint32 hash, sint32 index)
+{
+	uint32 slot = hash & table->mask;
+	while (table->slots[slot] != -1) {
+		slot = (slot + 1) & table->mask;
+	}
+	table->slots[slot] = index;
+}
+
+static void scenario_hash_table_dispose(scenario_hash_table *table)
+{
+	SafeFree(table->slots);
+	table->mask = 0;
+}
+
 /**
  * Searches and grabs the metadata for all the scenarios.
  */
@@ -54,17 +144,75 @@ void scenario_load_list()
 
 	// Clear scenario list
 	gScenarioListCount = 0;
+	scenario_hash_table_init(&_scenarioFilenameTable, 0);
 
-	// Get scenario directory from RCT2
+	// Find all the scenario files, in the RCT2 directory and then the user directory
+	scenario_file_list list = { 0 };
 	safe_strcpy(directory, gConfigGeneral.game_path, sizeof(directory));
 	safe_strcat_path(directory, "Scenarios", sizeof(directory));
-	scenario_list_include(directory);
+	scenario_list_include(&list, directory);
 
-	// Get scenario directory from user directory
 	platform_get_user_directory(directory, "scenario");
-	scenario_list_include(directory);
+	scenario_list_include(&list, directory);
+
+	// Take the metadata of unchanged files from the index
+	int numIndexEntries;
+	scenario_index_record *indexEntries = scenario_index_load(&numIndexEntries);
+	scenario_hash_table pathTable = { 0 };
+	scenario_hash_table_init(&pathTable, numIndexEntries);
+	for (int i = 0; i < numIndexEntries; i++) {
+		scenario_hash_table_insert(&pathTable, scenario_hash_string(indexEntries[i].entry.path), i);
+	}
+
+	int numIndexed = 0;
+	int numToLoad = 0;
+	scenario_file **filesToLoad = malloc(max(1, list.count) * sizeof(scenario_file*));
+	for (int i = 0; i < list.count; i++) {
+		scenario_file *file = &list.files[i];
+
+		const scenario_index_record *indexRecord = NULL;
+		uint32 slot = scenario_hash_string(file->path) & pathTable.mask;
+		for (; pathTable.slots[slot] != -1; slot = (slot + 1) & pathTable.mask) {
+			const scenario_index_record *candidate = &indexEntries[pathTable.slots[slot]];
+			if (_strcmpi(candidate->entry.path, file->path) == 0) {
+				indexRecord = candidate;
+				break;
+			}
+		}
+
+		const scenario_index_entry *indexEntry = indexRecord == NULL ? NULL : &indexRecord->entry;
+		if (indexEntry != NULL && indexEntry->timestamp == file->timestamp && indexEntry->file_size == file->size) {
+			file->entry = *indexEntry;
+			file->valid = indexRecord->valid != 0;
+			numIndexed++;
+		} else {
+			filesToLoad[numToLoad++] = file;
+		}
+	}
+	scenario_hash_table_dispose(&pathTable);
+	free(indexEntries);
+
+	// Read the headers of new and modified files
+	if (numToLoad > 0) {
+		log_verbose("reading %d of %d scenarios", numToLoad, list.count);
+		scenario_list_load_files(filesToLoad, numToLoad);
+	}
+	free(filesToLoad);
+
+	for (int i = 0; i < list.count; i++) {
+		if (list.files[i].valid) {
+			scenario_list_add(&list.files[i].entry);
+		}
+	}
+
+	// Only rewrite the index if files were added, changed or removed
+	if (numToLoad > 0 || numIndexed != numIndexEntries) {
+		scenario_index_save(&list);
+	}
+	free(list.files);
 
 	scenario_list_sort();
+	scenario_list_build_filename_table();
 	scenario_scores_load();
 
 	utf8 scoresPath[MAX_PATH];
@@ -73,7 +221,7 @@ void scenario_load_list()
 	scenario_scores_legacy_load(get_file_path(PATH_ID_SCORES));
 }
 
-static void scenario_list_include(const utf8 *directory)
+static void scenario_list_include(scenario_file_list *list, const utf8 *directory)
 {
 	int handle;
 	file_info fileInfo;
@@ -85,10 +233,17 @@ static void scenario_list_include(const utf8 *directory)
 
 	handle = platform_enumerate_files_begin(pattern);
 	while (platform_enumerate_files_next(handle, &fileInfo)) {
-		utf8 path[MAX_PATH];
-		safe_strcpy(path, directory, sizeof(pattern));
-		safe_strcat_path(path, fileInfo.path, sizeof(pattern));
-		scenario_list_add(path, fileInfo.last_modified);
+		if (list->count == list->capacity) {
+			list->capacity = max(64, list->capacity * 2);
+			list->files = realloc(list->files, list->capacity * sizeof(scenario_file));
+		}
+
+		scenario_file *file = &list->files[list->count++];
+		memset(file, 0, sizeof(scenario_file));
+		safe_strcpy(file->path, directory, sizeof(file->path));
+		safe_strcat_path(file->path, fileInfo.path, sizeof(file->path));
+		file->size = fileInfo.size;
+		file->timestamp = fileInfo.last_modified;
 	}
 	platform_enumerate_files_end(handle);
 
@@ -99,28 +254,102 @@ static void scenario_list_include(const utf8 *directory)
 		utf8 path[MAX_PATH];
 		safe_strcpy(path, directory, sizeof(pattern));
 		safe_strcat_path(path, subDirectory, sizeof(pattern));
-		scenario_list_include(path);
+		scenario_list_include(list, path);
 	}
 	platform_enumerate_directories_end(handle);
 }
 
-static void scenario_list_add(const utf8 *path, uint64 timestamp)
+static int scenario_list_load_files_thread(void *ptr)
 {
-	// Load the basic scenario information
-	rct_s6_header s6Header;
-	rct_s6_info s6Info;
-	if (!scenario_load_basic(path, &s6Header, &s6Info)) {
-		return;
+	scenario_file_load_queue *queue = (scenario_file_load_queue*)ptr;
+
+	int index;
+	while ((index = SDL_AtomicAdd(&queue->next, 1)) < queue->count) {
+		scenario_file *file = queue->files[index];
+		rct_s6_header s6Header;
+		file->valid = scenario_load_basic(file->path, &s6Header, &file->info);
+	}
+	return 0;
+}
+
+/**
+ * Reads the header and info chunks of each file, spread over several threads as it is
+ * mostly waiting on the disk. The entries are then filled in on this thread as the
+ * translation looks up objects and language strings.
+ */
+static void scenario_list_load_files(scenario_file **files, int count)
+{
+	scenario_file_load_queue queue;
+	queue.files = files;
+	queue.count = count;
+	SDL_AtomicSet(&queue.next, 0);
+
+	SDL_Thread *threads[SCENARIO_INDEX_MAX_THREADS - 1] = { 0 };
+	int numThreads = clamp(1, SDL_GetCPUCount(), min(count, SCENARIO_INDEX_MAX_THREADS)) - 1;
+	for (int i = 0; i < numThreads; i++) {
+		threads[i] = SDL_CreateThread(scenario_list_load_files_thread, "scenario_list", &queue);
+	}
+	scenario_list_load_files_thread(&queue);
+	for (int i = 0; i < numThreads; i++) {
+		if (threads[i] != NULL) {
+			SDL_WaitThread(threads[i], NULL);
+		}
+	}
+
+	for (int i = 0; i < count; i++) {
+		scenario_file *file = files[i];
+		scenario_index_entry *newEntry = &file->entry;
+		safe_strcpy(newEntry->path, file->path, sizeof(newEntry->path));
+		newEntry->timestamp = file->timestamp;
+		newEntry->file_size = file->size;
+		if (!file->valid) {
+			continue;
+		}
+
+		rct_s6_info *s6Info = &file->info;
+		newEntry->category = s6Info->category;
+		newEntry->objective_type = s6Info->objective_type;
+		newEntry->objective_arg_1 = s6Info->objective_arg_1;
+		newEntry->objective_arg_2 = s6Info->objective_arg_2;
+		newEntry->objective_arg_3 = s6Info->objective_arg_3;
+		newEntry->highscore = NULL;
+		safe_strcpy(newEntry->name, s6Info->name, sizeof(newEntry->name));
+		safe_strcpy(newEntry->details, s6Info->details, sizeof(newEntry->details));
+
+		// Normalise the name to make the scenario as recognisable as possible.
+		scenario_normalise_name(newEntry->name);
+
+		// Look up and store information regarding the origins of this scenario.
+		source_desc desc;
+		if (scenario_get_source_desc(newEntry->name, &desc)) {
+			newEntry->sc_id = desc.id;
+			newEntry->source_index = desc.index;
+			newEntry->source_game = desc.source;
+			newEntry->category = desc.category;
+		} else {
+			newEntry->sc_id = SC_UNIDENTIFIED;
+			newEntry->source_index = -1;
+			if (newEntry->category == SCENARIO_CATEGORY_REAL) {
+				newEntry->source_game = SCENARIO_SOURCE_REAL;
+			} else {
+				newEntry->source_game = SCENARIO_SOURCE_OTHER;
+			}
+		}
+
+		scenario_translate(newEntry, &s6Info->entry);
 	}
+}
 
+static void scenario_list_add(const scenario_index_entry *entry)
+{
 	scenario_index_entry *newEntry = NULL;
 
-	const utf8 *filename = path_get_filename(path);
+	const utf8 *filename = path_get_filename(entry->path);
 	scenario_index_entry *existingEntry = scenario_list_find_by_filename(filename);
 	if (existingEntry != NULL) {
 		bool bail = false;
 		const utf8 *conflictPath;
-		if (existingEntry->timestamp > timestamp) {
+		if (existingEntry->timestamp > entry->timestamp) {
 			// Existing entry is more recent
 			conflictPath = existingEntry->path;
 
@@ -128,7 +357,7 @@ static void scenario_list_add(const utf8 *path, uint64 timestamp)
 			newEntry = existingEntry;
 		} else {
 			// This entry is more recent
-			conflictPath = path;
+			conflictPath = entry->path;
 			bail = true;
 		}
 		printf("Scenario conflict: '%s' ignored because it is newer.\n", conflictPath);
@@ -145,41 +374,20 @@ static void scenario_list_add(const utf8 *path, uint64 timestamp)
 		}
 		newEntry = &gScenarioList[gScenarioListCount];
 		gScenarioListCount++;
-	}
 
-	// Set new entry
-	safe_strcpy(newEntry->path, path, sizeof(newEntry->path));
-	newEntry->timestamp = timestamp;
-	newEntry->category = s6Info.category;
-	newEntry->objective_type = s6Info.objective_type;
-	newEntry->objective_arg_1 = s6Info.objective_arg_1;
-	newEntry->objective_arg_2 = s6Info.objective_arg_2;
-	newEntry->objective_arg_3 = s6Info.objective_arg_3;
-	newEntry->highscore = NULL;
-	safe_strcpy(newEntry->name, s6Info.name, sizeof(newEntry->name));
-	safe_strcpy(newEntry->details, s6Info.details, sizeof(newEntry->details));
-
-	// Normalise the name to make the scenario as recognisable as possible.
-	scenario_normalise_name(newEntry->name);
-
-	// Look up and store information regarding the origins of this scenario.
-	source_desc desc;
-	if (scenario_get_source_desc(newEntry->name, &desc)) {
-		newEntry->sc_id = desc.id;
-		newEntry->source_index = desc.index;
-		newEntry->source_game = desc.source;
-		newEntry->category = desc.category;
-	} else {
-		newEntry->sc_id = SC_UNIDENTIFIED;
-		newEntry->source_index = -1;
-		if (newEntry->category == SCENARIO_CATEGORY_REAL) {
-			newEntry->source_game = SCENARIO_SOURCE_REAL;
+		*newEntry = *entry;
+		newEntry->highscore = NULL;
+
+		// Keep the filename table at most half full
+		if ((uint32)gScenarioListCount * 2 > _scenarioFilenameTable.mask + 1) {
+			scenario_list_build_filename_table();
 		} else {
-			newEntry->source_game = SCENARIO_SOURCE_OTHER;
+			scenario_hash_table_insert(&_scenarioFilenameTable, scenario_hash_string(filename), gScenarioListCount - 1);
 		}
+	} else {
+		*newEntry = *entry;
+		newEntry->highscore = NULL;
 	}
-
-	scenario_translate(newEntry, &s6Info.entry);
 }
 
 void scenario_list_dispose()
@@ -187,6 +395,19 @@ void scenario_list_dispose()
 	gScenarioListCapacity = 0;
 	gScenarioListCount = 0;
 	SafeFree(gScenarioList);
+	scenario_hash_table_dispose(&_scenarioFilenameTable);
+}
+
+/**
+ * Rebuilds the filename lookup, required whenever entries of the list are moved.
+ */
+static void scenario_list_build_filename_table()
+{
+	scenario_hash_table_init(&_scenarioFilenameTable, gScenarioListCount);
+	for (int i = 0; i < gScenarioListCount; i++) {
+		const utf8 *filename = path_get_filename(gScenarioList[i].path);
+		scenario_hash_table_insert(&_scenarioFilenameTable, scenario_hash_string(filename), i);
+	}
 }
 
 static void scenario_list_sort()
@@ -267,10 +488,15 @@ static int scenario_list_sort_by_index(const void *a, const void *b)
 
 scenario_index_entry *scenario_list_find_by_filename(const utf8 *filename)
 {
-	for (int i = 0; i < gScenarioListCount; i++) {
-		const utf8 *scenarioFilename = path_get_filename(gScenarioList[i].path);
-		if (_strcmpi(filename, scenarioFilename) == 0) {
-			return &gScenarioList[i];
+	if (_scenarioFilenameTable.slots == NULL) {
+		return NULL;
+	}
+
+	uint32 slot = scenario_hash_string(filename) & _scenarioFilenameTable.mask;
+	for (; _scenarioFilenameTable.slots[slot] != -1; slot = (slot + 1) & _scenarioFilenameTable.mask) {
+		scenario_index_entry *entry = &gScenarioList[_scenarioFilenameTable.slots[slot]];
+		if (_strcmpi(filename, path_get_filename(entry->path)) == 0) {
+			return entry;
 		}
 	}
 	return NULL;
@@ -278,14 +504,91 @@ scenario_index_entry *scenario_list_find_by_filename(const utf8 *filename)
 
 scenario_index_entry *scenario_list_find_by_path(const utf8 *path)
 {
-	for (int i = 0; i < gScenarioListCount; i++) {
-		if (_strcmpi(path, gScenarioList[i].path) == 0) {
-			return &gScenarioList[i];
-		}
+	// Filenames are unique within the list
+	scenario_index_entry *entry = scenario_list_find_by_filename(path_get_filename(path));
+	if (entry != NULL && _strcmpi(path, entry->path) == 0) {
+		return entry;
 	}
 	return NULL;
 }
 
+static void scenario_index_get_path(utf8 *outPath)
+{
+	platform_get_user_directory(outPath, NULL);
+	strcat(outPath, "scenarios.idx");
+}
+
+/**
+ * Loads the saved scenario index. Returns NULL if there is none or it was written by a
+ * different version or for a different language.
+ */
+static scenario_index_record *scenario_index_load(int *outCount)
+{
+	*outCount = 0;
+
+	utf8 path[MAX_PATH];
+	scenario_index_get_path(path);
+	SDL_RWops *file = SDL_RWFromFile(path, "rb");
+	if (file == NULL) {
+		return NULL;
+	}
+
+	scenario_index_header header;
+	if (SDL_RWread(file, &header, sizeof(header), 1) != 1 ||
+		header.version != SCENARIO_INDEX_VERSION ||
+		header.language_id != gCurrentLanguage ||
+		header.entry_size != sizeof(scenario_index_record) ||
+		header.num_entries > (uint32)(SDL_RWsize(file) / sizeof(scenario_index_record))
+	) {
+		log_verbose("scenario index is out of date");
+		SDL_RWclose(file);
+		return NULL;
+	}
+
+	scenario_index_record *entries = malloc(max(1, header.num_entries) * sizeof(scenario_index_record));
+	if (header.num_entries > 0 && SDL_RWread(file, entries, sizeof(scenario_index_record), header.num_entries) != header.num_entries) {
+		SDL_RWclose(file);
+		free(entries);
+		return NULL;
+	}
+	SDL_RWclose(file);
+
+	for (uint32 i = 0; i < header.num_entries; i++) {
+		entries[i].entry.path[sizeof(entries[i].entry.path) - 1] = '\0';
+		entries[i].entry.highscore = NULL;
+	}
+	*outCount = (int)header.num_entries;
+	return entries;
+}
+
+static void scenario_index_save(const scenario_file_list *list)
+{
+	utf8 path[MAX_PATH];
+	scenario_index_get_path(path);
+	SDL_RWops *file = SDL_RWFromFile(path, "wb");
+	if (file == NULL) {
+		log_error("Unable to save scenario index.");
+		return;
+	}
+
+	scenario_index_header header;
+	header.version = SCENARIO_INDEX_VERSION;
+	header.language_id = gCurrentLanguage;
+	header.entry_size = sizeof(scenario_index_record);
+	header.num_entries = list->count;
+
+	SDL_RWwrite(file, &header, sizeof(header), 1);
+	for (int i = 0; i < list->count; i++) {
+		scenario_index_record record;
+		memset(&record, 0, sizeof(record));
+		record.valid = list->files[i].valid ? 1 : 0;
+		record.entry = list->files[i].entry;
+		record.entry.highscore = NULL;
+		SDL_RWwrite(file, &record, sizeof(record), 1);
+	}
+	SDL_RWclose(file);
+}
+
 /**
  * Gets the path for the scenario scores path.
  */
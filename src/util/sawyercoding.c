@@ -20,14 +20,16 @@
 #include "../scenario.h"
 #include "util.h"
 
+static size_t decode_chunk(uint8 encoding, const uint8 *src_buffer, size_t length, uint8 *dst_buffer, size_t dstSize);
 static size_t decode_chunk_rle(const uint8* src_buffer, uint8* dst_buffer, size_t length);
 static size_t decode_chunk_rle_with_size(const uint8* src_buffer, uint8* dst_buffer, size_t length, size_t dstSize);
-static size_t decode_chunk_repeat(uint8 *buffer, size_t length);
+static size_t decode_chunk_rle_repeat(const uint8 *src_buffer, uint8 *dst_buffer, size_t length, size_t dstSize);
 static void decode_chunk_rotate(uint8 *buffer, size_t length);
 
 static size_t encode_chunk_rle(const uint8 *src_buffer, uint8 *dst_buffer, size_t length);
 static size_t encode_chunk_repeat(const uint8 *src_buffer, uint8 *dst_buffer, size_t length);
-static void encode_chunk_rotate(uint8 *buffer, size_t length);
+static size_t encode_chunk_repeat_range(const uint8 *src_buffer, uint8 *dst_buffer, size_t begin, size_t end);
+static void encode_chunk_rotate(uint8 *buffer, size_t length, size_t offset);
 
 uint32 sawyercoding_calculate_checksum(const uint8* buffer, size_t length)
 {
@@ -45,9 +47,9 @@ uint32 sawyercoding_calculate_checksum(const uint8* buffer, size_t length)
  */
 int sawyercoding_validate_checksum(SDL_RWops* rw)
 {
-	size_t i, dataSize, bufferSize;
+	size_t dataSize, bufferSize;
 	uint32 checksum, fileChecksum;
-	uint8 buffer[1024];
+	uint8 buffer[16 * 1024];
 
 	// Get data size
 	SDL_RWseek(rw, 0, RW_SEEK_END);
@@ -61,12 +63,11 @@ int sawyercoding_validate_checksum(SDL_RWops* rw)
 	SDL_RWseek(rw, 0, RW_SEEK_SET);
 	checksum = 0;
 	do {
-		bufferSize = min(dataSize, 1024);
+		bufferSize = min(dataSize, sizeof(buffer));
 		if (SDL_RWread(rw, buffer, bufferSize, 1) != 1)
 			return 0;
 
-		for (i = 0; i < bufferSize; i++)
-			checksum += buffer[i];
+		checksum += sawyercoding_calculate_checksum(buffer, bufferSize);
 		dataSize -= bufferSize;
 	} while (dataSize != 0);
 
@@ -81,19 +82,69 @@ int sawyercoding_validate_checksum(SDL_RWops* rw)
 	return checksum == fileChecksum;
 }
 
+/**
+ * Validates the checksum stored in the last four bytes of a file that has already
+ * been read into memory.
+ */
+bool sawyercoding_validate_checksum_buffer(const uint8 *buffer, size_t length)
+{
+	if (length < 8)
+		return false;
+
+	uint32 fileChecksum;
+	memcpy(&fileChecksum, buffer + length - 4, sizeof(fileChecksum));
+	return sawyercoding_calculate_checksum(buffer, length - 4) == fileChecksum;
+}
+
 bool sawyercoding_read_chunk_safe(SDL_RWops *rw, void *dst, size_t dstLength)
 {
-	// Allocate 16 MB to store uncompressed data
-	uint8 *tempBuffer = malloc(16 * 1024 * 1024);
-	size_t uncompressedLength = sawyercoding_read_chunk(rw, tempBuffer);
-	if (uncompressedLength == SIZE_MAX) {
-		free(tempBuffer);
+	sawyercoding_chunk_header chunkHeader;
+	if (SDL_RWread(rw, &chunkHeader, sizeof(sawyercoding_chunk_header), 1) != 1) {
+		log_error("Unable to read chunk header!");
+		return false;
+	}
+
+	uint8 *src_buffer = malloc(chunkHeader.length);
+	if (src_buffer == NULL) {
+		log_error("Unable to read chunk data!");
+		return false;
+	}
+	if (SDL_RWread(rw, src_buffer, chunkHeader.length, 1) != 1) {
+		free(src_buffer);
+		log_error("Unable to read chunk data!");
 		return false;
-	} else {
-		memcpy(dst, tempBuffer, min(dstLength, uncompressedLength));
-		free(tempBuffer);
-		return true;
 	}
+
+	size_t uncompressedLength = decode_chunk(chunkHeader.encoding, src_buffer, chunkHeader.length, dst, dstLength);
+	free(src_buffer);
+	return uncompressedLength != SIZE_MAX;
+}
+
+/**
+ * Decodes the chunk at the start of src straight into dst, discarding anything that
+ * does not fit in dstLength. Returns the number of bytes the chunk occupies in src
+ * including its header, or 0 if the chunk is truncated or invalid.
+ */
+size_t sawyercoding_decode_chunk_safe(const uint8 *src, size_t srcLength, void *dst, size_t dstLength)
+{
+	sawyercoding_chunk_header chunkHeader;
+	if (srcLength < sizeof(sawyercoding_chunk_header)) {
+		log_error("Unable to read chunk header!");
+		return 0;
+	}
+	memcpy(&chunkHeader, src, sizeof(sawyercoding_chunk_header));
+	src += sizeof(sawyercoding_chunk_header);
+	srcLength -= sizeof(sawyercoding_chunk_header);
+
+	if (chunkHeader.length > srcLength) {
+		log_error("Unable to read chunk data!");
+		return 0;
+	}
+	if (decode_chunk(chunkHeader.encoding, src, chunkHeader.length, dst, dstLength) == SIZE_MAX) {
+		log_error("Invalid chunk data!");
+		return 0;
+	}
+	return sizeof(sawyercoding_chunk_header) + chunkHeader.length;
 }
 
 bool sawyercoding_skip_chunk(SDL_RWops *rw)
@@ -135,24 +186,9 @@ size_t sawyercoding_read_chunk(SDL_RWops* rw, uint8 *buffer)
 	}
 
 	// Decode chunk data
-	switch (chunkHeader.encoding) {
-	case CHUNK_ENCODING_NONE:
-		memcpy(buffer, src_buffer, chunkHeader.length);
-		break;
-	case CHUNK_ENCODING_RLE:
-		chunkHeader.length = decode_chunk_rle(src_buffer, buffer, chunkHeader.length);
-		break;
-	case CHUNK_ENCODING_RLECOMPRESSED:
-		chunkHeader.length = decode_chunk_rle(src_buffer, buffer, chunkHeader.length);
-		chunkHeader.length = decode_chunk_repeat(buffer, chunkHeader.length);
-		break;
-	case CHUNK_ENCODING_ROTATE:
-		memcpy(buffer, src_buffer, chunkHeader.length);
-		decode_chunk_rotate(buffer, chunkHeader.length);
-		break;
-	}
+	size_t length = decode_chunk(chunkHeader.encoding, src_buffer, chunkHeader.length, buffer, SIZE_MAX);
 	free(src_buffer);
-	return chunkHeader.length;
+	return length;
 }
 
 /**
@@ -184,25 +220,10 @@ size_t sawyercoding_read_chunk_with_size(SDL_RWops* rw, uint8 *buffer, const siz
 	}
 
 	// Decode chunk data
-	switch (chunkHeader.encoding) {
-	case CHUNK_ENCODING_NONE:
-		assert(chunkHeader.length <= buffer_size);
-		memcpy(buffer, src_buffer, chunkHeader.length);
-		break;
-	case CHUNK_ENCODING_RLE:
-		chunkHeader.length = decode_chunk_rle_with_size(src_buffer, buffer, chunkHeader.length, buffer_size);
-		break;
-	case CHUNK_ENCODING_RLECOMPRESSED:
-		chunkHeader.length = decode_chunk_rle_with_size(src_buffer, buffer, chunkHeader.length, buffer_size);
-		chunkHeader.length = decode_chunk_repeat(buffer, chunkHeader.length);
-		break;
-	case CHUNK_ENCODING_ROTATE:
-		memcpy(buffer, src_buffer, chunkHeader.length);
-		decode_chunk_rotate(buffer, chunkHeader.length);
-		break;
-	}
+	assert(chunkHeader.encoding != CHUNK_ENCODING_NONE || chunkHeader.length <= buffer_size);
+	size_t length = decode_chunk(chunkHeader.encoding, src_buffer, chunkHeader.length, buffer, buffer_size);
 	free(src_buffer);
-	return chunkHeader.length;
+	return length;
 }
 
 /**
@@ -250,7 +271,7 @@ size_t sawyercoding_write_chunk_buffer(uint8 *dst_file, uint8* buffer, sawyercod
 	case CHUNK_ENCODING_ROTATE:
 		encode_buffer = malloc(chunkHeader.length);
 		memcpy(encode_buffer, buffer, chunkHeader.length);
-		encode_chunk_rotate(encode_buffer, chunkHeader.length);
+		encode_chunk_rotate(encode_buffer, chunkHeader.length, 0);
 		memcpy(dst_file, &chunkHeader, sizeof(sawyercoding_chunk_header));
 		dst_file += sizeof(sawyercoding_chunk_header);
 		memcpy(dst_file, encode_buffer, chunkHeader.length);
@@ -350,6 +371,31 @@ int sawyercoding_validate_track_checksum(const uint8* src, size_t length){
 
 #pragma region Decoding
 
+/**
+ * Decodes a chunk body into dst_buffer, stopping once dstSize bytes have been
+ * written. Returns the decoded length, or SIZE_MAX if the chunk is invalid.
+ */
+static size_t decode_chunk(uint8 encoding, const uint8 *src_buffer, size_t length, uint8 *dst_buffer, size_t dstSize)
+{
+	switch (encoding) {
+	case CHUNK_ENCODING_NONE:
+		length = min(length, dstSize);
+		memcpy(dst_buffer, src_buffer, length);
+		return length;
+	case CHUNK_ENCODING_RLE:
+		return decode_chunk_rle_with_size(src_buffer, dst_buffer, length, dstSize);
+	case CHUNK_ENCODING_RLECOMPRESSED:
+		return decode_chunk_rle_repeat(src_buffer, dst_buffer, length, dstSize);
+	case CHUNK_ENCODING_ROTATE:
+		length = min(length, dstSize);
+		memcpy(dst_buffer, src_buffer, length);
+		decode_chunk_rotate(dst_buffer, length);
+		return length;
+	default:
+		return SIZE_MAX;
+	}
+}
+
 /**
  *
  *  rct2: 0x0067693A
@@ -385,61 +431,86 @@ static size_t decode_chunk_rle(const uint8* src_buffer, uint8* dst_buffer, size_
  */
 static size_t decode_chunk_rle_with_size(const uint8* src_buffer, uint8* dst_buffer, size_t length, size_t dstSize)
 {
-	size_t count;
-	uint8 *dst, rleCodeByte;
+	size_t count, dstLength;
+	uint8 rleCodeByte;
 
-	dst = dst_buffer;
+	dstLength = 0;
 
-	for (size_t i = 0; i < length; i++) {
+	for (size_t i = 0; i < length && dstLength < dstSize; i++) {
 		rleCodeByte = src_buffer[i];
 		if (rleCodeByte & 128) {
 			i++;
-			count = 257 - rleCodeByte;
-			assert(dst + count <= dst_buffer + dstSize);
-			memset(dst, src_buffer[i], count);
-			dst = (uint8*)((uintptr_t)dst + count);
+			if (i >= length)
+				break;
+			count = min(257 - rleCodeByte, dstSize - dstLength);
+			memset(dst_buffer + dstLength, src_buffer[i], count);
+			dstLength += count;
 		} else {
-			assert(dst + rleCodeByte + 1 <= dst_buffer + dstSize);
-			memcpy(dst, src_buffer + i + 1, rleCodeByte + 1);
-			dst = (uint8*)((uintptr_t)dst + rleCodeByte + 1);
+			count = min(min(rleCodeByte + 1, length - i - 1), dstSize - dstLength);
+			memcpy(dst_buffer + dstLength, src_buffer + i + 1, count);
+			dstLength += count;
 			i += rleCodeByte + 1;
 		}
 	}
 
 	// Return final size
-	return dst - dst_buffer;
+	return dstLength;
 }
 
 /**
+ * Decodes the RLE layer and the repeat layer of a chunk in a single pass. The RLE
+ * output is fed straight into the repeat decoder, so no intermediate copy of the
+ * chunk is needed.
  *
  *  rct2: 0x006769F1
  */
-static size_t decode_chunk_repeat(uint8 *buffer, size_t length)
+static size_t decode_chunk_rle_repeat(const uint8 *src_buffer, uint8 *dst_buffer, size_t length, size_t dstSize)
 {
-	size_t i, count;
-	uint8 *src, *dst, *copyOffset;
+	size_t dstLength = 0;
+	bool literal = false;
 
-	// Backup buffer
-	src = malloc(length);
-	memcpy(src, buffer, length);
-	dst = buffer;
-
-	for (i = 0; i < length; i++) {
-		if (src[i] == 0xFF) {
-			*dst++ = src[++i];
+	for (size_t i = 0; i < length && dstLength < dstSize; i++) {
+		uint8 rleCodeByte = src_buffer[i];
+		const uint8 *run;
+		size_t count, runStep;
+		if (rleCodeByte & 128) {
+			i++;
+			if (i >= length)
+				break;
+			run = src_buffer + i;
+			count = 257 - rleCodeByte;
+			runStep = 0;
 		} else {
-			count = (src[i] & 7) + 1;
-			copyOffset = dst + (int)(src[i] >> 3) - 32;
-			memcpy(dst, copyOffset, count);
-			dst = (uint8*)((uintptr_t)dst + count);
+			run = src_buffer + i + 1;
+			count = min(rleCodeByte + 1, length - i - 1);
+			runStep = 1;
+			i += rleCodeByte + 1;
 		}
-	}
 
-	// Free backup buffer
-	free(src);
+		for (; count != 0 && dstLength < dstSize; count--, run += runStep) {
+			uint8 code = *run;
+			if (literal) {
+				dst_buffer[dstLength++] = code;
+				literal = false;
+			} else if (code == 0xFF) {
+				literal = true;
+			} else {
+				size_t distance = 32 - (code >> 3);
+				size_t copyCount = min((size_t)(code & 7) + 1, dstSize - dstLength);
+				if (distance > dstLength)
+					return SIZE_MAX;
+
+				const uint8 *copySrc = dst_buffer + dstLength - distance;
+				uint8 *copyDst = dst_buffer + dstLength;
+				for (size_t j = 0; j < copyCount; j++)
+					copyDst[j] = copySrc[j];
+				dstLength += copyCount;
+			}
+		}
+	}
 
 	// Return final size
-	return dst - buffer;
+	return dstLength;
 }
 
 /**
@@ -507,41 +578,91 @@ static size_t encode_chunk_rle(const uint8 *src_buffer, uint8 *dst_buffer, size_
 	return dst - dst_buffer;
 }
 
+/**
+ * Encodes back-references into the previous 32 bytes, each copying up to 8 bytes.
+ *
+ * Rather than trying every offset in the window, candidates are found through a
+ * chain of earlier positions that start with the same byte. The chain is kept in a
+ * 32 entry ring (the window size) so no allocation is needed. Candidates are tried
+ * from the oldest to the newest and only a strictly longer match replaces the best
+ * one, which picks exactly the same match as an exhaustive search of the window.
+ */
 static size_t encode_chunk_repeat(const uint8 *src_buffer, uint8 *dst_buffer, size_t length)
 {
-	size_t i, j, outLength;
-	size_t searchIndex, searchEnd, maxRepeatCount;
-	size_t bestRepeatIndex, bestRepeatCount, repeatIndex, repeatCount;
+	return encode_chunk_repeat_range(src_buffer, dst_buffer, 0, length);
+}
+
+/**
+ * Encodes src_buffer[begin..end) so that the output can be appended to the encoding
+ * of src_buffer[0..begin). Bytes before begin are only used as history for matches,
+ * which allows separate ranges of a chunk to be encoded independently.
+ */
+static size_t encode_chunk_repeat_range(const uint8 *src_buffer, uint8 *dst_buffer, size_t begin, size_t end)
+{
+	size_t lastPosition[256];
+	uint8 previousDistance[32];
+	size_t candidates[32];
+	size_t i, outLength;
+	size_t length = end;
 
-	if (length == 0)
+	if (begin >= end)
 		return 0;
 
+	memset(lastPosition, 0, sizeof(lastPosition));
+
 	outLength = 0;
+	i = begin;
+
+	if (begin == 0) {
+		// Need to emit at least one byte, otherwise there is nothing to repeat
+		*dst_buffer++ = 255;
+		*dst_buffer++ = src_buffer[0];
+		outLength += 2;
+		i++;
+	}
 
-	// Need to emit at least one byte, otherwise there is nothing to repeat
-	*dst_buffer++ = 255;
-	*dst_buffer++ = src_buffer[0];
-	outLength += 2;
+	// Positions are stored plus one so that zero means no previous position
+	size_t inserted = begin - min(begin, 32);
 
 	// Iterate through remainder of the source buffer
-	for (i = 1; i < length; ) {
-		searchIndex = (i < 32) ? 0 : (i - 32);
-		searchEnd = i - 1;
-
-		bestRepeatCount = 0;
-		for (repeatIndex = searchIndex; repeatIndex <= searchEnd; repeatIndex++) {
-			repeatCount = 0;
-			maxRepeatCount = min(min(7, searchEnd - repeatIndex), length - i - 1);
-			// maxRepeatCount should not exceed length
-			assert(repeatIndex + maxRepeatCount < length);
-			assert(i + maxRepeatCount < length);
-			for (j = 0; j <= maxRepeatCount; j++) {
-				if (src_buffer[repeatIndex + j] == src_buffer[i + j]) {
-					repeatCount++;
-				} else {
+	for (; i < length; ) {
+		// Add all positions before i to the chains
+		for (; inserted < i; inserted++) {
+			uint8 value = src_buffer[inserted];
+			size_t distance = inserted + 1 - lastPosition[value];
+			previousDistance[inserted & 31] = (lastPosition[value] != 0 && distance <= 32) ? (uint8)distance : 0;
+			lastPosition[value] = inserted + 1;
+		}
+
+		// Gather the window positions that start with the current byte, newest first
+		size_t numCandidates = 0;
+		if (lastPosition[src_buffer[i]] != 0) {
+			size_t candidate = lastPosition[src_buffer[i]] - 1;
+			while (i - candidate <= 32) {
+				candidates[numCandidates++] = candidate;
+				uint8 distance = previousDistance[candidate & 31];
+				if (distance == 0)
 					break;
-				}
+				candidate -= distance;
 			}
+		}
+
+		// A match may not run past the current position or the end of the buffer
+		size_t bestRepeatIndex = 0;
+		size_t bestRepeatCount = 0;
+		size_t maxAvailable = min(8, length - i);
+		while (numCandidates > 0) {
+			size_t repeatIndex = candidates[--numCandidates];
+			size_t maxRepeatCount = min(maxAvailable, i - repeatIndex);
+
+			// Newer candidates can only be shorter, nothing left can beat the best
+			if (maxRepeatCount <= bestRepeatCount)
+				break;
+
+			size_t repeatCount = 1;
+			while (repeatCount < maxRepeatCount && src_buffer[repeatIndex + repeatCount] == src_buffer[i + repeatCount])
+				repeatCount++;
+
 			if (repeatCount > bestRepeatCount) {
 				bestRepeatIndex = repeatIndex;
 				bestRepeatCount = repeatCount;
@@ -567,10 +688,10 @@ static size_t encode_chunk_repeat(const uint8 *src_buffer, uint8 *dst_buffer, si
 	return outLength;
 }
 
-static void encode_chunk_rotate(uint8 *buffer, size_t length)
+static void encode_chunk_rotate(uint8 *buffer, size_t length, size_t offset)
 {
 	size_t i;
-	uint8 code = 1;
+	uint8 code = (1 + (offset * 2)) % 8;
 	for (i = 0; i < length; i++) {
 		buffer[i] = rol8(buffer[i], code);
 		code = (code + 2) % 8;
@@ -579,6 +700,301 @@ static void encode_chunk_rotate(uint8 *buffer, size_t length)
 
 #pragma endregion
 
+#pragma region Chunk writer
+
+// Chunks are encoded in segments of this size, each written out before the next is encoded, so
+// memory use is bounded regardless of chunk size
+#define SAWYERCODING_WRITER_SEGMENT_SIZE (256 * 1024)
+#define SAWYERCODING_WRITER_MAX_THREADS 4
+
+// Repeat encoding writes at most two bytes per input byte. RLE writes at most four bytes for
+// every three, a single literal byte followed by a run of two.
+#define SAWYERCODING_REPEAT_BOUND(length) ((length) * 2 + 16)
+#define SAWYERCODING_RLE_BOUND(length) ((length) + ((length) + 2) / 3 + 16)
+
+typedef struct sawyercoding_writer_segment {
+	const uint8 *src;
+	size_t begin;
+	size_t end;
+	uint8 encoding;
+	uint8 *buffer;
+	uint8 *scratch;
+	size_t length;
+
+	// Worker thread that encodes this segment, created once for the lifetime of the writer
+	SDL_Thread *thread;
+	SDL_sem *start;
+	SDL_sem *done;
+	bool quit;
+} sawyercoding_writer_segment;
+
+struct sawyercoding_writer {
+	SDL_RWops *rw;
+	SDL_RWops *checksum_rw;
+	uint32 checksum;
+	bool failed;
+	int num_segments;
+	sawyercoding_writer_segment segments[SAWYERCODING_WRITER_MAX_THREADS];
+};
+
+static Sint64 sawyercoding_writer_rw_size(SDL_RWops *context)
+{
+	sawyercoding_writer *writer = (sawyercoding_writer*)context->hidden.unknown.data1;
+	return SDL_RWsize(writer->rw);
+}
+
+static Sint64 sawyercoding_writer_rw_seek(SDL_RWops *context, Sint64 offset, int whence)
+{
+	sawyercoding_writer *writer = (sawyercoding_writer*)context->hidden.unknown.data1;
+	return SDL_RWseek(writer->rw, offset, whence);
+}
+
+static size_t sawyercoding_writer_rw_read(SDL_RWops *context, void *ptr, size_t size, size_t maxnum)
+{
+	return 0;
+}
+
+static size_t sawyercoding_writer_rw_write(SDL_RWops *context, const void *ptr, size_t size, size_t num)
+{
+	sawyercoding_writer *writer = (sawyercoding_writer*)context->hidden.unknown.data1;
+	return sawyercoding_writer_write(writer, ptr, size * num) ? num : 0;
+}
+
+static int sawyercoding_writer_rw_close(SDL_RWops *context)
+{
+	return 0;
+}
+
+static int sawyercoding_writer_encode_segment(void *arg);
+
+static int sawyercoding_writer_worker(void *arg)
+{
+	sawyercoding_writer_segment *segment = (sawyercoding_writer_segment*)arg;
+	for (;;) {
+		SDL_SemWait(segment->start);
+		if (segment->quit)
+			break;
+
+		sawyercoding_writer_encode_segment(segment);
+		SDL_SemPost(segment->done);
+	}
+	return 0;
+}
+
+sawyercoding_writer *sawyercoding_writer_create(SDL_RWops *rw, bool parallel)
+{
+	sawyercoding_writer *writer = calloc(1, sizeof(sawyercoding_writer));
+	if (writer == NULL)
+		return NULL;
+
+	writer->rw = rw;
+	writer->num_segments = parallel ? clamp(1, SDL_GetCPUCount(), SAWYERCODING_WRITER_MAX_THREADS) : 1;
+	for (int i = 0; i < writer->num_segments; i++) {
+		sawyercoding_writer_segment *segment = &writer->segments[i];
+		segment->buffer = malloc(SAWYERCODING_RLE_BOUND(SAWYERCODING_REPEAT_BOUND(SAWYERCODING_WRITER_SEGMENT_SIZE)));
+		segment->scratch = malloc(SAWYERCODING_REPEAT_BOUND(SAWYERCODING_WRITER_SEGMENT_SIZE));
+		if (segment->buffer == NULL || segment->scratch == NULL) {
+			sawyercoding_writer_dispose(writer);
+			return NULL;
+		}
+
+		// The first segment is encoded on the calling thread, the others fall back to it if
+		// their thread can not be created
+		if (i > 0) {
+			segment->start = SDL_CreateSemaphore(0);
+			segment->done = SDL_CreateSemaphore(0);
+			if (segment->start != NULL && segment->done != NULL) {
+				segment->thread = SDL_CreateThread(sawyercoding_writer_worker, "sawyercoding", segment);
+			}
+		}
+	}
+
+	writer->checksum_rw = SDL_AllocRW();
+	if (writer->checksum_rw == NULL) {
+		sawyercoding_writer_dispose(writer);
+		return NULL;
+	}
+	writer->checksum_rw->type = SDL_RWOPS_UNKNOWN;
+	writer->checksum_rw->size = sawyercoding_writer_rw_size;
+	writer->checksum_rw->seek = sawyercoding_writer_rw_seek;
+	writer->checksum_rw->read = sawyercoding_writer_rw_read;
+	writer->checksum_rw->write = sawyercoding_writer_rw_write;
+	writer->checksum_rw->close = sawyercoding_writer_rw_close;
+	writer->checksum_rw->hidden.unknown.data1 = writer;
+	return writer;
+}
+
+void sawyercoding_writer_dispose(sawyercoding_writer *writer)
+{
+	if (writer == NULL)
+		return;
+
+	for (int i = 0; i < writer->num_segments; i++) {
+		sawyercoding_writer_segment *segment = &writer->segments[i];
+		if (segment->thread != NULL) {
+			segment->quit = true;
+			SDL_SemPost(segment->start);
+			SDL_WaitThread(segment->thread, NULL);
+		}
+		if (segment->start != NULL) {
+			SDL_DestroySemaphore(segment->start);
+		}
+		if (segment->done != NULL) {
+			SDL_DestroySemaphore(segment->done);
+		}
+		free(segment->buffer);
+		free(segment->scratch);
+	}
+	if (writer->checksum_rw != NULL) {
+		SDL_FreeRW(writer->checksum_rw);
+	}
+	free(writer);
+}
+
+SDL_RWops *sawyercoding_writer_get_rw(sawyercoding_writer *writer)
+{
+	return writer->checksum_rw;
+}
+
+bool sawyercoding_writer_write(sawyercoding_writer *writer, const void *data, size_t length)
+{
+	if (writer->failed)
+		return false;
+
+	if (length != 0 && SDL_RWwrite(writer->rw, data, length, 1) != 1) {
+		log_error("Unable to write chunk data!");
+		writer->failed = true;
+		return false;
+	}
+	writer->checksum += sawyercoding_calculate_checksum(data, length);
+	return true;
+}
+
+static int sawyercoding_writer_encode_segment(void *arg)
+{
+	sawyercoding_writer_segment *segment = (sawyercoding_writer_segment*)arg;
+	size_t length = segment->end - segment->begin;
+	switch (segment->encoding) {
+	case CHUNK_ENCODING_RLE:
+		segment->length = encode_chunk_rle(segment->src + segment->begin, segment->buffer, length);
+		break;
+	case CHUNK_ENCODING_RLECOMPRESSED:
+		length = encode_chunk_repeat_range(segment->src, segment->scratch, segment->begin, segment->end);
+		segment->length = encode_chunk_rle(segment->scratch, segment->buffer, length);
+		break;
+	case CHUNK_ENCODING_ROTATE:
+		memcpy(segment->buffer, segment->src + segment->begin, length);
+		encode_chunk_rotate(segment->buffer, length, segment->begin);
+		segment->length = length;
+		break;
+	default:
+		memcpy(segment->buffer, segment->src + segment->begin, length);
+		segment->length = length;
+		break;
+	}
+	return 0;
+}
+
+/**
+ * Encodes a chunk and writes it to the stream. Chunks are encoded in segments which are
+ * independent of each other, so they can be encoded on several threads and each one is
+ * written out before the buffers are reused. The chunk length is only known at the end,
+ * so the header is written last.
+ */
+bool sawyercoding_writer_write_chunk(sawyercoding_writer *writer, const void *data, sawyercoding_chunk_header chunkHeader)
+{
+	if (writer->failed)
+		return false;
+
+	if (gUseRLE == false) {
+		if (chunkHeader.encoding == CHUNK_ENCODING_RLE || chunkHeader.encoding == CHUNK_ENCODING_RLECOMPRESSED) {
+			chunkHeader.encoding = CHUNK_ENCODING_NONE;
+		}
+	}
+
+	const uint8 *src = (const uint8*)data;
+	size_t length = chunkHeader.length;
+	if (chunkHeader.encoding == CHUNK_ENCODING_NONE) {
+		return sawyercoding_writer_write(writer, &chunkHeader, sizeof(sawyercoding_chunk_header)) &&
+		       sawyercoding_writer_write(writer, src, length);
+	}
+
+	// Leave space for the header, it is filled in once the encoded length is known
+	Sint64 headerPosition = SDL_RWtell(writer->rw);
+	sawyercoding_chunk_header placeholder = { 0 };
+	if (SDL_RWwrite(writer->rw, &placeholder, sizeof(sawyercoding_chunk_header), 1) != 1) {
+		log_error("Unable to write chunk header!");
+		writer->failed = true;
+		return false;
+	}
+
+	size_t encodedLength = 0;
+	size_t position = 0;
+	while (position < length) {
+		// Encode the next batch of segments, one per thread
+		int numSegments = 0;
+		for (; numSegments < writer->num_segments && position < length; numSegments++) {
+			sawyercoding_writer_segment *segment = &writer->segments[numSegments];
+			segment->src = src;
+			segment->begin = position;
+			segment->end = min(length, position + SAWYERCODING_WRITER_SEGMENT_SIZE);
+			segment->encoding = chunkHeader.encoding;
+			position = segment->end;
+			if (segment->thread != NULL) {
+				SDL_SemPost(segment->start);
+			}
+		}
+		sawyercoding_writer_encode_segment(&writer->segments[0]);
+		for (int i = 1; i < numSegments; i++) {
+			sawyercoding_writer_segment *segment = &writer->segments[i];
+			if (segment->thread != NULL) {
+				SDL_SemWait(segment->done);
+			} else {
+				sawyercoding_writer_encode_segment(segment);
+			}
+		}
+
+		for (int i = 0; i < numSegments; i++) {
+			sawyercoding_writer_segment *segment = &writer->segments[i];
+			if (!sawyercoding_writer_write(writer, segment->buffer, segment->length)) {
+				return false;
+			}
+			encodedLength += segment->length;
+		}
+	}
+
+	// Go back and write the real header
+	Sint64 endPosition = SDL_RWtell(writer->rw);
+	chunkHeader.length = (uint32)encodedLength;
+	SDL_RWseek(writer->rw, headerPosition, RW_SEEK_SET);
+	if (SDL_RWwrite(writer->rw, &chunkHeader, sizeof(sawyercoding_chunk_header), 1) != 1) {
+		log_error("Unable to write chunk header!");
+		writer->failed = true;
+		return false;
+	}
+	SDL_RWseek(writer->rw, endPosition, RW_SEEK_SET);
+	writer->checksum += sawyercoding_calculate_checksum((const uint8*)&chunkHeader, sizeof(sawyercoding_chunk_header));
+	return true;
+}
+
+/**
+ * Appends the checksum of everything written so far, completing the file.
+ */
+bool sawyercoding_writer_finish(sawyercoding_writer *writer)
+{
+	if (writer->failed)
+		return false;
+
+	if (SDL_RWwrite(writer->rw, &writer->checksum, sizeof(uint32), 1) != 1) {
+		log_error("Unable to write checksum!");
+		writer->failed = true;
+		return false;
+	}
+	return true;
+}
+
+#pragma endregion
+
 int sawyercoding_detect_file_type(const uint8 *src, size_t length)
 {
 	size_t i;
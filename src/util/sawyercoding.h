@@ -47,9 +47,13 @@ enum {
 	FILE_TYPE_SC4 = (2 << 2)
 };
 
+typedef struct sawyercoding_writer sawyercoding_writer;
+
 int sawyercoding_validate_checksum(SDL_RWops* rw);
+bool sawyercoding_validate_checksum_buffer(const uint8 *buffer, size_t length);
 uint32 sawyercoding_calculate_checksum(const uint8* buffer, size_t length);
 bool sawyercoding_read_chunk_safe(SDL_RWops *rw, void *dst, size_t dstLength);
+size_t sawyercoding_decode_chunk_safe(const uint8 *src, size_t srcLength, void *dst, size_t dstLength);
 bool sawyercoding_skip_chunk(SDL_RWops *rw);
 size_t sawyercoding_read_chunk(SDL_RWops* rw, uint8 *buffer);
 size_t sawyercoding_read_chunk_with_size(SDL_RWops* rw, uint8 *buffer, const size_t buffer_size);
@@ -61,6 +65,13 @@ size_t sawyercoding_decode_td6(const uint8 *src, uint8 *dst, size_t length);
 size_t sawyercoding_encode_td6(const uint8 *src, uint8 *dst, size_t length);
 int sawyercoding_validate_track_checksum(const uint8* src, size_t length);
 
+sawyercoding_writer *sawyercoding_writer_create(SDL_RWops *rw, bool parallel);
+void sawyercoding_writer_dispose(sawyercoding_writer *writer);
+SDL_RWops *sawyercoding_writer_get_rw(sawyercoding_writer *writer);
+bool sawyercoding_writer_write(sawyercoding_writer *writer, const void *data, size_t length);
+bool sawyercoding_writer_write_chunk(sawyercoding_writer *writer, const void *data, sawyercoding_chunk_header chunkHeader);
+bool sawyercoding_writer_finish(sawyercoding_writer *writer);
+
 int sawyercoding_detect_file_type(const uint8 *src, size_t length);
 int sawyercoding_detect_rct1_version(int gameVersion);
 
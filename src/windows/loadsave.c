@@ -185,7 +185,8 @@ rct_window *window_loadsave_open(int type, char *defaultName)
 	case LOADSAVETYPE_GAME:
 		w->widgets[WIDX_TITLE].text = isSave ? STR_FILE_DIALOG_TITLE_SAVE_GAME : STR_FILE_DIALOG_TITLE_LOAD_GAME;
 		if (window_loadsave_get_dir(gConfigGeneral.last_save_game_directory, path, "save")) {
-			window_loadsave_populate_list(w, isSave, path, ".sv6");
+			// Title sequences can only use SV6 saves
+			window_loadsave_populate_list(w, isSave, path, gLoadSaveTitleSequenceSave ? ".sv6" : ".sv6;.park");
 			success = true;
 		}
 		break;
@@ -249,7 +250,7 @@ static bool browse(bool isSave, char *path)
 	case LOADSAVETYPE_GAME:
 		title = isSave ? STR_FILE_DIALOG_TITLE_SAVE_GAME : STR_FILE_DIALOG_TITLE_LOAD_GAME;
 		desc.filters[0].name = language_get_string(STR_OPENRCT2_SAVED_GAME);
-		desc.filters[0].pattern = isSave ? "*.sv6" : "*.sv4;*.sv6";
+		desc.filters[0].pattern = isSave ? "*.sv6;*.park" : "*.sv4;*.sv6;*.park";
 		break;
 	case LOADSAVETYPE_LANDSCAPE:
 		title = isSave ? STR_FILE_DIALOG_TITLE_SAVE_LANDSCAPE : STR_FILE_DIALOG_TITLE_LOAD_LANDSCAPE;
@@ -388,6 +389,24 @@ static void window_loadsave_scrollmouseover(rct_window *w, int scrollIndex, int
 	window_invalidate(w);
 }
 
+/**
+ * Checks whether the name ends with one of the listed extensions, separated by semicolons.
+ */
+static bool window_loadsave_has_listed_extension(const char *name, const char *extensions)
+{
+	const char *extension = path_get_extension(name);
+	while (*extensions != '\0') {
+		size_t extensionLength = strcspn(extensions, ";");
+		if (strlen(extension) == extensionLength && _strnicmp(extension, extensions, extensionLength) == 0)
+			return true;
+
+		extensions += extensionLength;
+		if (*extensions == ';')
+			extensions++;
+	}
+	return false;
+}
+
 static void window_loadsave_textinput(rct_window *w, int widgetIndex, char *text)
 {
 	char path[MAX_PATH];
@@ -413,7 +432,12 @@ static void window_loadsave_textinput(rct_window *w, int widgetIndex, char *text
 
 	safe_strcpy(path, _directory, sizeof(path));
 	strncat(path, text, sizeof(path) - strnlen(path, MAX_PATH) - 1);
-	strncat(path, _extension, sizeof(path) - strnlen(path, MAX_PATH) - 1);
+
+	// New files get the first of the listed extensions unless another one was typed
+	if (!window_loadsave_has_listed_extension(text, _extension)) {
+		size_t extensionLength = strcspn(_extension, ";");
+		strncat(path, _extension, min(extensionLength, sizeof(path) - strnlen(path, MAX_PATH) - 1));
+	}
 
 	overwrite = 0;
 	for (i = 0; i < _listItemsCount; i++) {
@@ -621,34 +645,44 @@ static void window_loadsave_populate_list(rct_window *w, int includeNewItem, con
 		}
 		platform_enumerate_files_end(fileEnumHandle);
 
-		// List all files with the wanted extension
-		char filter[MAX_PATH];
-		safe_strcpy(filter, directory, sizeof(filter));
-		safe_strcat_path(filter, "*", sizeof(filter));
-		safe_strcat(filter, extension, sizeof(filter));
+		// List all files with the wanted extensions, separated by semicolons
+		const char *nextExtension = extension;
+		while (*nextExtension != '\0') {
+			size_t extensionLength = strcspn(nextExtension, ";");
 
-		file_info fileInfo;
-		fileEnumHandle = platform_enumerate_files_begin(filter);
-		while (platform_enumerate_files_next(fileEnumHandle, &fileInfo)) {
-			if (listItemCapacity <= _listItemsCount) {
-				listItemCapacity *= 2;
-				_listItems = realloc(_listItems, listItemCapacity * sizeof(loadsave_list_item));
+			char filter[MAX_PATH];
+			safe_strcpy(filter, directory, sizeof(filter));
+			safe_strcat_path(filter, "*", sizeof(filter));
+			strncat(filter, nextExtension, min(extensionLength, sizeof(filter) - strlen(filter) - 1));
+
+			nextExtension += extensionLength;
+			if (*nextExtension == ';') {
+				nextExtension++;
 			}
 
-			loadsave_list_item *listItem = &_listItems[_listItemsCount];
+			file_info fileInfo;
+			fileEnumHandle = platform_enumerate_files_begin(filter);
+			while (platform_enumerate_files_next(fileEnumHandle, &fileInfo)) {
+				if (listItemCapacity <= _listItemsCount) {
+					listItemCapacity *= 2;
+					_listItems = realloc(_listItems, listItemCapacity * sizeof(loadsave_list_item));
+				}
 
-			safe_strcpy(listItem->path, directory, sizeof(listItem->path));
-			safe_strcat_path(listItem->path, fileInfo.path, sizeof(listItem->path));
-			listItem->type = TYPE_FILE;
-			listItem->date_modified = platform_file_get_modified_time(listItem->path);
+				loadsave_list_item *listItem = &_listItems[_listItemsCount];
 
-			// Remove the extension
-			safe_strcpy(listItem->name, fileInfo.path, sizeof(listItem->name));
-			path_remove_extension(listItem->name);
+				safe_strcpy(listItem->path, directory, sizeof(listItem->path));
+				safe_strcat_path(listItem->path, fileInfo.path, sizeof(listItem->path));
+				listItem->type = TYPE_FILE;
+				listItem->date_modified = platform_file_get_modified_time(listItem->path);
 
-			_listItemsCount++;
+				// Remove the extension
+				safe_strcpy(listItem->name, fileInfo.path, sizeof(listItem->name));
+				path_remove_extension(listItem->name);
+
+				_listItemsCount++;
+			}
+			platform_enumerate_files_end(fileEnumHandle);
 		}
-		platform_enumerate_files_end(fileEnumHandle);
 
 		window_loadsave_sort_list(0, _listItemsCount - 1);
 	}
@@ -677,9 +711,8 @@ static void window_loadsave_select(rct_window *w, const char *path)
 		save_path(&gConfigGeneral.last_save_game_directory, path);
 		if (gLoadSaveTitleSequenceSave) {
 			utf8 newName[MAX_PATH];
-			char *extension = (char*)path_get_extension(path);
 			safe_strcpy(newName, path_get_filename(path), MAX_PATH);
-			if (_stricmp(extension, ".sv6") != 0 && _stricmp(extension, ".sc6") != 0)
+			if (!window_loadsave_has_listed_extension(path, ".sv6;.sc6"))
 				strcat(newName, ".sv6");
 			if (title_sequence_save_exists(gCurrentTitleSequence, newName)) {
 				set_format_arg(0, uint32, (uint32)&_listItems[w->selected_list_item].name);
@@ -707,7 +740,10 @@ static void window_loadsave_select(rct_window *w, const char *path)
 		save_path(&gConfigGeneral.last_save_game_directory, path);
 		rw = SDL_RWFromFile(path, "wb+");
 		if (rw != NULL) {
-			int success = scenario_save(rw, gConfigGeneral.save_plugin_data ? 1 : 0);
+			int flags = gConfigGeneral.save_plugin_data ? 1 : 0;
+			int success = get_file_extension_type(path) == FILE_EXTENSION_PARK ?
+				scenario_save_park(rw, flags) :
+				scenario_save(rw, flags);
 			SDL_RWclose(rw);
 			if (success) {
 				safe_strcpy(gScenarioSavePath, path, MAX_PATH);
@@ -406,6 +406,9 @@ static rct_xy16 window_multiplayer_information_get_size()
 	int lineHeight = font_get_line_height(fontSpriteBase);
 	height += (numLines + 1) * lineHeight;
 
+	// Network statistics
+	height += 3 + 3 * 11;
+
 	_windowInformationSizeDirty = false;
 	_windowInformationSize = (rct_xy16){ width, height };
 	return _windowInformationSize;
@@ -421,6 +424,11 @@ static void window_multiplayer_information_update(rct_window *w)
 {
 	w->frame_no++;
 	widget_invalidate(w, WIDX_TAB1 + w->page);
+
+	// The network statistics are updated once a second
+	if (w->frame_no % 40 == 0) {
+		window_invalidate(w);
+	}
 }
 
 static void window_multiplayer_information_invalidate(rct_window *w)
@@ -473,7 +481,24 @@ static void window_multiplayer_information_paint(rct_window *w, rct_drawpixelinf
 		const utf8 * providerWebsite = network_get_server_provider_website();
 		if (!str_is_null_or_empty(providerWebsite)) {
 			gfx_draw_string_left(dpi, STR_PROVIDER_WEBSITE, (void*)&providerWebsite, 0, x, y);
+			y += 11;
 		}
+		y += 3;
+
+		network_stats_summary stats;
+		network_get_stats(&stats);
+
+		uint32 traffic[] = { stats.bytes_in_per_second, stats.bytes_out_per_second };
+		gfx_draw_string_left(dpi, STR_MULTIPLAYER_TRAFFIC, traffic, 0, x, y);
+		y += 11;
+
+		uint32 sendQueue[] = { stats.queue_depth, stats.queue_time_p99 };
+		gfx_draw_string_left(dpi, STR_MULTIPLAYER_SEND_QUEUE, sendQueue, 0, x, y);
+		y += 11;
+
+		// Clients measure their own game commands, the server the pings to its clients
+		uint32 roundTrip = network_get_mode() == NETWORK_MODE_CLIENT ? stats.command_latency_p99 : stats.ping_p99;
+		gfx_draw_string_left(dpi, STR_MULTIPLAYER_ROUND_TRIP, &roundTrip, 0, x, y);
 	}
 }
 
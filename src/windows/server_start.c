@@ -153,7 +153,7 @@ static void window_server_start_scenarioselect_callback(const utf8 *path)
 {
 	network_set_password(_password);
 	if (scenario_load_and_play_from_path(path)) {
-		network_begin_server(gConfigNetwork.default_port);
+		network_begin_server(gConfigNetwork.default_port, NULL);
 	} else {
 		title_load();
 	}
@@ -162,7 +162,7 @@ static void window_server_start_scenarioselect_callback(const utf8 *path)
 static void window_server_start_loadsave_callback(int result)
 {
 	if (result == MODAL_RESULT_OK) {
-		network_begin_server(gConfigNetwork.default_port);
+		network_begin_server(gConfigNetwork.default_port, NULL);
 	}
 }
 